@@ -14,10 +14,13 @@ major=${version%%.*} # 2.3 -> 2, 2.3.1 -> 2
 minor=${version#*.}  # 2.3 -> 3, 2.3.1 -> 3.1
 minor=${minor%.*}    # 3 -> 3, 3.1 -> 3
 
-sdkmajor=$major
+# one API change in a minor release: the new virtual functions of 2.11
+sdkmajor=$(($major+1))
 sdkminor=$minor
 
-hostmajor=$(($major+1)) # there has been one API change in a minor release
+# there have been two API changes in minor releases: one in 2.x
+# before 2.10, and the new virtual functions and members of 2.11
+hostmajor=$(($major+2))
 hostminor=$minor
 
 acs="`echo $version | tr '.' '_'`"
@@ -37,6 +37,7 @@
 #include "AmplitudeFollower.h"
 
 #include <cmath>
+#include <cstring>
 
 #include <string>
 #include <vector>
@@ -130,6 +131,22 @@ AmplitudeFollower::reset()
     m_previn = 0.0f;
 }
 
+bool
+AmplitudeFollower::getState(StateData &state) const
+{
+    const unsigned char *p = (const unsigned char *)&m_previn;
+    state.assign(p, p + sizeof(m_previn));
+    return true;
+}
+
+bool
+AmplitudeFollower::setState(const StateData &state)
+{
+    if (state.size() != sizeof(m_previn)) return false;
+    memcpy(&m_previn, &state[0], sizeof(m_previn));
+    return true;
+}
+
 AmplitudeFollower::OutputList
 AmplitudeFollower::getOutputDescriptors() const
 {
@@ -55,6 +55,12 @@ public:
 
     InputDomain getInputDomain() const { return TimeDomain; }
 
+    // The envelope carries over from one block to the next without limit
+    StateDependency getStateDependency() const { return WholeSignal; }
+
+    bool getState(StateData &state) const;
+    bool setState(const StateData &state);
+
     std::string getIdentifier() const;
     std::string getName() const;
     std::string getDescription() const;
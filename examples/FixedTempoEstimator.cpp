@@ -63,6 +63,20 @@ public:
 
     OutputList getOutputDescriptors() const;
 
+    void setTaskScheduler(Vamp::TaskScheduler *scheduler) {
+        m_scheduler = scheduler;
+    }
+
+    void setEnabledOutputs(const vector<bool> &enabled) {
+        m_enabled = enabled;
+    }
+
+    bool setSpectrumFormat(SpectrumFormat format) {
+        if (format == MagnitudeSpectrum) return false;
+        m_powerInput = (format == PowerSpectrum);
+        return true;
+    }
+
     bool initialise(size_t channels, size_t stepSize, size_t blockSize);
     void reset();
     FeatureSet process(const float *const *, RealTime);
@@ -75,6 +89,10 @@ private:
     float lag2tempo(int);
     int tempo2lag(float);
 
+    bool isEnabled(int output) const {
+        return output >= int(m_enabled.size()) || m_enabled[output];
+    }
+
     float m_inputSampleRate;
     size_t m_stepSize;
     size_t m_blockSize;
@@ -84,6 +102,7 @@ private:
     float m_maxdflen;
 
     float *m_priorMagnitudes;
+    bool m_powerInput;
 
     size_t m_dfsize;
     float *m_df;
@@ -94,6 +113,9 @@ private:
 
     Vamp::RealTime m_start;
     Vamp::RealTime m_lasttime;
+
+    Vamp::TaskScheduler *m_scheduler;
+    vector<bool> m_enabled;
 };
 
 FixedTempoEstimator::D::D(float inputSampleRate) :
@@ -104,11 +126,13 @@ FixedTempoEstimator::D::D(float inputSampleRate) :
     m_maxbpm(190),
     m_maxdflen(10),
     m_priorMagnitudes(0),
+    m_powerInput(false),
     m_df(0),
     m_r(0),
     m_fr(0),
     m_t(0),
-    m_n(0)
+    m_n(0),
+    m_scheduler(Vamp::TaskScheduler::getSerialScheduler())
 {
 }
 
@@ -333,10 +357,16 @@ FixedTempoEstimator::D::process(const float *const *inputBuffers, RealTime ts)
 
     for (size_t i = 1; i < m_blockSize/2; ++i) {
 
-        float real = inputBuffers[0][i*2];
-        float imag = inputBuffers[0][i*2 + 1];
+        float sqrmag;
+
+        if (m_powerInput) {
+            sqrmag = inputBuffers[0][i];
+        } else {
+            float real = inputBuffers[0][i*2];
+            float imag = inputBuffers[0][i*2 + 1];
+            sqrmag = real * real + imag * imag;
+        }
 
-        float sqrmag = real * real + imag * imag;
         value += fabsf(sqrmag - m_priorMagnitudes[i]);
 
         m_priorMagnitudes[i] = sqrmag;
@@ -402,16 +432,34 @@ FixedTempoEstimator::D::calculate()
         m_t[i]  = lag2tempo(i);
     }
 
-    // Calculate the raw autocorrelation of the detection function
+    // Everything from here on is only needed for the outputs derived
+    // from the autocorrelation
 
-    for (int i = 0; i < n/2; ++i) {
+    bool wantTempo =
+        isEnabled(TempoOutput) || isEnabled(CandidatesOutput);
+
+    if (!wantTempo &&
+        !isEnabled(ACFOutput) &&
+        !isEnabled(FilteredACFOutput)) {
+        return;
+    }
+
+    // Calculate the raw autocorrelation of the detection function.
+    // Each lag is independent of the others, so they can be shared
+    // out among the host's threads
+
+    m_scheduler->parallelFor(n/2, [this, n](size_t lag) {
+
+        int i = int(lag);
 
         for (int j = i; j < n; ++j) {
             m_r[i] += m_df[j] * m_df[j - i];
         }
 
         m_r[i] /= n - i - 1;
-    }
+    });
+
+    if (!wantTempo && !isEnabled(FilteredACFOutput)) return;
 
     // Filter the autocorrelation and average out the tempo estimates
     
@@ -494,7 +542,7 @@ FixedTempoEstimator::D::assembleFeatures()
 
     int n = m_n;
 
-    for (int i = 0; i < n; ++i) {
+    for (int i = 0; i < n && isEnabled(DFOutput); ++i) {
 
         // Return the detection function in the DF output
 
@@ -505,7 +553,7 @@ FixedTempoEstimator::D::assembleFeatures()
         fs[DFOutput].push_back(feature);
     }
 
-    for (int i = 1; i < n/2; ++i) {
+    for (int i = 1; i < n/2 && isEnabled(ACFOutput); ++i) {
 
         // Return the raw autocorrelation in the ACF output, each
         // value labelled according to its corresponding tempo
@@ -525,13 +573,17 @@ FixedTempoEstimator::D::assembleFeatures()
     int p0 = tempo2lag(t1);
     int p1 = tempo2lag(t0);
 
+    bool wantTempo =
+        isEnabled(TempoOutput) || isEnabled(CandidatesOutput);
+
     std::map<float, int> candidates;
 
     for (int i = p0; i <= p1 && i+1 < n/2; ++i) {
 
         if (i < 1) continue;
         
-        if (m_fr[i] > m_fr[i-1] &&
+        if (wantTempo &&
+            m_fr[i] > m_fr[i-1] &&
             m_fr[i] > m_fr[i+1]) {
 
             // This is a peak in the filtered autocorrelation: stick
@@ -543,6 +595,8 @@ FixedTempoEstimator::D::assembleFeatures()
 
         // Also return the filtered autocorrelation in its own output
 
+        if (!isEnabled(FilteredACFOutput)) continue;
+
         feature.timestamp = m_start +
             RealTime::frame2RealTime(i * m_stepSize, m_inputSampleRate);
         feature.values[0] = m_fr[i];
@@ -552,6 +606,8 @@ FixedTempoEstimator::D::assembleFeatures()
         fs[FilteredACFOutput].push_back(feature);
     }
 
+    if (!wantTempo) return fs;
+
     if (candidates.empty()) {
         cerr << "No tempo candidates!" << endl;
         return fs;
@@ -591,7 +647,9 @@ FixedTempoEstimator::D::assembleFeatures()
 
     // Return the best tempo in the main output
 
-    fs[TempoOutput].push_back(feature);
+    if (isEnabled(TempoOutput)) {
+        fs[TempoOutput].push_back(feature);
+    }
 
     // And return the other estimates (up to the arbitrarily chosen
     // number of 10 of them) in the candidates output
@@ -609,7 +667,9 @@ FixedTempoEstimator::D::assembleFeatures()
         --ci;
     }
 
-    fs[CandidatesOutput].push_back(feature);
+    if (isEnabled(CandidatesOutput)) {
+        fs[CandidatesOutput].push_back(feature);
+    }
     
     return fs;
 }
@@ -684,6 +744,18 @@ FixedTempoEstimator::initialise(size_t channels, size_t stepSize, size_t blockSi
     return m_d->initialise(channels, stepSize, blockSize);
 }
 
+void
+FixedTempoEstimator::setTaskScheduler(Vamp::TaskScheduler *scheduler)
+{
+    m_d->setTaskScheduler(scheduler);
+}
+
+void
+FixedTempoEstimator::setEnabledOutputs(const std::vector<bool> &enabled)
+{
+    m_d->setEnabledOutputs(enabled);
+}
+
 void
 FixedTempoEstimator::reset()
 {
@@ -714,6 +786,12 @@ FixedTempoEstimator::getOutputDescriptors() const
     return m_d->getOutputDescriptors();
 }
 
+bool
+FixedTempoEstimator::setSpectrumFormat(SpectrumFormat format)
+{
+    return m_d->setSpectrumFormat(format);
+}
+
 FixedTempoEstimator::FeatureSet
 FixedTempoEstimator::process(const float *const *inputBuffers, RealTime ts)
 {
@@ -54,6 +54,12 @@ public:
 
     InputDomain getInputDomain() const { return FrequencyDomain; }
 
+    // The tempo is estimated from the whole input at the end
+    StateDependency getStateDependency() const { return WholeSignal; }
+
+    void setTaskScheduler(Vamp::TaskScheduler *scheduler);
+    void setEnabledOutputs(const std::vector<bool> &enabled);
+
     std::string getIdentifier() const;
     std::string getName() const;
     std::string getDescription() const;
@@ -73,6 +79,12 @@ public:
     FeatureSet process(const float *const *inputBuffers,
                        Vamp::RealTime timestamp);
 
+    // Only the power of each bin is used
+    SpectrumFormat getPreferredSpectrumFormat() const {
+        return PowerSpectrum;
+    }
+    bool setSpectrumFormat(SpectrumFormat format);
+
     FeatureSet getRemainingFeatures();
 
 protected:
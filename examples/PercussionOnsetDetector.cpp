@@ -42,6 +42,7 @@ using std::cerr;
 using std::endl;
 
 #include <cmath>
+#include <cstring>
 
 
 PercussionOnsetDetector::PercussionOnsetDetector(float inputSampleRate) :
@@ -52,7 +53,10 @@ PercussionOnsetDetector::PercussionOnsetDetector(float inputSampleRate) :
     m_sensitivity(40),
     m_priorMagnitudes(0),
     m_dfMinus1(0),
-    m_dfMinus2(0)
+    m_dfMinus2(0),
+    m_onsetsEnabled(true),
+    m_dfEnabled(true),
+    m_powerInput(false)
 {
 }
 
@@ -97,6 +101,21 @@ PercussionOnsetDetector::getCopyright() const
     return "Code copyright 2006 Queen Mary, University of London, after Dan Barry et al 2005.  Freely redistributable (BSD license)";
 }
 
+void
+PercussionOnsetDetector::setEnabledOutputs(const std::vector<bool> &enabled)
+{
+    m_onsetsEnabled = (enabled.size() < 1 || enabled[0]);
+    m_dfEnabled = (enabled.size() < 2 || enabled[1]);
+}
+
+bool
+PercussionOnsetDetector::setSpectrumFormat(SpectrumFormat format)
+{
+    if (format == MagnitudeSpectrum) return false;
+    m_powerInput = (format == PowerSpectrum);
+    return true;
+}
+
 size_t
 PercussionOnsetDetector::getPreferredStepSize() const
 {
@@ -141,6 +160,34 @@ PercussionOnsetDetector::reset()
     m_dfMinus2 = 0.f;
 }
 
+bool
+PercussionOnsetDetector::getState(StateData &state) const
+{
+    // The prior magnitudes followed by the two previous detection
+    // function values
+    size_t n = m_blockSize/2;
+    float df[2] = { m_dfMinus1, m_dfMinus2 };
+    state.resize((n + 2) * sizeof(float));
+    if (n > 0) memcpy(&state[0], m_priorMagnitudes, n * sizeof(float));
+    memcpy(&state[n * sizeof(float)], df, sizeof(df));
+    return true;
+}
+
+bool
+PercussionOnsetDetector::setState(const StateData &state)
+{
+    size_t n = m_blockSize/2;
+    if (!m_priorMagnitudes || state.size() != (n + 2) * sizeof(float)) {
+        return false;
+    }
+    float df[2];
+    if (n > 0) memcpy(m_priorMagnitudes, &state[0], n * sizeof(float));
+    memcpy(df, &state[n * sizeof(float)], sizeof(df));
+    m_dfMinus1 = df[0];
+    m_dfMinus2 = df[1];
+    return true;
+}
+
 PercussionOnsetDetector::ParameterList
 PercussionOnsetDetector::getParameterDescriptors() const
 {
@@ -237,10 +284,15 @@ PercussionOnsetDetector::process(const float *const *inputBuffers,
 
     for (size_t i = 1; i < m_blockSize/2; ++i) {
 
-        float real = inputBuffers[0][i*2];
-        float imag = inputBuffers[0][i*2 + 1];
+        float sqrmag;
 
-        float sqrmag = real * real + imag * imag;
+        if (m_powerInput) {
+            sqrmag = inputBuffers[0][i];
+        } else {
+            float real = inputBuffers[0][i*2];
+            float imag = inputBuffers[0][i*2 + 1];
+            sqrmag = real * real + imag * imag;
+        }
 
         if (m_priorMagnitudes[i] > 0.f) {
             float diff = 10.f * log10f(sqrmag / m_priorMagnitudes[i]);
@@ -255,12 +307,15 @@ PercussionOnsetDetector::process(const float *const *inputBuffers,
 
     FeatureSet returnFeatures;
 
-    Feature detectionFunction;
-    detectionFunction.hasTimestamp = false;
-    detectionFunction.values.push_back(count);
-    returnFeatures[1].push_back(detectionFunction);
+    if (m_dfEnabled) {
+        Feature detectionFunction;
+        detectionFunction.hasTimestamp = false;
+        detectionFunction.values.push_back(count);
+        returnFeatures[1].push_back(detectionFunction);
+    }
 
-    if (m_dfMinus2 < m_dfMinus1 &&
+    if (m_onsetsEnabled &&
+        m_dfMinus2 < m_dfMinus1 &&
         m_dfMinus1 >= count &&
         m_dfMinus1 > ((100 - m_sensitivity) * m_blockSize) / 200) {
 
@@ -54,6 +54,17 @@ public:
 
     InputDomain getInputDomain() const { return FrequencyDomain; }
 
+    // Each block's detection function value compares it with the
+    // magnitudes of the block before, and an onset is found by
+    // comparing the values for the previous two blocks as well
+    StateDependency getStateDependency() const { return BoundedHistory; }
+    size_t getWarmUpBlockCount() const { return 3; }
+
+    bool getState(StateData &state) const;
+    bool setState(const StateData &state);
+
+    void setEnabledOutputs(const std::vector<bool> &enabled);
+
     std::string getIdentifier() const;
     std::string getName() const;
     std::string getDescription() const;
@@ -73,6 +84,13 @@ public:
     FeatureSet process(const float *const *inputBuffers,
                        Vamp::RealTime timestamp);
 
+    // Only the power of each bin is used, so take that directly if
+    // the host can supply it
+    SpectrumFormat getPreferredSpectrumFormat() const {
+        return PowerSpectrum;
+    }
+    bool setSpectrumFormat(SpectrumFormat format);
+
     FeatureSet getRemainingFeatures();
 
 protected:
@@ -84,6 +102,9 @@ protected:
     float *m_priorMagnitudes;
     float  m_dfMinus1;
     float  m_dfMinus2;
+    bool   m_onsetsEnabled;
+    bool   m_dfEnabled;
+    bool   m_powerInput;
 };
 
 
@@ -44,7 +44,8 @@ using std::endl;
 
 PowerSpectrum::PowerSpectrum(float inputSampleRate) :
     Plugin(inputSampleRate),
-    m_blockSize(0)
+    m_blockSize(0),
+    m_powerInput(false)
 {
 }
 
@@ -104,6 +105,14 @@ PowerSpectrum::reset()
 {
 }
 
+bool
+PowerSpectrum::setSpectrumFormat(SpectrumFormat format)
+{
+    if (format == MagnitudeSpectrum) return false;
+    m_powerInput = (format == Plugin::PowerSpectrum);
+    return true;
+}
+
 PowerSpectrum::OutputList
 PowerSpectrum::getOutputDescriptors() const
 {
@@ -149,6 +158,12 @@ PowerSpectrum::process(const float *const *inputBuffers, Vamp::RealTime)
     feature.hasTimestamp = false;
     feature.values.reserve(n); // optional
 
+    if (m_powerInput) {
+        feature.values.assign(fbuf, fbuf + n);
+        fs[0].push_back(feature);
+        return fs;
+    }
+
     for (size_t i = 0; i < n; ++i) {
 
 	double real = fbuf[i * 2];
@@ -58,6 +58,12 @@ public:
 
     InputDomain getInputDomain() const { return FrequencyDomain; }
 
+    StateDependency getStateDependency() const { return BlockLocal; }
+
+    // Nothing carries over between blocks, so the state is empty
+    bool getState(StateData &state) const { state.clear(); return true; }
+    bool setState(const StateData &state) { return state.empty(); }
+
     std::string getIdentifier() const;
     std::string getName() const;
     std::string getDescription() const;
@@ -70,10 +76,19 @@ public:
     FeatureSet process(const float *const *inputBuffers,
                        Vamp::RealTime timestamp);
 
+    // The power of each bin is all we return, so take that directly
+    // if the host can supply it (qualified, as our own class name
+    // hides the enum value here)
+    SpectrumFormat getPreferredSpectrumFormat() const {
+        return Plugin::PowerSpectrum;
+    }
+    bool setSpectrumFormat(SpectrumFormat format);
+
     FeatureSet getRemainingFeatures();
 
 protected:
     size_t m_blockSize;
+    bool m_powerInput;
 };
 
 
@@ -56,7 +56,8 @@ using std::endl;
 SpectralCentroid::SpectralCentroid(float inputSampleRate) :
     Plugin(inputSampleRate),
     m_stepSize(0),
-    m_blockSize(0)
+    m_blockSize(0),
+    m_magnitudeInput(false)
 {
 }
 
@@ -117,6 +118,14 @@ SpectralCentroid::reset()
 {
 }
 
+bool
+SpectralCentroid::setSpectrumFormat(SpectrumFormat format)
+{
+    if (format == PowerSpectrum) return false;
+    m_magnitudeInput = (format == MagnitudeSpectrum);
+    return true;
+}
+
 SpectralCentroid::OutputList
 SpectralCentroid::getOutputDescriptors() const
 {
@@ -144,6 +153,20 @@ SpectralCentroid::getOutputDescriptors() const
 
 SpectralCentroid::FeatureSet
 SpectralCentroid::process(const float *const *inputBuffers, Vamp::RealTime)
+{
+    return processBlock(inputBuffers);
+}
+
+SpectralCentroid::FeatureSet
+SpectralCentroid::processDouble(const double *const *inputBuffers,
+                                size_t, size_t, Vamp::RealTime)
+{
+    return processBlock(inputBuffers);
+}
+
+template <typename T>
+SpectralCentroid::FeatureSet
+SpectralCentroid::processBlock(const T *const *inputBuffers)
 {
     if (m_stepSize == 0) {
 	cerr << "ERROR: SpectralCentroid::process: "
@@ -156,9 +179,15 @@ SpectralCentroid::process(const float *const *inputBuffers, Vamp::RealTime)
 
     for (size_t i = 1; i <= m_blockSize/2; ++i) {
 	double freq = (double(i) * m_inputSampleRate) / m_blockSize;
-	double real = inputBuffers[0][i*2];
-	double imag = inputBuffers[0][i*2 + 1];
-	double scalemag = sqrt(real * real + imag * imag) / (m_blockSize/2);
+	double mag;
+	if (m_magnitudeInput) {
+	    mag = inputBuffers[0][i];
+	} else {
+	    double real = inputBuffers[0][i*2];
+	    double imag = inputBuffers[0][i*2 + 1];
+	    mag = sqrt(real * real + imag * imag);
+	}
+	double scalemag = mag / (m_blockSize/2);
 	numLin += freq * scalemag;
         numLog += log10f(freq) * scalemag;
 	denom += scalemag;
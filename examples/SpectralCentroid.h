@@ -55,6 +55,12 @@ public:
 
     InputDomain getInputDomain() const { return FrequencyDomain; }
 
+    StateDependency getStateDependency() const { return BlockLocal; }
+
+    // Nothing carries over between blocks, so the state is empty
+    bool getState(StateData &state) const { state.clear(); return true; }
+    bool setState(const StateData &state) { return state.empty(); }
+
     std::string getIdentifier() const;
     std::string getName() const;
     std::string getDescription() const;
@@ -67,11 +73,27 @@ public:
     FeatureSet process(const float *const *inputBuffers,
                        Vamp::RealTime timestamp);
 
+    FeatureSet processDouble(const double *const *inputBuffers,
+                             size_t channels, size_t frames,
+                             Vamp::RealTime timestamp);
+    bool supportsDoubleInput() const { return true; }
+
+    // Only the magnitude of each bin is used, so take that directly
+    // if the host can supply it
+    SpectrumFormat getPreferredSpectrumFormat() const {
+        return MagnitudeSpectrum;
+    }
+    bool setSpectrumFormat(SpectrumFormat format);
+
     FeatureSet getRemainingFeatures();
 
 protected:
+    template <typename T>
+    FeatureSet processBlock(const T *const *inputBuffers);
+
     size_t m_stepSize;
     size_t m_blockSize;
+    bool m_magnitudeInput;
 };
 
 
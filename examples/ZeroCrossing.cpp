@@ -42,6 +42,7 @@ using std::cerr;
 using std::endl;
 
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 
 ZeroCrossing::ZeroCrossing(float inputSampleRate) :
@@ -108,6 +109,22 @@ ZeroCrossing::reset()
     m_previousSample = 0.0f;
 }
 
+bool
+ZeroCrossing::getState(StateData &state) const
+{
+    const unsigned char *p = (const unsigned char *)&m_previousSample;
+    state.assign(p, p + sizeof(m_previousSample));
+    return true;
+}
+
+bool
+ZeroCrossing::setState(const StateData &state)
+{
+    if (state.size() != sizeof(m_previousSample)) return false;
+    memcpy(&m_previousSample, &state[0], sizeof(m_previousSample));
+    return true;
+}
+
 ZeroCrossing::OutputList
 ZeroCrossing::getOutputDescriptors() const
 {
@@ -142,6 +159,21 @@ ZeroCrossing::getOutputDescriptors() const
 ZeroCrossing::FeatureSet
 ZeroCrossing::process(const float *const *inputBuffers,
                       Vamp::RealTime timestamp)
+{
+    return processChannel(inputBuffers[0], 1, timestamp);
+}
+
+ZeroCrossing::FeatureSet
+ZeroCrossing::processStrided(const float *inputBuffer,
+                             size_t, size_t, size_t stride,
+                             Vamp::RealTime timestamp)
+{
+    return processChannel(inputBuffer, stride, timestamp);
+}
+
+ZeroCrossing::FeatureSet
+ZeroCrossing::processChannel(const float *input, size_t stride,
+                             Vamp::RealTime timestamp)
 {
     if (m_stepSize == 0) {
 	cerr << "ERROR: ZeroCrossing::process: "
@@ -157,7 +189,7 @@ ZeroCrossing::process(const float *const *inputBuffers,
 
     for (size_t i = 0; i < m_stepSize; ++i) {
 
-	float sample = inputBuffers[0][i];
+	float sample = input[i * stride];
 	bool crossing = false;
 
 	if (sample <= 0.0) {
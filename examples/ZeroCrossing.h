@@ -55,6 +55,14 @@ public:
 
     InputDomain getInputDomain() const { return TimeDomain; }
 
+    // A crossing at the start of a block depends on the last sample
+    // of the block before
+    StateDependency getStateDependency() const { return BoundedHistory; }
+    size_t getWarmUpBlockCount() const { return 1; }
+
+    bool getState(StateData &state) const;
+    bool setState(const StateData &state);
+
     std::string getIdentifier() const;
     std::string getName() const;
     std::string getDescription() const;
@@ -67,11 +75,21 @@ public:
     FeatureSet process(const float *const *inputBuffers,
                        Vamp::RealTime timestamp);
 
+    // We only read one channel, so can read it straight from an
+    // interleaved buffer
+    FeatureSet processStrided(const float *inputBuffer,
+                              size_t channels, size_t frames, size_t stride,
+                              Vamp::RealTime timestamp);
+    bool supportsStridedInput() const { return true; }
+
     FeatureSet getRemainingFeatures();
 
 protected:
     size_t m_stepSize;
     float m_previousSample;
+
+    FeatureSet processChannel(const float *input, size_t stride,
+                              Vamp::RealTime timestamp);
 };
 
 
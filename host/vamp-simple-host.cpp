@@ -43,12 +43,15 @@
  * However, the runPlugin function still contains a reasonable
  * implementation of a fairly generic Vamp plugin host capable of
  * evaluating a given output on a given plugin for a sound file read
- * via libsndfile.
+ * via libsndfile, or for raw audio streamed on standard input.
  */
 
 #include <vamp-hostsdk/PluginHostAdapter.h>
 #include <vamp-hostsdk/PluginInputDomainAdapter.h>
 #include <vamp-hostsdk/PluginLoader.h>
+#include <vamp-hostsdk/PluginChannelAdapter.h>
+#include <vamp-hostsdk/PluginProfilingAdapter.h>
+#include <vamp-hostsdk/PluginInstancePool.h>
 
 #include <iostream>
 #include <fstream>
@@ -57,11 +60,36 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstdint>
 
 #include "system.h"
 
 #include <cmath>
 
+#ifdef _WIN32
+#include <psapi.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#endif
+
 using namespace std;
 
 using Vamp::Plugin;
@@ -70,6 +98,9 @@ using Vamp::RealTime;
 using Vamp::HostExt::PluginLoader;
 using Vamp::HostExt::PluginWrapper;
 using Vamp::HostExt::PluginInputDomainAdapter;
+using Vamp::HostExt::PluginChannelAdapter;
+using Vamp::HostExt::PluginProfilingAdapter;
+using Vamp::HostExt::PluginInstancePool;
 
 #define HOST_VERSION "1.5"
 
@@ -80,9 +111,548 @@ enum Verbosity {
     PluginInformationDetailed
 };
 
+enum RawSampleFormat {
+    RawFloat32,
+    RawInt16
+};
+
+struct RawInputFormat {
+    int sampleRate = 0;
+    int channels = 0;
+    RawSampleFormat format = RawFloat32;
+};
+
+// Source of interleaved audio frames for runPlugin: either a sound
+// file read through libsndfile, or raw samples arriving on standard
+// input
+
+class AudioInput
+{
+public:
+    virtual ~AudioInput() { }
+
+    virtual int getSampleRate() const = 0;
+    virtual int getChannelCount() const = 0;
+
+    // Total number of frames, or 0 if not known in advance
+    virtual sf_count_t getFrameCount() const = 0;
+
+    // Read the given number of interleaved frames into buffer,
+    // returning fewer only at the end of the input, or -1 on error
+    virtual sf_count_t readFrames(float *buffer, int frames) = 0;
+
+    virtual string getError() const = 0;
+};
+
+class SndfileInput : public AudioInput
+{
+public:
+    SndfileInput(string path) {
+        memset(&m_info, 0, sizeof(SF_INFO));
+        m_file = sf_open(path.c_str(), SFM_READ, &m_info);
+    }
+
+    ~SndfileInput() {
+        if (m_file) sf_close(m_file);
+    }
+
+    bool isOK() const { return m_file != 0; }
+
+    int getSampleRate() const { return m_info.samplerate; }
+    int getChannelCount() const { return m_info.channels; }
+    sf_count_t getFrameCount() const { return m_info.frames; }
+
+    sf_count_t readFrames(float *buffer, int frames) {
+        return sf_readf_float(m_file, buffer, frames);
+    }
+
+    string getError() const { return sf_strerror(m_file); }
+
+private:
+    SNDFILE *m_file;
+    SF_INFO m_info;
+};
+
+// Raw interleaved samples in native byte order on standard input,
+// such as from a decoder or capture process writing to a pipe. A
+// reader thread fills one buffer while the other is being converted
+// and processed, and each read returns as soon as any whole frames
+// have arrived, so that a slow stream is not held up waiting for a
+// full buffer.
+
+class RawStreamInput : public AudioInput
+{
+public:
+    RawStreamInput(RawInputFormat format) :
+        m_format(format),
+        m_stream(new Stream(format.channels *
+                            (format.format == RawInt16 ?
+                             sizeof(int16_t) : sizeof(float)))) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        m_thread = thread(&RawStreamInput::run, m_stream);
+    }
+
+    ~RawStreamInput() {
+        bool done;
+        {
+            lock_guard<mutex> guard(m_stream->access);
+            done = m_stream->done;
+        }
+        if (done) {
+            m_thread.join();
+            delete m_stream;
+        } else {
+            // The reader may be blocked on a pipe that will never
+            // close. Leave it, and the stream it uses, to be cleaned
+            // up on process exit
+            m_thread.detach();
+        }
+    }
+
+    int getSampleRate() const { return m_format.sampleRate; }
+    int getChannelCount() const { return m_format.channels; }
+    sf_count_t getFrameCount() const { return 0; }
+
+    sf_count_t readFrames(float *buffer, int frames) {
+
+        Stream &s = *m_stream;
+        int channels = m_format.channels;
+        sf_count_t got = 0;
+
+        while (got < frames) {
+
+            Buffer &b = s.buffers[s.reading];
+            {
+                unique_lock<mutex> lock(s.access);
+                s.changed.wait(lock, [&]() { return b.full || s.done; });
+                if (!b.full) {
+                    if (s.error && got == 0) return -1;
+                    break;
+                }
+            }
+
+            size_t available = (b.filled - b.consumed) / s.frameBytes;
+            size_t n = min(available, size_t(frames - got));
+            const char *src = b.data.data() + b.consumed;
+            float *dst = buffer + got * channels;
+
+            if (m_format.format == RawInt16) {
+                const int16_t *samples = reinterpret_cast<const int16_t *>(src);
+                for (size_t i = 0; i < n * channels; ++i) {
+                    dst[i] = float(samples[i]) / 32768.f;
+                }
+            } else {
+                memcpy(dst, src, n * s.frameBytes);
+            }
+
+            b.consumed += n * s.frameBytes;
+            got += n;
+
+            if (b.consumed == b.filled) {
+                lock_guard<mutex> guard(s.access);
+                b.full = false;
+                s.reading = 1 - s.reading;
+                s.changed.notify_all();
+            }
+        }
+
+        return got;
+    }
+
+    string getError() const {
+        return "Failed to read from standard input";
+    }
+
+private:
+    struct Buffer {
+        vector<char> data;
+        size_t filled;
+        size_t consumed;
+        bool full;
+    };
+
+    // State shared with the reader thread
+    struct Stream {
+        Stream(size_t fb) :
+            frameBytes(fb), reading(0), done(false), error(false) {
+            for (int i = 0; i < 2; ++i) {
+                buffers[i].data.resize(frameBytes * 8192);
+                buffers[i].filled = 0;
+                buffers[i].consumed = 0;
+                buffers[i].full = false;
+            }
+        }
+        size_t frameBytes;
+        Buffer buffers[2];
+        int reading; // index of the buffer being consumed
+        bool done;
+        bool error;
+        mutex access;
+        condition_variable changed;
+    };
+
+    RawInputFormat m_format;
+    Stream *m_stream;
+    thread m_thread;
+
+    static long readStdin(char *data, size_t bytes) {
+#ifdef _WIN32
+        size_t n = fread(data, 1, bytes, stdin);
+        if (n == 0 && ferror(stdin)) return -1;
+        return long(n);
+#else
+        while (true) {
+            ssize_t n = ::read(0, data, bytes);
+            if (n < 0 && errno == EINTR) continue;
+            return long(n);
+        }
+#endif
+    }
+
+    // Read at least one whole frame, and only whole frames, into the
+    // buffer, returning false at the end of the input or on error
+    static bool fill(Buffer &b, size_t frameBytes, bool &error) {
+        b.filled = 0;
+        b.consumed = 0;
+        while (b.filled < frameBytes || b.filled % frameBytes != 0) {
+            long n = readStdin(b.data.data() + b.filled,
+                               b.data.size() - b.filled);
+            if (n <= 0) {
+                error = (n < 0);
+                b.filled -= b.filled % frameBytes;
+                return false;
+            }
+            b.filled += n;
+        }
+        return true;
+    }
+
+    static void run(Stream *s) {
+        int filling = 0;
+        while (true) {
+            Buffer &b = s->buffers[filling];
+            {
+                unique_lock<mutex> lock(s->access);
+                s->changed.wait(lock, [&]() { return !b.full; });
+            }
+            bool error = false;
+            bool more = fill(b, s->frameBytes, error);
+            lock_guard<mutex> guard(s->access);
+            if (b.filled > 0) b.full = true;
+            if (!more) {
+                s->done = true;
+                s->error = error;
+            }
+            s->changed.notify_all();
+            if (!more) return;
+            filling = 1 - filling;
+        }
+    }
+};
+
+enum OutputFormat {
+    TextFormat,
+    JsonLinesFormat,
+    CsvFormat
+};
+
+// Append v to s using the fewest significant digits (at most 9) that
+// read back as the same float, without going through a stream or the
+// C locale. Infinities and NaN are written as null, which is all JSON
+// has for them, unless asJson is false
+static void
+appendFloat(string &s, float v, bool asJson)
+{
+    if (v != v || v - v != 0.f) {
+        if (asJson) s += "null";
+        else if (v != v) s += "nan";
+        else s += (v < 0.f ? "-inf" : "inf");
+        return;
+    }
+    
+    if (v == 0.f) {
+        s += (signbit(v) ? "-0" : "0");
+        return;
+    }
+
+    static const struct Powers {
+        double p[64];
+        Powers() { for (int i = 0; i < 64; ++i) p[i] = pow(10.0, i); }
+    } powers;
+    auto tenTo = [&](int k) {
+        return k >= 0 ? powers.p[k] : 1.0 / powers.p[-k];
+    };
+    // x * 10^k, with one rounding where both are exact
+    auto scale = [&](double x, int k) {
+        return k >= 0 ? x * powers.p[k] : x / powers.p[-k];
+    };
+
+    double a = fabs(double(v));
+    if (v < 0.f) s += '-';
+
+    // decimal exponent of the leading digit
+    int e = int(floor(log10(a)));
+    if (a < tenTo(e)) --e;
+    else if (a >= tenTo(e + 1)) ++e;
+
+    // the shortest run of n digits m that gives back the same float
+    long long m = 0;
+    int n = 1;
+    for ( ; n <= 9; ++n) {
+        m = (long long)(scale(a, n - 1 - e) + 0.5);
+        if (n == 9 || float(scale(double(m), e - n + 1)) == float(a)) break;
+    }
+    if (m >= (long long)powers.p[n]) { // rounded up to another digit
+        m /= 10;
+        ++e;
+    }
+
+    char digits[9];
+    for (int i = n - 1; i >= 0; --i) {
+        digits[i] = char('0' + m % 10);
+        m /= 10;
+    }
+    while (n > 1 && digits[n-1] == '0') --n;
+
+    if (e >= 0 && e < 9) {
+        for (int i = 0; i <= e; ++i) s += (i < n ? digits[i] : '0');
+        if (n > e + 1) {
+            s += '.';
+            s.append(digits + e + 1, n - e - 1);
+        }
+    } else if (e < 0 && e >= -5) {
+        s += "0.";
+        s.append(-e - 1, '0');
+        s.append(digits, n);
+    } else {
+        s += digits[0];
+        if (n > 1) {
+            s += '.';
+            s.append(digits + 1, n - 1);
+        }
+        s += 'e';
+        s += (e < 0 ? '-' : '+');
+        int ae = (e < 0 ? -e : e);
+        if (ae >= 10) s += char('0' + ae / 10);
+        s += char('0' + ae % 10);
+    }
+}
+
+// Writes features in the chosen format. The text format goes to the
+// stream a line at a time, as it always has. The machine-readable
+// formats are collected into a large buffer that is written out in
+// batches, or after every block when streaming, so that a consumer
+// of a stream sees each block's features as soon as they are ready
+class FeatureWriter
+{
+public:
+    FeatureWriter(ostream &out, OutputFormat format, bool useFrames,
+                  string outputId, bool streaming) :
+        m_out(out),
+        m_format(format),
+        m_useFrames(useFrames),
+        m_streaming(streaming) {
+        if (m_format == JsonLinesFormat) {
+            appendJsonString(m_outputId, outputId);
+        } else {
+            appendCsvString(m_outputId, outputId);
+        }
+        m_buffer.reserve(batchSize + 4096);
+    }
+
+    ~FeatureWriter() {
+        flush();
+    }
+
+    bool usesFrames() const { return m_useFrames; }
+
+    // Write one feature, at time rt or, if usesFrames(), at
+    // displayFrame and with a duration of durationFrames
+    void write(const Plugin::Feature &f, const RealTime &rt,
+               int displayFrame, int durationFrames) {
+        switch (m_format) {
+        case TextFormat: writeText(f, rt, displayFrame, durationFrames); break;
+        case JsonLinesFormat: writeJson(f, rt, displayFrame, durationFrames); break;
+        case CsvFormat: writeCsv(f, rt, displayFrame, durationFrames); break;
+        }
+        if (m_buffer.size() >= batchSize) flush();
+    }
+
+    // Call after each block's features have been written
+    void endBlock() {
+        if (m_streaming) flush();
+    }
+
+    void flush() {
+        if (!m_buffer.empty()) {
+            m_out.write(m_buffer.data(), m_buffer.size());
+            m_buffer.clear();
+        }
+        if (m_streaming) m_out.flush();
+    }
+
+private:
+    static const size_t batchSize = 256 * 1024;
+
+    ostream &m_out;
+    OutputFormat m_format;
+    bool m_useFrames;
+    bool m_streaming;
+    string m_outputId; // already quoted for the format
+    string m_buffer;
+
+    void writeText(const Plugin::Feature &f, const RealTime &rt,
+                   int displayFrame, int durationFrames) {
+
+        char buffer[RealTime::maxFormattedLength];
+
+        if (m_useFrames) {
+            m_out << displayFrame;
+            if (f.hasDuration) {
+                m_out << "," << durationFrames;
+            }
+        } else {
+            m_out.write(buffer, rt.toChars(buffer, buffer + sizeof(buffer))
+                        - buffer);
+            if (f.hasDuration) {
+                m_out << ",";
+                m_out.write(buffer, f.duration.toChars
+                            (buffer, buffer + sizeof(buffer)) - buffer);
+            }
+        }
+
+        m_out << ":";
+
+        for (unsigned int j = 0; j < f.values.size(); ++j) {
+            m_out << " " << f.values[j];
+        }
+        m_out << " " << f.label;
+
+        m_out << endl;
+    }
+
+    void appendTime(const RealTime &rt) {
+        char buffer[RealTime::maxFormattedLength];
+        char *end = rt.toChars(buffer, buffer + sizeof(buffer));
+        // toChars leaves a space in place of a sign for positive times
+        m_buffer.append(buffer[0] == ' ' ? buffer + 1 : buffer, end);
+    }
+
+    void appendInt(int n) {
+        char buffer[16];
+        int len = 0;
+        unsigned int u = (n < 0 ? 0u - unsigned(n) : unsigned(n));
+        do {
+            buffer[len++] = char('0' + u % 10);
+            u /= 10;
+        } while (u > 0);
+        if (n < 0) m_buffer += '-';
+        while (len > 0) m_buffer += buffer[--len];
+    }
+
+    static void appendJsonString(string &s, const string &text) {
+        static const char hex[] = "0123456789abcdef";
+        s += '"';
+        for (size_t i = 0; i < text.size(); ++i) {
+            unsigned char c = text[i];
+            if (c == '"' || c == '\\') {
+                s += '\\';
+                s += char(c);
+            } else if (c < 0x20) {
+                s += "\\u00";
+                s += hex[c >> 4];
+                s += hex[c & 0xf];
+            } else {
+                s += char(c);
+            }
+        }
+        s += '"';
+    }
+
+    static void appendCsvString(string &s, const string &text) {
+        if (text.find_first_of(",\"\r\n") == string::npos) {
+            s += text;
+            return;
+        }
+        s += '"';
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '"') s += '"';
+            s += text[i];
+        }
+        s += '"';
+    }
+
+    void writeJson(const Plugin::Feature &f, const RealTime &rt,
+                   int displayFrame, int durationFrames) {
+        m_buffer += "{\"output\":";
+        m_buffer += m_outputId;
+        if (m_useFrames) {
+            m_buffer += ",\"frame\":";
+            appendInt(displayFrame);
+            if (f.hasDuration) {
+                m_buffer += ",\"durationFrames\":";
+                appendInt(durationFrames);
+            }
+        } else {
+            m_buffer += ",\"timestamp\":";
+            appendTime(rt);
+            if (f.hasDuration) {
+                m_buffer += ",\"duration\":";
+                appendTime(f.duration);
+            }
+        }
+        m_buffer += ",\"values\":[";
+        for (size_t j = 0; j < f.values.size(); ++j) {
+            if (j > 0) m_buffer += ',';
+            appendFloat(m_buffer, f.values[j], true);
+        }
+        m_buffer += ']';
+        if (!f.label.empty()) {
+            m_buffer += ",\"label\":";
+            appendJsonString(m_buffer, f.label);
+        }
+        m_buffer += "}\n";
+    }
+
+    void writeCsv(const Plugin::Feature &f, const RealTime &rt,
+                  int displayFrame, int durationFrames) {
+        m_buffer += m_outputId;
+        m_buffer += ',';
+        if (m_useFrames) {
+            appendInt(displayFrame);
+            m_buffer += ',';
+            if (f.hasDuration) appendInt(durationFrames);
+        } else {
+            appendTime(rt);
+            m_buffer += ',';
+            if (f.hasDuration) appendTime(f.duration);
+        }
+        m_buffer += ',';
+        appendCsvString(m_buffer, f.label);
+        for (size_t j = 0; j < f.values.size(); ++j) {
+            m_buffer += ',';
+            appendFloat(m_buffer, f.values[j], false);
+        }
+        m_buffer += '\n';
+    }
+};
+
+static bool
+parseOutputFormat(string name, OutputFormat &format)
+{
+    if (name == "text") format = TextFormat;
+    else if (name == "jsonl") format = JsonLinesFormat;
+    else if (name == "csv") format = CsvFormat;
+    else return false;
+    return true;
+}
+
 void printFeatures(int, int,
                    const Plugin::OutputDescriptor &, int,
-                   const Plugin::FeatureSet &, ofstream *, bool frames);
+                   const Plugin::FeatureSet &, FeatureWriter &,
+                   int &featureCount);
 void transformInput(float *, size_t);
 void fft(unsigned int, bool, double *, double *, double *, double *);
 void printPluginPath(bool verbose);
@@ -90,7 +660,184 @@ void printPluginCategoryList();
 void enumeratePlugins(Verbosity);
 void listPluginsInLibrary(string soname);
 int runPlugin(string myname, string soname, string id, string output,
-              int outputNo, string inputFile, string outfilename, bool frames);
+              int outputNo, string inputFile, RawInputFormat rawFormat,
+              string outfilename, bool frames, OutputFormat format,
+              bool profile);
+int runBenchmark(string myname, string soname, string id,
+                 string inputFile, double synthSeconds,
+                 int runs, int warmups, string outfilename);
+int runServer(string myname, string socketPath);
+
+// Count the bytes allocated by each thread, so that --profile can
+// report allocations made within plugin calls. Replacing the global
+// allocation functions means replacing all of them, so that every
+// new is paired with a matching delete; but they only count once
+// --profile has switched counting on, and otherwise just forward to
+// malloc and free as the standard library's own versions do. They
+// are kept opaque to the optimiser, as otherwise GCC can inline or
+// merge them and then warn that a new is paired with the wrong
+// delete at the call site.
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 8
+#define REPLACEMENT __attribute__((noipa))
+#elif defined(__GNUC__)
+#define REPLACEMENT __attribute__((noinline))
+#else
+#define REPLACEMENT
+#endif
+
+static bool countingAllocations = false;
+static thread_local unsigned long long bytesAllocated = 0;
+
+static unsigned long long getBytesAllocated()
+{
+    return bytesAllocated;
+}
+
+static void *allocate(size_t size)
+{
+    if (countingAllocations) bytesAllocated += size;
+    return malloc(size ? size : 1);
+}
+
+REPLACEMENT void *operator new(size_t size)
+{
+    void *p = allocate(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+REPLACEMENT void *operator new[](size_t size)
+{
+    void *p = allocate(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+REPLACEMENT void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+REPLACEMENT void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+REPLACEMENT void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+REPLACEMENT void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+REPLACEMENT void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    free(p);
+}
+
+REPLACEMENT void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+REPLACEMENT void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+REPLACEMENT void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+static void *allocateAligned(size_t size, std::align_val_t align)
+{
+    if (countingAllocations) bytesAllocated += size;
+    size_t alignment = size_t(align);
+    if (alignment < sizeof(void *)) alignment = sizeof(void *);
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    void *p = 0;
+    if (posix_memalign(&p, alignment, size ? size : 1)) return 0;
+    return p;
+#endif
+}
+
+static void freeAligned(void *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+REPLACEMENT void *operator new(size_t size, std::align_val_t align)
+{
+    void *p = allocateAligned(size, align);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+REPLACEMENT void *operator new[](size_t size, std::align_val_t align)
+{
+    void *p = allocateAligned(size, align);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+REPLACEMENT void *operator new(size_t size, std::align_val_t align,
+                   const std::nothrow_t &) noexcept
+{
+    return allocateAligned(size, align);
+}
+
+REPLACEMENT void *operator new[](size_t size, std::align_val_t align,
+                     const std::nothrow_t &) noexcept
+{
+    return allocateAligned(size, align);
+}
+
+REPLACEMENT void operator delete(void *p, std::align_val_t) noexcept
+{
+    freeAligned(p);
+}
+
+REPLACEMENT void operator delete[](void *p, std::align_val_t) noexcept
+{
+    freeAligned(p);
+}
+
+REPLACEMENT void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+    freeAligned(p);
+}
+
+REPLACEMENT void operator delete[](void *p, size_t, std::align_val_t) noexcept
+{
+    freeAligned(p);
+}
+
+REPLACEMENT void operator delete(void *p, std::align_val_t,
+                     const std::nothrow_t &) noexcept
+{
+    freeAligned(p);
+}
+
+REPLACEMENT void operator delete[](void *p, std::align_val_t,
+                       const std::nothrow_t &) noexcept
+{
+    freeAligned(p);
+}
+#endif
 
 void usage(const char *name)
 {
@@ -100,8 +847,8 @@ void usage(const char *name)
         "Copyright 2006-2009 Chris Cannam and QMUL.\n"
         "Freely redistributable; published under a BSD-style license.\n\n"
         "Usage:\n\n"
-        "  " << name << " [-s] pluginlibrary[." << PLUGIN_SUFFIX << "]:plugin[:output] file.wav [-o out.txt]\n"
-        "  " << name << " [-s] pluginlibrary[." << PLUGIN_SUFFIX << "]:plugin file.wav [outputno] [-o out.txt]\n\n"
+        "  " << name << " [-s] [--profile] [--format F] pluginlibrary[." << PLUGIN_SUFFIX << "]:plugin[:output] file.wav [-o out.txt]\n"
+        "  " << name << " [-s] [--profile] [--format F] pluginlibrary[." << PLUGIN_SUFFIX << "]:plugin file.wav [outputno] [-o out.txt]\n\n"
         "    -- Load plugin id \"plugin\" from \"pluginlibrary\" and run it on the\n"
         "       audio data in \"file.wav\", retrieving the named \"output\", or output\n"
         "       number \"outputno\" (the first output by default) and dumping it to\n"
@@ -112,6 +859,49 @@ void usage(const char *name)
         "       If the -s option is given, results will be labelled with the audio\n"
         "       sample frame at which they occur. Otherwise, they will be labelled\n"
         "       with time in seconds.\n\n"
+        "       If the --profile option is given, the plugin is timed both on its\n"
+        "       own and together with its adapters, and a report is printed as\n"
+        "       JSON to standard error at the end of the run.\n\n"
+        "       The --format option selects the output format: \"text\" (the default)\n"
+        "       for the form described above, \"jsonl\" for one JSON object per line\n"
+        "       with fields \"output\", \"timestamp\" and \"duration\" in seconds (or\n"
+        "       \"frame\" and \"durationFrames\" with -s), \"values\" and \"label\", or\n"
+        "       \"csv\" for lines of output, time, duration, label and then values.\n"
+        "       These are written in large batches and are much faster to produce\n"
+        "       and to parse than the text format.\n\n"
+        "  " << name << " [-s] [--profile] [--format F] --rate N --channels N [--int16] pluginlibrary[." << PLUGIN_SUFFIX << "]:plugin[:output] - [-o out.txt]\n\n"
+        "    -- As above, but read the audio data as it arrives on standard input\n"
+        "       (for example through a pipe from a decoder) instead of from a file.\n"
+        "       The input is raw interleaved samples, with the given sample rate\n"
+        "       and channel count, as native-endian 32-bit floats or, if --int16 is\n"
+        "       given, 16-bit signed integers. Each feature is written out as soon\n"
+        "       as the plugin returns it.\n\n"
+        "  " << name << " --benchmark [--runs N] [--warmup N] pluginlibrary[." << PLUGIN_SUFFIX << "]:plugin file.wav [-o out.json]\n"
+        "  " << name << " --benchmark [--runs N] [--warmup N] --synthetic secs pluginlibrary[." << PLUGIN_SUFFIX << "]:plugin [-o out.json]\n\n"
+        "    -- Load plugin id \"plugin\" from \"pluginlibrary\" and time it repeatedly\n"
+        "       over the audio data in \"file.wav\", or over \"secs\" seconds of a\n"
+        "       synthetic signal, after first running it \"--warmup\" times (default 1)\n"
+        "       untimed. The input is decoded into memory before timing starts and\n"
+        "       features are not printed. Reports the real-time factor (processing\n"
+        "       time divided by audio duration) over \"--runs\" runs (default 5),\n"
+        "       the time per block, the median and 99th percentile process() call\n"
+        "       latency, and the peak resident memory, as JSON.\n\n"
+        "  " << name << " --server socket\n\n"
+        "    -- Run as a server, listening for requests on the UNIX domain socket\n"
+        "       \"socket\". Plugin libraries stay loaded and initialised plugin\n"
+        "       instances are kept for reuse between requests, so that running a\n"
+        "       plugin on a short file costs little more than the analysis itself.\n"
+        "       Each connection carries one request, as a line of the form\n\n"
+        "         [-s] [--format F] pluginlibrary:plugin[:output] file.wav [outputno] [param=value ...]\n\n"
+        "       and receives the features, as they would be printed to standard\n"
+        "       output by the first form above, before the connection is closed.\n"
+        "       Errors are reported in a line starting \"ERROR:\". Arguments\n"
+        "       containing spaces may be enclosed in double quotes. A client that\n"
+        "       does not send its request line (of at most 64K bytes) within 10\n"
+        "       seconds, or stops reading its results for as long, is disconnected.\n"
+        "       Only the user running the server may connect to the socket. On\n"
+        "       SIGINT or SIGTERM the server finishes the requests it has received\n"
+        "       and exits.\n\n"
         "  " << name << " -l\n"
         "  " << name << " --list\n\n"
         "    -- List the plugin libraries and Vamp plugins in the library search path\n"
@@ -192,26 +982,89 @@ int main(int argc, char **argv)
         } else usage(name);
     }
 
+    if (argc == 3 && !strcmp(argv[1], "--server")) {
+        return runServer(name, argv[2]);
+    }
+    
     if (argc < 3) usage(name);
 
     bool useFrames = false;
+    bool profile = false;
+    bool benchmark = false;
+    int runs = 5;
+    int warmups = 1;
+    double synthSeconds = 0.0;
+    RawInputFormat rawFormat;
+    bool rawFormatGiven = false;
+    OutputFormat format = TextFormat;
+    bool formatGiven = false;
     
     int base = 1;
-    if (!strcmp(argv[1], "-s")) {
-        useFrames = true;
-        base = 2;
+    while (base < argc) {
+        if (!strcmp(argv[base], "-s")) {
+            useFrames = true;
+        } else if (!strcmp(argv[base], "--profile")) {
+            profile = true;
+        } else if (!strcmp(argv[base], "--benchmark")) {
+            benchmark = true;
+        } else if (!strcmp(argv[base], "--runs") && base + 1 < argc) {
+            runs = atoi(argv[++base]);
+            if (runs < 1) usage(name);
+        } else if (!strcmp(argv[base], "--warmup") && base + 1 < argc) {
+            warmups = atoi(argv[++base]);
+            if (warmups < 0) usage(name);
+        } else if (!strcmp(argv[base], "--synthetic") && base + 1 < argc) {
+            synthSeconds = atof(argv[++base]);
+            if (synthSeconds <= 0.0) usage(name);
+        } else if (!strcmp(argv[base], "--rate") && base + 1 < argc) {
+            rawFormat.sampleRate = atoi(argv[++base]);
+            if (rawFormat.sampleRate <= 0) usage(name);
+            rawFormatGiven = true;
+        } else if (!strcmp(argv[base], "--channels") && base + 1 < argc) {
+            rawFormat.channels = atoi(argv[++base]);
+            if (rawFormat.channels <= 0) usage(name);
+            rawFormatGiven = true;
+        } else if (!strcmp(argv[base], "--format") && base + 1 < argc) {
+            if (!parseOutputFormat(argv[++base], format)) usage(name);
+            formatGiven = true;
+        } else if (!strcmp(argv[base], "--int16")) {
+            rawFormat.format = RawInt16;
+            rawFormatGiven = true;
+        } else {
+            break;
+        }
+        ++base;
     }
 
+    if (synthSeconds > 0.0 && !benchmark) usage(name);
+    if (benchmark && (useFrames || profile || formatGiven)) usage(name);
+
+    // With a synthetic input there is no input filename argument
+    int positional = (synthSeconds > 0.0 ? 1 : 2);
+    
+    if (argc < base + positional) usage(name);
+
     string soname = argv[base];
-    string wavname = argv[base+1];
+    string wavname = (positional > 1 ? argv[base+1] : "");
+
+    // Input from standard input ("-") needs its format given, and
+    // is not supported for benchmarking, which reads it all up front
+    if (wavname == "-") {
+        if (benchmark ||
+            rawFormat.sampleRate == 0 || rawFormat.channels == 0) {
+            usage(name);
+        }
+    } else if (rawFormatGiven) {
+        usage(name);
+    }
     string plugid = "";
     string output = "";
     int outputNo = -1;
     string outfilename;
 
-    if (argc >= base+3) {
+    if (argc >= base + positional + 1) {
 
-        int idx = base+2;
+        int idx = base + positional;
 
         if (isdigit(*argv[idx])) {
             outputNo = atoi(argv[idx++]);
@@ -228,7 +1081,13 @@ int main(int argc, char **argv)
 
     cerr << endl << name << ": Running..." << endl;
 
-    cerr << "Reading file: \"" << wavname << "\", writing to ";
+    if (wavname == "") {
+        cerr << "Using " << synthSeconds << " seconds of synthetic input, writing to ";
+    } else if (wavname == "-") {
+        cerr << "Reading raw samples from standard input, writing to ";
+    } else {
+        cerr << "Reading file: \"" << wavname << "\", writing to ";
+    }
     if (outfilename == "") {
         cerr << "standard output" << endl;
     } else {
@@ -241,260 +1100,1185 @@ int main(int argc, char **argv)
         plugid = soname.substr(sep + 1);
         soname = soname.substr(0, sep);
 
-        sep = plugid.find(':');
-        if (sep != string::npos) {
-            output = plugid.substr(sep + 1);
-            plugid = plugid.substr(0, sep);
-        }
+        sep = plugid.find(':');
+        if (sep != string::npos) {
+            output = plugid.substr(sep + 1);
+            plugid = plugid.substr(0, sep);
+        }
+    }
+
+    if (plugid == "") {
+        usage(name);
+    }
+
+    if (output != "" && outputNo != -1) {
+        usage(name);
+    }
+
+    if (output == "" && outputNo == -1) {
+        outputNo = 0;
+    }
+
+    if (benchmark) {
+        return runBenchmark(name, soname, plugid, wavname, synthSeconds,
+                            runs, warmups, outfilename);
+    }
+
+    return runPlugin(name, soname, plugid, output, outputNo,
+                     wavname, rawFormat, outfilename, useFrames, format,
+                     profile);
+}
+
+
+static void
+chooseBlockAndStepSize(Plugin *plugin, int &blockSize, int &stepSize)
+{
+    blockSize = plugin->getPreferredBlockSize();
+    stepSize = plugin->getPreferredStepSize();
+
+    if (blockSize == 0) {
+        blockSize = 1024;
+    }
+    if (stepSize == 0) {
+        if (plugin->getInputDomain() == Plugin::FrequencyDomain) {
+            stepSize = blockSize/2;
+        } else {
+            stepSize = blockSize;
+        }
+    } else if (stepSize > blockSize) {
+        cerr << "WARNING: stepSize " << stepSize << " > blockSize " << blockSize << ", resetting blockSize to ";
+        if (plugin->getInputDomain() == Plugin::FrequencyDomain) {
+            blockSize = stepSize * 2;
+        } else {
+            blockSize = stepSize;
+        }
+        cerr << blockSize << endl;
+    }
+}
+
+// Run an initialised plugin over the whole of the input, printing
+// the features from the given output as they are returned. Return
+// false if the input could not be read to the end
+static bool
+processInput(Plugin *plugin, AudioInput *input, int blockSize, int stepSize,
+             int outputNo, const Plugin::OutputDescriptor &od,
+             FeatureWriter &writer, bool showProgress)
+{
+    int sampleRate = input->getSampleRate();
+    sf_count_t frameCount = input->getFrameCount();
+    int channels = input->getChannelCount();
+
+    int overlapSize = blockSize - stepSize;
+    sf_count_t currentStep = 0;
+    int finalStepsRemaining = max(1, (blockSize / stepSize) - 1); // at end of file, this many part-silent frames needed after we hit EOF
+
+    float *filebuf = new float[blockSize * channels];
+    float **plugbuf = new float*[channels];
+    for (int c = 0; c < channels; ++c) plugbuf[c] = new float[blockSize + 2];
+
+    Plugin::FeatureSet features;
+    int featureCount = -1;
+    int progress = 0;
+    bool ok = true;
+
+    RealTime rt;
+    RealTime adjustment = RealTime::zeroTime;
+    vector<float> padbuf;
+
+    bool stridedInput = plugin->supportsStridedInput();
+
+    PluginWrapper *wrapper = dynamic_cast<PluginWrapper *>(plugin);
+    if (wrapper) {
+        // See documentation for
+        // PluginInputDomainAdapter::getTimestampAdjustment
+        PluginInputDomainAdapter *ida =
+            wrapper->getWrapper<PluginInputDomainAdapter>();
+        if (ida) adjustment = ida->getTimestampAdjustment();
+    }
+    
+    // Here we iterate over the frames, avoiding asking the numframes in case it's streaming input.
+    do {
+
+        int count;
+
+        if ((blockSize==stepSize) || (currentStep==0)) {
+            // read a full fresh block
+            if ((count = input->readFrames(filebuf, blockSize)) < 0) {
+                cerr << "ERROR: Failed to read input: " << input->getError() << endl;
+                ok = false;
+                break;
+            }
+            if (count != blockSize) --finalStepsRemaining;
+        } else {
+            //  otherwise shunt the existing data down and read the remainder.
+            memmove(filebuf, filebuf + (stepSize * channels), overlapSize * channels * sizeof(float));
+            if ((count = input->readFrames(filebuf + (overlapSize * channels), stepSize)) < 0) {
+                cerr << "ERROR: Failed to read input: " << input->getError() << endl;
+                ok = false;
+                break;
+            }
+            if (count != stepSize) --finalStepsRemaining;
+            count += overlapSize;
+        }
+
+        rt = RealTime::frame2RealTime(currentStep * stepSize, sampleRate);
+
+        if (stridedInput) {
+
+            // The plugin reads the interleaved file buffer directly,
+            // except for a short block at the end, which is padded in
+            // a copy so as to leave filebuf as the next step expects
+            const float *source = filebuf;
+            if (count < blockSize) {
+                padbuf.assign(filebuf, filebuf + count * channels);
+                padbuf.resize(blockSize * channels, 0.0f);
+                source = padbuf.data();
+            }
+
+            features = plugin->processStrided
+                (source, channels, blockSize, channels, rt);
+
+        } else {
+
+            for (int c = 0; c < channels; ++c) {
+                int j = 0;
+                while (j < count) {
+                    plugbuf[c][j] = filebuf[j * channels + c];
+                    ++j;
+                }
+                while (j < blockSize) {
+                    plugbuf[c][j] = 0.0f;
+                    ++j;
+                }
+            }
+
+            features = plugin->process(plugbuf, rt);
+        }
+        
+        printFeatures
+            (RealTime::realTime2Frame(rt + adjustment, sampleRate),
+             sampleRate, od, outputNo, features, writer, featureCount);
+        writer.endBlock();
+
+        if (showProgress && frameCount > 0){
+            int pp = progress;
+            progress = (int)((float(currentStep * stepSize) / frameCount) * 100.f + 0.5f);
+            if (progress != pp) {
+                cerr << "\r" << progress << "%";
+            }
+        }
+
+        ++currentStep;
+
+    } while (finalStepsRemaining > 0);
+
+    if (showProgress) cerr << "\rDone" << endl;
+
+    rt = RealTime::frame2RealTime(currentStep * stepSize, sampleRate);
+
+    features = plugin->getRemainingFeatures();
+    
+    printFeatures(RealTime::realTime2Frame(rt + adjustment, sampleRate),
+                  sampleRate, od, outputNo, features, writer, featureCount);
+    writer.flush();
+
+    for (int c = 0; c < channels; ++c) delete[] plugbuf[c];
+    delete[] plugbuf;
+    delete[] filebuf;
+
+    return ok;
+
+}
+
+int runPlugin(string myname, string soname, string id,
+              string output, int outputNo, string wavname,
+              RawInputFormat rawFormat,
+              string outfilename, bool useFrames, OutputFormat format,
+              bool profile)
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    PluginLoader::PluginKey key = loader->composePluginKey(soname, id);
+    
+    AudioInput *input = 0;
+    
+    if (wavname == "-") {
+        input = new RawStreamInput(rawFormat);
+    } else {
+        SndfileInput *fileInput = new SndfileInput(wavname);
+        if (!fileInput->isOK()) {
+            cerr << myname << ": ERROR: Failed to open input file \""
+                 << wavname << "\": " << fileInput->getError() << endl;
+            delete fileInput;
+            return 1;
+        }
+        input = fileInput;
+    }
+
+    int sampleRate = input->getSampleRate();
+
+    ofstream *out = 0;
+    if (outfilename != "") {
+        out = new ofstream(outfilename.c_str(), ios::out);
+        if (!*out) {
+            cerr << myname << ": ERROR: Failed to open output file \""
+                 << outfilename << "\" for writing" << endl;
+            delete out;
+            delete input;
+            return 1;
+        }
+    }
+
+    Plugin *plugin = 0;
+    PluginProfilingAdapter *pluginProfiler = 0, *chainProfiler = 0;
+
+    if (profile) {
+        // Load the plugin without adapters and apply the same ones
+        // that ADAPT_ALL_SAFE would, so that we can profile the plugin
+        // both with and without them
+        plugin = loader->loadPlugin(key, sampleRate, 0);
+        if (plugin) {
+            pluginProfiler = new PluginProfilingAdapter(plugin, "plugin");
+            plugin = pluginProfiler;
+            if (plugin->getInputDomain() == Plugin::FrequencyDomain) {
+                plugin = new PluginInputDomainAdapter(plugin);
+            }
+            plugin = new PluginChannelAdapter(plugin);
+            chainProfiler = new PluginProfilingAdapter(plugin, "adapted");
+            plugin = chainProfiler;
+            countingAllocations = true;
+            PluginProfilingAdapter::setAllocationCounter(getBytesAllocated);
+        }
+    } else {
+        plugin = loader->loadPlugin
+            (key, sampleRate, PluginLoader::ADAPT_ALL_SAFE);
+    }
+    
+    if (!plugin) {
+        cerr << myname << ": ERROR: Failed to load plugin \"" << id
+             << "\" from library \"" << soname << "\"" << endl;
+        delete input;
+        if (out) {
+            out->close();
+            delete out;
+        }
+        return 1;
+    }
+
+    cerr << "Running plugin: \"" << plugin->getIdentifier() << "\"..." << endl;
+
+    // Note that the following would be much simpler if we used a
+    // PluginBufferingAdapter as well -- i.e. if we had passed
+    // PluginLoader::ADAPT_ALL to loader->loadPlugin() above, instead
+    // of ADAPT_ALL_SAFE.  Then we could simply specify our own block
+    // size, keep the step size equal to the block size, and ignore
+    // the plugin's bleatings.  However, there are some issues with
+    // using a PluginBufferingAdapter that make the results sometimes
+    // technically different from (if effectively the same as) the
+    // un-adapted plugin, so we aren't doing that here.  See the
+    // PluginBufferingAdapter documentation for details.
+
+    int blockSize, stepSize;
+    chooseBlockAndStepSize(plugin, blockSize, stepSize);
+    int channels = input->getChannelCount();
+
+    cerr << "Using block size = " << blockSize << ", step size = "
+              << stepSize << endl;
+
+    // The channel queries here are for informational purposes only --
+    // a PluginChannelAdapter is being used automatically behind the
+    // scenes, and it will take case of any channel mismatch
+
+    int minch = plugin->getMinChannelCount();
+    int maxch = plugin->getMaxChannelCount();
+    cerr << "Plugin accepts " << minch << " -> " << maxch << " channel(s)" << endl;
+    cerr << "Sound file has " << channels << " (will mix/augment if necessary)" << endl;
+
+    Plugin::OutputList outputs = plugin->getOutputDescriptors();
+    Plugin::OutputDescriptor od;
+
+    int returnValue = 1;
+
+    if (outputs.empty()) {
+        cerr << "ERROR: Plugin has no outputs!" << endl;
+        goto done;
+    }
+
+    if (outputNo < 0) {
+
+        for (size_t oi = 0; oi < outputs.size(); ++oi) {
+            if (outputs[oi].identifier == output) {
+                outputNo = oi;
+                break;
+            }
+        }
+
+        if (outputNo < 0) {
+            cerr << "ERROR: Non-existent output \"" << output << "\" requested" << endl;
+            goto done;
+        }
+
+    } else {
+
+        if (int(outputs.size()) <= outputNo) {
+            cerr << "ERROR: Output " << outputNo << " requested, but plugin has only " << outputs.size() << " output(s)" << endl;
+            goto done;
+        }        
+    }
+
+    od = outputs[outputNo];
+    cerr << "Output is: \"" << od.identifier << "\"" << endl;
+
+    // We only print the one output, so the plugin needn't calculate
+    // the others
+    {
+        vector<bool> enabled(outputs.size(), false);
+        enabled[outputNo] = true;
+        plugin->setEnabledOutputs(enabled);
+    }
+
+    if (!plugin->initialise(channels, stepSize, blockSize)) {
+        cerr << "ERROR: Plugin initialise (channels = " << channels
+             << ", stepSize = " << stepSize << ", blockSize = "
+             << blockSize << ") failed." << endl;
+        goto done;
+    }
+
+    {
+        // Flush each block's features when reading a stream, so that
+        // they are not held back waiting for more input
+        FeatureWriter writer(out ? *out : cout, format, useFrames,
+                             od.identifier, wavname == "-");
+        processInput(plugin, input, blockSize, stepSize, outputNo, od,
+                     writer, out != 0);
+    }
+
+    returnValue = 0;
+
+    if (chainProfiler && pluginProfiler) {
+        cerr << "[" << chainProfiler->getReportJSON() << ",\n "
+             << pluginProfiler->getReportJSON() << "]" << endl;
+    }
+
+done:
+    delete plugin;
+    if (out) {
+        out->close();
+        delete out;
+    }
+    delete input;
+    return returnValue;
+}
+
+#ifndef _WIN32
+
+// Stream buffer that writes to a socket, so that printFeatures can
+// send features to a client as it would to a file
+class SocketOutputBuffer : public streambuf
+{
+public:
+    SocketOutputBuffer(int fd) : m_fd(fd), m_failed(false) {
+        setp(m_buffer, m_buffer + sizeof(m_buffer));
+    }
+
+    ~SocketOutputBuffer() {
+        sync();
+    }
+
+protected:
+    int overflow(int c) {
+        if (sync() < 0) return EOF;
+        if (c != EOF) {
+            *pptr() = char(c);
+            pbump(1);
+        }
+        return (c == EOF ? 0 : c);
+    }
+
+    int sync() {
+        const char *p = pbase();
+        while (p < pptr() && !m_failed) {
+            ssize_t n = ::write(m_fd, p, pptr() - p);
+            if (n < 0) {
+                if (errno != EINTR) m_failed = true;
+                continue;
+            }
+            p += n;
+        }
+        setp(m_buffer, m_buffer + sizeof(m_buffer));
+        return m_failed ? -1 : 0;
+    }
+
+private:
+    int m_fd;
+    bool m_failed;
+    char m_buffer[4096];
+};
+
+// Plugin state kept between requests, and the workers that serve
+// them. The loader and the instance pool are thread-safe themselves;
+// the mutex guards the configurations and the queue of connections
+// waiting for a worker
+class ServerState
+{
+public:
+    // Block and step sizes and outputs for each plugin, sample rate
+    // and parameter set, found by loading the plugin once
+    struct Configuration {
+        int blockSize;
+        int stepSize;
+        Plugin::OutputList outputs;
+    };
+
+    ServerState(size_t workers, size_t maxQueued);
+
+    // Stops the workers if stop() has not been called
+    ~ServerState();
+
+    PluginInstancePool pool;
+
+    bool getConfiguration(string key, Configuration &config);
+    void setConfiguration(string key, const Configuration &config);
+
+    // Hand a connection to the workers, waiting while the queue is
+    // full. The connection is closed once it has been served
+    void enqueue(int fd);
+
+    // Serve the connections already queued, then wait for the
+    // workers to finish
+    void stop();
+
+private:
+    mutex m_mutex;
+    condition_variable m_queueChanged;
+    map<string, Configuration> m_configurations;
+    deque<int> m_queue;
+    size_t m_maxQueued;
+    bool m_stopping;
+    vector<thread> m_workers;
+
+    void work();
+
+    ServerState(const ServerState &); // not provided
+    ServerState &operator=(const ServerState &); // not provided
+};
+
+// Written to by the signal handler to wake the accept loop, and
+// any workers still waiting for a request
+static int serverWakeFds[2] = { -1, -1 };
+
+// How long a client has to send its request line, and how long a
+// write of results to it may block, before it is disconnected
+static const int requestTimeoutSeconds = 10;
+
+// The longest request line accepted
+static const size_t maxRequestLine = 65536;
+
+// Read the request line, which must arrive in full within the
+// timeout, and before the server is asked to stop. Anything after
+// the newline is ignored
+static bool
+readRequestLine(int fd, string &line)
+{
+    auto deadline = chrono::steady_clock::now() +
+        chrono::seconds(requestTimeoutSeconds);
+    char buffer[4096];
+    
+    while (true) {
+
+        auto remaining = chrono::duration_cast<chrono::milliseconds>
+            (deadline - chrono::steady_clock::now()).count();
+        if (remaining <= 0) return false;
+
+        struct pollfd fds[2];
+        fds[0].fd = fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = serverWakeFds[0];
+        fds[1].events = POLLIN;
+        int ready = poll(fds, 2, int(remaining));
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return false;
+        if (!fds[0].revents) return false; // stopping
+
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return !line.empty();
+
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buffer[i] == '\n') return true;
+            if (buffer[i] != '\r') line += buffer[i];
+        }
+        if (line.size() > maxRequestLine) return false;
+    }
+}
+
+// Split at whitespace, except within double quotes
+static vector<string>
+splitRequestLine(const string &line)
+{
+    vector<string> args;
+    string current;
+    bool inQuotes = false, inArg = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (c == '"') {
+            inQuotes = !inQuotes;
+            inArg = true;
+        } else if (!inQuotes && isspace((unsigned char)c)) {
+            if (inArg) args.push_back(current);
+            current = "";
+            inArg = false;
+        } else {
+            current += c;
+            inArg = true;
+        }
+    }
+    if (inArg) args.push_back(current);
+    return args;
+}
+
+static void
+serveRequest(int fd, ServerState &state)
+{
+    // Don't let a client that stops reading hold the worker either
+    struct timeval timeout;
+    timeout.tv_sec = requestTimeoutSeconds;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    SocketOutputBuffer buffer(fd);
+    ostream out(&buffer);
+
+    string line;
+    if (!readRequestLine(fd, line)) return;
+    
+    vector<string> args = splitRequestLine(line);
+    
+    size_t idx = 0;
+    bool useFrames = false;
+    OutputFormat format = TextFormat;
+    while (idx < args.size()) {
+        if (args[idx] == "-s") {
+            useFrames = true;
+        } else if (args[idx] == "--format" && idx + 1 < args.size() &&
+                   parseOutputFormat(args[idx + 1], format)) {
+            ++idx;
+        } else {
+            break;
+        }
+        ++idx;
+    }
+    if (args.size() < idx + 2) {
+        out << "ERROR: Expected [-s] [--format text|jsonl|csv] pluginlibrary:plugin[:output] file [outputno] [param=value ...]" << endl;
+        return;
+    }
+
+    string soname = args[idx++];
+    string wavname = args[idx++];
+    string plugid, output;
+    int outputNo = -1;
+
+    string::size_type sep = soname.find(':');
+    if (sep != string::npos) {
+        plugid = soname.substr(sep + 1);
+        soname = soname.substr(0, sep);
+        sep = plugid.find(':');
+        if (sep != string::npos) {
+            output = plugid.substr(sep + 1);
+            plugid = plugid.substr(0, sep);
+        }
+    }
+    if (plugid == "") {
+        out << "ERROR: No plugin identifier given" << endl;
+        return;
+    }
+
+    if (idx < args.size() && isdigit((unsigned char)args[idx][0])) {
+        if (output != "") {
+            out << "ERROR: Output given both by name and by number" << endl;
+            return;
+        }
+        outputNo = atoi(args[idx++].c_str());
+    }
+
+    PluginInstancePool::ParameterValues parameters;
+    string parameterText;
+    for ( ; idx < args.size(); ++idx) {
+        sep = args[idx].find('=');
+        if (sep == string::npos || sep == 0) {
+            out << "ERROR: Expected param=value, not \"" << args[idx]
+                << "\"" << endl;
+            return;
+        }
+        parameters[args[idx].substr(0, sep)] =
+            float(atof(args[idx].substr(sep + 1).c_str()));
+    }
+    for (auto p: parameters) {
+        parameterText += " " + p.first + "=" + to_string(p.second);
+    }
+
+    SndfileInput input(wavname);
+    if (!input.isOK()) {
+        out << "ERROR: Failed to open input file \"" << wavname << "\": "
+            << input.getError() << endl;
+        return;
+    }
+    int sampleRate = input.getSampleRate();
+    int channels = input.getChannelCount();
+
+    PluginLoader *loader = PluginLoader::getInstance();
+    PluginLoader::PluginKey key;
+    ServerState::Configuration config;
+    Plugin *plugin = 0;
+
+    key = loader->composePluginKey(soname, plugid);
+    string configKey = key + "@" + to_string(sampleRate) + parameterText;
+
+    if (!state.getConfiguration(configKey, config)) {
+        // Two requests may both get here for a new configuration, in
+        // which case both find the same result
+        Plugin *probe = loader->loadPlugin
+            (key, sampleRate, PluginLoader::ADAPT_ALL_SAFE);
+        if (!probe) {
+            out << "ERROR: Failed to load plugin \"" << plugid
+                << "\" from library \"" << soname << "\"" << endl;
+            return;
+        }
+        for (auto p: parameters) {
+            probe->setParameter(p.first, p.second);
+        }
+        chooseBlockAndStepSize(probe, config.blockSize, config.stepSize);
+        config.outputs = probe->getOutputDescriptors();
+        delete probe;
+        state.setConfiguration(configKey, config);
+    }
+
+    // Unlike runPlugin, we can't disable the outputs we don't
+    // print, as pooled instances are initialised already
+    plugin = state.pool.acquire
+        (key, sampleRate, PluginLoader::ADAPT_ALL_SAFE, channels,
+         config.stepSize, config.blockSize, parameters);
+
+    if (!plugin) {
+        out << "ERROR: Failed to load or initialise plugin \"" << plugid
+            << "\" from library \"" << soname << "\"" << endl;
+        return;
+    }
+
+    if (outputNo < 0) {
+        for (size_t oi = 0; oi < config.outputs.size(); ++oi) {
+            if (output == "" || config.outputs[oi].identifier == output) {
+                outputNo = oi;
+                break;
+            }
+        }
+    }
+
+    if (config.outputs.empty()) {
+        out << "ERROR: Plugin has no outputs" << endl;
+    } else if (outputNo < 0 || outputNo >= int(config.outputs.size())) {
+        out << "ERROR: Output \""
+            << (output != "" ? output : to_string(outputNo))
+            << "\" not found" << endl;
+    } else {
+        const Plugin::OutputDescriptor &od = config.outputs[outputNo];
+        FeatureWriter writer(out, format, useFrames, od.identifier, true);
+        if (!processInput(plugin, &input,
+                          config.blockSize, config.stepSize,
+                          outputNo, od, writer, false)) {
+            writer.flush();
+            out << "ERROR: Failed to read input: " << input.getError() << endl;
+        }
+    }
+
+    out.flush();
+    
+    state.pool.release(plugin);
+}
+
+ServerState::ServerState(size_t workers, size_t maxQueued) :
+    m_maxQueued(maxQueued),
+    m_stopping(false)
+{
+    for (size_t i = 0; i < workers; ++i) {
+        m_workers.push_back(thread([this]() { work(); }));
+    }
+}
+
+ServerState::~ServerState()
+{
+    stop();
+}
+
+bool
+ServerState::getConfiguration(string key, Configuration &config)
+{
+    lock_guard<mutex> guard(m_mutex);
+    auto i = m_configurations.find(key);
+    if (i == m_configurations.end()) return false;
+    config = i->second;
+    return true;
+}
+
+void
+ServerState::setConfiguration(string key, const Configuration &config)
+{
+    lock_guard<mutex> guard(m_mutex);
+    m_configurations[key] = config;
+}
+
+void
+ServerState::enqueue(int fd)
+{
+    unique_lock<mutex> lock(m_mutex);
+    while (!m_stopping && m_queue.size() >= m_maxQueued) {
+        m_queueChanged.wait(lock);
     }
-
-    if (plugid == "") {
-        usage(name);
+    if (m_stopping) {
+        close(fd);
+        return;
     }
+    m_queue.push_back(fd);
+    m_queueChanged.notify_all();
+}
 
-    if (output != "" && outputNo != -1) {
-        usage(name);
+void
+ServerState::stop()
+{
+    {
+        lock_guard<mutex> guard(m_mutex);
+        m_stopping = true;
     }
+    m_queueChanged.notify_all();
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        m_workers[i].join();
+    }
+    m_workers.clear();
+}
 
-    if (output == "" && outputNo == -1) {
-        outputNo = 0;
+void
+ServerState::work()
+{
+    while (true) {
+        int fd;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            while (!m_stopping && m_queue.empty()) {
+                m_queueChanged.wait(lock);
+            }
+            if (m_queue.empty()) return;
+            fd = m_queue.front();
+            m_queue.pop_front();
+        }
+        m_queueChanged.notify_all();
+        serveRequest(fd, *this);
+        close(fd);
     }
+}
 
-    return runPlugin(name, soname, plugid, output, outputNo,
-                     wavname, outfilename, useFrames);
+static void
+serverStopHandler(int)
+{
+    char c = 0;
+    ssize_t n = write(serverWakeFds[1], &c, 1);
+    (void)n;
 }
 
+#endif
 
-int runPlugin(string myname, string soname, string id,
-              string output, int outputNo, string wavname,
-              string outfilename, bool useFrames)
+int runServer(string myname, string socketPath)
 {
-    PluginLoader *loader = PluginLoader::getInstance();
-
-    PluginLoader::PluginKey key = loader->composePluginKey(soname, id);
-    
-    SNDFILE *sndfile;
-    SF_INFO sfinfo;
-    memset(&sfinfo, 0, sizeof(SF_INFO));
-
-    sndfile = sf_open(wavname.c_str(), SFM_READ, &sfinfo);
-    if (!sndfile) {
-        cerr << myname << ": ERROR: Failed to open input file \""
-             << wavname << "\": " << sf_strerror(sndfile) << endl;
+#ifdef _WIN32
+    cerr << myname << ": ERROR: Server mode is not supported on this platform" << endl;
+    return 1;
+#else
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        cerr << myname << ": ERROR: Socket path \"" << socketPath
+             << "\" is too long" << endl;
         return 1;
     }
-
-    ofstream *out = 0;
-    if (outfilename != "") {
-        out = new ofstream(outfilename.c_str(), ios::out);
-        if (!*out) {
-            cerr << myname << ": ERROR: Failed to open output file \""
-                 << outfilename << "\" for writing" << endl;
-            delete out;
+    strcpy(addr.sun_path, socketPath.c_str());
+
+    // Remove a socket left behind by a server that has gone away,
+    // but not one that a server is still listening on, and nothing
+    // that is not a socket (which bind will then refuse to replace)
+    struct stat st;
+    if (lstat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = (probe >= 0 &&
+                     connect(probe, (struct sockaddr *)&addr,
+                             sizeof(addr)) == 0);
+        if (probe >= 0) close(probe);
+        if (live) {
+            cerr << myname << ": ERROR: Socket \"" << socketPath
+                 << "\" is in use by another server" << endl;
             return 1;
         }
+        unlink(socketPath.c_str());
     }
 
-    Plugin *plugin = loader->loadPlugin
-        (key, sfinfo.samplerate, PluginLoader::ADAPT_ALL_SAFE);
-    if (!plugin) {
-        cerr << myname << ": ERROR: Failed to load plugin \"" << id
-             << "\" from library \"" << soname << "\"" << endl;
-        sf_close(sndfile);
-        if (out) {
-            out->close();
-            delete out;
-        }
+    // Only our own user may connect: requests name files for the
+    // server to read, with the server's permissions
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t oldMask = umask(077);
+    bool bound = (sock >= 0 &&
+                  ::bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    umask(oldMask);
+    if (!bound || listen(sock, 16) < 0) {
+        cerr << myname << ": ERROR: Failed to listen on socket \""
+             << socketPath << "\": " << strerror(errno) << endl;
+        if (sock >= 0) close(sock);
+        if (bound) unlink(socketPath.c_str());
         return 1;
     }
 
-    cerr << "Running plugin: \"" << plugin->getIdentifier() << "\"..." << endl;
-
-    // Note that the following would be much simpler if we used a
-    // PluginBufferingAdapter as well -- i.e. if we had passed
-    // PluginLoader::ADAPT_ALL to loader->loadPlugin() above, instead
-    // of ADAPT_ALL_SAFE.  Then we could simply specify our own block
-    // size, keep the step size equal to the block size, and ignore
-    // the plugin's bleatings.  However, there are some issues with
-    // using a PluginBufferingAdapter that make the results sometimes
-    // technically different from (if effectively the same as) the
-    // un-adapted plugin, so we aren't doing that here.  See the
-    // PluginBufferingAdapter documentation for details.
-
-    int blockSize = plugin->getPreferredBlockSize();
-    int stepSize = plugin->getPreferredStepSize();
-
-    if (blockSize == 0) {
-        blockSize = 1024;
+    // Remember which file is ours, so as not to remove a socket that
+    // has replaced it by the time we exit
+    struct stat ours;
+    memset(&ours, 0, sizeof(ours));
+    lstat(socketPath.c_str(), &ours);
+
+    // Stop in an orderly way on SIGINT or SIGTERM, and don't let a
+    // client that goes away early take the server with it
+    if (pipe(serverWakeFds) < 0) {
+        cerr << myname << ": ERROR: Failed to create pipe: "
+             << strerror(errno) << endl;
+        close(sock);
+        unlink(socketPath.c_str());
+        return 1;
     }
-    if (stepSize == 0) {
-        if (plugin->getInputDomain() == Plugin::FrequencyDomain) {
-            stepSize = blockSize/2;
-        } else {
-            stepSize = blockSize;
-        }
-    } else if (stepSize > blockSize) {
-        cerr << "WARNING: stepSize " << stepSize << " > blockSize " << blockSize << ", resetting blockSize to ";
-        if (plugin->getInputDomain() == Plugin::FrequencyDomain) {
-            blockSize = stepSize * 2;
-        } else {
-            blockSize = stepSize;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = serverStopHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    cerr << myname << ": Listening on \"" << socketPath << "\"" << endl;
+
+    // A fixed number of workers serve the requests, with a few more
+    // connections queued for them; beyond that, clients wait in the
+    // socket's backlog until a worker is free
+    size_t workers = thread::hardware_concurrency();
+    if (workers < 2) workers = 2;
+
+    int result = 0;
+    
+    {
+        ServerState state(workers, workers * 4);
+
+        while (true) {
+            struct pollfd fds[2];
+            fds[0].fd = sock;
+            fds[0].events = POLLIN;
+            fds[1].fd = serverWakeFds[0];
+            fds[1].events = POLLIN;
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                cerr << myname << ": ERROR: Failed to wait for connection: "
+                     << strerror(errno) << endl;
+                result = 1;
+                break;
+            }
+            if (fds[1].revents) {
+                cerr << myname << ": Stopping" << endl;
+                break;
+            }
+            if (!fds[0].revents) continue;
+            int fd = accept(sock, 0, 0);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                cerr << myname << ": ERROR: Failed to accept connection: "
+                     << strerror(errno) << endl;
+                result = 1;
+                break;
+            }
+            state.enqueue(fd);
         }
-        cerr << blockSize << endl;
+
+        // No more connections; let the workers finish those accepted
+        // already before the state goes
+        close(sock);
+        state.stop();
     }
-    int overlapSize = blockSize - stepSize;
-    sf_count_t currentStep = 0;
-    int finalStepsRemaining = max(1, (blockSize / stepSize) - 1); // at end of file, this many part-silent frames needed after we hit EOF
 
-    int channels = sfinfo.channels;
+    struct stat now;
+    if (lstat(socketPath.c_str(), &now) == 0 &&
+        now.st_dev == ours.st_dev && now.st_ino == ours.st_ino) {
+        unlink(socketPath.c_str());
+    }
 
-    float *filebuf = new float[blockSize * channels];
-    float **plugbuf = new float*[channels];
-    for (int c = 0; c < channels; ++c) plugbuf[c] = new float[blockSize + 2];
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    close(serverWakeFds[0]);
+    close(serverWakeFds[1]);
+    
+    return result;
+#endif
+}
 
-    cerr << "Using block size = " << blockSize << ", step size = "
-              << stepSize << endl;
+static string
+jsonString(string s)
+{
+    string out = "\"";
+    for (size_t i = 0; i < s.length(); ++i) {
+        if (s[i] == '"' || s[i] == '\\') out += '\\';
+        if ((unsigned char)s[i] < 0x20) out += ' ';
+        else out += s[i];
+    }
+    return out + "\"";
+}
 
-    // The channel queries here are for informational purposes only --
-    // a PluginChannelAdapter is being used automatically behind the
-    // scenes, and it will take case of any channel mismatch
+static long long
+getPeakRSSBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return -1;
+    }
+    return pmc.PeakWorkingSetSize;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru)) {
+        return -1;
+    }
+#ifdef __APPLE__
+    return ru.ru_maxrss; // already in bytes on macOS
+#else
+    return (long long)ru.ru_maxrss * 1024;
+#endif
+#endif
+}
 
-    int minch = plugin->getMinChannelCount();
-    int maxch = plugin->getMaxChannelCount();
-    cerr << "Plugin accepts " << minch << " -> " << maxch << " channel(s)" << endl;
-    cerr << "Sound file has " << channels << " (will mix/augment if necessary)" << endl;
+static long long
+percentile(const vector<long long> &sorted, double p)
+{
+    // nearest-rank method
+    if (sorted.empty()) return 0;
+    size_t rank = size_t(ceil(p / 100.0 * sorted.size()));
+    if (rank < 1) rank = 1;
+    if (rank > sorted.size()) rank = sorted.size();
+    return sorted[rank - 1];
+}
 
-    Plugin::OutputList outputs = plugin->getOutputDescriptors();
-    Plugin::OutputDescriptor od;
-    Plugin::FeatureSet features;
+int runBenchmark(string myname, string soname, string id,
+                 string wavname, double synthSeconds,
+                 int runs, int warmups, string outfilename)
+{
+    PluginLoader *loader = PluginLoader::getInstance();
 
-    int returnValue = 1;
-    int progress = 0;
+    PluginLoader::PluginKey key = loader->composePluginKey(soname, id);
 
-    RealTime rt;
-    PluginWrapper *wrapper = 0;
-    RealTime adjustment = RealTime::zeroTime;
+    // Decode (or synthesise) the whole input up front, de-interleaved,
+    // so that none of that work falls within the timed region
 
-    if (outputs.empty()) {
-        cerr << "ERROR: Plugin has no outputs!" << endl;
-        goto done;
-    }
+    int sampleRate = 44100;
+    int channels = 2;
+    size_t frames = 0;
+    vector<vector<float> > data;
 
-    if (outputNo < 0) {
+    if (wavname != "") {
 
-        for (size_t oi = 0; oi < outputs.size(); ++oi) {
-            if (outputs[oi].identifier == output) {
-                outputNo = oi;
-                break;
-            }
+        SF_INFO sfinfo;
+        memset(&sfinfo, 0, sizeof(SF_INFO));
+
+        SNDFILE *sndfile = sf_open(wavname.c_str(), SFM_READ, &sfinfo);
+        if (!sndfile) {
+            cerr << myname << ": ERROR: Failed to open input file \""
+                 << wavname << "\": " << sf_strerror(sndfile) << endl;
+            return 1;
         }
 
-        if (outputNo < 0) {
-            cerr << "ERROR: Non-existent output \"" << output << "\" requested" << endl;
-            goto done;
+        sampleRate = sfinfo.samplerate;
+        channels = sfinfo.channels;
+        data.resize(channels);
+
+        const int chunk = 65536;
+        vector<float> filebuf(chunk * channels);
+        sf_count_t count;
+        
+        while ((count = sf_readf_float(sndfile, filebuf.data(), chunk)) > 0) {
+            for (int c = 0; c < channels; ++c) {
+                for (sf_count_t j = 0; j < count; ++j) {
+                    data[c].push_back(filebuf[j * channels + c]);
+                }
+            }
+            frames += count;
         }
 
+        sf_close(sndfile);
+        
     } else {
 
-        if (int(outputs.size()) <= outputNo) {
-            cerr << "ERROR: Output " << outputNo << " requested, but plugin has only " << outputs.size() << " output(s)" << endl;
-            goto done;
-        }        
+        // A tone in each channel, with a burst of noise every half
+        // second in the first, so that onset and spectral plugins
+        // have something to find
+        
+        frames = size_t(synthSeconds * sampleRate);
+        data.resize(channels);
+        unsigned int seed = 1;
+        
+        for (int c = 0; c < channels; ++c) {
+            data[c].resize(frames);
+            double freq = 440.0 * (c + 1);
+            for (size_t i = 0; i < frames; ++i) {
+                float v = float(0.3 * sin(2.0 * 3.14159265358979323846 * freq * i / sampleRate));
+                if (c == 0 && (i % (sampleRate / 2)) < 256) {
+                    seed = seed * 1103515245u + 12345u;
+                    v += float((seed >> 16) & 0x7fff) / 32768.f - 0.5f;
+                }
+                data[c][i] = v;
+            }
+        }
     }
 
-    od = outputs[outputNo];
-    cerr << "Output is: \"" << od.identifier << "\"" << endl;
+    if (frames == 0) {
+        cerr << myname << ": ERROR: Input is empty" << endl;
+        return 1;
+    }
+    
+    Plugin *plugin = loader->loadPlugin
+        (key, sampleRate, PluginLoader::ADAPT_ALL_SAFE);
+    if (!plugin) {
+        cerr << myname << ": ERROR: Failed to load plugin \"" << id
+             << "\" from library \"" << soname << "\"" << endl;
+        return 1;
+    }
+
+    int blockSize, stepSize;
+    chooseBlockAndStepSize(plugin, blockSize, stepSize);
+
+    cerr << "Using block size = " << blockSize << ", step size = "
+         << stepSize << endl;
 
     if (!plugin->initialise(channels, stepSize, blockSize)) {
         cerr << "ERROR: Plugin initialise (channels = " << channels
              << ", stepSize = " << stepSize << ", blockSize = "
              << blockSize << ") failed." << endl;
-        goto done;
+        delete plugin;
+        return 1;
     }
 
-    wrapper = dynamic_cast<PluginWrapper *>(plugin);
-    if (wrapper) {
-        // See documentation for
-        // PluginInputDomainAdapter::getTimestampAdjustment
-        PluginInputDomainAdapter *ida =
-            wrapper->getWrapper<PluginInputDomainAdapter>();
-        if (ida) adjustment = ida->getTimestampAdjustment();
+    // Cover the same blocks as runPlugin does, i.e. up to the first
+    // short read plus the part-silent ones after it, and zero-pad each
+    // channel so that every block can be passed to the plugin in place
+    
+    size_t blocks = max(1, (blockSize / stepSize) - 1);
+    if (frames >= size_t(blockSize)) {
+        blocks += (frames - blockSize) / stepSize + 1;
+    }
+    for (int c = 0; c < channels; ++c) {
+        data[c].resize(blocks * stepSize + blockSize, 0.f);
+    }
+
+    vector<RealTime> timestamps(blocks);
+    for (size_t i = 0; i < blocks; ++i) {
+        timestamps[i] = RealTime::frame2RealTime(i * stepSize, sampleRate);
     }
+
+    vector<const float *> buffers(channels);
+    vector<long long> latencies;
+    latencies.reserve(blocks * runs);
+    vector<double> runSeconds;
+
+    typedef chrono::steady_clock Clock;
     
-    // Here we iterate over the frames, avoiding asking the numframes in case it's streaming input.
-    do {
+    for (int r = 0; r < warmups + runs; ++r) {
 
-        int count;
+        if (r > 0) plugin->reset();
+        bool measured = (r >= warmups);
 
-        if ((blockSize==stepSize) || (currentStep==0)) {
-            // read a full fresh block
-            if ((count = sf_readf_float(sndfile, filebuf, blockSize)) < 0) {
-                cerr << "ERROR: sf_readf_float failed: " << sf_strerror(sndfile) << endl;
-                break;
-            }
-            if (count != blockSize) --finalStepsRemaining;
-        } else {
-            //  otherwise shunt the existing data down and read the remainder.
-            memmove(filebuf, filebuf + (stepSize * channels), overlapSize * channels * sizeof(float));
-            if ((count = sf_readf_float(sndfile, filebuf + (overlapSize * channels), stepSize)) < 0) {
-                cerr << "ERROR: sf_readf_float failed: " << sf_strerror(sndfile) << endl;
-                break;
-            }
-            if (count != stepSize) --finalStepsRemaining;
-            count += overlapSize;
-        }
+        Clock::time_point runStart = Clock::now();
 
-        for (int c = 0; c < channels; ++c) {
-            int j = 0;
-            while (j < count) {
-                plugbuf[c][j] = filebuf[j * sfinfo.channels + c];
-                ++j;
+        for (size_t i = 0; i < blocks; ++i) {
+            for (int c = 0; c < channels; ++c) {
+                buffers[c] = data[c].data() + i * stepSize;
             }
-            while (j < blockSize) {
-                plugbuf[c][j] = 0.0f;
-                ++j;
+            Clock::time_point t0 = Clock::now();
+            Plugin::FeatureSet features =
+                plugin->process(buffers.data(), timestamps[i]);
+            Clock::time_point t1 = Clock::now();
+            if (measured) {
+                latencies.push_back
+                    (chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count());
             }
         }
 
-        rt = RealTime::frame2RealTime(currentStep * stepSize, sfinfo.samplerate);
-
-        features = plugin->process(plugbuf, rt);
-        
-        printFeatures
-            (RealTime::realTime2Frame(rt + adjustment, sfinfo.samplerate),
-             sfinfo.samplerate, od, outputNo, features, out, useFrames);
+        Plugin::FeatureSet features = plugin->getRemainingFeatures();
 
-        if (sfinfo.frames > 0){
-            int pp = progress;
-            progress = (int)((float(currentStep * stepSize) / sfinfo.frames) * 100.f + 0.5f);
-            if (progress != pp && out) {
-                cerr << "\r" << progress << "%";
-            }
+        Clock::time_point runEnd = Clock::now();
+        if (measured) {
+            runSeconds.push_back
+                (chrono::duration<double>(runEnd - runStart).count());
         }
+    }
 
-        ++currentStep;
-
-    } while (finalStepsRemaining > 0);
+    delete plugin;
 
-    if (out) cerr << "\rDone" << endl;
+    long long totalProcessNs = 0;
+    for (size_t i = 0; i < latencies.size(); ++i) {
+        totalProcessNs += latencies[i];
+    }
+    sort(latencies.begin(), latencies.end());
+    sort(runSeconds.begin(), runSeconds.end());
 
-    rt = RealTime::frame2RealTime(currentStep * stepSize, sfinfo.samplerate);
+    double duration = double(frames) / sampleRate;
+    double medianSeconds = runSeconds[runSeconds.size() / 2];
+    if (runSeconds.size() % 2 == 0) {
+        medianSeconds = (medianSeconds + runSeconds[runSeconds.size() / 2 - 1]) / 2.0;
+    }
 
-    features = plugin->getRemainingFeatures();
-    
-    printFeatures(RealTime::realTime2Frame(rt + adjustment, sfinfo.samplerate),
-                  sfinfo.samplerate, od, outputNo, features, out, useFrames);
+    ofstream *out = 0;
+    if (outfilename != "") {
+        out = new ofstream(outfilename.c_str(), ios::out);
+        if (!*out) {
+            cerr << myname << ": ERROR: Failed to open output file \""
+                 << outfilename << "\" for writing" << endl;
+            delete out;
+            return 1;
+        }
+    }
 
-    returnValue = 0;
+    ostream &os = (out ? *out : cout);
+
+    os << "{\n"
+       << "  \"plugin\": " << jsonString(key) << ",\n"
+       << "  \"input\": " << (wavname != "" ? jsonString(wavname) : "null") << ",\n"
+       << "  \"sampleRate\": " << sampleRate << ",\n"
+       << "  \"channels\": " << channels << ",\n"
+       << "  \"frames\": " << frames << ",\n"
+       << "  \"durationSeconds\": " << duration << ",\n"
+       << "  \"blockSize\": " << blockSize << ",\n"
+       << "  \"stepSize\": " << stepSize << ",\n"
+       << "  \"blocks\": " << blocks << ",\n"
+       << "  \"warmupRuns\": " << warmups << ",\n"
+       << "  \"runs\": " << runs << ",\n"
+       << "  \"runSeconds\": [";
+    for (size_t i = 0; i < runSeconds.size(); ++i) {
+        os << (i > 0 ? ", " : "") << runSeconds[i];
+    }
+    os << "],\n"
+       << "  \"realTimeFactor\": " << medianSeconds / duration << ",\n"
+       << "  \"realTimeFactorBest\": " << runSeconds[0] / duration << ",\n"
+       << "  \"nsPerBlock\": " << totalProcessNs / (long long)latencies.size() << ",\n"
+       << "  \"processLatencyNs\": { \"p50\": " << percentile(latencies, 50)
+       << ", \"p99\": " << percentile(latencies, 99)
+       << ", \"max\": " << latencies[latencies.size() - 1] << " },\n"
+       << "  \"peakRssBytes\": " << getPeakRSSBytes() << "\n"
+       << "}" << endl;
 
-done:
-    delete plugin;
     if (out) {
         out->close();
         delete out;
     }
-    sf_close(sndfile);
-    return returnValue;
+    
+    return 0;
 }
 
 static double
@@ -506,12 +2290,11 @@ toSeconds(const RealTime &time)
 void
 printFeatures(int frame, int sr,
               const Plugin::OutputDescriptor &output, int outputNo,
-              const Plugin::FeatureSet &features, ofstream *out, bool useFrames)
+              const Plugin::FeatureSet &features, FeatureWriter &writer,
+              int &featureCount)
 {
-    static int featureCount = -1;
-    
     if (features.find(outputNo) == features.end()) return;
-    
+
     for (size_t i = 0; i < features.at(outputNo).size(); ++i) {
 
         const Plugin::Feature &f = features.at(outputNo).at(i);
@@ -531,46 +2314,22 @@ printFeatures(int frame, int sr,
             haveRt = true;
             featureCount = n;
         }
-        
-        if (useFrames) {
-
-            int displayFrame = frame;
 
+        int displayFrame = frame;
+        int durationFrames = 0;
+        
+        if (writer.usesFrames()) {
             if (haveRt) {
                 displayFrame = RealTime::realTime2Frame(rt, sr);
             }
-
-            (out ? *out : cout) << displayFrame;
-
-            if (f.hasDuration) {
-                displayFrame = RealTime::realTime2Frame(f.duration, sr);
-                (out ? *out : cout) << "," << displayFrame;
-            }
-
-            (out ? *out : cout)  << ":";
-
-        } else {
-
-            if (!haveRt) {
-                rt = RealTime::frame2RealTime(frame, sr);
-            }
-
-            (out ? *out : cout) << rt.toString();
-
             if (f.hasDuration) {
-                rt = f.duration;
-                (out ? *out : cout) << "," << rt.toString();
+                durationFrames = RealTime::realTime2Frame(f.duration, sr);
             }
-
-            (out ? *out : cout) << ":";
+        } else if (!haveRt) {
+            rt = RealTime::frame2RealTime(frame, sr);
         }
 
-        for (unsigned int j = 0; j < f.values.size(); ++j) {
-            (out ? *out : cout) << " " << f.values[j];
-        }
-        (out ? *out : cout) << " " << f.label;
-
-        (out ? *out : cout) << endl;
+        writer.write(f, rt, displayFrame, durationFrames);
     }
 }
 
@@ -703,6 +2462,20 @@ enumeratePlugins(Verbosity verbosity)
                      << plugin->getMinChannelCount() << endl;
                 cout << " - Maximum Channels:   " 
                      << plugin->getMaxChannelCount() << endl;
+                size_t warmUp = 0;
+                cout << " - State Dependency:   ";
+                switch (loader->getPluginStateDependency(key, &warmUp)) {
+                case Plugin::BlockLocal:
+                    cout << "Block Local"; break;
+                case Plugin::BoundedHistory:
+                    cout << "Bounded History (" << warmUp
+                         << " block(s) warm-up)"; break;
+                case Plugin::WholeSignal:
+                    cout << "Whole Signal"; break;
+                case Plugin::UnknownStateDependency:
+                    cout << "Unknown"; break;
+                }
+                cout << endl;
 
             } else if (verbosity == PluginIds) {
                 cout << "vamp:" << key << endl;
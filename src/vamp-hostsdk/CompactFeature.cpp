@@ -0,0 +1,229 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#include <vamp-hostsdk/CompactFeature.h>
+
+#include <cstring>
+
+using namespace std;
+
+_VAMP_SDK_HOSTSPACE_BEGIN(CompactFeature.cpp)
+
+namespace Vamp {
+
+namespace HostExt {
+
+// Space is allocated in blocks of at least this many floats
+static const size_t minBlockSize = 4096;
+
+FeatureArena::FeatureArena() :
+    m_block(0),
+    m_used(0)
+{
+}
+
+FeatureArena::~FeatureArena()
+{
+    for (size_t i = 0; i < m_blocks.size(); ++i) {
+        delete[] m_blocks[i];
+    }
+}
+
+float *
+FeatureArena::allocate(size_t n)
+{
+    while (m_block < m_blocks.size()) {
+        if (m_sizes[m_block] - m_used >= n) {
+            float *p = m_blocks[m_block] + m_used;
+            m_used += n;
+            return p;
+        }
+        ++m_block;
+        m_used = 0;
+    }
+
+    size_t size = minBlockSize;
+    if (!m_sizes.empty() && m_sizes[m_sizes.size()-1] * 2 > size) {
+        size = m_sizes[m_sizes.size()-1] * 2;
+    }
+    if (n > size) size = n;
+
+    float *block = new float[size];
+    m_blocks.push_back(block);
+    m_sizes.push_back(size);
+    m_block = m_blocks.size() - 1;
+    m_used = n;
+    return block;
+}
+
+void
+FeatureArena::clear()
+{
+    m_block = 0;
+    m_used = 0;
+}
+
+FeatureValues::FeatureValues(const float *values, size_t count,
+                             FeatureArena *arena) :
+    m_size(0),
+    m_external(0),
+    m_owned(false)
+{
+    assign(values, count, arena);
+}
+
+FeatureValues::FeatureValues(const vector<float> &values) :
+    m_size(0),
+    m_external(0),
+    m_owned(false)
+{
+    assign(values.empty() ? 0 : &values[0], values.size(), 0);
+}
+
+FeatureValues::FeatureValues(const FeatureValues &other) :
+    m_size(0),
+    m_external(0),
+    m_owned(false)
+{
+    assign(other.data(), other.size(), 0);
+}
+
+FeatureValues::FeatureValues(FeatureValues &&other) :
+    m_size(other.m_size),
+    m_external(other.m_external),
+    m_owned(other.m_owned)
+{
+    if (m_size <= InlineCapacity) {
+        for (size_t i = 0; i < m_size; ++i) m_inline[i] = other.m_inline[i];
+    }
+    other.m_size = 0;
+    other.m_external = 0;
+    other.m_owned = false;
+}
+
+FeatureValues::~FeatureValues()
+{
+    release();
+}
+
+FeatureValues &
+FeatureValues::operator=(const FeatureValues &other)
+{
+    if (&other != this) {
+        release();
+        assign(other.data(), other.size(), 0);
+    }
+    return *this;
+}
+
+FeatureValues &
+FeatureValues::operator=(FeatureValues &&other)
+{
+    if (&other != this) {
+        release();
+        m_size = other.m_size;
+        m_external = other.m_external;
+        m_owned = other.m_owned;
+        if (m_size <= InlineCapacity) {
+            for (size_t i = 0; i < m_size; ++i) m_inline[i] = other.m_inline[i];
+        }
+        other.m_size = 0;
+        other.m_external = 0;
+        other.m_owned = false;
+    }
+    return *this;
+}
+
+void
+FeatureValues::assign(const float *values, size_t count, FeatureArena *arena)
+{
+    // must be called with nothing currently held
+    
+    m_size = count;
+
+    if (count <= InlineCapacity) {
+        for (size_t i = 0; i < count; ++i) m_inline[i] = values[i];
+        return;
+    }
+
+    if (arena) {
+        m_external = arena->allocate(count);
+        m_owned = false;
+    } else {
+        m_external = new float[count];
+        m_owned = true;
+    }
+
+    memcpy(m_external, values, count * sizeof(float));
+}
+
+void
+FeatureValues::release()
+{
+    if (m_owned) delete[] m_external;
+    m_size = 0;
+    m_external = 0;
+    m_owned = false;
+}
+
+CompactFeature::CompactFeature(Plugin::Feature &&feature) :
+    hasTimestamp(feature.hasTimestamp),
+    timestamp(feature.timestamp),
+    hasDuration(feature.hasDuration),
+    duration(feature.duration),
+    values(feature.values),
+    label(std::move(feature.label))
+{
+}
+
+Plugin::Feature
+CompactFeature::toFeature() const
+{
+    Plugin::Feature feature;
+    feature.hasTimestamp = hasTimestamp;
+    feature.timestamp = timestamp;
+    feature.hasDuration = hasDuration;
+    feature.duration = duration;
+    feature.values.assign(values.begin(), values.end());
+    feature.label = label;
+    return feature;
+}
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(CompactFeature.cpp)
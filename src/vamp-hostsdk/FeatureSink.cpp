@@ -0,0 +1,114 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#include <vamp-hostsdk/FeatureSink.h>
+#include <vamp-hostsdk/CompactFeature.h>
+#include <vamp-hostsdk/PluginWrapper.h>
+#include <vamp-hostsdk/PluginHostAdapter.h>
+
+using namespace std;
+
+_VAMP_SDK_HOSTSPACE_BEGIN(FeatureSink.cpp)
+
+namespace Vamp {
+
+namespace HostExt {
+
+FeatureSink::~FeatureSink()
+{
+}
+
+void
+FeatureSink::pushCompact(int outputNumber, CompactFeature &&feature)
+{
+    push(outputNumber, feature.toFeature());
+}
+
+void
+FeatureSink::pushAll(Plugin::FeatureSet &&features)
+{
+    for (Plugin::FeatureSet::iterator i = features.begin();
+         i != features.end(); ++i) {
+        for (size_t j = 0; j < i->second.size(); ++j) {
+            push(i->first, std::move(i->second[j]));
+        }
+    }
+}
+
+void
+FeatureSink::processFrom(Plugin *plugin,
+                         const float *const *inputBuffers,
+                         RealTime timestamp)
+{
+    PluginWrapper *wrapper = dynamic_cast<PluginWrapper *>(plugin);
+    if (wrapper) {
+        wrapper->processInto(inputBuffers, timestamp, *this);
+        return;
+    }
+
+    PluginHostAdapter *adapter = dynamic_cast<PluginHostAdapter *>(plugin);
+    if (adapter) {
+        adapter->processInto(inputBuffers, timestamp, *this);
+        return;
+    }
+
+    pushAll(plugin->process(inputBuffers, timestamp));
+}
+
+void
+FeatureSink::remainingFeaturesFrom(Plugin *plugin)
+{
+    PluginWrapper *wrapper = dynamic_cast<PluginWrapper *>(plugin);
+    if (wrapper) {
+        wrapper->getRemainingFeaturesInto(*this);
+        return;
+    }
+
+    PluginHostAdapter *adapter = dynamic_cast<PluginHostAdapter *>(plugin);
+    if (adapter) {
+        adapter->getRemainingFeaturesInto(*this);
+        return;
+    }
+
+    pushAll(plugin->getRemainingFeatures());
+}
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(FeatureSink.cpp)
+
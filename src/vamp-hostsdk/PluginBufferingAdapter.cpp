@@ -40,6 +40,11 @@
 
 #include <vamp-hostsdk/PluginBufferingAdapter.h>
 #include <vamp-hostsdk/PluginInputDomainAdapter.h>
+#include <vamp-hostsdk/FeatureSink.h>
+#include <vamp-hostsdk/CompactFeature.h>
+#include <vamp-hostsdk/Trace.h>
+
+#include "StateData.h"
 
 #include <iostream>
 using std::cerr;
@@ -74,9 +79,13 @@ public:
 
     void reset();
 
-    FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
+    bool getState(StateData &state) const;
+    bool setState(const StateData &state);
+
+    void process(const float *const *inputBuffers, RealTime timestamp,
+                 FeatureSink &sink);
 		
-    FeatureSet getRemainingFeatures();
+    void getRemainingFeatures(FeatureSink &sink);
 		
 protected:
     class RingBuffer
@@ -244,14 +253,51 @@ protected:
     vector<RingBuffer *> m_queue;
     float **m_buffers;
     float m_inputSampleRate;
-    long m_frame;
+    int64_t m_frame;
     bool m_unrun;
     mutable OutputList m_outputs;
     mutable std::map<int, bool> m_rewriteOutputTimes;
     std::map<int, int> m_fixedRateFeatureNos; // output no -> feature no
 		
-    void processBlock(FeatureSet& allFeatureSets);
-    void adjustFixedRateFeatureTime(int outputNo, Feature &);
+    void processBlock(FeatureSink &sink);
+    template <typename F> void adjustFixedRateFeatureTime(int outputNo, F &);
+
+    // Sink that applies our timestamp adjustments to the features
+    // returned by the plugin on their way through to the host's sink
+    class RetimingSink : public FeatureSink
+    {
+    public:
+        // for features from process()
+        RetimingSink(Impl *impl, FeatureSink &target, RealTime timestamp) :
+            m_impl(impl), m_target(target), m_timestamp(timestamp),
+            m_final(false) { }
+        
+        // for features from getRemainingFeatures()
+        RetimingSink(Impl *impl, FeatureSink &target) :
+            m_impl(impl), m_target(target), m_final(true) { }
+        
+        void push(int outputNo, Feature &&feature) {
+            retime(outputNo, feature);
+            m_target.push(outputNo, std::move(feature));
+        }
+
+        bool acceptsCompactFeatures() const {
+            return m_target.acceptsCompactFeatures();
+        }
+
+        void pushCompact(int outputNo, CompactFeature &&feature) {
+            retime(outputNo, feature);
+            m_target.pushCompact(outputNo, std::move(feature));
+        }
+
+    private:
+        template <typename F> void retime(int outputNo, F &feature);
+
+        Impl *m_impl;
+        FeatureSink &m_target;
+        RealTime m_timestamp;
+        bool m_final;
+    };
 };
 		
 PluginBufferingAdapter::PluginBufferingAdapter(Plugin *plugin) :
@@ -320,6 +366,30 @@ PluginBufferingAdapter::getOutputDescriptors() const
     return m_impl->getOutputDescriptors();
 }
 
+Plugin::StateDependency
+PluginBufferingAdapter::getStateDependency() const
+{
+    return UnknownStateDependency;
+}
+
+size_t
+PluginBufferingAdapter::getWarmUpBlockCount() const
+{
+    return 0;
+}
+
+bool
+PluginBufferingAdapter::getState(StateData &state) const
+{
+    return m_impl->getState(state);
+}
+
+bool
+PluginBufferingAdapter::setState(const StateData &state)
+{
+    return m_impl->setState(state);
+}
+
 void
 PluginBufferingAdapter::setParameter(std::string name, float value)
 {
@@ -342,13 +412,33 @@ PluginBufferingAdapter::FeatureSet
 PluginBufferingAdapter::process(const float *const *inputBuffers,
                                 RealTime timestamp)
 {
-    return m_impl->process(inputBuffers, timestamp);
+    FeatureSet fs;
+    FeatureSetSink sink(fs);
+    m_impl->process(inputBuffers, timestamp, sink);
+    return fs;
 }
 		
 PluginBufferingAdapter::FeatureSet
 PluginBufferingAdapter::getRemainingFeatures()
 {
-    return m_impl->getRemainingFeatures();
+    FeatureSet fs;
+    FeatureSetSink sink(fs);
+    m_impl->getRemainingFeatures(sink);
+    return fs;
+}
+
+void
+PluginBufferingAdapter::processInto(const float *const *inputBuffers,
+                                    RealTime timestamp,
+                                    FeatureSink &sink)
+{
+    m_impl->process(inputBuffers, timestamp, sink);
+}
+
+void
+PluginBufferingAdapter::getRemainingFeaturesInto(FeatureSink &sink)
+{
+    m_impl->getRemainingFeatures(sink);
 }
 		
 PluginBufferingAdapter::Impl::Impl(Plugin *plugin, float inputSampleRate) :
@@ -575,20 +665,101 @@ PluginBufferingAdapter::Impl::reset()
     m_plugin->reset();
 }
 
-PluginBufferingAdapter::FeatureSet
+bool
+PluginBufferingAdapter::Impl::getState(StateData &state) const
+{
+    StateData pluginState;
+    if (!m_plugin->getState(pluginState)) return false;
+
+    StateWriter writer(state);
+    writer.put(m_frame);
+    writer.put(m_unrun);
+
+    writer.put(m_fixedRateFeatureNos.size());
+    for (std::map<int, int>::const_iterator i = m_fixedRateFeatureNos.begin();
+         i != m_fixedRateFeatureNos.end(); ++i) {
+        writer.put(i->first);
+        writer.put(i->second);
+    }
+
+    // Only the queued samples are saved, not the read and write
+    // positions, which are of no significance to the output
+    writer.put(m_queue.size());
+    for (size_t i = 0; i < m_queue.size(); ++i) {
+        vector<float> queued(m_queue[i]->getReadSpace());
+        if (!queued.empty()) {
+            m_queue[i]->peek(&queued[0], int(queued.size()));
+        }
+        writer.putFloats(queued.empty() ? 0 : &queued[0], queued.size());
+    }
+
+    writer.putData(pluginState);
+    return true;
+}
+
+bool
+PluginBufferingAdapter::Impl::setState(const StateData &state)
+{
+    StateReader reader(state);
+
+    int64_t frame = 0;
+    bool unrun = true;
+    std::map<int, int> featureNos;
+    size_t n = 0;
+    
+    if (!reader.get(frame) || !reader.get(unrun) || !reader.get(n)) {
+        return false;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        int outputNo = 0, featureNo = 0;
+        if (!reader.get(outputNo) || !reader.get(featureNo)) return false;
+        featureNos[outputNo] = featureNo;
+    }
+
+    if (!reader.get(n) || n != m_queue.size()) {
+        std::cerr << "WARNING: PluginBufferingAdapter::setState: "
+                  << "State does not match channel count" << std::endl;
+        return false;
+    }
+    vector<vector<float> > queued(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (!reader.getFloats(queued[i]) ||
+            int(queued[i].size()) > m_queue[i]->getSize()) {
+            return false;
+        }
+    }
+
+    StateData pluginState;
+    if (!reader.getData(pluginState) || !reader.atEnd()) return false;
+    if (!m_plugin->setState(pluginState)) return false;
+
+    m_frame = frame;
+    m_unrun = unrun;
+    m_fixedRateFeatureNos = featureNos;
+    for (size_t i = 0; i < n; ++i) {
+        m_queue[i]->reset();
+        if (!queued[i].empty()) {
+            m_queue[i]->write(&queued[i][0], int(queued[i].size()));
+        }
+    }
+    return true;
+}
+
+void
 PluginBufferingAdapter::Impl::process(const float *const *inputBuffers,
-                                      RealTime timestamp)
+                                      RealTime timestamp,
+                                      FeatureSink &sink)
 {
+    VAMP_TRACE_SCOPE("PluginBufferingAdapter::process");
+    
     if (m_inputStepSize == 0) {
         std::cerr << "PluginBufferingAdapter::process: ERROR: Plugin has not been initialised" << std::endl;
-        return FeatureSet();
+        return;
     }
 
-    FeatureSet allFeatureSets;
-
     if (m_unrun) {
-        m_frame = RealTime::realTime2Frame(timestamp,
-                                           int(m_inputSampleRate + 0.5));
+        m_frame = RealTime::toFrame(timestamp,
+                                    int(m_inputSampleRate + 0.5));
         m_unrun = false;
     }
 			
@@ -609,32 +780,57 @@ PluginBufferingAdapter::Impl::process(const float *const *inputBuffers,
     // process as much as we can
 
     while (m_queue[0]->getReadSpace() >= int(m_blockSize)) {
-        processBlock(allFeatureSets);
+        processBlock(sink);
     }	
-    
-    return allFeatureSets;
 }
     
+template <typename F>
 void
 PluginBufferingAdapter::Impl::adjustFixedRateFeatureTime(int outputNo,
-                                                         Feature &feature)
+                                                         F &feature)
 {
 //    cerr << "adjustFixedRateFeatureTime: from " << feature.timestamp;
     
     double rate = m_outputs[outputNo].sampleRate;
+
+    // Where the feature rate is a whole number of steps at a
+    // whole-number input rate, or is itself a whole number, we can
+    // use exact integer frame arithmetic, which does not drift however
+    // long the input. Otherwise go through seconds as a double
+    
+    unsigned int frameRate = 0; // rate in frames per second
+    int64_t framesPerFeature = 1;
+    
     if (rate == 0.0) {
         rate = m_inputSampleRate / float(m_stepSize);
+        if (m_inputSampleRate == float(int(m_inputSampleRate))) {
+            frameRate = int(m_inputSampleRate);
+            framesPerFeature = m_stepSize;
+        }
+    } else if (rate == double(int(rate))) {
+        frameRate = int(rate);
     }
     
     if (feature.hasTimestamp) {
-        double secs = feature.timestamp.sec;
-        secs += feature.timestamp.nsec / 1e9;
-        m_fixedRateFeatureNos[outputNo] = int(secs * rate + 0.5);
-//        cerr << " [secs = " << secs << ", no = " << m_fixedRateFeatureNos[outputNo] << "]";
+        if (frameRate > 0) {
+            int64_t frame = RealTime::toFrame(feature.timestamp, frameRate);
+            m_fixedRateFeatureNos[outputNo] =
+                int((frame + framesPerFeature / 2) / framesPerFeature);
+        } else {
+            double secs = feature.timestamp.sec;
+            secs += feature.timestamp.nsec / 1e9;
+            m_fixedRateFeatureNos[outputNo] = int(secs * rate + 0.5);
+        }
+//        cerr << " [no = " << m_fixedRateFeatureNos[outputNo] << "]";
     }
 
-    feature.timestamp = RealTime::fromSeconds
-        (m_fixedRateFeatureNos[outputNo] / rate);
+    if (frameRate > 0) {
+        feature.timestamp = RealTime::fromFrame
+            (m_fixedRateFeatureNos[outputNo] * framesPerFeature, frameRate);
+    } else {
+        feature.timestamp = RealTime::fromSeconds
+            (m_fixedRateFeatureNos[outputNo] / rate);
+    }
 
 //    cerr << " to " << feature.timestamp << " (rate = " << rate << ", hasTimestamp = " << feature.hasTimestamp << ")" << endl;
     
@@ -643,14 +839,12 @@ PluginBufferingAdapter::Impl::adjustFixedRateFeatureTime(int outputNo,
     m_fixedRateFeatureNos[outputNo] = m_fixedRateFeatureNos[outputNo] + 1;
 }    
 
-PluginBufferingAdapter::FeatureSet
-PluginBufferingAdapter::Impl::getRemainingFeatures() 
+void
+PluginBufferingAdapter::Impl::getRemainingFeatures(FeatureSink &sink)
 {
-    FeatureSet allFeatureSets;
-    
     // process remaining samples in queue
     while (m_queue[0]->getReadSpace() >= int(m_blockSize)) {
-        processBlock(allFeatureSets);
+        processBlock(sink);
     }
     
     // pad any last samples remaining and process
@@ -658,46 +852,28 @@ PluginBufferingAdapter::Impl::getRemainingFeatures()
         for (size_t i = 0; i < m_channels; ++i) {
             m_queue[i]->zero(int(m_blockSize) - m_queue[i]->getReadSpace());
         }
-        processBlock(allFeatureSets);
+        processBlock(sink);
     }			
     
     // get remaining features			
 
-    FeatureSet featureSet = m_plugin->getRemainingFeatures();
-
-    for (map<int, FeatureList>::iterator iter = featureSet.begin();
-         iter != featureSet.end(); ++iter) {
-
-        int outputNo = iter->first;
-        FeatureList featureList = iter->second;
-
-        for (size_t i = 0; i < featureList.size(); ++i) {
-
-            if (m_outputs[outputNo].sampleType ==
-                OutputDescriptor::FixedSampleRate) {
-                adjustFixedRateFeatureTime(outputNo, featureList[i]);
-            }
-
-            allFeatureSets[outputNo].push_back(featureList[i]);
-        }
-    }
-    
-    return allFeatureSets;
+    RetimingSink retiming(this, sink);
+    retiming.remainingFeaturesFrom(m_plugin);
 }
     
 void
-PluginBufferingAdapter::Impl::processBlock(FeatureSet& allFeatureSets)
+PluginBufferingAdapter::Impl::processBlock(FeatureSink &sink)
 {
+    VAMP_TRACE_SCOPE("PluginBufferingAdapter::processBlock");
+    
     for (size_t i = 0; i < m_channels; ++i) {
         m_queue[i]->peek(m_buffers[i], int(m_blockSize));
     }
 
-    long frame = m_frame;
-    RealTime timestamp = RealTime::frame2RealTime
+    int64_t frame = m_frame;
+    RealTime timestamp = RealTime::fromFrame
         (frame, int(m_inputSampleRate + 0.5));
 
-    FeatureSet featureSet = m_plugin->process(m_buffers, timestamp);
-    
     PluginWrapper *wrapper = dynamic_cast<PluginWrapper *>(m_plugin);
     RealTime adjustment;
     if (wrapper) {
@@ -706,45 +882,8 @@ PluginBufferingAdapter::Impl::processBlock(FeatureSet& allFeatureSets)
         if (ida) adjustment = ida->getTimestampAdjustment();
     }
 
-    for (FeatureSet::iterator iter = featureSet.begin();
-         iter != featureSet.end(); ++iter) {
-
-        int outputNo = iter->first;
-
-        if (m_rewriteOutputTimes[outputNo]) {
-            
-            FeatureList featureList = iter->second;
-	
-            for (size_t i = 0; i < featureList.size(); ++i) {
-
-                switch (m_outputs[outputNo].sampleType) {
-
-                case OutputDescriptor::OneSamplePerStep:
-                    // use our internal timestamp, always
-                    featureList[i].timestamp = timestamp + adjustment;
-                    featureList[i].hasTimestamp = true;
-                    break;
-
-                case OutputDescriptor::FixedSampleRate:
-                    adjustFixedRateFeatureTime(outputNo, featureList[i]);
-                    break;
-
-                case OutputDescriptor::VariableSampleRate:
-                    // plugin must set timestamp
-                    break;
-
-                default:
-                    break;
-                }
-            
-                allFeatureSets[outputNo].push_back(featureList[i]);
-            }
-        } else {
-            for (size_t i = 0; i < iter->second.size(); ++i) {
-                allFeatureSets[outputNo].push_back(iter->second[i]);
-            }
-        }
-    }
+    RetimingSink retiming(this, sink, timestamp + adjustment);
+    retiming.processFrom(m_plugin, m_buffers, timestamp);
     
     // step forward
 
@@ -756,6 +895,41 @@ PluginBufferingAdapter::Impl::processBlock(FeatureSet& allFeatureSets)
     m_frame += m_stepSize;
 }
 
+template <typename F>
+void
+PluginBufferingAdapter::Impl::RetimingSink::retime(int outputNo, F &feature)
+{
+    if (m_final) {
+
+        if (m_impl->m_outputs[outputNo].sampleType ==
+            OutputDescriptor::FixedSampleRate) {
+            m_impl->adjustFixedRateFeatureTime(outputNo, feature);
+        }
+
+    } else if (m_impl->m_rewriteOutputTimes[outputNo]) {
+
+        switch (m_impl->m_outputs[outputNo].sampleType) {
+
+        case OutputDescriptor::OneSamplePerStep:
+            // use our internal timestamp, always
+            feature.timestamp = m_timestamp;
+            feature.hasTimestamp = true;
+            break;
+
+        case OutputDescriptor::FixedSampleRate:
+            m_impl->adjustFixedRateFeatureTime(outputNo, feature);
+            break;
+
+        case OutputDescriptor::VariableSampleRate:
+            // plugin must set timestamp
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
 }
 	
 }
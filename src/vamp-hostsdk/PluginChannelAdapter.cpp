@@ -35,6 +35,8 @@
 */
 
 #include <vamp-hostsdk/PluginChannelAdapter.h>
+#include <vamp-hostsdk/FeatureSink.h>
+#include <vamp-hostsdk/Trace.h>
 
 _VAMP_SDK_HOSTSPACE_BEGIN(PluginChannelAdapter.cpp)
 
@@ -50,8 +52,19 @@ public:
 
     bool initialise(size_t channels, size_t stepSize, size_t blockSize);
 
-    FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
-    FeatureSet processInterleaved(const float *inputBuffers, RealTime timestamp);
+    void process(const float *const *inputBuffers, RealTime timestamp,
+                 FeatureSink &sink);
+    void processInterleaved(const float *inputBuffers, RealTime timestamp,
+                            FeatureSink &sink);
+    void processStrided(const float *inputBuffer, size_t frames,
+                        size_t stride, RealTime timestamp,
+                        FeatureSink &sink);
+
+    bool canForwardStrided() const { return m_forwardStrided; }
+    bool canForwardDouble() const { return m_forwardDouble; }
+
+    size_t getPluginChannelCount() const { return m_pluginChannels; }
+    size_t getBlockSize() const { return m_blockSize; }
 
 protected:
     Plugin *m_plugin;
@@ -61,6 +74,8 @@ protected:
     float **m_buffer;
     float **m_deinterleave;
     const float **m_forwardPtrs;
+    bool m_forwardStrided;
+    bool m_forwardDouble;
 };
 
 PluginChannelAdapter::PluginChannelAdapter(Plugin *plugin) :
@@ -84,14 +99,69 @@ PluginChannelAdapter::FeatureSet
 PluginChannelAdapter::process(const float *const *inputBuffers,
                               RealTime timestamp)
 {
-    return m_impl->process(inputBuffers, timestamp);
+    FeatureSet fs;
+    FeatureSetSink sink(fs);
+    m_impl->process(inputBuffers, timestamp, sink);
+    return fs;
+}
+
+void
+PluginChannelAdapter::processInto(const float *const *inputBuffers,
+                                  RealTime timestamp,
+                                  FeatureSink &sink)
+{
+    m_impl->process(inputBuffers, timestamp, sink);
 }
 
 PluginChannelAdapter::FeatureSet
 PluginChannelAdapter::processInterleaved(const float *inputBuffers,
                                          RealTime timestamp)
 {
-    return m_impl->processInterleaved(inputBuffers, timestamp);
+    FeatureSet fs;
+    FeatureSetSink sink(fs);
+    m_impl->processInterleaved(inputBuffers, timestamp, sink);
+    return fs;
+}
+
+PluginChannelAdapter::FeatureSet
+PluginChannelAdapter::processStrided(const float *inputBuffer,
+                                     size_t /* channels */,
+                                     size_t frames,
+                                     size_t stride,
+                                     RealTime timestamp)
+{
+    FeatureSet fs;
+    FeatureSetSink sink(fs);
+    m_impl->processStrided(inputBuffer, frames, stride, timestamp, sink);
+    return fs;
+}
+
+bool
+PluginChannelAdapter::supportsStridedInput() const
+{
+    return m_impl->canForwardStrided();
+}
+
+PluginChannelAdapter::FeatureSet
+PluginChannelAdapter::processDouble(const double *const *inputBuffers,
+                                    size_t channels,
+                                    size_t frames,
+                                    RealTime timestamp)
+{
+    if (!m_impl->canForwardDouble() || frames != m_impl->getBlockSize()) {
+        return Plugin::processDouble(inputBuffers, channels, frames,
+                                     timestamp);
+    }
+    // The plugin reads the leading channels of the input directly
+    return m_plugin->processDouble(inputBuffers,
+                                   m_impl->getPluginChannelCount(),
+                                   frames, timestamp);
+}
+
+bool
+PluginChannelAdapter::supportsDoubleInput() const
+{
+    return m_impl->canForwardDouble();
 }
 
 PluginChannelAdapter::Impl::Impl(Plugin *plugin) :
@@ -101,7 +171,9 @@ PluginChannelAdapter::Impl::Impl(Plugin *plugin) :
     m_pluginChannels(0),
     m_buffer(0),
     m_deinterleave(0),
-    m_forwardPtrs(0)
+    m_forwardPtrs(0),
+    m_forwardStrided(false),
+    m_forwardDouble(false)
 {
 }
 
@@ -190,33 +262,80 @@ PluginChannelAdapter::Impl::initialise(size_t channels, size_t stepSize, size_t
         m_pluginChannels = m_inputChannels;
     }
 
-    return m_plugin->initialise(m_pluginChannels, stepSize, blockSize);
+    if (!m_plugin->initialise(m_pluginChannels, stepSize, blockSize)) {
+        return false;
+    }
+
+    // The plugin can read a caller's strided buffer directly if it
+    // takes either all of the input channels or the leading subset of
+    // them, i.e. unless we are padding out channels or mixing down to
+    // mono
+    m_forwardStrided =
+        (m_inputChannels >= m_pluginChannels) &&
+        !(m_inputChannels > m_pluginChannels && m_pluginChannels == 1) &&
+        m_plugin->supportsStridedInput();
+
+    // Likewise for double-precision input, which is in separate
+    // channel buffers already
+    m_forwardDouble =
+        (m_inputChannels >= m_pluginChannels) &&
+        !(m_inputChannels > m_pluginChannels && m_pluginChannels == 1) &&
+        m_plugin->supportsDoubleInput();
+    
+    return true;
 }
 
-PluginChannelAdapter::FeatureSet
+void
 PluginChannelAdapter::Impl::processInterleaved(const float *inputBuffers,
-                                               RealTime timestamp)
+                                               RealTime timestamp,
+                                               FeatureSink &sink)
 {
+    processStrided(inputBuffers, m_blockSize, m_inputChannels,
+                   timestamp, sink);
+}
+
+void
+PluginChannelAdapter::Impl::processStrided(const float *inputBuffer,
+                                           size_t frames,
+                                           size_t stride,
+                                           RealTime timestamp,
+                                           FeatureSink &sink)
+{
+    VAMP_TRACE_SCOPE("PluginChannelAdapter::processStrided");
+    
+    if (canForwardStrided()) {
+        sink.pushAll(m_plugin->processStrided(inputBuffer, m_pluginChannels,
+                                              frames, stride, timestamp));
+        return;
+    }
+
+    // Room for frequency-domain input as well, for a plugin wrapped
+    // without an input domain adapter
+    if (frames > m_blockSize + 2) frames = m_blockSize + 2;
+    
     if (!m_deinterleave) {
         m_deinterleave = new float *[m_inputChannels];
         for (size_t i = 0; i < m_inputChannels; ++i) {
-            m_deinterleave[i] = new float[m_blockSize];
+            m_deinterleave[i] = new float[m_blockSize + 2];
         }
     }
 
     for (size_t i = 0; i < m_inputChannels; ++i) {
-        for (size_t j = 0; j < m_blockSize; ++j) {
-            m_deinterleave[i][j] = inputBuffers[j * m_inputChannels + i];
+        for (size_t j = 0; j < frames; ++j) {
+            m_deinterleave[i][j] = inputBuffer[j * stride + i];
         }
     }
 
-    return process(m_deinterleave, timestamp);
+    process(m_deinterleave, timestamp, sink);
 }
 
-PluginChannelAdapter::FeatureSet
+void
 PluginChannelAdapter::Impl::process(const float *const *inputBuffers,
-                                    RealTime timestamp)
+                                    RealTime timestamp,
+                                    FeatureSink &sink)
 {
+    VAMP_TRACE_SCOPE("PluginChannelAdapter::process");
+
 //    std::cerr << "PluginChannelAdapter::process: " << m_inputChannels << " -> " << m_pluginChannels << " channels" << std::endl;
 
     if (m_inputChannels < m_pluginChannels) {
@@ -234,7 +353,7 @@ PluginChannelAdapter::Impl::process(const float *const *inputBuffers,
             }
         }
 
-        return m_plugin->process(m_forwardPtrs, timestamp);
+        sink.processFrom(m_plugin, m_forwardPtrs, timestamp);
 
     } else if (m_inputChannels > m_pluginChannels) {
 
@@ -250,14 +369,14 @@ PluginChannelAdapter::Impl::process(const float *const *inputBuffers,
             for (size_t j = 0; j < m_blockSize; ++j) {
                 m_buffer[0][j] /= float(m_inputChannels);
             }
-            return m_plugin->process(m_buffer, timestamp);
+            sink.processFrom(m_plugin, m_buffer, timestamp);
         } else {
-            return m_plugin->process(inputBuffers, timestamp);
+            sink.processFrom(m_plugin, inputBuffers, timestamp);
         }
 
     } else {
 
-        return m_plugin->process(inputBuffers, timestamp);
+        sink.processFrom(m_plugin, inputBuffers, timestamp);
     }
 }
 
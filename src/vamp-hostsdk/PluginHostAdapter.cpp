@@ -35,6 +35,9 @@
 */
 
 #include <vamp-hostsdk/PluginHostAdapter.h>
+#include <vamp-hostsdk/FeatureSink.h>
+#include <vamp-hostsdk/CompactFeature.h>
+#include <vamp-hostsdk/Trace.h>
 #include <cstdlib>
 
 #include "Files.h"
@@ -50,20 +53,38 @@ namespace Vamp
 
 PluginHostAdapter::PluginHostAdapter(const VampPluginDescriptor *descriptor,
                                      float inputSampleRate) :
+    PluginHostAdapter(descriptor, 0, inputSampleRate)
+{
+}
+
+PluginHostAdapter::PluginHostAdapter(const VampPluginDescriptor *descriptor,
+                                     const VampPluginExtensions *extensions,
+                                     float inputSampleRate) :
     Plugin(inputSampleRate),
-    m_descriptor(descriptor)
+    m_descriptor(descriptor),
+    m_extensions(extensions),
+    m_outputBuffer(0),
+    m_outputBufferSize(0),
+    m_arena(0),
+    m_outputsValid(false)
 {
 //    std::cerr << "PluginHostAdapter::PluginHostAdapter (plugin = " << descriptor->name << ")" << std::endl;
     m_handle = m_descriptor->instantiate(m_descriptor, inputSampleRate);
     if (!m_handle) {
 //        std::cerr << "WARNING: PluginHostAdapter: Plugin instantiation failed for plugin " << m_descriptor->name << std::endl;
     }
+    m_useOutputBuffer =
+        VAMP_HAS_EXTENSION(m_extensions, processToBuffer) &&
+        VAMP_HAS_EXTENSION(m_extensions, getRemainingFeaturesToBuffer) &&
+        VAMP_HAS_EXTENSION(m_extensions, retrieveFeatures);
 }
 
 PluginHostAdapter::~PluginHostAdapter()
 {
 //    std::cerr << "PluginHostAdapter::~PluginHostAdapter (plugin = " << m_descriptor->name << ")" << std::endl;
     if (m_handle) m_descriptor->cleanup(m_handle);
+    free(m_outputBuffer);
+    delete m_arena;
 }
 
 std::vector<std::string>
@@ -131,12 +152,14 @@ PluginHostAdapter::initialise(size_t channels,
                               size_t blockSize)
 {
     if (!m_handle) return false;
-    return m_descriptor->initialise
+    bool result = m_descriptor->initialise
         (m_handle,
          (unsigned int)channels,
          (unsigned int)stepSize,
          (unsigned int)blockSize) ?
         true : false;
+    invalidateOutputs();
+    return result;
 }
 
 void
@@ -251,6 +274,7 @@ PluginHostAdapter::setParameter(std::string param,
     for (unsigned int i = 0; i < m_descriptor->parameterCount; ++i) {
         if (param == m_descriptor->parameters[i]->identifier) {
             m_descriptor->setParameter(m_handle, i, value);
+            invalidateOutputs();
             return;
         }
     }
@@ -289,6 +313,7 @@ PluginHostAdapter::selectProgram(std::string program)
     for (unsigned int i = 0; i < m_descriptor->programCount; ++i) {
         if (program == m_descriptor->programs[i]) {
             m_descriptor->selectProgram(m_handle, i);
+            invalidateOutputs();
             return;
         }
     }
@@ -322,19 +347,35 @@ PluginHostAdapter::getMaxChannelCount() const
     return m_descriptor->getMaxChannelCount(m_handle);
 }
 
+void
+PluginHostAdapter::invalidateOutputs()
+{
+    std::lock_guard<std::mutex> guard(m_outputsMutex);
+    m_outputsValid = false;
+    m_outputs.clear();
+}
+
 PluginHostAdapter::OutputList
 PluginHostAdapter::getOutputDescriptors() const
 {
-    OutputList list;
     if (!m_handle) {
 //        std::cerr << "PluginHostAdapter::getOutputDescriptors: no handle " << std::endl;
-        return list;
+        return OutputList();
+    }
+
+    std::lock_guard<std::mutex> guard(m_outputsMutex);
+
+    if (m_outputsValid) {
+        return m_outputs;
     }
 
+    OutputList list;
+
     unsigned int count = m_descriptor->getOutputCount(m_handle);
 
     for (unsigned int i = 0; i < count; ++i) {
         VampOutputDescriptor *sd = m_descriptor->getOutputDescriptor(m_handle, i);
+        if (!sd) continue;
         OutputDescriptor d;
         d.identifier = sd->identifier;
         d.name = sd->name;
@@ -375,6 +416,8 @@ PluginHostAdapter::getOutputDescriptors() const
         m_descriptor->releaseOutputDescriptor(sd);
     }
 
+    m_outputs = list;
+    m_outputsValid = true;
     return list;
 }
 
@@ -383,82 +426,429 @@ PluginHostAdapter::process(const float *const *inputBuffers,
                            RealTime timestamp)
 {
     FeatureSet fs;
-    if (!m_handle) return fs;
+    HostExt::FeatureSetSink sink(fs);
+    processInto(inputBuffers, timestamp, sink);
+    return fs;
+}
+
+PluginHostAdapter::FeatureSet
+PluginHostAdapter::getRemainingFeatures()
+{
+    FeatureSet fs;
+    HostExt::FeatureSetSink sink(fs);
+    getRemainingFeaturesInto(sink);
+    return fs;
+}
+
+PluginHostAdapter::FeatureSet
+PluginHostAdapter::processStrided(const float *inputBuffer,
+                                  size_t channels,
+                                  size_t frames,
+                                  size_t stride,
+                                  RealTime timestamp)
+{
+    VAMP_TRACE_SCOPE("PluginHostAdapter::processStrided");
+    
+    if (!m_handle) return FeatureSet();
+
+    if (!VAMP_HAS_EXTENSION(m_extensions, processStrided)) {
+        return Plugin::processStrided(inputBuffer, channels, frames, stride,
+                                      timestamp);
+    }
 
     int sec = timestamp.sec;
     int nsec = timestamp.nsec;
     
-    VampFeatureList *features = m_descriptor->process(m_handle,
-                                                      inputBuffers,
-                                                      sec, nsec);
-    
+    VampFeatureList *features = m_extensions->processStrided
+        (m_handle, inputBuffer, (unsigned int)stride, sec, nsec);
+
+    FeatureSet fs;
     convertFeatures(features, fs);
     m_descriptor->releaseFeatureSet(features);
     return fs;
 }
 
+bool
+PluginHostAdapter::supportsStridedInput() const
+{
+    if (!m_handle) return false;
+    if (!VAMP_HAS_EXTENSION(m_extensions, supportsStridedInput)) return false;
+    return m_extensions->supportsStridedInput(m_handle) ? true : false;
+}
+
 PluginHostAdapter::FeatureSet
-PluginHostAdapter::getRemainingFeatures()
+PluginHostAdapter::processDouble(const double *const *inputBuffers,
+                                 size_t channels,
+                                 size_t frames,
+                                 RealTime timestamp)
 {
-    FeatureSet fs;
-    if (!m_handle) return fs;
+    VAMP_TRACE_SCOPE("PluginHostAdapter::processDouble");
     
-    VampFeatureList *features = m_descriptor->getRemainingFeatures(m_handle); 
+    if (!m_handle) return FeatureSet();
+
+    if (!VAMP_HAS_EXTENSION(m_extensions, processDouble)) {
+        return Plugin::processDouble(inputBuffers, channels, frames,
+                                     timestamp);
+    }
 
+    int sec = timestamp.sec;
+    int nsec = timestamp.nsec;
+    
+    VampFeatureList *features = m_extensions->processDouble
+        (m_handle, inputBuffers, sec, nsec);
+
+    FeatureSet fs;
     convertFeatures(features, fs);
     m_descriptor->releaseFeatureSet(features);
     return fs;
 }
 
+bool
+PluginHostAdapter::supportsDoubleInput() const
+{
+    if (!m_handle) return false;
+    if (!VAMP_HAS_EXTENSION(m_extensions, supportsDoubleInput)) return false;
+    return m_extensions->supportsDoubleInput(m_handle) ? true : false;
+}
+
+PluginHostAdapter::SpectrumFormat
+PluginHostAdapter::getPreferredSpectrumFormat() const
+{
+    if (!m_handle) return ComplexSpectrum;
+    if (!VAMP_HAS_EXTENSION(m_extensions, getPreferredSpectrumFormat)) {
+        return ComplexSpectrum;
+    }
+    switch (m_extensions->getPreferredSpectrumFormat(m_handle)) {
+    case vampMagnitudeSpectrum: return MagnitudeSpectrum;
+    case vampPowerSpectrum: return PowerSpectrum;
+    default: return ComplexSpectrum;
+    }
+}
+
+bool
+PluginHostAdapter::setSpectrumFormat(SpectrumFormat format)
+{
+    if (!m_handle) return false;
+    if (!VAMP_HAS_EXTENSION(m_extensions, setSpectrumFormat)) {
+        return format == ComplexSpectrum;
+    }
+    VampSpectrumFormat f = vampComplexSpectrum;
+    switch (format) {
+    case ComplexSpectrum: f = vampComplexSpectrum; break;
+    case MagnitudeSpectrum: f = vampMagnitudeSpectrum; break;
+    case PowerSpectrum: f = vampPowerSpectrum; break;
+    }
+    return m_extensions->setSpectrumFormat(m_handle, f) ? true : false;
+}
+
+PluginHostAdapter::StateDependency
+PluginHostAdapter::getStateDependency() const
+{
+    return getStateDependency(m_descriptor, m_extensions, 0);
+}
+
+size_t
+PluginHostAdapter::getWarmUpBlockCount() const
+{
+    size_t blocks = 0;
+    (void)getStateDependency(m_descriptor, m_extensions, &blocks);
+    return blocks;
+}
+
+PluginHostAdapter::StateDependency
+PluginHostAdapter::getStateDependency(const VampPluginDescriptor *descriptor,
+                                      const VampPluginExtensions *extensions,
+                                      size_t *warmUpBlocks)
+{
+    if (warmUpBlocks) *warmUpBlocks = 0;
+    
+    if (!VAMP_HAS_EXTENSION(extensions, getStateDependency)) {
+        return UnknownStateDependency;
+    }
+
+    unsigned int blocks = 0;
+    
+    switch (extensions->getStateDependency(descriptor, &blocks)) {
+    case vampBlockLocal:
+        return BlockLocal;
+    case vampBoundedHistory:
+        if (warmUpBlocks) *warmUpBlocks = blocks;
+        return BoundedHistory;
+    case vampWholeSignal:
+        return WholeSignal;
+    default:
+        return UnknownStateDependency;
+    }
+}
+
+bool
+PluginHostAdapter::getState(StateData &state) const
+{
+    if (!m_handle) return false;
+    if (!VAMP_HAS_EXTENSION(m_extensions, getState)) return false;
+
+    size_t size = 0;
+    if (!m_extensions->getState(m_handle, 0, 0, &size)) return false;
+
+    state.resize(size);
+    if (size == 0) return true;
+
+    size_t written = 0;
+    if (!m_extensions->getState(m_handle, &state[0], size, &written) ||
+        written != size) {
+        std::cerr << "WARNING: PluginHostAdapter::getState: Plugin state size changed between calls" << std::endl;
+        state.clear();
+        return false;
+    }
+    return true;
+}
+
+void
+PluginHostAdapter::setTaskScheduler(TaskScheduler *scheduler)
+{
+    if (!m_handle) return;
+    if (!VAMP_HAS_EXTENSION(m_extensions, setTaskScheduler)) return;
+
+    if (!scheduler) {
+        m_extensions->setTaskScheduler(m_handle, 0);
+        return;
+    }
+    
+    m_scheduler.schedulerSize = sizeof(VampTaskScheduler);
+    m_scheduler.context = scheduler;
+    m_scheduler.submit = submitTask;
+    m_scheduler.wait = waitTask;
+    m_scheduler.parallelFor = parallelFor;
+    m_scheduler.getConcurrency = getConcurrency;
+
+    m_extensions->setTaskScheduler(m_handle, &m_scheduler);
+}
+
+void
+PluginHostAdapter::setEnabledOutputs(const std::vector<bool> &enabled)
+{
+    m_enabledOutputs = enabled;
+    
+    if (!m_handle) return;
+    if (!VAMP_HAS_EXTENSION(m_extensions, setEnabledOutputs)) return;
+
+    std::vector<int> e(enabled.begin(), enabled.end());
+    m_extensions->setEnabledOutputs
+        (m_handle, e.empty() ? 0 : &e[0], (unsigned int)e.size());
+}
+
+// Identifier returned to the plugin for a task that the scheduler
+// ran at once, as a NULL return would tell the plugin to run it again
+static char completedTask;
+
+void *
+PluginHostAdapter::submitTask(void *context, void (*task)(void *), void *arg)
+{
+    TaskScheduler *scheduler = (TaskScheduler *)context;
+    void *t = scheduler->submit([task, arg]() { task(arg); });
+    return t ? t : &completedTask;
+}
+
+void
+PluginHostAdapter::waitTask(void *context, void *task)
+{
+    if (task == &completedTask) return;
+    TaskScheduler *scheduler = (TaskScheduler *)context;
+    scheduler->wait(task);
+}
+
+void
+PluginHostAdapter::parallelFor(void *context, unsigned int count,
+                               void (*body)(void *, unsigned int), void *arg)
+{
+    TaskScheduler *scheduler = (TaskScheduler *)context;
+    scheduler->parallelFor(count, [body, arg](size_t i) {
+            body(arg, (unsigned int)i);
+        });
+}
+
+unsigned int
+PluginHostAdapter::getConcurrency(void *context)
+{
+    TaskScheduler *scheduler = (TaskScheduler *)context;
+    return (unsigned int)scheduler->getConcurrency();
+}
+
+bool
+PluginHostAdapter::setState(const StateData &state)
+{
+    if (!m_handle) return false;
+    if (!VAMP_HAS_EXTENSION(m_extensions, setState)) return false;
+
+    return m_extensions->setState
+        (m_handle, state.empty() ? 0 : &state[0], state.size()) ? true : false;
+}
+
+void
+PluginHostAdapter::processInto(const float *const *inputBuffers,
+                               RealTime timestamp,
+                               HostExt::FeatureSink &sink)
+{
+    VAMP_TRACE_SCOPE("PluginHostAdapter::process");
+    
+    if (!m_handle) return;
+
+    int sec = timestamp.sec;
+    int nsec = timestamp.nsec;
+
+    if (m_useOutputBuffer) {
+        size_t required = m_extensions->processToBuffer
+            (m_handle, inputBuffers, sec, nsec,
+             m_outputBuffer, m_outputBufferSize);
+        convertFeatures(receiveFeatures(required), sink);
+        return;
+    }
+    
+    VampFeatureList *features = m_descriptor->process(m_handle,
+                                                      inputBuffers,
+                                                      sec, nsec);
+    
+    convertFeatures(features, sink);
+    m_descriptor->releaseFeatureSet(features);
+}
+
+void
+PluginHostAdapter::getRemainingFeaturesInto(HostExt::FeatureSink &sink)
+{
+    if (!m_handle) return;
+
+    if (m_useOutputBuffer) {
+        size_t required = m_extensions->getRemainingFeaturesToBuffer
+            (m_handle, m_outputBuffer, m_outputBufferSize);
+        convertFeatures(receiveFeatures(required), sink);
+        return;
+    }
+    
+    VampFeatureList *features = m_descriptor->getRemainingFeatures(m_handle); 
+
+    convertFeatures(features, sink);
+    m_descriptor->releaseFeatureSet(features);
+}
+
+VampFeatureList *
+PluginHostAdapter::receiveFeatures(size_t required)
+{
+    // The plugin has either written its features into our buffer, or
+    // told us how big the buffer needs to be and kept hold of them
+    // for us to retrieve once it is big enough
+    
+    while (required > m_outputBufferSize) {
+        size_t size = m_outputBufferSize * 2;
+        if (size < required) size = required;
+        free(m_outputBuffer);
+        m_outputBufferSize = 0;
+        m_outputBuffer = malloc(size);
+        if (!m_outputBuffer) {
+            std::cerr << "WARNING: PluginHostAdapter::receiveFeatures: Failed to allocate " << size << " bytes for plugin output" << std::endl;
+            return 0;
+        }
+        m_outputBufferSize = size;
+        required = m_extensions->retrieveFeatures
+            (m_handle, m_outputBuffer, m_outputBufferSize);
+    }
+
+    if (required == 0) return 0;
+    return (VampFeatureList *)m_outputBuffer;
+}
+
 void
 PluginHostAdapter::convertFeatures(VampFeatureList *features,
                                    FeatureSet &fs)
+{
+    HostExt::FeatureSetSink sink(fs);
+    convertFeatures(features, sink);
+}
+
+void
+PluginHostAdapter::convertFeatures(VampFeatureList *features,
+                                   HostExt::FeatureSink &sink)
 {
     if (!features) return;
 
+    if (sink.acceptsCompactFeatures()) {
+        convertCompactFeatures(features, sink);
+        return;
+    }
+    
     unsigned int outputs = m_descriptor->getOutputCount(m_handle);
 
     for (unsigned int i = 0; i < outputs; ++i) {
+
+        if (!isOutputEnabled(i)) continue;
         
         VampFeatureList &list = features[i];
 
-        if (list.featureCount > 0) {
+        for (unsigned int j = 0; j < list.featureCount; ++j) {
 
             Feature feature;
-            feature.values.reserve(list.features[0].v1.valueCount);
+            
+            feature.hasTimestamp = list.features[j].v1.hasTimestamp;
+            feature.timestamp = RealTime(list.features[j].v1.sec,
+                                         list.features[j].v1.nsec);
+            feature.hasDuration = false;
+
+            if (m_descriptor->vampApiVersion >= 2) {
+                unsigned int j2 = j + list.featureCount;
+                feature.hasDuration = list.features[j2].v2.hasDuration;
+                feature.duration = RealTime(list.features[j2].v2.durationSec,
+                                            list.features[j2].v2.durationNsec);
+            }
+
+            const float *values = list.features[j].v1.values;
+            feature.values.assign(values, values + list.features[j].v1.valueCount);
+
+            if (list.features[j].v1.label) {
+                feature.label = list.features[j].v1.label;
+            }
+
+            sink.push(int(i), std::move(feature));
+        }
+    }
+}
 
-            for (unsigned int j = 0; j < list.featureCount; ++j) {
+void
+PluginHostAdapter::convertCompactFeatures(VampFeatureList *features,
+                                          HostExt::FeatureSink &sink)
+{
+    if (!m_arena) m_arena = new HostExt::FeatureArena;
+    m_arena->clear();
+    
+    unsigned int outputs = m_descriptor->getOutputCount(m_handle);
 
-                feature.hasTimestamp = list.features[j].v1.hasTimestamp;
-                feature.timestamp = RealTime(list.features[j].v1.sec,
-                                             list.features[j].v1.nsec);
-                feature.hasDuration = false;
+    for (unsigned int i = 0; i < outputs; ++i) {
 
-                if (m_descriptor->vampApiVersion >= 2) {
-                    unsigned int j2 = j + list.featureCount;
-                    feature.hasDuration = list.features[j2].v2.hasDuration;
-                    feature.duration = RealTime(list.features[j2].v2.durationSec,
-                                                list.features[j2].v2.durationNsec);
-                }
+        if (!isOutputEnabled(i)) continue;
+        
+        VampFeatureList &list = features[i];
 
-                for (unsigned int k = 0; k < list.features[j].v1.valueCount; ++k) {
-                    feature.values.push_back(list.features[j].v1.values[k]);
-                }
+        for (unsigned int j = 0; j < list.featureCount; ++j) {
 
-                if (list.features[j].v1.label) {
-                    feature.label = list.features[j].v1.label;
-                }
+            const VampFeature &v1 = list.features[j].v1;
+            
+            HostExt::CompactFeature feature;
+            
+            feature.hasTimestamp = v1.hasTimestamp;
+            feature.timestamp = RealTime(v1.sec, v1.nsec);
 
-                fs[i].push_back(feature);
+            if (m_descriptor->vampApiVersion >= 2) {
+                const VampFeatureV2 &v2 = list.features[j + list.featureCount].v2;
+                feature.hasDuration = v2.hasDuration;
+                feature.duration = RealTime(v2.durationSec, v2.durationNsec);
+            }
 
-                if (list.features[j].v1.valueCount > 0) {
-                    feature.values.clear();
-                }
+            feature.values = HostExt::FeatureValues
+                (v1.values, v1.valueCount, m_arena);
 
-                if (list.features[j].v1.label) {
-                    feature.label = "";
-                }
+            if (v1.label) {
+                feature.label = v1.label;
             }
+
+            sink.pushCompact(int(i), std::move(feature));
         }
     }
 }
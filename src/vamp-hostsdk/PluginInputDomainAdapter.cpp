@@ -38,10 +38,13 @@
 */
 
 #include <vamp-hostsdk/PluginInputDomainAdapter.h>
+#include <vamp-hostsdk/FeatureSink.h>
+#include <vamp-hostsdk/Trace.h>
 
 #include <cmath>
 
 #include "Window.h"
+#include "StateData.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -53,6 +56,13 @@ _VAMP_SDK_HOSTSPACE_BEGIN(PluginInputDomainAdapter.cpp)
 
 #include "../vamp-sdk/FFTimpl.cpp"
 
+#if !defined(SINGLE_PRECISION_FFT) && \
+    (defined(__SSE2__) || defined(_M_X64) || \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define VAMP_SPECTRUM_SSE2 1
+#include <emmintrin.h>
+#endif
+
 namespace Vamp {
 
 namespace HostExt {
@@ -66,10 +76,21 @@ public:
     bool initialise(size_t channels, size_t stepSize, size_t blockSize);
     void reset();
 
+    bool getState(StateData &state) const;
+    bool setState(const StateData &state);
+
     size_t getPreferredStepSize() const;
     size_t getPreferredBlockSize() const;
 
-    FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
+    void process(const float *const *inputBuffers, RealTime timestamp,
+                 FeatureSink &sink);
+    void processDouble(const double *const *inputBuffers, RealTime timestamp,
+                       FeatureSink &sink);
+    bool supportsDoubleInput() const;
+
+    bool hasInputShape(size_t channels, size_t frames) const {
+        return int(channels) == m_channels && int(frames) == m_blockSize;
+    }
 
     void setProcessTimestampMethod(ProcessTimestampMethod m);
     ProcessTimestampMethod getProcessTimestampMethod() const;
@@ -86,6 +107,9 @@ protected:
     int m_stepSize;
     int m_blockSize;
     float **m_freqbuf;
+    double **m_freqbufDouble;
+    bool m_pluginTakesDouble;
+    SpectrumFormat m_spectrumFormat;
     Kiss::vamp_kiss_fft_scalar *m_ri;
 
     WindowType m_windowType;
@@ -99,8 +123,38 @@ protected:
     Kiss::vamp_kiss_fftr_cfg m_cfg;
     Kiss::vamp_kiss_fft_cpx *m_cbuf;
 
-    FeatureSet processShiftingTimestamp(const float *const *inputBuffers, RealTime timestamp);
-    FeatureSet processShiftingData(const float *const *inputBuffers, RealTime timestamp);
+    template <typename T>
+    void processShiftingTimestamp(const T *const *inputBuffers, RealTime timestamp,
+                                  FeatureSink &sink);
+    template <typename T>
+    void processShiftingData(const T *const *inputBuffers, RealTime timestamp,
+                             FeatureSink &sink);
+
+    // Window and transform each channel of the given time-domain
+    // input and pass the spectra to the plugin, in double precision
+    // if the input is double and the plugin accepts it
+    void processTransformed(const float *const *inputBuffers,
+                            RealTime timestamp, FeatureSink &sink);
+    void processTransformed(const double *const *inputBuffers,
+                            RealTime timestamp, FeatureSink &sink);
+
+    template <typename In, typename Out>
+    void transform(const In *const *inputBuffers, Out **outputBuffers);
+
+    // Number of values per channel in the spectra passed to the
+    // plugin, which depends on the negotiated spectrum format
+    int getSpectrumSize() const {
+        return m_spectrumFormat == ComplexSpectrum ?
+            m_blockSize + 2 : m_blockSize/2 + 1;
+    }
+
+    // Write the magnitude (or, if magnitude is false, the power) of
+    // each of the given complex bins to out
+    static void convertSpectrum(const Kiss::vamp_kiss_fft_cpx *in,
+                                Kiss::vamp_kiss_fft_scalar *out,
+                                int bins, bool magnitude);
+
+    void deleteBuffers();
 
     size_t makeBlockSizeAcceptable(size_t) const;
     
@@ -130,6 +184,18 @@ PluginInputDomainAdapter::reset()
     m_impl->reset();
 }
 
+bool
+PluginInputDomainAdapter::getState(StateData &state) const
+{
+    return m_impl->getState(state);
+}
+
+bool
+PluginInputDomainAdapter::setState(const StateData &state)
+{
+    return m_impl->setState(state);
+}
+
 Plugin::InputDomain
 PluginInputDomainAdapter::getInputDomain() const
 {
@@ -151,7 +217,39 @@ PluginInputDomainAdapter::getPreferredBlockSize() const
 Plugin::FeatureSet
 PluginInputDomainAdapter::process(const float *const *inputBuffers, RealTime timestamp)
 {
-    return m_impl->process(inputBuffers, timestamp);
+    FeatureSet fs;
+    FeatureSetSink sink(fs);
+    m_impl->process(inputBuffers, timestamp, sink);
+    return fs;
+}
+
+void
+PluginInputDomainAdapter::processInto(const float *const *inputBuffers,
+                                      RealTime timestamp,
+                                      FeatureSink &sink)
+{
+    m_impl->process(inputBuffers, timestamp, sink);
+}
+
+Plugin::FeatureSet
+PluginInputDomainAdapter::processDouble(const double *const *inputBuffers,
+                                        size_t channels, size_t frames,
+                                        RealTime timestamp)
+{
+    if (!m_impl->hasInputShape(channels, frames)) {
+        return Plugin::processDouble(inputBuffers, channels, frames,
+                                     timestamp);
+    }
+    FeatureSet fs;
+    FeatureSetSink sink(fs);
+    m_impl->processDouble(inputBuffers, timestamp, sink);
+    return fs;
+}
+
+bool
+PluginInputDomainAdapter::supportsDoubleInput() const
+{
+    return m_impl->supportsDoubleInput();
 }
 
 void
@@ -192,6 +290,9 @@ PluginInputDomainAdapter::Impl::Impl(Plugin *plugin, float inputSampleRate) :
     m_stepSize(0),
     m_blockSize(0),
     m_freqbuf(0),
+    m_freqbufDouble(0),
+    m_pluginTakesDouble(false),
+    m_spectrumFormat(ComplexSpectrum),
     m_ri(0),
     m_windowType(HanningWindow),
     m_window(0),
@@ -214,12 +315,23 @@ PluginInputDomainAdapter::Impl::~Impl()
         delete[] m_shiftBuffers;
     }
 
-    if (m_channels > 0) {
+    deleteBuffers();
+}
+
+void
+PluginInputDomainAdapter::Impl::deleteBuffers()
+{
+    if (m_freqbuf) {
         for (int c = 0; c < m_channels; ++c) {
             delete[] m_freqbuf[c];
+            if (m_freqbufDouble) delete[] m_freqbufDouble[c];
         }
         delete[] m_freqbuf;
+        delete[] m_freqbufDouble;
+        m_freqbuf = 0;
+        m_freqbufDouble = 0;
         delete[] m_ri;
+        m_ri = 0;
         if (m_cfg) {
             Kiss::vamp_kiss_fftr_free(m_cfg);
             m_cfg = 0;
@@ -227,6 +339,7 @@ PluginInputDomainAdapter::Impl::~Impl()
             m_cbuf = 0;
         }
         delete m_window;
+        m_window = 0;
     }
 }
 
@@ -257,20 +370,7 @@ PluginInputDomainAdapter::Impl::initialise(size_t channels, size_t stepSize, siz
         return false;
     }
 
-    if (m_channels > 0) {
-        for (int c = 0; c < m_channels; ++c) {
-            delete[] m_freqbuf[c];
-        }
-        delete[] m_freqbuf;
-        delete[] m_ri;
-        if (m_cfg) {
-            Kiss::vamp_kiss_fftr_free(m_cfg);
-            m_cfg = 0;
-            delete[] m_cbuf;
-            m_cbuf = 0;
-        }
-        delete m_window;
-    }
+    deleteBuffers();
 
     m_stepSize = int(stepSize);
     m_blockSize = int(blockSize);
@@ -289,6 +389,17 @@ PluginInputDomainAdapter::Impl::initialise(size_t channels, size_t stepSize, siz
 
     m_processCount = 0;
 
+    m_pluginTakesDouble = m_plugin->supportsDoubleInput();
+
+    // If the plugin only wants magnitudes or powers, and agrees to
+    // take them, we can save it the conversion
+
+    m_spectrumFormat = ComplexSpectrum;
+    SpectrumFormat preferred = m_plugin->getPreferredSpectrumFormat();
+    if (preferred != ComplexSpectrum && m_plugin->setSpectrumFormat(preferred)) {
+        m_spectrumFormat = preferred;
+    }
+
     return m_plugin->initialise(channels, stepSize, m_blockSize);
 }
 
@@ -299,6 +410,74 @@ PluginInputDomainAdapter::Impl::reset()
     m_plugin->reset();
 }
 
+bool
+PluginInputDomainAdapter::Impl::getState(StateData &state) const
+{
+    StateData pluginState;
+    if (!m_plugin->getState(pluginState)) return false;
+
+    StateWriter writer(state);
+    writer.put(m_processCount);
+
+    // The shift buffers are only in use with ShiftData, and are
+    // cleared when m_processCount is zero
+    int shiftChannels = 0;
+    if (m_shiftBuffers && m_processCount > 0) shiftChannels = m_channels;
+    
+    writer.put(shiftChannels);
+    for (int c = 0; c < shiftChannels; ++c) {
+        writer.putFloats(m_shiftBuffers[c], m_blockSize + m_blockSize/2);
+    }
+
+    writer.putData(pluginState);
+    return true;
+}
+
+bool
+PluginInputDomainAdapter::Impl::setState(const StateData &state)
+{
+    StateReader reader(state);
+
+    int processCount = 0, shiftChannels = 0;
+    if (!reader.get(processCount) || !reader.get(shiftChannels)) {
+        return false;
+    }
+    if (shiftChannels != 0 && shiftChannels != m_channels) {
+        std::cerr << "WARNING: PluginInputDomainAdapter::setState: "
+                  << "State does not match channel count" << std::endl;
+        return false;
+    }
+    
+    std::vector<std::vector<float> > shifted(shiftChannels);
+    for (int c = 0; c < shiftChannels; ++c) {
+        if (!reader.getFloats(shifted[c]) ||
+            int(shifted[c].size()) != m_blockSize + m_blockSize/2) {
+            return false;
+        }
+    }
+
+    StateData pluginState;
+    if (!reader.getData(pluginState) || !reader.atEnd()) return false;
+    if (!m_plugin->setState(pluginState)) return false;
+
+    if (shiftChannels > 0 && !m_shiftBuffers) {
+        m_shiftBuffers = new float *[m_channels];
+        for (int c = 0; c < m_channels; ++c) {
+            m_shiftBuffers[c] = new float[m_blockSize + m_blockSize/2];
+        }
+    }
+    for (int c = 0; c < shiftChannels; ++c) {
+        for (int i = 0; i < m_blockSize + m_blockSize/2; ++i) {
+            m_shiftBuffers[c][i] = shifted[c][i];
+        }
+    }
+
+    // A state saved before any input was processed, or by an adapter
+    // using another timestamp method, leaves nothing to restore
+    m_processCount = (shiftChannels > 0 ? processCount : 0);
+    return true;
+}
+
 size_t
 PluginInputDomainAdapter::Impl::getPreferredStepSize() const
 {
@@ -411,24 +590,63 @@ PluginInputDomainAdapter::Impl::convertType(WindowType t) const
     }
 }
 
-Plugin::FeatureSet
+void
 PluginInputDomainAdapter::Impl::process(const float *const *inputBuffers,
-                                        RealTime timestamp)
+                                        RealTime timestamp,
+                                        FeatureSink &sink)
 {
+    VAMP_TRACE_SCOPE("PluginInputDomainAdapter::process");
+    
     if (m_plugin->getInputDomain() == TimeDomain) {
-        return m_plugin->process(inputBuffers, timestamp);
+        sink.processFrom(m_plugin, inputBuffers, timestamp);
+        return;
     }
 
     if (m_method == ShiftTimestamp || m_method == NoShift) {
-        return processShiftingTimestamp(inputBuffers, timestamp);
+        processShiftingTimestamp(inputBuffers, timestamp, sink);
     } else {
-        return processShiftingData(inputBuffers, timestamp);
+        processShiftingData(inputBuffers, timestamp, sink);
     }
 }
 
-Plugin::FeatureSet
-PluginInputDomainAdapter::Impl::processShiftingTimestamp(const float *const *inputBuffers,
-                                                         RealTime timestamp)
+void
+PluginInputDomainAdapter::Impl::processDouble(const double *const *inputBuffers,
+                                              RealTime timestamp,
+                                              FeatureSink &sink)
+{
+    VAMP_TRACE_SCOPE("PluginInputDomainAdapter::processDouble");
+    
+    if (m_plugin->getInputDomain() == TimeDomain) {
+        sink.pushAll(m_plugin->processDouble(inputBuffers, m_channels,
+                                             m_blockSize, timestamp));
+        return;
+    }
+
+    if (m_method == ShiftTimestamp || m_method == NoShift) {
+        processShiftingTimestamp(inputBuffers, timestamp, sink);
+    } else {
+        processShiftingData(inputBuffers, timestamp, sink);
+    }
+}
+
+bool
+PluginInputDomainAdapter::Impl::supportsDoubleInput() const
+{
+    // We read double input straight into the FFT, so there is no
+    // point in the host converting it for us, except with ShiftData
+    // whose shift buffers are in float
+    
+    if (m_plugin->getInputDomain() == TimeDomain) {
+        return m_plugin->supportsDoubleInput();
+    }
+    return m_method != ShiftData;
+}
+
+template <typename T>
+void
+PluginInputDomainAdapter::Impl::processShiftingTimestamp(const T *const *inputBuffers,
+                                                         RealTime timestamp,
+                                                         FeatureSink &sink)
 {
     unsigned int roundedRate = 1;
     if (m_inputSampleRate > 0.f) {
@@ -446,31 +664,14 @@ PluginInputDomainAdapter::Impl::processShiftingTimestamp(const float *const *inp
         }
     }
 
-    for (int c = 0; c < m_channels; ++c) {
-
-        m_window->cut(inputBuffers[c], m_ri);
-
-        for (int i = 0; i < m_blockSize/2; ++i) {
-            // FFT shift
-            Kiss::vamp_kiss_fft_scalar value = m_ri[i];
-            m_ri[i] = m_ri[i + m_blockSize/2];
-            m_ri[i + m_blockSize/2] = value;
-        }
-
-        Kiss::vamp_kiss_fftr(m_cfg, m_ri, m_cbuf);
-        
-        for (int i = 0; i <= m_blockSize/2; ++i) {
-            m_freqbuf[c][i * 2] = float(m_cbuf[i].r);
-            m_freqbuf[c][i * 2 + 1] = float(m_cbuf[i].i);
-        }
-    }
-
-    return m_plugin->process(m_freqbuf, timestamp);
+    processTransformed(inputBuffers, timestamp, sink);
 }
 
-Plugin::FeatureSet
-PluginInputDomainAdapter::Impl::processShiftingData(const float *const *inputBuffers,
-                                                    RealTime timestamp)
+template <typename T>
+void
+PluginInputDomainAdapter::Impl::processShiftingData(const T *const *inputBuffers,
+                                                    RealTime timestamp,
+                                                    FeatureSink &sink)
 {
     if (m_processCount == 0) {
         if (!m_shiftBuffers) {
@@ -491,13 +692,55 @@ PluginInputDomainAdapter::Impl::processShiftingData(const float *const *inputBuf
             m_shiftBuffers[c][i - m_stepSize] = m_shiftBuffers[c][i];
         }
         for (int i = 0; i < m_blockSize; ++i) {
-            m_shiftBuffers[c][i + m_blockSize/2] = inputBuffers[c][i];
+            m_shiftBuffers[c][i + m_blockSize/2] = float(inputBuffers[c][i]);
         }
     }
 
+    ++m_processCount;
+
+    processTransformed(m_shiftBuffers, timestamp, sink);
+}
+
+void
+PluginInputDomainAdapter::Impl::processTransformed(const float *const *inputBuffers,
+                                                   RealTime timestamp,
+                                                   FeatureSink &sink)
+{
+    transform(inputBuffers, m_freqbuf);
+    sink.processFrom(m_plugin, m_freqbuf, timestamp);
+}
+
+void
+PluginInputDomainAdapter::Impl::processTransformed(const double *const *inputBuffers,
+                                                   RealTime timestamp,
+                                                   FeatureSink &sink)
+{
+    if (!m_pluginTakesDouble) {
+        transform(inputBuffers, m_freqbuf);
+        sink.processFrom(m_plugin, m_freqbuf, timestamp);
+        return;
+    }
+
+    if (!m_freqbufDouble) {
+        m_freqbufDouble = new double *[m_channels];
+        for (int c = 0; c < m_channels; ++c) {
+            m_freqbufDouble[c] = new double[m_blockSize + 2];
+        }
+    }
+
+    transform(inputBuffers, m_freqbufDouble);
+    sink.pushAll(m_plugin->processDouble(m_freqbufDouble, m_channels,
+                                         getSpectrumSize(), timestamp));
+}
+
+template <typename In, typename Out>
+void
+PluginInputDomainAdapter::Impl::transform(const In *const *inputBuffers,
+                                          Out **outputBuffers)
+{
     for (int c = 0; c < m_channels; ++c) {
 
-        m_window->cut(m_shiftBuffers[c], m_ri);
+        m_window->cut(inputBuffers[c], m_ri);
 
         for (int i = 0; i < m_blockSize/2; ++i) {
             // FFT shift
@@ -507,16 +750,56 @@ PluginInputDomainAdapter::Impl::processShiftingData(const float *const *inputBuf
         }
 
         Kiss::vamp_kiss_fftr(m_cfg, m_ri, m_cbuf);
-        
-        for (int i = 0; i <= m_blockSize/2; ++i) {
-            m_freqbuf[c][i * 2] = float(m_cbuf[i].r);
-            m_freqbuf[c][i * 2 + 1] = float(m_cbuf[i].i);
+
+        if (m_spectrumFormat == ComplexSpectrum) {
+            for (int i = 0; i <= m_blockSize/2; ++i) {
+                outputBuffers[c][i * 2] = Out(m_cbuf[i].r);
+                outputBuffers[c][i * 2 + 1] = Out(m_cbuf[i].i);
+            }
+            continue;
+        }
+
+        // The time-domain buffer is free again once the FFT is done,
+        // and is long enough to take one value per bin
+
+        int bins = m_blockSize/2 + 1;
+        convertSpectrum(m_cbuf, m_ri, bins,
+                        m_spectrumFormat == MagnitudeSpectrum);
+        for (int i = 0; i < bins; ++i) {
+            outputBuffers[c][i] = Out(m_ri[i]);
         }
     }
+}
 
-    ++m_processCount;
+void
+PluginInputDomainAdapter::Impl::convertSpectrum(const Kiss::vamp_kiss_fft_cpx *in,
+                                                Kiss::vamp_kiss_fft_scalar *out,
+                                                int bins,
+                                                bool magnitude)
+{
+    int i = 0;
+
+#ifdef VAMP_SPECTRUM_SSE2
+    // Two bins at a time: square both components of each, gather the
+    // real and imaginary squares into separate registers and add
+    const double *d = &in[0].r;
+    for (; i + 1 < bins; i += 2) {
+        __m128d a = _mm_loadu_pd(d + i * 2);
+        __m128d b = _mm_loadu_pd(d + i * 2 + 2);
+        a = _mm_mul_pd(a, a);
+        b = _mm_mul_pd(b, b);
+        __m128d p = _mm_add_pd(_mm_unpacklo_pd(a, b),
+                               _mm_unpackhi_pd(a, b));
+        if (magnitude) p = _mm_sqrt_pd(p);
+        _mm_storeu_pd(out + i, p);
+    }
+#endif
 
-    return m_plugin->process(m_freqbuf, timestamp);
+    for (; i < bins; ++i) {
+        Kiss::vamp_kiss_fft_scalar p =
+            in[i].r * in[i].r + in[i].i * in[i].i;
+        out[i] = (magnitude ? sqrt(p) : p);
+    }
 }
 
 }
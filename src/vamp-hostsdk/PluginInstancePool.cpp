@@ -0,0 +1,352 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#include <vamp-hostsdk/PluginInstancePool.h>
+
+#include <vector>
+#include <mutex>
+#include <tuple>
+#include <iostream>
+
+using namespace std;
+
+_VAMP_SDK_HOSTSPACE_BEGIN(PluginInstancePool.cpp)
+
+namespace Vamp {
+
+namespace HostExt {
+
+class PluginInstancePool::Impl
+{
+public:
+    Impl(PluginLoader *loader);
+    ~Impl();
+
+    Plugin *acquire(PluginLoader::PluginKey key,
+                    float inputSampleRate,
+                    int adapterFlags,
+                    size_t channels,
+                    size_t stepSize,
+                    size_t blockSize,
+                    const ParameterValues &parameters);
+
+    void release(Plugin *plugin);
+    void discard(Plugin *plugin);
+
+    void setMaxIdlePerConfiguration(size_t n);
+    size_t getIdleCount() const;
+    void clear();
+
+protected:
+    struct Configuration {
+        PluginLoader::PluginKey key;
+        float inputSampleRate;
+        int adapterFlags;
+        size_t channels;
+        size_t stepSize;
+        size_t blockSize;
+        ParameterValues parameters;
+
+        bool operator<(const Configuration &c) const {
+            return tie(key, inputSampleRate, adapterFlags,
+                       channels, stepSize, blockSize, parameters) <
+                tie(c.key, c.inputSampleRate, c.adapterFlags,
+                    c.channels, c.stepSize, c.blockSize, c.parameters);
+        }
+    };
+
+    bool parametersUnchanged(Plugin *plugin, const Configuration &c);
+    
+    PluginLoader *m_loader;
+    size_t m_maxIdle;
+
+    map<Configuration, vector<Plugin *> > m_idle;
+    map<Plugin *, Configuration> m_acquired;
+
+    mutable mutex m_mutex;
+};
+
+PluginInstancePool::PluginInstancePool(PluginLoader *loader)
+{
+    m_impl = new Impl(loader);
+}
+
+PluginInstancePool::~PluginInstancePool()
+{
+    delete m_impl;
+}
+
+Plugin *
+PluginInstancePool::acquire(PluginLoader::PluginKey key,
+                            float inputSampleRate,
+                            int adapterFlags,
+                            size_t channels,
+                            size_t stepSize,
+                            size_t blockSize,
+                            const ParameterValues &parameters)
+{
+    return m_impl->acquire(key, inputSampleRate, adapterFlags,
+                           channels, stepSize, blockSize, parameters);
+}
+
+void
+PluginInstancePool::release(Plugin *plugin)
+{
+    m_impl->release(plugin);
+}
+
+void
+PluginInstancePool::discard(Plugin *plugin)
+{
+    m_impl->discard(plugin);
+}
+
+void
+PluginInstancePool::setMaxIdlePerConfiguration(size_t n)
+{
+    m_impl->setMaxIdlePerConfiguration(n);
+}
+
+size_t
+PluginInstancePool::getIdleCount() const
+{
+    return m_impl->getIdleCount();
+}
+
+void
+PluginInstancePool::clear()
+{
+    m_impl->clear();
+}
+
+PluginInstancePool::Impl::Impl(PluginLoader *loader) :
+    m_loader(loader ? loader : PluginLoader::getInstance()),
+    m_maxIdle(4)
+{
+}
+
+PluginInstancePool::Impl::~Impl()
+{
+    clear();
+}
+
+Plugin *
+PluginInstancePool::Impl::acquire(PluginLoader::PluginKey key,
+                                  float inputSampleRate,
+                                  int adapterFlags,
+                                  size_t channels,
+                                  size_t stepSize,
+                                  size_t blockSize,
+                                  const ParameterValues &parameters)
+{
+    Configuration c;
+    c.key = key;
+    c.inputSampleRate = inputSampleRate;
+    c.adapterFlags = adapterFlags;
+    c.channels = channels;
+    c.stepSize = stepSize;
+    c.blockSize = blockSize;
+    c.parameters = parameters;
+
+    Plugin *plugin = 0;
+    
+    {
+        lock_guard<mutex> guard(m_mutex);
+
+        map<Configuration, vector<Plugin *> >::iterator i = m_idle.find(c);
+        if (i != m_idle.end() && !i->second.empty()) {
+            plugin = i->second.back();
+            i->second.pop_back();
+            if (i->second.empty()) m_idle.erase(i);
+            m_acquired[plugin] = c;
+            return plugin;
+        }
+    }
+
+    // The loader has its own lock, which also covers the deletion of
+    // the plugins it loaded, so nothing here is done under ours
+    plugin = m_loader->loadPlugin(key, inputSampleRate, adapterFlags);
+
+    if (!plugin) return 0;
+
+    for (ParameterValues::const_iterator i = parameters.begin();
+         i != parameters.end(); ++i) {
+        plugin->setParameter(i->first, i->second);
+    }
+
+    if (!plugin->initialise(channels, stepSize, blockSize)) {
+        cerr << "WARNING: Vamp::HostExt::PluginInstancePool: Plugin \""
+             << key << "\" failed to initialise with channels = "
+             << channels << ", step size = " << stepSize
+             << ", block size = " << blockSize << endl;
+        delete plugin;
+        return 0;
+    }
+
+    lock_guard<mutex> guard(m_mutex);
+    m_acquired[plugin] = c;
+    return plugin;
+}
+
+bool
+PluginInstancePool::Impl::parametersUnchanged(Plugin *plugin,
+                                              const Configuration &c)
+{
+    for (ParameterValues::const_iterator i = c.parameters.begin();
+         i != c.parameters.end(); ++i) {
+        if (plugin->getParameter(i->first) != i->second) return false;
+    }
+    return true;
+}
+
+void
+PluginInstancePool::Impl::release(Plugin *plugin)
+{
+    if (!plugin) return;
+
+    Configuration c;
+    
+    {
+        lock_guard<mutex> guard(m_mutex);
+        map<Plugin *, Configuration>::iterator i = m_acquired.find(plugin);
+        if (i == m_acquired.end()) {
+            cerr << "WARNING: Vamp::HostExt::PluginInstancePool::release: "
+                 << "Plugin was not acquired from this pool, ignoring"
+                 << endl;
+            return;
+        }
+        c = i->second;
+        m_acquired.erase(i);
+    }
+
+    // A plugin's requested parameter values may legitimately be
+    // quantized, in which case getParameter won't match what was
+    // set. We can't tell that apart from a host having changed the
+    // value, so we just don't reuse such instances.
+    
+    if (!parametersUnchanged(plugin, c)) {
+        delete plugin;
+        return;
+    }
+
+    plugin->reset();
+
+    {
+        lock_guard<mutex> guard(m_mutex);
+        vector<Plugin *> &idle = m_idle[c];
+        if (idle.size() < m_maxIdle) {
+            idle.push_back(plugin);
+            return;
+        }
+        if (idle.empty()) m_idle.erase(c);
+    }
+
+    delete plugin;
+}
+
+void
+PluginInstancePool::Impl::discard(Plugin *plugin)
+{
+    if (!plugin) return;
+
+    {
+        lock_guard<mutex> guard(m_mutex);
+        m_acquired.erase(plugin);
+    }
+
+    delete plugin;
+}
+
+void
+PluginInstancePool::Impl::setMaxIdlePerConfiguration(size_t n)
+{
+    vector<Plugin *> toDelete;
+
+    {
+        lock_guard<mutex> guard(m_mutex);
+        m_maxIdle = n;
+        for (map<Configuration, vector<Plugin *> >::iterator i =
+                 m_idle.begin(); i != m_idle.end(); ) {
+            while (i->second.size() > m_maxIdle) {
+                toDelete.push_back(i->second.back());
+                i->second.pop_back();
+            }
+            if (i->second.empty()) m_idle.erase(i++);
+            else ++i;
+        }
+    }
+
+    for (size_t i = 0; i < toDelete.size(); ++i) {
+        delete toDelete[i];
+    }
+}
+
+size_t
+PluginInstancePool::Impl::getIdleCount() const
+{
+    lock_guard<mutex> guard(m_mutex);
+    size_t n = 0;
+    for (map<Configuration, vector<Plugin *> >::const_iterator i =
+             m_idle.begin(); i != m_idle.end(); ++i) {
+        n += i->second.size();
+    }
+    return n;
+}
+
+void
+PluginInstancePool::Impl::clear()
+{
+    map<Configuration, vector<Plugin *> > idle;
+
+    {
+        lock_guard<mutex> guard(m_mutex);
+        idle.swap(m_idle);
+    }
+
+    for (map<Configuration, vector<Plugin *> >::iterator i = idle.begin();
+         i != idle.end(); ++i) {
+        for (size_t j = 0; j < i->second.size(); ++j) {
+            delete i->second[j];
+        }
+    }
+}
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(PluginInstancePool.cpp)
+
@@ -39,12 +39,18 @@
 #include <vamp-hostsdk/PluginChannelAdapter.h>
 #include <vamp-hostsdk/PluginBufferingAdapter.h>
 #include <vamp-hostsdk/PluginHostAdapter.h>
+#include <vamp-hostsdk/FeatureSink.h>
 
 #include <vamp/vamp.h>
 
 #include "Files.h"
 
 #include <fstream>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <system_error>
 
 using namespace std;
 
@@ -74,6 +80,9 @@ public:
 
     string getLibraryPathForPlugin(PluginKey key);
 
+    Plugin::StateDependency getPluginStateDependency(PluginKey key,
+                                                     size_t *warmUpBlocks);
+
     static void setInstanceToClean(PluginLoader *instance);
 
 protected:
@@ -81,6 +90,37 @@ protected:
     public:
         PluginDeletionNotifyAdapter(Plugin *plugin, Impl *loader);
         virtual ~PluginDeletionNotifyAdapter();
+        void processInto(const float *const *inputBuffers,
+                         RealTime timestamp, FeatureSink &sink) {
+            sink.processFrom(m_plugin, inputBuffers, timestamp);
+        }
+        void getRemainingFeaturesInto(FeatureSink &sink) {
+            sink.remainingFeaturesFrom(m_plugin);
+        }
+        FeatureSet processStrided(const float *inputBuffer,
+                                  size_t channels, size_t frames,
+                                  size_t stride, RealTime timestamp) {
+            return m_plugin->processStrided(inputBuffer, channels, frames,
+                                            stride, timestamp);
+        }
+        bool supportsStridedInput() const {
+            return m_plugin->supportsStridedInput();
+        }
+        FeatureSet processDouble(const double *const *inputBuffers,
+                                 size_t channels, size_t frames,
+                                 RealTime timestamp) {
+            return m_plugin->processDouble(inputBuffers, channels, frames,
+                                           timestamp);
+        }
+        bool supportsDoubleInput() const {
+            return m_plugin->supportsDoubleInput();
+        }
+        SpectrumFormat getPreferredSpectrumFormat() const {
+            return m_plugin->getPreferredSpectrumFormat();
+        }
+        bool setSpectrumFormat(SpectrumFormat format) {
+            return m_plugin->setSpectrumFormat(format);
+        }
     protected:
         Impl *m_loader;
     };
@@ -111,11 +151,39 @@ protected:
     /// that were added to it
     vector<PluginKey> enumeratePlugins(Enumeration);
 
+    /// Result of probing a single library file during enumeration
+    struct LibraryProbe {
+        bool loaded;
+        bool haveDescriptorFunction;
+        vector<string> identifiers;
+        LibraryProbe() : loaded(false), haveDescriptorFunction(false) { }
+    };
+    static LibraryProbe probeLibrary(string fullPath, string identifier);
+
     map<PluginKey, PluginCategoryHierarchy> m_taxonomy;
     void generateTaxonomy();
 
+    typedef pair<Plugin::StateDependency, size_t> StateDependencyRec;
+    map<PluginKey, StateDependencyRec> m_stateDependencies;
+
+    typedef vector<pair<PluginKey, PluginCategoryHierarchy> > CategoryList;
+    static CategoryList readCategoryFile(string filepath);
+
+    /// Call job(i) for every i in [0, count), spreading the calls
+    /// across a small bounded set of threads. Returns when all calls
+    /// have completed. Falls back to calling them serially if there
+    /// is only one job or threads cannot be started.
+    static void runJobs(size_t count, function<void(size_t)> job);
+
     map<Plugin *, void *> m_pluginLibraryHandleMap;
 
+    // Guards all of the above, and the loading and unloading of
+    // libraries, so that plugins may be loaded and deleted from any
+    // thread. Recursive because the public entry points call one
+    // another, and because deleting a plugin that fails during
+    // loadPlugin calls back into pluginDeleted
+    recursive_mutex m_mutex;
+
     bool decomposePluginKey(PluginKey key,
                             string &libraryName, string &identifier);
 
@@ -194,6 +262,12 @@ PluginLoader::getLibraryPathForPlugin(PluginKey key)
 {
     return m_impl->getLibraryPathForPlugin(key);
 }
+
+Plugin::StateDependency
+PluginLoader::getPluginStateDependency(PluginKey key, size_t *warmUpBlocks)
+{
+    return m_impl->getPluginStateDependency(key, warmUpBlocks);
+}
  
 PluginLoader::Impl::Impl() :
     m_allPluginsEnumerated(false)
@@ -213,6 +287,8 @@ PluginLoader::Impl::setInstanceToClean(PluginLoader *instance)
 PluginLoader::PluginKeyList
 PluginLoader::Impl::listPlugins() 
 {
+    lock_guard<recursive_mutex> guard(m_mutex);
+
     if (!m_allPluginsEnumerated) enumeratePlugins(Enumeration());
 
     vector<PluginKey> plugins;
@@ -228,6 +304,8 @@ PluginLoader::Impl::listPlugins()
 PluginLoader::PluginKeyList
 PluginLoader::Impl::listPluginsIn(vector<string> libs) 
 {
+    lock_guard<recursive_mutex> guard(m_mutex);
+
     Enumeration enumeration;
     enumeration.type = Enumeration::InLibraries;
     enumeration.libraryNames = libs;
@@ -237,6 +315,8 @@ PluginLoader::Impl::listPluginsIn(vector<string> libs)
 PluginLoader::PluginKeyList
 PluginLoader::Impl::listPluginsNotIn(vector<string> libs) 
 {
+    lock_guard<recursive_mutex> guard(m_mutex);
+
     Enumeration enumeration;
     enumeration.type = Enumeration::NotInLibraries;
     enumeration.libraryNames = libs;
@@ -297,41 +377,40 @@ PluginLoader::Impl::enumeratePlugins(Enumeration enumeration)
     bool specific = (enumeration.type == Enumeration::SinglePlugin ||
                      enumeration.type == Enumeration::InLibraries);
 
+    // Loading each library and querying its descriptors is by far
+    // the slowest part of enumeration, so do that for all libraries
+    // concurrently. Each library is only ever touched from a single
+    // thread, which is all that older plugin builds (SDK 2.8 and
+    // earlier) can tolerate. The results are then merged in the
+    // original path order so that the outcome does not depend on
+    // thread timing.
+
+    vector<LibraryProbe> probes(fullPaths.size());
+
+    runJobs(fullPaths.size(), [&](size_t i) {
+        probes[i] = probeLibrary(fullPaths[i], identifier);
+    });
+
     vector<PluginKey> added;
     
     for (size_t i = 0; i < fullPaths.size(); ++i) {
 
-        string fullPath = fullPaths[i];
-        void *handle = Files::loadLibrary(fullPath);
-        if (!handle) continue;
-            
-        VampGetPluginDescriptorFunction fn =
-            (VampGetPluginDescriptorFunction)Files::lookupInLibrary
-            (handle, "vampGetPluginDescriptor");
-            
-        if (!fn) {
+        const string &fullPath = fullPaths[i];
+        const LibraryProbe &probe = probes[i];
+
+        if (!probe.loaded) continue;
+
+        if (!probe.haveDescriptorFunction) {
             if (specific) {
                 cerr << "Vamp::HostExt::PluginLoader: "
                     << "No vampGetPluginDescriptor function found in library \""
                      << fullPath << "\"" << endl;
             }
-            Files::unloadLibrary(handle);
             continue;
         }
             
-        int index = 0;
-        const VampPluginDescriptor *descriptor = 0;
-        bool found = false;
-            
-        while ((descriptor = fn(VAMP_API_VERSION, index))) {
-            ++index;
-            if (identifier != "") {
-                if (descriptor->identifier != identifier) {
-                    continue;
-                }
-            }
-            found = true;
-            PluginKey key = composePluginKey(fullPath, descriptor->identifier);
+        for (size_t j = 0; j < probe.identifiers.size(); ++j) {
+            PluginKey key = composePluginKey(fullPath, probe.identifiers[j]);
             if (m_pluginLibraryNameMap.find(key) ==
                 m_pluginLibraryNameMap.end()) {
                 m_pluginLibraryNameMap[key] = fullPath;
@@ -339,13 +418,11 @@ PluginLoader::Impl::enumeratePlugins(Enumeration enumeration)
             added.push_back(key);
         }
 
-        if (!found && specific) {
+        if (probe.identifiers.empty() && specific) {
             cerr << "Vamp::HostExt::PluginLoader: Plugin \""
                  << identifier << "\" not found in library \""
                  << fullPath << "\"" << endl;
         }
-            
-        Files::unloadLibrary(handle);
     }
 
     if (enumeration.type == Enumeration::All) {
@@ -355,6 +432,77 @@ PluginLoader::Impl::enumeratePlugins(Enumeration enumeration)
     return added;
 }
 
+PluginLoader::Impl::LibraryProbe
+PluginLoader::Impl::probeLibrary(string fullPath, string identifier)
+{
+    LibraryProbe probe;
+    
+    void *handle = Files::loadLibrary(fullPath);
+    if (!handle) return probe;
+
+    probe.loaded = true;
+            
+    VampGetPluginDescriptorFunction fn =
+        (VampGetPluginDescriptorFunction)Files::lookupInLibrary
+        (handle, "vampGetPluginDescriptor");
+            
+    if (fn) {
+
+        probe.haveDescriptorFunction = true;
+        
+        int index = 0;
+        const VampPluginDescriptor *descriptor = 0;
+            
+        while ((descriptor = fn(VAMP_API_VERSION, index))) {
+            ++index;
+            if (identifier != "") {
+                if (descriptor->identifier != identifier) {
+                    continue;
+                }
+            }
+            probe.identifiers.push_back(descriptor->identifier);
+        }
+    }
+            
+    Files::unloadLibrary(handle);
+    return probe;
+}
+
+void
+PluginLoader::Impl::runJobs(size_t count, function<void(size_t)> job)
+{
+    size_t nthreads = thread::hardware_concurrency();
+    if (nthreads > 8) nthreads = 8;
+    if (nthreads > count) nthreads = count;
+
+    if (nthreads < 2) {
+        for (size_t i = 0; i < count; ++i) job(i);
+        return;
+    }
+
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next++) < count) job(i);
+    };
+
+    vector<thread> threads;
+    try {
+        for (size_t t = 1; t < nthreads; ++t) {
+            threads.push_back(thread(worker));
+        }
+    } catch (const system_error &) {
+        // Carry on with however many threads we managed to start,
+        // plus this one
+    }
+
+    worker();
+    
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+}
+
 PluginLoader::PluginKey
 PluginLoader::Impl::composePluginKey(string libraryName, string identifier)
 {
@@ -380,6 +528,8 @@ PluginLoader::Impl::decomposePluginKey(PluginKey key,
 PluginLoader::PluginCategoryHierarchy
 PluginLoader::Impl::getPluginCategory(PluginKey plugin)
 {
+    lock_guard<recursive_mutex> guard(m_mutex);
+
     if (m_taxonomy.empty()) generateTaxonomy();
     if (m_taxonomy.find(plugin) == m_taxonomy.end()) {
         return PluginCategoryHierarchy();
@@ -390,6 +540,8 @@ PluginLoader::Impl::getPluginCategory(PluginKey plugin)
 string
 PluginLoader::Impl::getLibraryPathForPlugin(PluginKey plugin)
 {
+    lock_guard<recursive_mutex> guard(m_mutex);
+
     if (m_pluginLibraryNameMap.find(plugin) == m_pluginLibraryNameMap.end()) {
         if (m_allPluginsEnumerated) return "";
         Enumeration enumeration;
@@ -403,10 +555,68 @@ PluginLoader::Impl::getLibraryPathForPlugin(PluginKey plugin)
     return m_pluginLibraryNameMap[plugin];
 }    
 
+Plugin::StateDependency
+PluginLoader::Impl::getPluginStateDependency(PluginKey key,
+                                             size_t *warmUpBlocks)
+{
+    lock_guard<recursive_mutex> guard(m_mutex);
+
+    if (warmUpBlocks) *warmUpBlocks = 0;
+
+    if (m_stateDependencies.find(key) == m_stateDependencies.end()) {
+
+        StateDependencyRec rec(Plugin::UnknownStateDependency, 0);
+        
+        string libname, identifier;
+        if (!decomposePluginKey(key, libname, identifier)) {
+            std::cerr << "Vamp::HostExt::PluginLoader: Invalid plugin key \""
+                      << key << "\" in getPluginStateDependency" << std::endl;
+            return rec.first;
+        }
+
+        string fullPath = getLibraryPathForPlugin(key);
+        if (fullPath == "") return rec.first;
+
+        void *handle = Files::loadLibrary(fullPath);
+        if (!handle) return rec.first;
+
+        VampGetPluginDescriptorFunction fn =
+            (VampGetPluginDescriptorFunction)Files::lookupInLibrary
+            (handle, "vampGetPluginDescriptor");
+
+        VampGetPluginExtensionsFunction extfn =
+            (VampGetPluginExtensionsFunction)Files::lookupInLibrary
+            (handle, "vampGetPluginExtensions");
+
+        if (fn && extfn) {
+            int index = 0;
+            const VampPluginDescriptor *descriptor = 0;
+            while ((descriptor = fn(VAMP_API_VERSION, index))) {
+                if (string(descriptor->identifier) == identifier) {
+                    rec.first = PluginHostAdapter::getStateDependency
+                        (descriptor, extfn(descriptor), &rec.second);
+                    break;
+                }
+                ++index;
+            }
+        }
+
+        Files::unloadLibrary(handle);
+
+        m_stateDependencies[key] = rec;
+    }
+
+    const StateDependencyRec &rec = m_stateDependencies[key];
+    if (warmUpBlocks) *warmUpBlocks = rec.second;
+    return rec.first;
+}
+
 Plugin *
 PluginLoader::Impl::loadPlugin(PluginKey key,
                                float inputSampleRate, int adapterFlags)
 {
+    lock_guard<recursive_mutex> guard(m_mutex);
+
     string libname, identifier;
     if (!decomposePluginKey(key, libname, identifier)) {
         std::cerr << "Vamp::HostExt::PluginLoader: Invalid plugin key \""
@@ -434,6 +644,10 @@ PluginLoader::Impl::loadPlugin(PluginKey key,
         return 0;
     }
 
+    VampGetPluginExtensionsFunction extfn =
+        (VampGetPluginExtensionsFunction)Files::lookupInLibrary
+        (handle, "vampGetPluginExtensions");
+
     int index = 0;
     const VampPluginDescriptor *descriptor = 0;
 
@@ -441,8 +655,12 @@ PluginLoader::Impl::loadPlugin(PluginKey key,
 
         if (string(descriptor->identifier) == identifier) {
 
+            const VampPluginExtensions *extensions = 0;
+            if (extfn) extensions = extfn(descriptor);
+
             Vamp::PluginHostAdapter *plugin =
-                new Vamp::PluginHostAdapter(descriptor, inputSampleRate);
+                new Vamp::PluginHostAdapter(descriptor, extensions,
+                                            inputSampleRate);
 
             Plugin *adapter = new PluginDeletionNotifyAdapter(plugin, this);
 
@@ -507,7 +725,7 @@ PluginLoader::Impl::generateTaxonomy()
         catpath.push_back(dir);
     }
 
-    char buffer[1024];
+    vector<string> filepaths;
 
     for (vector<string>::iterator i = catpath.begin();
          i != catpath.end(); ++i) {
@@ -516,56 +734,83 @@ PluginLoader::Impl::generateTaxonomy()
 
         for (vector<string>::iterator fi = files.begin();
              fi != files.end(); ++fi) {
+            filepaths.push_back(Files::splicePath(*i, *fi));
+        }
+    }
 
-            string filepath = Files::splicePath(*i, *fi);
-            ifstream is(filepath.c_str(), ifstream::in | ifstream::binary);
+    // Read and parse the category files concurrently, then apply
+    // them in path order so that later entries still override
+    // earlier ones exactly as they would if read one at a time
 
-            if (is.fail()) {
-//                cerr << "failed to open: " << filepath << endl;
-                continue;
-            }
+    vector<CategoryList> results(filepaths.size());
+
+    runJobs(filepaths.size(), [&](size_t i) {
+        results[i] = readCategoryFile(filepaths[i]);
+    });
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        for (size_t j = 0; j < results[i].size(); ++j) {
+            m_taxonomy[results[i][j].first] = results[i][j].second;
+        }
+    }
+}    
 
-//            cerr << "opened: " << filepath << endl;
+PluginLoader::Impl::CategoryList
+PluginLoader::Impl::readCategoryFile(string filepath)
+{
+    CategoryList list;
+    char buffer[1024];
 
-            while (!!is.getline(buffer, 1024)) {
+    ifstream is(filepath.c_str(), ifstream::in | ifstream::binary);
 
-                string line(buffer);
+    if (is.fail()) {
+//        cerr << "failed to open: " << filepath << endl;
+        return list;
+    }
 
-//                cerr << "line = " << line << endl;
+//    cerr << "opened: " << filepath << endl;
 
-                string::size_type di = line.find("::");
-                if (di == string::npos) continue;
+    while (!!is.getline(buffer, 1024)) {
 
-                string id = line.substr(0, di);
-                string encodedCat = line.substr(di + 2);
+        string line(buffer);
 
-                if (id.substr(0, 5) != "vamp:") continue;
-                id = id.substr(5);
+//        cerr << "line = " << line << endl;
 
-                while (encodedCat.length() >= 1 &&
-                       encodedCat[encodedCat.length()-1] == '\r') {
-                    encodedCat = encodedCat.substr(0, encodedCat.length()-1);
-                }
+        string::size_type di = line.find("::");
+        if (di == string::npos) continue;
 
-//                cerr << "id = " << id << ", cat = " << encodedCat << endl;
+        string id = line.substr(0, di);
+        string encodedCat = line.substr(di + 2);
 
-                PluginCategoryHierarchy category;
-                string::size_type ai;
-                while ((ai = encodedCat.find(" > ")) != string::npos) {
-                    category.push_back(encodedCat.substr(0, ai));
-                    encodedCat = encodedCat.substr(ai + 3);
-                }
-                if (encodedCat != "") category.push_back(encodedCat);
+        if (id.substr(0, 5) != "vamp:") continue;
+        id = id.substr(5);
 
-                m_taxonomy[id] = category;
-            }
+        while (encodedCat.length() >= 1 &&
+               encodedCat[encodedCat.length()-1] == '\r') {
+            encodedCat = encodedCat.substr(0, encodedCat.length()-1);
         }
+
+//        cerr << "id = " << id << ", cat = " << encodedCat << endl;
+
+        PluginCategoryHierarchy category;
+        string::size_type ai;
+        while ((ai = encodedCat.find(" > ")) != string::npos) {
+            category.push_back(encodedCat.substr(0, ai));
+            encodedCat = encodedCat.substr(ai + 3);
+        }
+        if (encodedCat != "") category.push_back(encodedCat);
+
+        list.push_back(CategoryList::value_type(id, category));
     }
-}    
+
+    return list;
+}
 
 void
 PluginLoader::Impl::pluginDeleted(PluginDeletionNotifyAdapter *adapter)
 {
+    lock_guard<recursive_mutex> guard(m_mutex);
+
     void *handle = m_pluginLibraryHandleMap[adapter];
     if (!handle) return;
 
@@ -0,0 +1,385 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#include <vamp-hostsdk/PluginProfilingAdapter.h>
+
+#include <chrono>
+#include <atomic>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std;
+
+_VAMP_SDK_HOSTSPACE_BEGIN(PluginProfilingAdapter.cpp)
+
+namespace Vamp {
+
+namespace HostExt {
+
+static atomic<PluginProfilingAdapter::AllocationCounter> allocationCounter(0);
+
+class PluginProfilingAdapter::Impl
+{
+public:
+    Impl(Plugin *plugin, string label);
+    ~Impl();
+
+    FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
+    FeatureSet getRemainingFeatures();
+
+    Report getReport() const;
+    string getReportJSON() const;
+    void resetReport();
+
+protected:
+    Plugin *m_plugin;
+    Report m_report;
+
+    struct Sample {
+        chrono::steady_clock::time_point wall;
+        unsigned long long cpuNs;
+        unsigned long long allocated;
+    };
+
+    static unsigned long long threadCpuNs();
+    static int bucketFor(unsigned long long ns);
+    
+    Sample sample() const;
+    void record(CallProfile &profile, const Sample &before);
+    void count(const FeatureSet &fs);
+
+    static void writeCallProfile(ostream &, const CallProfile &);
+    static void writeHistogram(ostream &, const vector<size_t> &);
+    static void writeString(ostream &, string);
+};
+
+PluginProfilingAdapter::CallProfile::CallProfile() :
+    calls(0),
+    totalWallNs(0),
+    totalCpuNs(0),
+    minWallNs(0),
+    maxWallNs(0),
+    bytesAllocated(0),
+    wallHistogram(HistogramBuckets, 0),
+    cpuHistogram(HistogramBuckets, 0)
+{
+}
+
+PluginProfilingAdapter::PluginProfilingAdapter(Plugin *plugin, string label) :
+    PluginWrapper(plugin)
+{
+    m_impl = new Impl(plugin, label);
+}
+
+PluginProfilingAdapter::~PluginProfilingAdapter()
+{
+    delete m_impl;
+}
+
+PluginProfilingAdapter::FeatureSet
+PluginProfilingAdapter::process(const float *const *inputBuffers,
+                                RealTime timestamp)
+{
+    return m_impl->process(inputBuffers, timestamp);
+}
+
+PluginProfilingAdapter::FeatureSet
+PluginProfilingAdapter::getRemainingFeatures()
+{
+    return m_impl->getRemainingFeatures();
+}
+
+PluginProfilingAdapter::Report
+PluginProfilingAdapter::getReport() const
+{
+    return m_impl->getReport();
+}
+
+string
+PluginProfilingAdapter::getReportJSON() const
+{
+    return m_impl->getReportJSON();
+}
+
+void
+PluginProfilingAdapter::resetReport()
+{
+    m_impl->resetReport();
+}
+
+void
+PluginProfilingAdapter::setAllocationCounter(AllocationCounter counter)
+{
+    allocationCounter = counter;
+}
+
+PluginProfilingAdapter::Impl::Impl(Plugin *plugin, string label) :
+    m_plugin(plugin)
+{
+    m_report.label = label;
+    m_report.pluginIdentifier = plugin->getIdentifier();
+    m_report.allocationsCounted = false;
+}
+
+PluginProfilingAdapter::Impl::~Impl()
+{
+    // the adapter will delete the plugin
+}
+
+unsigned long long
+PluginProfilingAdapter::Impl::threadCpuNs()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 100; // FILETIME is in 100ns units
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)) {
+        return 0;
+    }
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+int
+PluginProfilingAdapter::Impl::bucketFor(unsigned long long ns)
+{
+    int b = 0;
+    while (ns > 1 && b < HistogramBuckets - 1) {
+        ns >>= 1;
+        ++b;
+    }
+    return b;
+}
+
+PluginProfilingAdapter::Impl::Sample
+PluginProfilingAdapter::Impl::sample() const
+{
+    Sample s;
+    AllocationCounter counter = allocationCounter;
+    s.allocated = (counter ? counter() : 0);
+    s.cpuNs = threadCpuNs();
+    s.wall = chrono::steady_clock::now();
+    return s;
+}
+
+void
+PluginProfilingAdapter::Impl::record(CallProfile &profile, const Sample &before)
+{
+    // Read in the reverse order from sample(), so that the clock
+    // reads are as close as possible to the call being measured
+    
+    chrono::steady_clock::time_point wall = chrono::steady_clock::now();
+    unsigned long long cpuNs = threadCpuNs();
+    AllocationCounter counter = allocationCounter;
+    unsigned long long allocated = (counter ? counter() : 0);
+
+    unsigned long long wallNs = chrono::duration_cast<chrono::nanoseconds>
+        (wall - before.wall).count();
+    if (cpuNs < before.cpuNs) cpuNs = before.cpuNs;
+    cpuNs -= before.cpuNs;
+    
+    if (profile.calls == 0 || wallNs < profile.minWallNs) {
+        profile.minWallNs = wallNs;
+    }
+    if (wallNs > profile.maxWallNs) {
+        profile.maxWallNs = wallNs;
+    }
+
+    ++profile.calls;
+    profile.totalWallNs += wallNs;
+    profile.totalCpuNs += cpuNs;
+    ++profile.wallHistogram[bucketFor(wallNs)];
+    ++profile.cpuHistogram[bucketFor(cpuNs)];
+
+    if (counter) {
+        m_report.allocationsCounted = true;
+        if (allocated > before.allocated) {
+            profile.bytesAllocated += allocated - before.allocated;
+        }
+    }
+}
+
+void
+PluginProfilingAdapter::Impl::count(const FeatureSet &fs)
+{
+    for (FeatureSet::const_iterator i = fs.begin(); i != fs.end(); ++i) {
+        OutputProfile &op = m_report.outputs[i->first];
+        op.features += i->second.size();
+        for (size_t j = 0; j < i->second.size(); ++j) {
+            op.values += i->second[j].values.size();
+        }
+    }
+}
+
+PluginProfilingAdapter::FeatureSet
+PluginProfilingAdapter::Impl::process(const float *const *inputBuffers,
+                                      RealTime timestamp)
+{
+    Sample before = sample();
+    FeatureSet fs = m_plugin->process(inputBuffers, timestamp);
+    record(m_report.process, before);
+    count(fs);
+    return fs;
+}
+
+PluginProfilingAdapter::FeatureSet
+PluginProfilingAdapter::Impl::getRemainingFeatures()
+{
+    Sample before = sample();
+    FeatureSet fs = m_plugin->getRemainingFeatures();
+    record(m_report.remaining, before);
+    count(fs);
+    return fs;
+}
+
+PluginProfilingAdapter::Report
+PluginProfilingAdapter::Impl::getReport() const
+{
+    return m_report;
+}
+
+void
+PluginProfilingAdapter::Impl::resetReport()
+{
+    Report report;
+    report.label = m_report.label;
+    report.pluginIdentifier = m_report.pluginIdentifier;
+    report.allocationsCounted = false;
+    m_report = report;
+}
+
+void
+PluginProfilingAdapter::Impl::writeString(ostream &os, string s)
+{
+    os << '"';
+    for (size_t i = 0; i < s.length(); ++i) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+            os << '\\' << c;
+        } else if (c < 0x20) {
+            static const char *hex = "0123456789abcdef";
+            os << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+void
+PluginProfilingAdapter::Impl::writeHistogram(ostream &os,
+                                             const vector<size_t> &histogram)
+{
+    // Written as a list of [lower bound in ns, count] pairs, omitting
+    // empty buckets
+    
+    os << "[";
+    bool first = true;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        if (histogram[i] == 0) continue;
+        if (!first) os << ", ";
+        first = false;
+        unsigned long long lower = (i == 0 ? 0ull : (1ull << i));
+        os << "[" << lower << ", " << histogram[i] << "]";
+    }
+    os << "]";
+}
+
+void
+PluginProfilingAdapter::Impl::writeCallProfile(ostream &os,
+                                               const CallProfile &p)
+{
+    os << "{ \"calls\": " << p.calls
+       << ", \"totalWallNs\": " << p.totalWallNs
+       << ", \"totalCpuNs\": " << p.totalCpuNs
+       << ", \"minWallNs\": " << p.minWallNs
+       << ", \"maxWallNs\": " << p.maxWallNs
+       << ", \"bytesAllocated\": " << p.bytesAllocated
+       << ", \"wallHistogram\": ";
+    writeHistogram(os, p.wallHistogram);
+    os << ", \"cpuHistogram\": ";
+    writeHistogram(os, p.cpuHistogram);
+    os << " }";
+}
+
+string
+PluginProfilingAdapter::Impl::getReportJSON() const
+{
+    ostringstream os;
+    
+    os << "{ \"label\": ";
+    writeString(os, m_report.label);
+    os << ", \"plugin\": ";
+    writeString(os, m_report.pluginIdentifier);
+    os << ", \"allocationsCounted\": "
+       << (m_report.allocationsCounted ? "true" : "false");
+    os << ", \"process\": ";
+    writeCallProfile(os, m_report.process);
+    os << ", \"getRemainingFeatures\": ";
+    writeCallProfile(os, m_report.remaining);
+    os << ", \"outputs\": {";
+    for (map<int, OutputProfile>::const_iterator i = m_report.outputs.begin();
+         i != m_report.outputs.end(); ++i) {
+        if (i != m_report.outputs.begin()) os << ",";
+        os << " \"" << i->first << "\": { \"features\": "
+           << i->second.features << ", \"values\": "
+           << i->second.values << " }";
+    }
+    os << " } }";
+
+    return os.str();
+}
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(PluginProfilingAdapter.cpp)
+
@@ -36,10 +36,17 @@
 
 #include <vamp-hostsdk/PluginSummarisingAdapter.h>
 
+#include "StateData.h"
+#include "SpillFile.h"
+#include <vamp-hostsdk/FeatureSink.h>
+#include <vamp-hostsdk/CompactFeature.h>
+
 #include <map>
+#include <list>
 #include <algorithm>
 #include <cmath>
 #include <climits>
+#include <cstdint>
 
 using namespace std;
 
@@ -62,11 +69,21 @@ public:
 
     void reset();
 
-    FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
-    FeatureSet getRemainingFeatures();
+    void process(const float *const *inputBuffers, RealTime timestamp,
+                 FeatureSink &sink);
+    void getRemainingFeatures(FeatureSink &sink);
 
     void setSummarySegmentBoundaries(const SegmentBoundaries &);
 
+    void setTaskScheduler(TaskScheduler *scheduler) {
+        m_scheduler = scheduler ? scheduler :
+            TaskScheduler::getSerialScheduler();
+    }
+
+    void setMemoryBudget(size_t bytes) {
+        m_store.setBudget(bytes);
+    }
+
     FeatureList getSummaryForOutput(int output,
                                     SummaryType type,
                                     AveragingMethod avg);
@@ -74,6 +91,10 @@ public:
     FeatureSet getSummaryForAllOutputs(SummaryType type,
                                        AveragingMethod avg);
 
+    void getSummaryState(SummaryState::Impl &state);
+
+    static string getSummaryLabel(SummaryType type, AveragingMethod avg);
+
 protected:
     Plugin *m_plugin;
     float m_inputSampleRate;
@@ -82,22 +103,172 @@ protected:
 
     SegmentBoundaries m_boundaries;
 
-    typedef vector<float> ValueList;
-
-    struct Result { // smaller than Feature
-        RealTime time;
-        RealTime duration;
-        ValueList values; // bin number -> value
+    TaskScheduler *m_scheduler;
+
+    // Results are stored by column rather than by row, in chunks of
+    // chunkSize results. Each chunk has a time column and a duration
+    // column shared by all bins, and a contiguous column of values
+    // for each bin. Bins missing from a result (because an output has
+    // a variable bin count) read as zero. This avoids an allocation
+    // per result and lets reduce() work through each bin in a few
+    // linear passes.
+    //
+    // If a memory budget has been set and is used up, each chunk is
+    // written out to a temporary file once it is full (by which time
+    // all of its durations are known) and read back through a memory
+    // mapping.
+
+    static const int chunkSize = 1024;
+
+    struct Chunk {
+        int bins; // columns present; any further bins read as zero
+        vector<RealTime> times;
+        vector<RealTime> durations;
+        vector<float> values; // bin * chunkSize + row
+        int64_t offset; // in spill file, or -1 if held in memory
+        Chunk() : bins(0), offset(-1) { }
+        size_t getMemorySize() const {
+            return (times.capacity() + durations.capacity()) *
+                sizeof(RealTime) + values.capacity() * sizeof(float);
+        }
     };
 
-    typedef vector<Result> ResultList;
+    class ResultStore
+    {
+    public:
+        ResultStore() : m_budget(0), m_inMemory(0), m_file(0) { }
+        ~ResultStore() { delete m_file; }
+
+        void setBudget(size_t budget) { m_budget = budget; }
+        size_t getBudget() const { return m_budget; }
+        
+        void added(size_t bytes) { m_inMemory += bytes; }
+        void released(size_t bytes) { m_inMemory -= bytes; }
+
+        // Write out a full chunk if we are over budget
+        void retire(Chunk &chunk);
+
+        // Map the spill file for reading, after writing and before
+        // reading any spilled chunks
+        void prepareForReading() { if (m_file) m_file->map(); }
+
+        const char *at(int64_t offset) const { return m_file->at(offset); }
+
+        void clear() {
+            delete m_file;
+            m_file = 0;
+            m_inMemory = 0;
+        }
+
+    private:
+        ResultStore(const ResultStore &); // not provided
+        ResultStore &operator=(const ResultStore &); // not provided
+
+        size_t m_budget;
+        size_t m_inMemory;
+        SpillFile *m_file;
+    };
 
     struct OutputAccumulator {
         int bins;
-        ResultList results;
-        OutputAccumulator() : bins(0) { }
+        int count;
+        vector<Chunk> chunks;
+        OutputAccumulator() : bins(0), count(0) { }
+
+        void setBinCount(ResultStore &store, int n) {
+            if (n <= bins) return;
+            bins = n;
+            if (!chunks.empty() && chunks.back().offset < 0) {
+                Chunk &chunk = chunks.back();
+                store.released(chunk.getMemorySize());
+                chunk.values.resize(size_t(n) * chunkSize, 0.f);
+                chunk.bins = n;
+                store.added(chunk.getMemorySize());
+            }
+        }
+
+        template <typename V>
+        void append(ResultStore &store, RealTime time, RealTime duration,
+                    const V &values, int nvalues) {
+            int row = count % chunkSize;
+            if (row == 0) {
+                if (!chunks.empty()) store.retire(chunks.back());
+                chunks.push_back(Chunk());
+                Chunk &chunk = chunks.back();
+                chunk.bins = bins;
+                chunk.times.reserve(chunkSize);
+                chunk.durations.reserve(chunkSize);
+                chunk.values.resize(size_t(bins) * chunkSize, 0.f);
+                store.added(chunk.getMemorySize());
+            }
+            Chunk &chunk = chunks.back();
+            chunk.times.push_back(time);
+            chunk.durations.push_back(duration);
+            for (int b = 0; b < bins && b < nvalues; ++b) {
+                chunk.values[size_t(b) * chunkSize + row] = float(values[b]);
+            }
+            ++count;
+        }
+
+        // Free everything, accounting for it in the store
+        void release(ResultStore &store) {
+            for (size_t c = 0; c < chunks.size(); ++c) {
+                if (chunks[c].offset < 0) {
+                    store.released(chunks[c].getMemorySize());
+                }
+            }
+            chunks.clear();
+            bins = 0;
+            count = 0;
+        }
+
+        // The last chunk is always in memory, so its last duration
+        // may be written to
+        RealTime &getLastDuration() {
+            return chunks.back().durations.back();
+        }
+
+        int getChunkCount() const { return int(chunks.size()); }
+
+        int getRowCount(int c) const {
+            if (c + 1 < int(chunks.size())) return chunkSize;
+            return count - c * chunkSize;
+        }
+
+        const RealTime *getTimes(const ResultStore &store, int c) const {
+            const Chunk &chunk = chunks[c];
+            if (chunk.offset < 0) return chunk.times.data();
+            return (const RealTime *)store.at(chunk.offset);
+        }
+
+        const RealTime *getDurations(const ResultStore &store, int c) const {
+            const Chunk &chunk = chunks[c];
+            if (chunk.offset < 0) return chunk.durations.data();
+            return (const RealTime *)store.at
+                (chunk.offset + chunkSize * sizeof(RealTime));
+        }
+
+        // Return 0 if the bin is absent from the chunk, i.e. all zero
+        const float *getValues(const ResultStore &store, int c, int bin) const {
+            const Chunk &chunk = chunks[c];
+            if (bin >= chunk.bins) return 0;
+            if (chunk.offset < 0) {
+                return chunk.values.data() + size_t(bin) * chunkSize;
+            }
+            return (const float *)store.at
+                (chunk.offset + 2 * chunkSize * sizeof(RealTime) +
+                 size_t(bin) * chunkSize * sizeof(float));
+        }
+
+        RealTime getLastEnd(const ResultStore &store) const {
+            int c = getChunkCount() - 1;
+            int r = getRowCount(c) - 1;
+            return getTimes(store, c)[r] + getDurations(store, c)[r];
+        }
     };
 
+    ResultStore m_store;
+
     typedef map<int, OutputAccumulator> OutputAccumulatorMap;
     OutputAccumulatorMap m_accumulators; // output number -> accumulator
 
@@ -139,14 +310,139 @@ protected:
     bool m_reduced;
     RealTime m_endTime;
 
-    void accumulate(const FeatureSet &fs, RealTime, bool final);
-    void accumulate(int output, const Feature &f, RealTime, bool final);
+    // One unit of work for reduce(): the summaries of a range of bins
+    // within one segment of one output. Each task writes only to the
+    // summaries for its own bins, which are created before any task
+    // is run, so tasks may run in any order or concurrently
+    struct ReduceTask {
+        const OutputAccumulator *accumulator;
+        double totalDuration;
+        size_t sortBudget; // bytes, or 0 for no limit
+        OutputSummary *summary;
+        int startBin;
+        int endBin;
+    };
+
+    void reduceBins(const ReduceTask &task) const;
+
+    // Obtain the values of a bin, and the durations of the results in
+    // seconds, for one chunk of an accumulator, returning the number
+    // of results in the chunk
+    int readChunk(const OutputAccumulator &, int chunk, int bin,
+                  const float *&values, double *durations) const;
+
+    class SortedHistogramBuilder;
+
+    template <typename Consumer>
+    void forEachSorted(const OutputAccumulator &, int bin, size_t budget,
+                       Consumer &consumer) const;
+
+    template <typename F>
+    void accumulate(int output, const F &f, RealTime, bool final);
+
+    // Sink that accumulates each feature returned by the plugin on
+    // its way through to the host's sink
+    class AccumulatingSink : public FeatureSink
+    {
+    public:
+        AccumulatingSink(Impl *impl, FeatureSink &target,
+                         RealTime timestamp, bool final) :
+            m_impl(impl), m_target(target),
+            m_timestamp(timestamp), m_final(final) { }
+
+        void push(int output, Feature &&feature) {
+            accumulate(output, feature);
+            m_target.push(output, std::move(feature));
+        }
+
+        bool acceptsCompactFeatures() const {
+            return m_target.acceptsCompactFeatures();
+        }
+
+        void pushCompact(int output, CompactFeature &&feature) {
+            accumulate(output, feature);
+            m_target.pushCompact(output, std::move(feature));
+        }
+
+    private:
+        template <typename F>
+        void accumulate(int output, const F &feature) {
+            if (feature.hasTimestamp) {
+                m_impl->accumulate(output, feature, feature.timestamp, m_final);
+            } else {
+                //!!! is this correct?
+                m_impl->accumulate(output, feature, m_timestamp, m_final);
+            }
+        }
+
+        Impl *m_impl;
+        FeatureSink &m_target;
+        RealTime m_timestamp;
+        bool m_final;
+    };
     void accumulateFinalDurations();
     void findSegmentBounds(RealTime t, RealTime &start, RealTime &end);
     void segment();
     void reduce();
+    void summarise();
+};
+
+class PluginSummarisingAdapter::SummaryState::Impl
+{
+public:
+    // One entry per distinct value (or, once the histogram has been
+    // compressed, per cluster of neighbouring values) in a bin
+    struct HistogramEntry {
+        float value;
+        int64_t count;
+        double duration; // seconds
+    };
+
+    typedef vector<HistogramEntry> Histogram; // ordered by value
+
+    struct BinState {
+        double minimum;
+        double maximum;
+        double sum;
+        double m2;   // sum of squared differences from the mean
+        double sum_c; // sum of value * duration
+        double m2_c; // duration-weighted m2, about sum_c / weight
+        Histogram histogram;
+    };
+
+    struct SegmentState {
+        RealTime end; // end of the last result in the segment
+        int64_t count;
+        double weight; // total duration of results, in seconds
+        vector<BinState> bins;
+    };
+
+    typedef map<RealTime, SegmentState> SegmentMap; // start -> segment
+    typedef map<int, SegmentMap> OutputMap;
+
+    OutputMap outputs;
+    RealTime endTime;
 
-    string getSummaryLabel(SummaryType type, AveragingMethod avg);
+    static const size_t maxHistogramSize = 1024;
+
+    void merge(const Impl &other);
+
+    FeatureList getSummaryForOutput(int output, SummaryType type,
+                                    AveragingMethod avg) const;
+
+    void serialise(StateData &data) const;
+    bool deserialise(const StateData &data);
+
+    static void compress(Histogram &histogram);
+
+private:
+    static BinState zeroBin(const SegmentState &segment);
+    static void mergeSegment(SegmentState &a, const SegmentState &b);
+    static void mergeBin(BinState &a, const SegmentState &sa,
+                         const BinState &b, const SegmentState &sb);
+    static double getValue(const SegmentState &segment, int bin,
+                           RealTime start, SummaryType type,
+                           AveragingMethod avg);
 };
 
 static RealTime INVALID_DURATION(INT_MIN, INT_MIN);
@@ -177,16 +473,48 @@ PluginSummarisingAdapter::reset()
     m_impl->reset();
 }
 
+bool
+PluginSummarisingAdapter::getState(StateData &) const
+{
+    return false;
+}
+
+bool
+PluginSummarisingAdapter::setState(const StateData &)
+{
+    return false;
+}
+
 Plugin::FeatureSet
 PluginSummarisingAdapter::process(const float *const *inputBuffers, RealTime timestamp)
 {
-    return m_impl->process(inputBuffers, timestamp);
+    FeatureSet fs;
+    FeatureSetSink sink(fs);
+    m_impl->process(inputBuffers, timestamp, sink);
+    return fs;
 }
 
 Plugin::FeatureSet
 PluginSummarisingAdapter::getRemainingFeatures()
 {
-    return m_impl->getRemainingFeatures();
+    FeatureSet fs;
+    FeatureSetSink sink(fs);
+    m_impl->getRemainingFeatures(sink);
+    return fs;
+}
+
+void
+PluginSummarisingAdapter::processInto(const float *const *inputBuffers,
+                                      RealTime timestamp,
+                                      FeatureSink &sink)
+{
+    m_impl->process(inputBuffers, timestamp, sink);
+}
+
+void
+PluginSummarisingAdapter::getRemainingFeaturesInto(FeatureSink &sink)
+{
+    m_impl->getRemainingFeatures(sink);
 }
 
 void
@@ -195,6 +523,27 @@ PluginSummarisingAdapter::setSummarySegmentBoundaries(const SegmentBoundaries &b
     m_impl->setSummarySegmentBoundaries(b);
 }
 
+void
+PluginSummarisingAdapter::setTaskScheduler(TaskScheduler *scheduler)
+{
+    PluginWrapper::setTaskScheduler(scheduler);
+    m_impl->setTaskScheduler(scheduler);
+}
+
+void
+PluginSummarisingAdapter::setMemoryBudget(size_t bytes)
+{
+    m_impl->setMemoryBudget(bytes);
+}
+
+PluginSummarisingAdapter::SummaryState
+PluginSummarisingAdapter::getSummaryState()
+{
+    SummaryState state;
+    m_impl->getSummaryState(*state.m_impl);
+    return state;
+}
+
 Plugin::FeatureList
 PluginSummarisingAdapter::getSummaryForOutput(int output,
                                               SummaryType type,
@@ -213,6 +562,7 @@ PluginSummarisingAdapter::getSummaryForAllOutputs(SummaryType type,
 PluginSummarisingAdapter::Impl::Impl(Plugin *plugin, float inputSampleRate) :
     m_plugin(plugin),
     m_inputSampleRate(inputSampleRate),
+    m_scheduler(TaskScheduler::getSerialScheduler()),
     m_reduced(false)
 {
 }
@@ -236,39 +586,39 @@ PluginSummarisingAdapter::Impl::reset()
     m_segmentedAccumulators.clear();
     m_prevTimestamps.clear();
     m_prevDurations.clear();
+    m_store.clear();
     m_summaries.clear();
     m_reduced = false;
     m_endTime = RealTime();
     m_plugin->reset();
 }
 
-Plugin::FeatureSet
+void
 PluginSummarisingAdapter::Impl::process(const float *const *inputBuffers,
-                                        RealTime timestamp)
+                                        RealTime timestamp,
+                                        FeatureSink &sink)
 {
     if (m_reduced) {
         cerr << "WARNING: Cannot call PluginSummarisingAdapter::process() or getRemainingFeatures() after one of the getSummary methods" << endl;
     }
-    FeatureSet fs = m_plugin->process(inputBuffers, timestamp);
-    accumulate(fs, timestamp, false);
+    AccumulatingSink accumulating(this, sink, timestamp, false);
+    accumulating.processFrom(m_plugin, inputBuffers, timestamp);
     m_endTime = timestamp + 
         RealTime::frame2RealTime(m_stepSize, int(m_inputSampleRate + 0.5));
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
     cerr << "timestamp = " << timestamp << ", end time becomes " << m_endTime
          << endl;
 #endif
-    return fs;
 }
 
-Plugin::FeatureSet
-PluginSummarisingAdapter::Impl::getRemainingFeatures()
+void
+PluginSummarisingAdapter::Impl::getRemainingFeatures(FeatureSink &sink)
 {
     if (m_reduced) {
         cerr << "WARNING: Cannot call PluginSummarisingAdapter::process() or getRemainingFeatures() after one of the getSummary methods" << endl;
     }
-    FeatureSet fs = m_plugin->getRemainingFeatures();
-    accumulate(fs, m_endTime, true);
-    return fs;
+    AccumulatingSink accumulating(this, sink, m_endTime, true);
+    accumulating.remainingFeaturesFrom(m_plugin);
 }
 
 void
@@ -290,12 +640,7 @@ PluginSummarisingAdapter::Impl::getSummaryForOutput(int output,
                                                     SummaryType type,
                                                     AveragingMethod avg)
 {
-    if (!m_reduced) {
-        accumulateFinalDurations();
-        segment();
-        reduce();
-        m_reduced = true;
-    }
+    summarise();
 
     bool continuous = (avg == ContinuousTimeAverage);
 
@@ -393,12 +738,7 @@ Plugin::FeatureSet
 PluginSummarisingAdapter::Impl::getSummaryForAllOutputs(SummaryType type,
                                                         AveragingMethod avg)
 {
-    if (!m_reduced) {
-        accumulateFinalDurations();
-        segment();
-        reduce();
-        m_reduced = true;
-    }
+    summarise();
 
     FeatureSet fs;
     for (OutputSummarySegmentMap::const_iterator i = m_summaries.begin();
@@ -408,24 +748,6 @@ PluginSummarisingAdapter::Impl::getSummaryForAllOutputs(SummaryType type,
     return fs;
 }
 
-void
-PluginSummarisingAdapter::Impl::accumulate(const FeatureSet &fs,
-                                           RealTime timestamp, 
-                                           bool final)
-{
-    for (FeatureSet::const_iterator i = fs.begin(); i != fs.end(); ++i) {
-        for (FeatureList::const_iterator j = i->second.begin();
-             j != i->second.end(); ++j) {
-            if (j->hasTimestamp) {
-                accumulate(i->first, *j, j->timestamp, final);
-            } else {
-                //!!! is this correct?
-                accumulate(i->first, *j, timestamp, final);
-            }
-        }
-    }
-}
-
 string
 PluginSummarisingAdapter::Impl::getSummaryLabel(SummaryType type,
                                                 AveragingMethod avg)
@@ -452,9 +774,10 @@ PluginSummarisingAdapter::Impl::getSummaryLabel(SummaryType type,
     return label;
 }
 
+template <typename F>
 void
 PluginSummarisingAdapter::Impl::accumulate(int output,
-                                           const Feature &f,
+                                           const F &f,
                                            RealTime timestamp,
                                            bool
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
@@ -532,9 +855,7 @@ PluginSummarisingAdapter::Impl::accumulate(int output,
         cerr << "Pushing previous duration as " << prevDuration << endl;
 #endif
         
-        m_accumulators[output].results
-            [m_accumulators[output].results.size() - 1]
-            .duration = prevDuration;
+        m_accumulators[output].getLastDuration() = prevDuration;
     }
 
     if (f.hasDuration) m_prevDurations[output] = f.duration;
@@ -551,19 +872,10 @@ PluginSummarisingAdapter::Impl::accumulate(int output,
 #endif
     }
 
-    Result result;
-    result.time = timestamp;
-    result.duration = INVALID_DURATION;
-
-    if (int(f.values.size()) > m_accumulators[output].bins) {
-        m_accumulators[output].bins = int(f.values.size());
-    }
-
-    for (int i = 0; i < int(f.values.size()); ++i) {
-        result.values.push_back(f.values[i]);
-    }
-
-    m_accumulators[output].results.push_back(result);
+    OutputAccumulator &acc = m_accumulators[output];
+    int nvalues = int(f.values.size());
+    acc.setBinCount(m_store, nvalues);
+    acc.append(m_store, timestamp, INVALID_DURATION, f.values, nvalues);
 }
 
 void
@@ -574,7 +886,7 @@ PluginSummarisingAdapter::Impl::accumulateFinalDurations()
 
         int output = i->first;
 
-        int acount = int(m_accumulators[output].results.size());
+        int acount = m_accumulators[output].count;
 
         if (acount == 0) continue;
 
@@ -589,7 +901,7 @@ PluginSummarisingAdapter::Impl::accumulateFinalDurations()
             cerr << "Pushing final duration from feature as " << m_prevDurations[output] << endl;
 #endif
 
-            m_accumulators[output].results[acount - 1].duration =
+            m_accumulators[output].getLastDuration() =
                 m_prevDurations[output];
 
         } else {
@@ -598,13 +910,13 @@ PluginSummarisingAdapter::Impl::accumulateFinalDurations()
             cerr << "Pushing final duration from diff as " << m_endTime << " - " << m_prevTimestamps[output] << endl;
 #endif
 
-            m_accumulators[output].results[acount - 1].duration =
+            m_accumulators[output].getLastDuration() =
                 m_endTime - m_prevTimestamps[output];
         }
         
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
         cerr << "so duration for result no " << acount-1 << " is "
-                  << m_accumulators[output].results[acount-1].duration
+                  << m_accumulators[output].getLastDuration()
                   << endl;
 #endif
     }
@@ -653,7 +965,7 @@ PluginSummarisingAdapter::Impl::segment()
 
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER_SEGMENT
         cerr << "segment: total results for output " << output << " = "
-                  << source.results.size() << endl;
+                  << source.count << endl;
 #endif
 
         // This is basically nonsense if the results have no values
@@ -661,81 +973,95 @@ PluginSummarisingAdapter::Impl::segment()
         // interest)... but perhaps it's the user's problem if they
         // ask for segmentation (or any summary at all) in that case
 
-        for (int n = 0; n < int(source.results.size()); ++n) {
+        vector<const float *> columns(source.bins);
+        vector<float> values(source.bins);
+
+        for (int c = 0; c < source.getChunkCount(); ++c) {
+
+            const RealTime *times = source.getTimes(m_store, c);
+            const RealTime *durations = source.getDurations(m_store, c);
+            for (int bin = 0; bin < source.bins; ++bin) {
+                columns[bin] = source.getValues(m_store, c, bin);
+            }
             
-            // This result spans source.results[n].time to
-            // source.results[n].time + source.results[n].duration.
-            // We need to dispose it into segments appropriately
+            for (int n = 0; n < source.getRowCount(c); ++n) {
+                
+                // This result spans times[n] to times[n] + durations[n].
+                // We need to dispose it into segments appropriately
+
+                RealTime resultStart = times[n];
+                RealTime resultEnd = resultStart + durations[n];
 
-            RealTime resultStart = source.results[n].time;
-            RealTime resultEnd = resultStart + source.results[n].duration;
+                for (int bin = 0; bin < source.bins; ++bin) {
+                    values[bin] = columns[bin] ? columns[bin][n] : 0.f;
+                }
 
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER_SEGMENT
-            cerr << "output: " << output << ", result start = " << resultStart << ", end = " << resultEnd << endl;
+                cerr << "output: " << output << ", result start = " << resultStart << ", end = " << resultEnd << endl;
 #endif
 
-            RealTime segmentStart = RealTime::zeroTime;
-            RealTime segmentEnd = resultEnd - RealTime(1, 0);
-            
-            RealTime prevSegmentStart = segmentStart - RealTime(1, 0);
+                RealTime segmentStart = RealTime::zeroTime;
+                RealTime segmentEnd = resultEnd - RealTime(1, 0);
+                
+                RealTime prevSegmentStart = segmentStart - RealTime(1, 0);
 
-            while (segmentEnd < resultEnd) {
+                while (segmentEnd < resultEnd) {
 
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER_SEGMENT
-                cerr << "segment end " << segmentEnd << " < result end "
-                          << resultEnd << " (with result start " << resultStart << ")" <<  endl;
+                    cerr << "segment end " << segmentEnd << " < result end "
+                              << resultEnd << " (with result start " << resultStart << ")" <<  endl;
 #endif
 
-                findSegmentBounds(resultStart, segmentStart, segmentEnd);
-
-                if (segmentStart == prevSegmentStart) {
-                    // This can happen when we reach the end of the
-                    // input, if a feature's end time overruns the
-                    // input audio end time
-                    break;
-                }
-                prevSegmentStart = segmentStart;
-                
-                RealTime chunkStart = resultStart;
-                if (chunkStart < segmentStart) chunkStart = segmentStart;
-
-                RealTime chunkEnd = resultEnd;
-                if (chunkEnd > segmentEnd) chunkEnd = segmentEnd;
-                
-                m_segmentedAccumulators[output][segmentStart].bins = source.bins;
+                    findSegmentBounds(resultStart, segmentStart, segmentEnd);
 
-                Result chunk;
-                chunk.time = chunkStart;
-                chunk.duration = chunkEnd - chunkStart;
-                chunk.values = source.results[n].values;
+                    if (segmentStart == prevSegmentStart) {
+                        // This can happen when we reach the end of the
+                        // input, if a feature's end time overruns the
+                        // input audio end time
+                        break;
+                    }
+                    prevSegmentStart = segmentStart;
+                    
+                    RealTime chunkStart = resultStart;
+                    if (chunkStart < segmentStart) chunkStart = segmentStart;
+
+                    RealTime chunkEnd = resultEnd;
+                    if (chunkEnd > segmentEnd) chunkEnd = segmentEnd;
+                    
+                    OutputAccumulator &target =
+                        m_segmentedAccumulators[output][segmentStart];
+                    target.setBinCount(m_store, source.bins);
 
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER_SEGMENT
-                cerr << "chunk for segment " << segmentStart << ": from " << chunk.time << ", duration " << chunk.duration << endl;
+                    cerr << "chunk for segment " << segmentStart << ": from " << chunkStart << ", duration " << chunkEnd - chunkStart << endl;
 #endif
 
-                m_segmentedAccumulators[output][segmentStart].results
-                    .push_back(chunk);
+                    target.append(m_store, chunkStart, chunkEnd - chunkStart,
+                                  values, source.bins);
 
-                resultStart = chunkEnd;
+                    resultStart = chunkEnd;
+                }
             }
         }
+
+        // The source is no longer needed once it has been segmented
+        source.release(m_store);
     }
 }
 
-struct ValueDurationFloatPair
+// One value from a bin, with the duration of its result, for sorting
+struct SortElement
 {
     float value;
-    float duration;
-
-    ValueDurationFloatPair() : value(0), duration(0) { }
-    ValueDurationFloatPair(float v, float d) : value(v), duration(d) { }
-    ValueDurationFloatPair &operator=(const ValueDurationFloatPair &p) {
-        value = p.value;
-        duration = p.duration;
-        return *this;
-    }
-    bool operator<(const ValueDurationFloatPair &p) const {
-        return value < p.value;
+    int index;
+    double duration;
+
+    bool operator<(const SortElement &e) const {
+        // ordering equal values by index keeps the order in which
+        // durations are summed for the continuous-time mode the same
+        // as the order of the results themselves
+        if (value != e.value) return value < e.value;
+        return index < e.index;
     }
 };
 
@@ -744,240 +1070,1104 @@ static double toSec(const RealTime &r)
     return r.sec + double(r.nsec) / 1000000000.0;
 }
 
-void
-PluginSummarisingAdapter::Impl::reduce()
+// Finds the extents, medians and modes of a bin from its values,
+// presented in ascending order
+class SortedBinSummariser
 {
-    for (OutputSegmentAccumulatorMap::iterator i =
-             m_segmentedAccumulators.begin();
-         i != m_segmentedAccumulators.end(); ++i) {
+public:
+    SortedBinSummariser(int count, double totalDuration) :
+        minimum(0), maximum(0), median(0), median_c(0), mode(0), mode_c(0),
+        m_count(count),
+        m_halfDuration(totalDuration / 2),
+        m_position(0),
+        m_haveMedian_c(false),
+        m_duracc(0.0),
+        m_v0(0.f),
+        m_v1(0.f),
+        m_runValue(0.f),
+        m_runCount(0),
+        m_runDuration(0.0),
+        m_md(0),
+        m_mrd(0.0) { }
+
+    void operator()(const SortElement &e) {
+
+        if (m_position == 0) minimum = e.value;
+        maximum = e.value;
+
+        if (m_position == m_count/2) m_v0 = e.value;
+        if (m_position == min(m_count/2 + 1, m_count - 1)) m_v1 = e.value;
+
+        if (!m_haveMedian_c) {
+            m_duracc += float(e.duration);
+            if (m_duracc > m_halfDuration) {
+                median_c = e.value;
+                m_haveMedian_c = true;
+            }
+        }
 
-        int output = i->first;
-        SegmentAccumulatorMap &segments = i->second;
+        // Equal values are adjacent, so the modes can be found from
+        // the lengths and total durations of runs, taking the lowest
+        // value in the case of a tie
+        
+        if (m_runCount > 0 && e.value != m_runValue) endRun();
+        m_runValue = e.value;
+        ++m_runCount;
+        m_runDuration += e.duration;
 
-        for (SegmentAccumulatorMap::iterator j = segments.begin();
-             j != segments.end(); ++j) {
+        ++m_position;
+    }
 
-            RealTime segmentStart = j->first;
-            OutputAccumulator &accumulator = j->second;
+    void finish() {
+        if (m_runCount > 0) endRun();
+        if (m_count % 2 == 1) {
+            median = m_v0;
+        } else {
+            median = (m_v0 + m_v1) / 2;
+        }
+        if (!m_haveMedian_c) median_c = maximum;
+    }
 
-            int sz = int(accumulator.results.size());
+    double minimum;
+    double maximum;
+    double median;
+    double median_c;
+    double mode;
+    double mode_c;
+
+private:
+    void endRun() {
+        if (m_runCount > m_md) {
+            m_md = m_runCount;
+            mode = m_runValue;
+        }
+        if (m_runDuration > m_mrd) {
+            m_mrd = m_runDuration;
+            mode_c = m_runValue;
+        }
+        m_runCount = 0;
+        m_runDuration = 0.0;
+    }
 
-#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-            cerr << "reduce: segment starting at " << segmentStart
-                      << " on output " << output << " has " << sz << " result(s)" << endl;
-#endif
+    int m_count;
+    double m_halfDuration;
+    int m_position;
+    bool m_haveMedian_c;
+    double m_duracc;
+    float m_v0;
+    float m_v1;
+    float m_runValue;
+    int m_runCount;
+    double m_runDuration;
+    int m_md;
+    double m_mrd;
+};
 
-            double totalDuration = 0.0;
-            //!!! is this right?
-            if (sz > 0) {
-#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                cerr << "last time = " << accumulator.results[sz-1].time 
-                          << ", duration = " << accumulator.results[sz-1].duration
-                          << " (step = " << m_stepSize << ", block = " << m_blockSize << ")"
-                          << endl;
-#endif
-                totalDuration = toSec((accumulator.results[sz-1].time +
-                                       accumulator.results[sz-1].duration) -
-                                      segmentStart);
+// Builds the histogram for a SummaryState from a bin's values,
+// presented in ascending order
+class PluginSummarisingAdapter::Impl::SortedHistogramBuilder
+{
+public:
+    SortedHistogramBuilder(vector<SummaryState::Impl::HistogramEntry> &h) :
+        minimum(0), maximum(0), m_histogram(h), m_position(0) {
+        m_histogram.clear();
+    }
+
+    void operator()(const SortElement &e) {
+        if (m_position++ == 0) minimum = e.value;
+        maximum = e.value;
+        if (m_histogram.empty() || m_histogram.back().value != e.value) {
+            if (m_histogram.size() > SummaryState::Impl::maxHistogramSize) {
+                SummaryState::Impl::compress(m_histogram);
             }
+            SummaryState::Impl::HistogramEntry entry;
+            entry.value = e.value;
+            entry.count = 0;
+            entry.duration = 0.0;
+            m_histogram.push_back(entry);
+        }
+        ++m_histogram.back().count;
+        m_histogram.back().duration += e.duration;
+    }
 
-            for (int bin = 0; bin < accumulator.bins; ++bin) {
+    void finish() {
+        SummaryState::Impl::compress(m_histogram);
+    }
 
-                // work on all values over time for a single bin
+    double minimum;
+    double maximum;
 
-#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                cerr << "bin " << bin << ":" << endl;
-#endif
-                
-                OutputBinSummary summary;
+private:
+    vector<SummaryState::Impl::HistogramEntry> &m_histogram;
+    int m_position;
+};
 
-                summary.count = sz;
+int
+PluginSummarisingAdapter::Impl::readChunk(const OutputAccumulator &accumulator,
+                                          int c, int bin,
+                                          const float *&values,
+                                          double *durations) const
+{
+    static const vector<float> zeros(chunkSize, 0.f);
+    int n = accumulator.getRowCount(c);
+    values = accumulator.getValues(m_store, c, bin);
+    if (!values) values = zeros.data();
+    const RealTime *d = accumulator.getDurations(m_store, c);
+    for (int k = 0; k < n; ++k) {
+        durations[k] = toSec(d[k]);
+    }
+    return n;
+}
 
-                summary.minimum = 0.f;
-                summary.maximum = 0.f;
+template <typename Consumer>
+void
+PluginSummarisingAdapter::Impl::forEachSorted(const OutputAccumulator &accumulator,
+                                              int bin, size_t budget,
+                                              Consumer &consumer) const
+{
+    // Present the values of one bin to the consumer in ascending
+    // order. If they will not fit in the given memory budget, sort
+    // them in runs that do fit, write the runs to a temporary file,
+    // and merge them from there
 
-                summary.median = 0.f;
-                summary.mode = 0.f;
-                summary.sum = 0.f;
-                summary.variance = 0.f;
+    int sz = accumulator.count;
 
-                summary.median_c = 0.f;
-                summary.mode_c = 0.f;
-                summary.mean_c = 0.f;
-                summary.variance_c = 0.f;
+    size_t runLength = size_t(sz);
+    if (budget > 0) {
+        runLength = max(budget / sizeof(SortElement), size_t(chunkSize));
+    }
 
-                if (sz == 0) continue;
+    vector<SortElement> run;
+    run.reserve(min(runLength, size_t(sz)));
+    vector<double> dur(chunkSize);
+
+    SpillFile file;
+    vector<int64_t> offsets;
+    vector<size_t> lengths;
+    bool external = (runLength < size_t(sz));
+
+    int index = 0;
+    for (int c = 0; c < accumulator.getChunkCount(); ++c) {
+        const float *values = 0;
+        int n = readChunk(accumulator, c, bin, values, dur.data());
+        for (int k = 0; k < n; ++k) {
+            SortElement e;
+            e.value = values[k];
+            e.index = index++;
+            e.duration = dur[k];
+            run.push_back(e);
+            if (external && run.size() == runLength) {
+                sort(run.begin(), run.end());
+                int64_t offset = file.append
+                    (run.data(), run.size() * sizeof(SortElement));
+                if (offset < 0) {
+                    cerr << "WARNING: PluginSummarisingAdapter: Unable to write sorted values to temporary file, sorting in memory instead" << endl;
+                    forEachSorted(accumulator, bin, 0, consumer);
+                    return;
+                }
+                offsets.push_back(offset);
+                lengths.push_back(run.size());
+                run.clear();
+            }
+        }
+    }
 
-                vector<ValueDurationFloatPair> valvec;
+    sort(run.begin(), run.end());
+    
+    if (!external) {
+        for (size_t i = 0; i < run.size(); ++i) {
+            consumer(run[i]);
+        }
+        consumer.finish();
+        return;
+    }
 
-                for (int k = 0; k < sz; ++k) {
-                    while (int(accumulator.results[k].values.size()) <
-                           accumulator.bins) {
-                        accumulator.results[k].values.push_back(0.f);
-                    }
-                }
+    if (!file.map()) {
+        cerr << "WARNING: PluginSummarisingAdapter: Unable to read sorted values from temporary file, sorting in memory instead" << endl;
+        forEachSorted(accumulator, bin, 0, consumer);
+        return;
+    }
 
-                for (int k = 0; k < sz; ++k) {
-                    float value = accumulator.results[k].values[bin];
-                    valvec.push_back
-                        (ValueDurationFloatPair
-                         (value,
-                          float(toSec(accumulator.results[k].duration))));
-                }
+    // The last run stays in memory; merge it with the spilled ones
+    
+    vector<const SortElement *> positions, ends;
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        const SortElement *p = (const SortElement *)file.at(offsets[i]);
+        positions.push_back(p);
+        ends.push_back(p + lengths[i]);
+    }
+    if (!run.empty()) {
+        positions.push_back(run.data());
+        ends.push_back(run.data() + run.size());
+    }
 
-                sort(valvec.begin(), valvec.end());
+    auto later = [&](size_t a, size_t b) {
+        return *positions[b] < *positions[a];
+    };
+    vector<size_t> heap;
+    for (size_t i = 0; i < positions.size(); ++i) {
+        heap.push_back(i);
+    }
+    make_heap(heap.begin(), heap.end(), later);
+
+    while (!heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), later);
+        size_t i = heap.back();
+        consumer(*positions[i]);
+        if (++positions[i] == ends[i]) {
+            heap.pop_back();
+        } else {
+            push_heap(heap.begin(), heap.end(), later);
+        }
+    }
+    
+    consumer.finish();
+}
 
-                summary.minimum = valvec[0].value;
-                summary.maximum = valvec[sz-1].value;
+void
+PluginSummarisingAdapter::Impl::reduceBins(const ReduceTask &task) const
+{
+    const OutputAccumulator &accumulator = *task.accumulator;
+    double totalDuration = task.totalDuration;
+    int sz = accumulator.count;
+    int chunks = accumulator.getChunkCount();
 
-#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                cerr << "total duration = " << totalDuration << endl;
-#endif
+    vector<double> dur(chunkSize);
+    const double *d = dur.data();
+
+    for (int bin = task.startBin; bin < task.endBin; ++bin) {
+
+        // work on all values over time for a single bin
 
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-/*
-                cerr << "value vector for medians:" << endl;
-                for (int k = 0; k < sz; ++k) {
-                    cerr << "(" << valvec[k].value << "," << valvec[k].duration << ") ";
-                }
-                cerr << endl;
-*/
+        cerr << "bin " << bin << ":" << endl;
 #endif
+        
+        OutputBinSummary summary;
 
-                if (sz % 2 == 1) {
-                    summary.median = valvec[sz/2].value;
-                } else {
-                    summary.median = (valvec[sz/2].value + valvec[sz/2 + 1].value) / 2;
-                }
-            
-                double duracc = 0.0;
-                summary.median_c = valvec[sz-1].value;
+        summary.count = sz;
 
-                for (int k = 0; k < sz; ++k) {
-                    duracc += valvec[k].duration;
-                    if (duracc > totalDuration/2) {
-                        summary.median_c = valvec[k].value;
-                        break;
-                    }
-                }
+        summary.minimum = 0.f;
+        summary.maximum = 0.f;
 
-#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                cerr << "median_c = " << summary.median_c << endl;
-                cerr << "median = " << summary.median << endl;
-#endif
-                
-                map<float, int> distribution;
+        summary.median = 0.f;
+        summary.mode = 0.f;
+        summary.sum = 0.f;
+        summary.variance = 0.f;
 
-#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                cerr << "summing (discrete): ";
+        summary.median_c = 0.f;
+        summary.mode_c = 0.f;
+        summary.mean_c = 0.f;
+        summary.variance_c = 0.f;
+
+        // sums for the sample and continuous-time means, in one pass
+        // over the column
+
+        double sum = 0.0, sum_c = 0.0;
+        for (int c = 0; c < chunks; ++c) {
+            const float *values = 0;
+            int n = readChunk(accumulator, c, bin, values, dur.data());
+            for (int k = 0; k < n; ++k) {
+                sum += values[k];
+                sum_c += values[k] * d[k];
+            }
+        }
+
+        summary.sum = sum;
+
+        SortedBinSummariser sorted(sz, totalDuration);
+        forEachSorted(accumulator, bin, task.sortBudget, sorted);
+
+        summary.minimum = sorted.minimum;
+        summary.maximum = sorted.maximum;
+        summary.median = sorted.median;
+        summary.median_c = sorted.median_c;
+        summary.mode = sorted.mode;
+        summary.mode_c = sorted.mode_c;
+
+#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
+        cerr << "total duration = " << totalDuration << endl;
+        cerr << "median_c = " << summary.median_c << endl;
+        cerr << "median = " << summary.median << endl;
 #endif
-                for (int k = 0; k < sz; ++k) {
+
+        if (totalDuration > 0.0) {
+
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                    cerr << accumulator.results[k].values[bin] << " ";
+            cerr << "mean_c = " << sum_c << " / " << totalDuration << " = "
+                      << sum_c / totalDuration << " (sz = " << sz << ")" << endl;
 #endif
-                    summary.sum += accumulator.results[k].values[bin];
-                    distribution[accumulator.results[k].values[bin]] += 1;
+        
+            summary.mean_c = sum_c / totalDuration;
+
+            double variance_c = 0.0;
+            for (int c = 0; c < chunks; ++c) {
+                const float *values = 0;
+                int n = readChunk(accumulator, c, bin, values, dur.data());
+                for (int k = 0; k < n; ++k) {
+                    double dv = values[k] - summary.mean_c;
+                    variance_c += dv * dv * d[k];
                 }
+            }
+
+            summary.variance_c = variance_c / totalDuration;
+        }
+
+        double mean = summary.sum / summary.count;
+
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                cerr << endl;
+        cerr << "mean = " << summary.sum << " / " << summary.count << " = "
+                  << summary.sum / summary.count << endl;
 #endif
 
-                int md = 0;
+        double variance = 0.0;
+        for (int c = 0; c < chunks; ++c) {
+            const float *values = 0;
+            int n = readChunk(accumulator, c, bin, values, dur.data());
+            for (int k = 0; k < n; ++k) {
+                double dv = values[k] - mean;
+                variance += dv * dv;
+            }
+        }
+        summary.variance = variance / summary.count;
+
+        // (find rather than operator[], which may not be called
+        // concurrently on a map)
+        task.summary->find(bin)->second = summary;
+    }
+}
 
-                for (map<float, int>::iterator di = distribution.begin();
-                     di != distribution.end(); ++di) {
-                    if (di->second > md) {
-                        md = di->second;
-                        summary.mode = di->first;
-                    }
-                }
+void
+PluginSummarisingAdapter::Impl::reduce()
+{
+    m_store.prepareForReading();
+    
+    // Set up all of the work first, creating every summary that will
+    // be written so that the tasks never modify the maps themselves
 
-                distribution.clear();
+    vector<ReduceTask> tasks;
 
-                map<float, double> distribution_c;
+    int segmentCount = 0;
+    for (OutputSegmentAccumulatorMap::const_iterator i =
+             m_segmentedAccumulators.begin();
+         i != m_segmentedAccumulators.end(); ++i) {
+        segmentCount += int(i->second.size());
+    }
 
-                for (int k = 0; k < sz; ++k) {
-                    distribution_c[accumulator.results[k].values[bin]]
-                        += toSec(accumulator.results[k].duration);
-                }
+    // Aim for a few tasks per thread, so that outputs and segments of
+    // different sizes still balance out
+    int concurrency = int(m_scheduler->getConcurrency());
+    int targetTasks = concurrency * 4;
+    int tasksPerSegment = 1;
+    if (segmentCount > 0 && targetTasks > segmentCount) {
+        tasksPerSegment = targetTasks / segmentCount;
+    }
 
-                double mrd = 0.0;
+    // Tasks running at once share the memory budget for sorting
+    size_t sortBudget = m_store.getBudget() / max(concurrency, 1);
 
-                for (map<float, double>::iterator di = distribution_c.begin();
-                     di != distribution_c.end(); ++di) {
-                    if (di->second > mrd) {
-#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                        cerr << "element " << di->first << " spans time "
-                             << di->second << " and so is an improved mode "
-                             << "candidate over element " << summary.mode_c
-                             << " which spanned " << mrd << endl;
-#endif
-                        mrd = di->second;
-                        summary.mode_c = di->first;
-                    }
-                }
+    for (OutputSegmentAccumulatorMap::iterator i =
+             m_segmentedAccumulators.begin();
+         i != m_segmentedAccumulators.end(); ++i) {
+
+        int output = i->first;
+        SegmentAccumulatorMap &segments = i->second;
 
-                distribution_c.clear();
+        for (SegmentAccumulatorMap::iterator j = segments.begin();
+             j != segments.end(); ++j) {
 
-                if (totalDuration > 0.0) {
+            RealTime segmentStart = j->first;
+            const OutputAccumulator &accumulator = j->second;
 
-                    double sum_c = 0.0;
+            int sz = accumulator.count;
 
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                    cerr << "summing (continuous): ";
+            cerr << "reduce: segment starting at " << segmentStart
+                      << " on output " << output << " has " << sz << " result(s)" << endl;
 #endif
-                    for (int k = 0; k < sz; ++k) {
+
+            if (sz == 0 || accumulator.bins == 0) continue;
+
+            double totalDuration = 0.0;
+            //!!! is this right?
 #ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                        cerr << accumulator.results[k].values[bin] << "*"
-                             << toSec(accumulator.results[k].duration) << " ";
+            cerr << "last result ends at " << accumulator.getLastEnd(m_store)
+                      << " (step = " << m_stepSize << ", block = " << m_blockSize << ")"
+                      << endl;
 #endif
-                        double value = accumulator.results[k].values[bin]
-                            * toSec(accumulator.results[k].duration);
-                        sum_c += value;
+            totalDuration = toSec(accumulator.getLastEnd(m_store) -
+                                  segmentStart);
+
+            OutputSummary &summary = m_summaries[output][segmentStart];
+            for (int bin = 0; bin < accumulator.bins; ++bin) {
+                summary[bin] = OutputBinSummary();
+            }
+
+            int binsPerTask =
+                (accumulator.bins + tasksPerSegment - 1) / tasksPerSegment;
+
+            for (int bin = 0; bin < accumulator.bins; bin += binsPerTask) {
+                ReduceTask task;
+                task.accumulator = &accumulator;
+                task.totalDuration = totalDuration;
+                task.sortBudget = sortBudget;
+                task.summary = &summary;
+                task.startBin = bin;
+                task.endBin = min(bin + binsPerTask, accumulator.bins);
+                tasks.push_back(task);
+            }
+        }
+    }
+
+    m_scheduler->parallelFor(tasks.size(), [&](size_t i) {
+        reduceBins(tasks[i]);
+    });
+
+    // The segmented accumulators are kept for getSummaryState()
+    m_accumulators.clear();
+}
+
+void
+PluginSummarisingAdapter::Impl::summarise()
+{
+    if (!m_reduced) {
+        accumulateFinalDurations();
+        m_store.prepareForReading();
+        segment();
+        reduce();
+        m_reduced = true;
+    }
+}
+
+void
+PluginSummarisingAdapter::Impl::getSummaryState(SummaryState::Impl &state)
+{
+    summarise();
+
+    typedef SummaryState::Impl S;
+    
+    state.outputs.clear();
+    state.endTime = m_endTime;
+
+    vector<double> dur(chunkSize);
+    const double *d = dur.data();
+    
+    for (OutputSegmentAccumulatorMap::const_iterator i =
+             m_segmentedAccumulators.begin();
+         i != m_segmentedAccumulators.end(); ++i) {
+
+        for (SegmentAccumulatorMap::const_iterator j = i->second.begin();
+             j != i->second.end(); ++j) {
+
+            const OutputAccumulator &accumulator = j->second;
+            int sz = accumulator.count;
+            if (sz == 0) continue;
+
+            int chunks = accumulator.getChunkCount();
+
+            S::SegmentState &segment = state.outputs[i->first][j->first];
+            segment.end = accumulator.getLastEnd(m_store);
+            segment.count = sz;
+            segment.weight = 0.0;
+            segment.bins.resize(accumulator.bins);
+
+            for (int c = 0; c < chunks; ++c) {
+                const float *values = 0;
+                int n = readChunk(accumulator, c, 0, values, dur.data());
+                for (int k = 0; k < n; ++k) {
+                    segment.weight += d[k];
+                }
+            }
+
+            for (int bin = 0; bin < accumulator.bins; ++bin) {
+
+                S::BinState &b = segment.bins[bin];
+
+                b.sum = 0.0;
+                b.sum_c = 0.0;
+                for (int c = 0; c < chunks; ++c) {
+                    const float *values = 0;
+                    int n = readChunk(accumulator, c, bin, values, dur.data());
+                    for (int k = 0; k < n; ++k) {
+                        b.sum += values[k];
+                        b.sum_c += values[k] * d[k];
                     }
-#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                cerr << endl;
-#endif
+                }
 
-#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                    cerr << "mean_c = " << sum_c << " / " << totalDuration << " = "
-                              << sum_c / totalDuration << " (sz = " << sz << ")" << endl;
-#endif
-                
-                    summary.mean_c = sum_c / totalDuration;
-
-                    for (int k = 0; k < sz; ++k) {
-                        double value = accumulator.results[k].values[bin];
-//                            * toSec(accumulator.results[k].duration);
-                        summary.variance_c +=
-                            (value - summary.mean_c) * (value - summary.mean_c)
-                            * toSec(accumulator.results[k].duration);
+                double mean = b.sum / sz;
+                double mean_c = 0.0;
+                if (segment.weight > 0.0) mean_c = b.sum_c / segment.weight;
+
+                b.m2 = 0.0;
+                b.m2_c = 0.0;
+                for (int c = 0; c < chunks; ++c) {
+                    const float *values = 0;
+                    int n = readChunk(accumulator, c, bin, values, dur.data());
+                    for (int k = 0; k < n; ++k) {
+                        double dv = values[k] - mean;
+                        b.m2 += dv * dv;
+                        double dc = values[k] - mean_c;
+                        b.m2_c += dc * dc * d[k];
                     }
+                }
+
+                SortedHistogramBuilder builder(b.histogram);
+                forEachSorted(accumulator, bin, m_store.getBudget(), builder);
+                b.minimum = builder.minimum;
+                b.maximum = builder.maximum;
+            }
+        }
+    }
+}
+
+void
+PluginSummarisingAdapter::Impl::ResultStore::retire(Chunk &chunk)
+{
+    if (m_budget == 0 || m_inMemory <= m_budget || chunk.offset >= 0) {
+        return;
+    }
+
+    // The chunk is full, so its columns are all chunkSize long
+    
+    if (!m_file) m_file = new SpillFile;
+    int64_t offset = m_file->append(chunk.times.data(),
+                                    chunkSize * sizeof(RealTime));
+    if (offset < 0 ||
+        m_file->append(chunk.durations.data(),
+                       chunkSize * sizeof(RealTime)) < 0 ||
+        (chunk.bins > 0 &&
+         m_file->append(chunk.values.data(),
+                        chunk.values.size() * sizeof(float)) < 0)) {
+        cerr << "WARNING: PluginSummarisingAdapter: Unable to write results to temporary file, keeping them in memory instead" << endl;
+        m_budget = 0;
+        return;
+    }
+
+    m_inMemory -= chunk.getMemorySize();
+    chunk.offset = offset;
+    vector<RealTime>().swap(chunk.times);
+    vector<RealTime>().swap(chunk.durations);
+    vector<float>().swap(chunk.values);
+}
+
+PluginSummarisingAdapter::SummaryState::SummaryState() :
+    m_impl(new Impl)
+{
+}
+
+PluginSummarisingAdapter::SummaryState::SummaryState(const SummaryState &other) :
+    m_impl(new Impl(*other.m_impl))
+{
+}
+
+PluginSummarisingAdapter::SummaryState &
+PluginSummarisingAdapter::SummaryState::operator=(const SummaryState &other)
+{
+    if (this != &other) {
+        *m_impl = *other.m_impl;
+    }
+    return *this;
+}
+
+PluginSummarisingAdapter::SummaryState::~SummaryState()
+{
+    delete m_impl;
+}
+
+bool
+PluginSummarisingAdapter::SummaryState::isEmpty() const
+{
+    return m_impl->outputs.empty();
+}
+
+void
+PluginSummarisingAdapter::SummaryState::merge(const SummaryState &other)
+{
+    m_impl->merge(*other.m_impl);
+}
+
+Plugin::FeatureList
+PluginSummarisingAdapter::SummaryState::getSummaryForOutput(int output,
+                                                            SummaryType type,
+                                                            AveragingMethod avg)
+    const
+{
+    return m_impl->getSummaryForOutput(output, type, avg);
+}
+
+Plugin::FeatureSet
+PluginSummarisingAdapter::SummaryState::getSummaryForAllOutputs(SummaryType type,
+                                                                AveragingMethod avg)
+    const
+{
+    FeatureSet fs;
+    for (Impl::OutputMap::const_iterator i = m_impl->outputs.begin();
+         i != m_impl->outputs.end(); ++i) {
+        FeatureList fl = m_impl->getSummaryForOutput(i->first, type, avg);
+        if (!fl.empty()) fs[i->first] = fl;
+    }
+    return fs;
+}
+
+void
+PluginSummarisingAdapter::SummaryState::serialise(StateData &data) const
+{
+    m_impl->serialise(data);
+}
+
+bool
+PluginSummarisingAdapter::SummaryState::deserialise(const StateData &data)
+{
+    if (m_impl->deserialise(data)) {
+        return true;
+    }
+    *m_impl = Impl();
+    return false;
+}
+
+void
+PluginSummarisingAdapter::SummaryState::Impl::compress(Histogram &histogram)
+{
+    // Reduce the histogram to half its maximum size by combining
+    // each run of values that are closer to their neighbours than
+    // some threshold, chosen so as to make enough combinations
+
+    if (histogram.size() <= maxHistogramSize) return;
+
+    size_t merges = histogram.size() - maxHistogramSize / 2;
+    
+    vector<float> gaps(histogram.size() - 1);
+    for (size_t i = 0; i + 1 < histogram.size(); ++i) {
+        gaps[i] = histogram[i+1].value - histogram[i].value;
+    }
+    nth_element(gaps.begin(), gaps.begin() + (merges - 1), gaps.end());
+    float threshold = gaps[merges - 1];
+
+    Histogram compressed;
+    compressed.reserve(maxHistogramSize / 2 + 1);
+
+    HistogramEntry current = histogram[0];
+    double weightedSum = double(current.value) * double(current.count);
+    
+    for (size_t i = 1; i < histogram.size(); ++i) {
+        const HistogramEntry &e = histogram[i];
+        if (merges > 0 && e.value - histogram[i-1].value <= threshold) {
+            weightedSum += double(e.value) * double(e.count);
+            current.count += e.count;
+            current.duration += e.duration;
+            --merges;
+        } else {
+            current.value = float(weightedSum / double(current.count));
+            compressed.push_back(current);
+            current = e;
+            weightedSum = double(current.value) * double(current.count);
+        }
+    }
+    current.value = float(weightedSum / double(current.count));
+    compressed.push_back(current);
+
+    histogram.swap(compressed);
+}
+
+PluginSummarisingAdapter::SummaryState::Impl::BinState
+PluginSummarisingAdapter::SummaryState::Impl::zeroBin(const SegmentState &segment)
+{
+    // The state of a bin that was absent from all of a segment's
+    // results, which the adapter would have filled in with zeros
+
+    BinState b;
+    b.minimum = 0.0;
+    b.maximum = 0.0;
+    b.sum = 0.0;
+    b.m2 = 0.0;
+    b.sum_c = 0.0;
+    b.m2_c = 0.0;
+    HistogramEntry e;
+    e.value = 0.f;
+    e.count = segment.count;
+    e.duration = segment.weight;
+    b.histogram.push_back(e);
+    return b;
+}
+
+void
+PluginSummarisingAdapter::SummaryState::Impl::mergeBin(BinState &a,
+                                                       const SegmentState &sa,
+                                                       const BinState &b,
+                                                       const SegmentState &sb)
+{
+    double na = double(sa.count), nb = double(sb.count);
+    double wa = sa.weight, wb = sb.weight;
+
+    a.minimum = min(a.minimum, b.minimum);
+    a.maximum = max(a.maximum, b.maximum);
+
+    // Chan et al's pairwise update for the sums of squared
+    // differences, in sample and duration-weighted forms
+
+    double delta = b.sum / nb - a.sum / na;
+    a.m2 += b.m2 + delta * delta * na * nb / (na + nb);
+    a.sum += b.sum;
+
+    if (wa > 0.0 && wb > 0.0) {
+        double delta_c = b.sum_c / wb - a.sum_c / wa;
+        a.m2_c += b.m2_c + delta_c * delta_c * wa * wb / (wa + wb);
+    } else {
+        a.m2_c += b.m2_c;
+    }
+    a.sum_c += b.sum_c;
+
+    Histogram merged;
+    merged.reserve(a.histogram.size() + b.histogram.size());
+    Histogram::const_iterator i = a.histogram.begin();
+    Histogram::const_iterator j = b.histogram.begin();
+    while (i != a.histogram.end() || j != b.histogram.end()) {
+        if (j == b.histogram.end() ||
+            (i != a.histogram.end() && i->value < j->value)) {
+            merged.push_back(*i++);
+        } else if (i == a.histogram.end() || j->value < i->value) {
+            merged.push_back(*j++);
+        } else {
+            HistogramEntry e = *i++;
+            e.count += j->count;
+            e.duration += j->duration;
+            ++j;
+            merged.push_back(e);
+        }
+    }
+    compress(merged);
+    a.histogram.swap(merged);
+}
+
+void
+PluginSummarisingAdapter::SummaryState::Impl::mergeSegment(SegmentState &a,
+                                                           const SegmentState &b)
+{
+    size_t bins = max(a.bins.size(), b.bins.size());
+    
+    while (a.bins.size() < bins) {
+        a.bins.push_back(zeroBin(a));
+    }
+
+    for (size_t bin = 0; bin < bins; ++bin) {
+        if (bin < b.bins.size()) {
+            mergeBin(a.bins[bin], a, b.bins[bin], b);
+        } else {
+            mergeBin(a.bins[bin], a, zeroBin(b), b);
+        }
+    }
+
+    if (b.end > a.end) a.end = b.end;
+    a.count += b.count;
+    a.weight += b.weight;
+}
+
+void
+PluginSummarisingAdapter::SummaryState::Impl::merge(const Impl &other)
+{
+    for (OutputMap::const_iterator i = other.outputs.begin();
+         i != other.outputs.end(); ++i) {
+        SegmentMap &segments = outputs[i->first];
+        for (SegmentMap::const_iterator j = i->second.begin();
+             j != i->second.end(); ++j) {
+            SegmentMap::iterator k = segments.find(j->first);
+            if (k == segments.end()) {
+                segments[j->first] = j->second;
+            } else {
+                mergeSegment(k->second, j->second);
+            }
+        }
+    }
+
+    if (other.endTime > endTime) endTime = other.endTime;
+}
+
+double
+PluginSummarisingAdapter::SummaryState::Impl::getValue(const SegmentState &segment,
+                                                       int bin,
+                                                       RealTime start,
+                                                       SummaryType type,
+                                                       AveragingMethod avg)
+{
+    // These follow the calculations in the adapter's reduce(),
+    // including its choice of elements for an even-sized median
+
+    const BinState &b = segment.bins[bin];
+    const Histogram &h = b.histogram;
+    
+    bool continuous = (avg == ContinuousTimeAverage);
+    double count = double(segment.count);
+    double totalDuration = toSec(segment.end - start);
+
+    double mean_c = 0.0, variance_c = 0.0;
+    if (totalDuration > 0.0) {
+        mean_c = b.sum_c / totalDuration;
+        if (segment.weight > 0.0) {
+            double d = b.sum_c / segment.weight - mean_c;
+            variance_c = (b.m2_c + segment.weight * d * d) / totalDuration;
+        }
+    }
+
+    switch (type) {
 
-//                    summary.variance_c /= summary.count;
-                    summary.variance_c /= totalDuration;
+    case Minimum:
+        return b.minimum;
+
+    case Maximum:
+        return b.maximum;
+
+    case Mean:
+        if (continuous) return mean_c;
+        return b.sum / count;
+
+    case Median:
+        if (continuous) {
+            double duracc = 0.0;
+            for (size_t i = 0; i < h.size(); ++i) {
+                duracc += h[i].duration;
+                if (duracc > totalDuration/2) return h[i].value;
+            }
+            return h.empty() ? 0.0 : h[h.size()-1].value;
+        } else {
+            int64_t n = segment.count;
+            int64_t r0 = n/2, r1 = min(n/2 + 1, n - 1);
+            float v0 = 0.f, v1 = 0.f;
+            int64_t acc = 0;
+            for (size_t i = 0; i < h.size(); ++i) {
+                int64_t next = acc + h[i].count;
+                if (r0 >= acc && r0 < next) v0 = h[i].value;
+                if (r1 >= acc && r1 < next) v1 = h[i].value;
+                acc = next;
+            }
+            if (n % 2 == 1) return v0;
+            return (v0 + v1) / 2;
+        }
+
+    case Mode:
+        if (continuous) {
+            double mrd = 0.0, mode = 0.0;
+            for (size_t i = 0; i < h.size(); ++i) {
+                if (h[i].duration > mrd) {
+                    mrd = h[i].duration;
+                    mode = h[i].value;
                 }
+            }
+            return mode;
+        } else {
+            int64_t md = 0;
+            double mode = 0.0;
+            for (size_t i = 0; i < h.size(); ++i) {
+                if (h[i].count > md) {
+                    md = h[i].count;
+                    mode = h[i].value;
+                }
+            }
+            return mode;
+        }
 
-                double mean = summary.sum / summary.count;
+    case Sum:
+        return b.sum;
 
-#ifdef DEBUG_PLUGIN_SUMMARISING_ADAPTER
-                cerr << "mean = " << summary.sum << " / " << summary.count << " = "
-                          << summary.sum / summary.count << endl;
-#endif
+    case Variance:
+        if (continuous) return variance_c;
+        return b.m2 / count;
+
+    case StandardDeviation:
+        if (continuous) return sqrt(variance_c);
+        return sqrt(b.m2 / count);
+
+    case Count:
+        return count;
+
+    case UnknownSummaryType:
+    default:
+        return 0.0;
+    }
+}
+
+Plugin::FeatureList
+PluginSummarisingAdapter::SummaryState::Impl::getSummaryForOutput(int output,
+                                                                  SummaryType type,
+                                                                  AveragingMethod avg)
+    const
+{
+    FeatureList fl;
+
+    OutputMap::const_iterator oi = outputs.find(output);
+    if (oi == outputs.end()) return fl;
+
+    // As in the adapter, segments with no bins produce no summary
+    // and do not count when finding the duration of the previous one
+
+    vector<SegmentMap::const_iterator> segments;
+    for (SegmentMap::const_iterator i = oi->second.begin();
+         i != oi->second.end(); ++i) {
+        if (!i->second.bins.empty()) segments.push_back(i);
+    }
+
+    for (size_t s = 0; s < segments.size(); ++s) {
+
+        Feature f;
+
+        f.hasTimestamp = true;
+        f.timestamp = segments[s]->first;
+
+        f.hasDuration = true;
+        if (s + 1 == segments.size()) {
+            f.duration = endTime - f.timestamp;
+        } else {
+            f.duration = segments[s+1]->first - f.timestamp;
+        }
+
+        f.label = PluginSummarisingAdapter::Impl::getSummaryLabel(type, avg);
+
+        const SegmentState &segment = segments[s]->second;
+        for (int bin = 0; bin < int(segment.bins.size()); ++bin) {
+            f.values.push_back(float(getValue(segment, bin, f.timestamp,
+                                              type, avg)));
+        }
+
+        fl.push_back(f);
+    }
+
+    return fl;
+}
+
+static const uint32_t summaryStateMagic = 0x56534d53; // "VSMS"
+static const uint32_t summaryStateVersion = 1;
 
-                for (int k = 0; k < sz; ++k) {
-                    float value = accumulator.results[k].values[bin];
-                    summary.variance += (value - mean) * (value - mean);
+void
+PluginSummarisingAdapter::SummaryState::Impl::serialise(StateData &data) const
+{
+    StateWriter writer(data);
+
+    writer.put(summaryStateMagic);
+    writer.put(summaryStateVersion);
+    writer.put(int32_t(endTime.sec));
+    writer.put(int32_t(endTime.nsec));
+    
+    writer.put(uint32_t(outputs.size()));
+    
+    for (OutputMap::const_iterator i = outputs.begin();
+         i != outputs.end(); ++i) {
+
+        writer.put(int32_t(i->first));
+        writer.put(uint32_t(i->second.size()));
+
+        for (SegmentMap::const_iterator j = i->second.begin();
+             j != i->second.end(); ++j) {
+
+            const SegmentState &segment = j->second;
+            writer.put(int32_t(j->first.sec));
+            writer.put(int32_t(j->first.nsec));
+            writer.put(int32_t(segment.end.sec));
+            writer.put(int32_t(segment.end.nsec));
+            writer.put(segment.count);
+            writer.put(segment.weight);
+            writer.put(uint32_t(segment.bins.size()));
+
+            for (size_t bin = 0; bin < segment.bins.size(); ++bin) {
+                const BinState &b = segment.bins[bin];
+                writer.put(b.minimum);
+                writer.put(b.maximum);
+                writer.put(b.sum);
+                writer.put(b.m2);
+                writer.put(b.sum_c);
+                writer.put(b.m2_c);
+                writer.put(uint32_t(b.histogram.size()));
+                for (size_t k = 0; k < b.histogram.size(); ++k) {
+                    writer.put(b.histogram[k].value);
+                    writer.put(b.histogram[k].count);
+                    writer.put(b.histogram[k].duration);
                 }
-                summary.variance /= summary.count;
+            }
+        }
+    }
+}
 
-                m_summaries[output][segmentStart][bin] = summary;
+static bool
+getRealTime(StateReader &reader, RealTime &rt)
+{
+    int32_t sec = 0, nsec = 0;
+    if (!reader.get(sec) || !reader.get(nsec)) return false;
+    rt = RealTime(sec, nsec);
+    return true;
+}
+
+bool
+PluginSummarisingAdapter::SummaryState::Impl::deserialise(const StateData &data)
+{
+    // Containers are filled one element at a time rather than sized
+    // up front, so that a corrupt count cannot cause a huge
+    // allocation before the data runs out
+    
+    StateReader reader(data);
+    
+    outputs.clear();
+    endTime = RealTime::zeroTime;
+
+    uint32_t magic = 0, version = 0;
+    if (!reader.get(magic) || magic != summaryStateMagic) {
+        cerr << "PluginSummarisingAdapter::SummaryState::deserialise: Not a summary state, or written on a machine with different byte order" << endl;
+        return false;
+    }
+    if (!reader.get(version) || version != summaryStateVersion) {
+        cerr << "PluginSummarisingAdapter::SummaryState::deserialise: Unsupported version " << version << endl;
+        return false;
+    }
+
+    uint32_t outputCount = 0;
+    if (!getRealTime(reader, endTime) || !reader.get(outputCount)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < outputCount; ++i) {
+
+        int32_t output = 0;
+        uint32_t segmentCount = 0;
+        if (!reader.get(output) || !reader.get(segmentCount)) return false;
+
+        SegmentMap &segments = outputs[output];
+        
+        for (uint32_t j = 0; j < segmentCount; ++j) {
+
+            RealTime start;
+            SegmentState segment;
+            uint32_t binCount = 0;
+            if (!getRealTime(reader, start) ||
+                !getRealTime(reader, segment.end) ||
+                !reader.get(segment.count) ||
+                !reader.get(segment.weight) ||
+                !reader.get(binCount)) {
+                return false;
             }
+            if (segment.count <= 0) return false;
+
+            for (uint32_t bin = 0; bin < binCount; ++bin) {
+                BinState b;
+                uint32_t entryCount = 0;
+                if (!reader.get(b.minimum) || !reader.get(b.maximum) ||
+                    !reader.get(b.sum) || !reader.get(b.m2) ||
+                    !reader.get(b.sum_c) || !reader.get(b.m2_c) ||
+                    !reader.get(entryCount)) {
+                    return false;
+                }
+                for (uint32_t k = 0; k < entryCount; ++k) {
+                    HistogramEntry e;
+                    if (!reader.get(e.value) || !reader.get(e.count) ||
+                        !reader.get(e.duration)) {
+                        return false;
+                    }
+                    b.histogram.push_back(e);
+                }
+                segment.bins.push_back(b);
+            }
+
+            segments[start] = segment;
         }
     }
 
-    m_segmentedAccumulators.clear();
-    m_accumulators.clear();
+    return reader.atEnd();
 }
 
 
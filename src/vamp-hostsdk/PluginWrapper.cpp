@@ -35,6 +35,7 @@
 */
 
 #include <vamp-hostsdk/PluginWrapper.h>
+#include <vamp-hostsdk/FeatureSink.h>
 
 _VAMP_SDK_HOSTSPACE_BEGIN(PluginWrapper.cpp)
 
@@ -187,6 +188,42 @@ PluginWrapper::getOutputDescriptors() const
     return m_plugin->getOutputDescriptors();
 }
 
+Plugin::StateDependency
+PluginWrapper::getStateDependency() const
+{
+    return m_plugin->getStateDependency();
+}
+
+size_t
+PluginWrapper::getWarmUpBlockCount() const
+{
+    return m_plugin->getWarmUpBlockCount();
+}
+
+bool
+PluginWrapper::getState(StateData &state) const
+{
+    return m_plugin->getState(state);
+}
+
+bool
+PluginWrapper::setState(const StateData &state)
+{
+    return m_plugin->setState(state);
+}
+
+void
+PluginWrapper::setTaskScheduler(TaskScheduler *scheduler)
+{
+    m_plugin->setTaskScheduler(scheduler);
+}
+
+void
+PluginWrapper::setEnabledOutputs(const std::vector<bool> &enabled)
+{
+    m_plugin->setEnabledOutputs(enabled);
+}
+
 Plugin::FeatureSet
 PluginWrapper::process(const float *const *inputBuffers, RealTime timestamp)
 {
@@ -199,6 +236,20 @@ PluginWrapper::getRemainingFeatures()
     return m_plugin->getRemainingFeatures();
 }
 
+void
+PluginWrapper::processInto(const float *const *inputBuffers,
+                           RealTime timestamp,
+                           FeatureSink &sink)
+{
+    sink.pushAll(process(inputBuffers, timestamp));
+}
+
+void
+PluginWrapper::getRemainingFeaturesInto(FeatureSink &sink)
+{
+    sink.pushAll(getRemainingFeatures());
+}
+
 }
 
 }
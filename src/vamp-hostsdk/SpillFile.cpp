@@ -0,0 +1,212 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#include "SpillFile.h"
+#include "Files.h"
+
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#else /* ! _WIN32 */
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#endif /* ! _WIN32 */
+
+using namespace std;
+
+SpillFile::SpillFile() :
+    m_handle(0),
+    m_mappingHandle(0),
+    m_fd(-1),
+    m_size(0),
+    m_mapping(0),
+    m_mappedSize(0)
+{
+}
+
+SpillFile::~SpillFile()
+{
+    unmap();
+#ifdef _WIN32
+    if (m_handle) CloseHandle((HANDLE)m_handle);
+#else
+    if (m_fd >= 0) ::close(m_fd);
+#endif
+}
+
+bool
+SpillFile::create()
+{
+#ifdef _WIN32
+    char dir[MAX_PATH + 1];
+    char path[MAX_PATH + 1];
+    if (!GetTempPathA(sizeof(dir), dir) ||
+        !GetTempFileNameA(dir, "vmp", 0, path)) {
+        cerr << "Vamp::HostExt: Unable to find a name for temporary file: error code " << GetLastError() << endl;
+        return false;
+    }
+    HANDLE h = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, 0,
+                           CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_TEMPORARY |
+                           FILE_FLAG_DELETE_ON_CLOSE, 0);
+    if (h == INVALID_HANDLE_VALUE) {
+        cerr << "Vamp::HostExt: Unable to create temporary file \""
+             << path << "\": error code " << GetLastError() << endl;
+        return false;
+    }
+    m_handle = h;
+#else
+    string dir;
+    if (!Files::getEnvUtf8("TMPDIR", dir) || dir == "") {
+        dir = "/tmp";
+    }
+    string path = Files::splicePath(dir, "vamp-spill-XXXXXX");
+    char *buffer = new char[path.length() + 1];
+    strcpy(buffer, path.c_str());
+    m_fd = mkstemp(buffer);
+    if (m_fd < 0) {
+        cerr << "Vamp::HostExt: Unable to create temporary file \""
+             << buffer << "\": " << strerror(errno) << endl;
+        delete[] buffer;
+        return false;
+    }
+    // remove the name at once, so that the file goes away with us
+    unlink(buffer);
+    delete[] buffer;
+#endif
+    return true;
+}
+
+int64_t
+SpillFile::append(const void *data, size_t bytes)
+{
+#ifdef _WIN32
+    if (!m_handle && !create()) return -1;
+#else
+    if (m_fd < 0 && !create()) return -1;
+#endif
+
+    int64_t offset = m_size;
+    const char *p = (const char *)data;
+    
+    while (bytes > 0) {
+#ifdef _WIN32
+        DWORD toWrite = DWORD(bytes > 0x40000000 ? 0x40000000 : bytes);
+        DWORD written = 0;
+        LARGE_INTEGER pos;
+        pos.QuadPart = m_size;
+        if (!SetFilePointerEx((HANDLE)m_handle, pos, 0, FILE_BEGIN) ||
+            !WriteFile((HANDLE)m_handle, p, toWrite, &written, 0) ||
+            written == 0) {
+            cerr << "Vamp::HostExt: Failed to write to temporary file: error code " << GetLastError() << endl;
+            return -1;
+        }
+#else
+        ssize_t written = ::pwrite(m_fd, p, bytes, off_t(m_size));
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+            cerr << "Vamp::HostExt: Failed to write to temporary file: "
+                 << strerror(errno) << endl;
+            return -1;
+        }
+#endif
+        p += written;
+        bytes -= size_t(written);
+        m_size += written;
+    }
+
+    return offset;
+}
+
+bool
+SpillFile::map()
+{
+    unmap();
+
+    if (m_size == 0) return true;
+
+#ifdef _WIN32
+    HANDLE mh = CreateFileMappingA((HANDLE)m_handle, 0, PAGE_READONLY,
+                                   0, 0, 0);
+    if (!mh) {
+        cerr << "Vamp::HostExt: Failed to map temporary file: error code " << GetLastError() << endl;
+        return false;
+    }
+    void *view = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        cerr << "Vamp::HostExt: Failed to map temporary file: error code " << GetLastError() << endl;
+        CloseHandle(mh);
+        return false;
+    }
+    m_mappingHandle = mh;
+    m_mapping = (const char *)view;
+#else
+    void *view = mmap(0, size_t(m_size), PROT_READ, MAP_SHARED, m_fd, 0);
+    if (view == MAP_FAILED) {
+        cerr << "Vamp::HostExt: Failed to map temporary file: "
+             << strerror(errno) << endl;
+        return false;
+    }
+    m_mapping = (const char *)view;
+#endif
+
+    m_mappedSize = m_size;
+    return true;
+}
+
+void
+SpillFile::unmap()
+{
+    if (!m_mapping) return;
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)m_mapping);
+    CloseHandle((HANDLE)m_mappingHandle);
+    m_mappingHandle = 0;
+#else
+    munmap((void *)m_mapping, size_t(m_mappedSize));
+#endif
+    m_mapping = 0;
+    m_mappedSize = 0;
+}
@@ -0,0 +1,96 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#ifndef VAMP_SPILL_FILE_H
+#define VAMP_SPILL_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * This is a private implementation class for the Vamp Host SDK.
+ *
+ * An anonymous temporary file that data can be appended to and then
+ * read back through a memory mapping. The file is created in the
+ * directory named by TMPDIR (or the system temporary directory on
+ * Windows) on the first append, and is removed when the object is
+ * deleted or, on most platforms, when the process exits.
+ */
+class SpillFile
+{
+public:
+    SpillFile();
+    ~SpillFile();
+
+    /**
+     * Append the given data to the file, returning the offset at
+     * which it was written, or -1 on failure.
+     */
+    int64_t append(const void *data, size_t bytes);
+
+    /**
+     * Map everything appended so far for reading, replacing any
+     * earlier mapping. Pointers obtained from at() before this call
+     * are no longer valid after it. Return false on failure.
+     */
+    bool map();
+
+    /**
+     * Return a pointer to the data at the given offset, which must
+     * lie within the region mapped by the last call to map().
+     */
+    const char *at(int64_t offset) const {
+        return m_mapping + offset;
+    }
+
+    int64_t getSize() const { return m_size; }
+
+private:
+    SpillFile(const SpillFile &); // not provided
+    SpillFile &operator=(const SpillFile &); // not provided
+
+    bool create();
+    void unmap();
+
+    void *m_handle;
+    void *m_mappingHandle;
+    int m_fd;
+    int64_t m_size;
+    const char *m_mapping;
+    int64_t m_mappedSize;
+};
+
+#endif
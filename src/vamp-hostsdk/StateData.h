@@ -0,0 +1,137 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#ifndef _VAMP_STATE_DATA_H_
+#define _VAMP_STATE_DATA_H_
+
+#include <vamp-hostsdk/hostguard.h>
+#include <vamp-hostsdk/Plugin.h>
+
+#include <cstring>
+
+_VAMP_SDK_HOSTSPACE_BEGIN(StateData.h)
+
+namespace Vamp {
+
+namespace HostExt {
+
+/**
+ * Private helpers for adapters that need to save their own state
+ * alongside that of the plugin they wrap. Values are written in the
+ * machine's native representation, as plugin state snapshots are not
+ * required to be portable between platforms.
+ */
+class StateWriter
+{
+public:
+    StateWriter(Plugin::StateData &data) : m_data(data) {
+        m_data.clear();
+    }
+
+    template <typename T>
+    void put(const T &value) {
+        write(&value, sizeof(T));
+    }
+
+    void putFloats(const float *values, size_t count) {
+        put(count);
+        write(values, count * sizeof(float));
+    }
+
+    void putData(const Plugin::StateData &data) {
+        put(data.size());
+        if (!data.empty()) write(&data[0], data.size());
+    }
+
+private:
+    void write(const void *p, size_t n) {
+        if (n == 0) return;
+        size_t sz = m_data.size();
+        m_data.resize(sz + n);
+        memcpy(&m_data[sz], p, n);
+    }
+    
+    Plugin::StateData &m_data;
+};
+
+class StateReader
+{
+public:
+    StateReader(const Plugin::StateData &data) : m_data(data), m_pos(0) { }
+
+    template <typename T>
+    bool get(T &value) {
+        return read(&value, sizeof(T));
+    }
+
+    bool getFloats(std::vector<float> &values) {
+        size_t n = 0;
+        if (!get(n) || n > (m_data.size() - m_pos) / sizeof(float)) {
+            return false;
+        }
+        values.resize(n);
+        return read(n ? &values[0] : 0, n * sizeof(float));
+    }
+
+    bool getData(Plugin::StateData &data) {
+        size_t n = 0;
+        if (!get(n) || n > m_data.size() - m_pos) return false;
+        data.assign(m_data.begin() + m_pos, m_data.begin() + m_pos + n);
+        m_pos += n;
+        return true;
+    }
+
+    bool atEnd() const { return m_pos == m_data.size(); }
+
+private:
+    bool read(void *p, size_t n) {
+        if (n > m_data.size() - m_pos) return false;
+        if (n > 0) memcpy(p, &m_data[m_pos], n);
+        m_pos += n;
+        return true;
+    }
+    
+    const Plugin::StateData &m_data;
+    size_t m_pos;
+};
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(StateData.h)
+
+#endif
@@ -0,0 +1,284 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+#include <vamp-hostsdk/ThreadPoolScheduler.h>
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+using namespace std;
+
+_VAMP_SDK_HOSTSPACE_BEGIN(ThreadPoolScheduler.cpp)
+
+namespace Vamp {
+
+namespace HostExt {
+
+class ThreadPoolScheduler::Impl
+{
+public:
+    Impl(size_t threads);
+    ~Impl();
+
+    Task submit(function<void()> task);
+    void wait(Task task);
+    void parallelFor(size_t count, function<void(size_t)> body);
+    size_t getConcurrency() const { return m_threads.size(); }
+
+protected:
+    enum JobState { Queued, Running, Done };
+
+    struct Job {
+        function<void()> task;
+        JobState state;
+        exception_ptr error;
+    };
+
+    mutex m_mutex;
+    condition_variable m_available;
+    condition_variable m_finished;
+    deque<Job *> m_queue;
+    vector<thread> m_threads;
+    bool m_exiting;
+
+    void work();
+    void run(Job *job);
+};
+
+ThreadPoolScheduler::ThreadPoolScheduler(size_t threads) :
+    m_impl(new Impl(threads))
+{
+}
+
+ThreadPoolScheduler::~ThreadPoolScheduler()
+{
+    delete m_impl;
+}
+
+TaskScheduler::Task
+ThreadPoolScheduler::submit(function<void()> task)
+{
+    return m_impl->submit(task);
+}
+
+void
+ThreadPoolScheduler::wait(Task task)
+{
+    m_impl->wait(task);
+}
+
+void
+ThreadPoolScheduler::parallelFor(size_t count, function<void(size_t)> body)
+{
+    m_impl->parallelFor(count, body);
+}
+
+size_t
+ThreadPoolScheduler::getConcurrency() const
+{
+    return m_impl->getConcurrency();
+}
+
+ThreadPoolScheduler::Impl::Impl(size_t threads) :
+    m_exiting(false)
+{
+    if (threads == 0) threads = thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    for (size_t i = 0; i < threads; ++i) {
+        m_threads.push_back(thread([this]() { work(); }));
+    }
+}
+
+ThreadPoolScheduler::Impl::~Impl()
+{
+    {
+        lock_guard<mutex> guard(m_mutex);
+        m_exiting = true;
+    }
+    m_available.notify_all();
+    for (size_t i = 0; i < m_threads.size(); ++i) {
+        m_threads[i].join();
+    }
+    // Only tasks that were never waited for can remain
+    for (size_t i = 0; i < m_queue.size(); ++i) {
+        delete m_queue[i];
+    }
+}
+
+void
+ThreadPoolScheduler::Impl::work()
+{
+    unique_lock<mutex> lock(m_mutex);
+    while (true) {
+        while (!m_exiting && m_queue.empty()) {
+            m_available.wait(lock);
+        }
+        if (m_exiting) return;
+        Job *job = m_queue.front();
+        m_queue.pop_front();
+        job->state = Running;
+        lock.unlock();
+        run(job);
+        lock.lock();
+    }
+}
+
+void
+ThreadPoolScheduler::Impl::run(Job *job)
+{
+    exception_ptr error;
+    try {
+        job->task();
+    } catch (...) {
+        error = current_exception();
+    }
+    {
+        lock_guard<mutex> guard(m_mutex);
+        job->error = error;
+        job->state = Done;
+    }
+    m_finished.notify_all();
+}
+
+TaskScheduler::Task
+ThreadPoolScheduler::Impl::submit(function<void()> task)
+{
+    Job *job = new Job;
+    job->task = task;
+    job->state = Queued;
+    {
+        lock_guard<mutex> guard(m_mutex);
+        m_queue.push_back(job);
+    }
+    m_available.notify_one();
+    return job;
+}
+
+void
+ThreadPoolScheduler::Impl::wait(Task task)
+{
+    if (!task) return;
+    Job *job = (Job *)task;
+
+    unique_lock<mutex> lock(m_mutex);
+
+    // A task that no pool thread has picked up yet is run here
+    // instead, so that a waiting thread never sits idle on work
+    // that may be queued behind its own caller
+    if (job->state == Queued) {
+        deque<Job *>::iterator i = find(m_queue.begin(), m_queue.end(), job);
+        if (i != m_queue.end()) m_queue.erase(i);
+        job->state = Running;
+        lock.unlock();
+        run(job);
+        lock.lock();
+    }
+
+    while (job->state != Done) {
+        m_finished.wait(lock);
+    }
+
+    exception_ptr error = job->error;
+    delete job;
+    lock.unlock();
+
+    if (error) rethrow_exception(error);
+}
+
+void
+ThreadPoolScheduler::Impl::parallelFor(size_t count,
+                                       function<void(size_t)> body)
+{
+    size_t helpers = min(count, getConcurrency());
+    if (helpers > 0) --helpers;
+
+    if (helpers == 0) {
+        for (size_t i = 0; i < count; ++i) body(i);
+        return;
+    }
+
+    // The calling thread and the helper tasks all take indices from
+    // the same counter until none remain
+    atomic<size_t> next(0);
+    atomic<bool> failed(false);
+
+    auto loop = [&]() {
+        size_t i;
+        while (!failed && (i = next++) < count) {
+            try {
+                body(i);
+            } catch (...) {
+                failed = true;
+                throw;
+            }
+        }
+    };
+
+    vector<Task> tasks;
+    for (size_t h = 0; h < helpers; ++h) {
+        tasks.push_back(submit(loop));
+    }
+
+    exception_ptr error;
+    try {
+        loop();
+    } catch (...) {
+        error = current_exception();
+    }
+
+    for (size_t h = 0; h < tasks.size(); ++h) {
+        try {
+            wait(tasks[h]);
+        } catch (...) {
+            if (!error) error = current_exception();
+        }
+    }
+
+    if (error) rethrow_exception(error);
+}
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(ThreadPoolScheduler.cpp)
@@ -35,9 +35,12 @@
 */
 
 #include <vamp-sdk/PluginAdapter.h>
+#include <vamp-sdk/Trace.h>
 
 #include <cstring>
 #include <cstdlib>
+#include <climits>
+#include <cstddef>
 
 #include <mutex>
 
@@ -59,6 +62,79 @@ _VAMP_SDK_PLUGSPACE_BEGIN(PluginAdapter.cpp)
 
 namespace Vamp {
 
+// TaskScheduler implementation that passes tasks to a host-supplied
+// VampTaskScheduler, running them on the calling thread instead if
+// the host does not accept them
+class HostTaskScheduler : public TaskScheduler
+{
+public:
+    HostTaskScheduler(const VampTaskScheduler *scheduler) {
+        // Copy only as much as the host knows about, leaving any
+        // later fields NULL
+        size_t size = scheduler->schedulerSize;
+        if (size > sizeof(m_scheduler)) size = sizeof(m_scheduler);
+        memset(&m_scheduler, 0, sizeof(m_scheduler));
+        memcpy(&m_scheduler, scheduler, size);
+        if (!m_scheduler.wait) m_scheduler.submit = 0;
+    }
+
+    Task submit(std::function<void()> task) {
+        std::function<void()> *f = new std::function<void()>(task);
+        void *t = 0;
+        if (m_scheduler.submit) {
+            t = m_scheduler.submit(m_scheduler.context, runTask, f);
+        }
+        if (!t) runTask(f);
+        return t;
+    }
+
+    void wait(Task task) {
+        if (task) m_scheduler.wait(m_scheduler.context, task);
+    }
+
+    void parallelFor(size_t count, std::function<void(size_t)> body) {
+        if (!m_scheduler.parallelFor) {
+            for (size_t i = 0; i < count; ++i) body(i);
+            return;
+        }
+        Range range;
+        range.body = &body;
+        range.base = 0;
+        while (range.base < count) {
+            size_t n = count - range.base;
+            if (n > UINT_MAX) n = UINT_MAX;
+            m_scheduler.parallelFor(m_scheduler.context, (unsigned int)n,
+                                    runRange, &range);
+            range.base += n;
+        }
+    }
+
+    size_t getConcurrency() const {
+        if (!m_scheduler.getConcurrency) return 1;
+        size_t n = m_scheduler.getConcurrency(m_scheduler.context);
+        return n > 0 ? n : 1;
+    }
+
+private:
+    VampTaskScheduler m_scheduler;
+
+    struct Range {
+        std::function<void(size_t)> *body;
+        size_t base;
+    };
+
+    static void runTask(void *arg) {
+        std::function<void()> *f = (std::function<void()> *)arg;
+        (*f)();
+        delete f;
+    }
+
+    static void runRange(void *arg, unsigned int index) {
+        Range *range = (Range *)arg;
+        (*range->body)(range->base + index);
+    }
+};
+
 class PluginAdapterBase::Impl
 {
 public:
@@ -67,7 +143,13 @@ public:
 
     const VampPluginDescriptor *getDescriptor();
 
+    static const VampPluginExtensions *getExtensions
+    (const VampPluginDescriptor *desc);
+
 protected:
+    static VampStateDependency vampGetStateDependency
+    (const VampPluginDescriptor *desc, unsigned int *warmUpBlocks);
+
     PluginAdapterBase *m_base;
 
     static VampPluginHandle vampInstantiate(const VampPluginDescriptor *desc,
@@ -107,24 +189,105 @@ protected:
 
     static void vampReleaseFeatureSet(VampFeatureList *fs);
 
+    static size_t vampProcessToBuffer(VampPluginHandle handle,
+                                      const float *const *inputBuffers,
+                                      int sec,
+                                      int nsec,
+                                      void *buffer,
+                                      size_t bufferSize);
+
+    static size_t vampGetRemainingFeaturesToBuffer(VampPluginHandle handle,
+                                                   void *buffer,
+                                                   size_t bufferSize);
+
+    static size_t vampRetrieveFeatures(VampPluginHandle handle,
+                                       void *buffer,
+                                       size_t bufferSize);
+
+    static int vampSupportsStridedInput(VampPluginHandle handle);
+
+    static VampFeatureList *vampProcessStrided(VampPluginHandle handle,
+                                               const float *inputBuffer,
+                                               unsigned int stride,
+                                               int sec,
+                                               int nsec);
+
+    static int vampGetState(VampPluginHandle handle,
+                            void *buffer,
+                            size_t bufferSize,
+                            size_t *stateSize);
+
+    static int vampSetState(VampPluginHandle handle,
+                            const void *state,
+                            size_t stateSize);
+
+    static void vampSetTaskScheduler(VampPluginHandle handle,
+                                     const VampTaskScheduler *scheduler);
+
+    static void vampSetEnabledOutputs(VampPluginHandle handle,
+                                      const int *enabled,
+                                      unsigned int outputCount);
+
+    static int vampSupportsDoubleInput(VampPluginHandle handle);
+
+    static VampFeatureList *vampProcessDouble(VampPluginHandle handle,
+                                              const double *const *inputBuffers,
+                                              int sec,
+                                              int nsec);
+
+    static VampSpectrumFormat vampGetPreferredSpectrumFormat
+    (VampPluginHandle handle);
+
+    static int vampSetSpectrumFormat(VampPluginHandle handle,
+                                     VampSpectrumFormat format);
+
     void checkOutputMap(Plugin *plugin);
     void markOutputsChanged(Plugin *plugin);
 
     void cleanup(Plugin *plugin);
     unsigned int getOutputCount(Plugin *plugin);
     VampOutputDescriptor *getOutputDescriptor(Plugin *plugin, unsigned int i);
+    struct OutputBlock;
+    static OutputBlock *buildOutputBlock(const Plugin::OutputList &outputs);
+    static void detachOutputBlock(OutputBlock *block);
     VampFeatureList *process(Plugin *plugin,
                              const float *const *inputBuffers,
                              int sec, int nsec);
     VampFeatureList *getRemainingFeatures(Plugin *plugin);
     VampFeatureList *convertFeatures(Plugin *plugin,
                                      const Plugin::FeatureSet &features);
+    size_t processToBuffer(Plugin *plugin,
+                           const float *const *inputBuffers,
+                           int sec, int nsec,
+                           void *buffer, size_t bufferSize);
+    size_t getRemainingFeaturesToBuffer(Plugin *plugin,
+                                        void *buffer, size_t bufferSize);
+    size_t retrieveFeatures(Plugin *plugin,
+                            void *buffer, size_t bufferSize);
+    size_t writeFeatures(Plugin *plugin,
+                         Plugin::FeatureSet &features,
+                         void *buffer, size_t bufferSize);
+    void setInputShape(Plugin *plugin, unsigned int channels,
+                       unsigned int blockSize);
+    void setTaskScheduler(Plugin *plugin,
+                          const VampTaskScheduler *scheduler);
+    void setEnabledOutputs(Plugin *plugin, const vector<bool> &enabled);
+    const vector<bool> *getEnabledOutputs(Plugin *plugin);
+    VampFeatureList *processStrided(Plugin *plugin,
+                                    const float *inputBuffer,
+                                    unsigned int stride,
+                                    int sec, int nsec);
+    VampFeatureList *processDouble(Plugin *plugin,
+                                   const double *const *inputBuffers,
+                                   int sec, int nsec);
     
     // maps both plugins and descriptors to adapters
     typedef map<const void *, Impl *> AdapterMap;
 
     static AdapterMap *m_adapterMap;
 
+    static const VampPluginExtensions m_extensions;
+
     static mutex &adapterMapMutex() {
         // If this mutex was a global static, then it might be
         // destroyed before the last adapter, and we would end up
@@ -137,6 +300,15 @@ protected:
         static mutex m;
         return m;
     }
+
+    static mutex &outputBlockMutex() {
+        // Guards the reference counts of all output blocks, which
+        // may be released after the plugin, or even the adapter,
+        // that they came from has gone. Constructed early for the
+        // same reason as adapterMapMutex
+        static mutex m;
+        return m;
+    }
         
     static Impl *lookupAdapter(VampPluginHandle);
 
@@ -146,16 +318,64 @@ protected:
     VampPluginDescriptor m_descriptor;
     Plugin::ParameterList m_parameters;
     Plugin::ProgramList m_programs;
+    Plugin::StateDependency m_stateDependency;
+    size_t m_warmUpBlocks;
     
     typedef map<Plugin *, Plugin::OutputList *> OutputMap;
     OutputMap m_pluginOutputs;
 
+    // Each plugin's output descriptors are handed out from a single
+    // immutable allocation (see buildOutputBlock), built on first
+    // request and detached from the plugin by markOutputsChanged or
+    // cleanup. Every descriptor handed out counts as a reference to
+    // its block, dropped again by vampReleaseOutputDescriptor, and a
+    // detached block is kept until its last descriptor has been
+    // released, so that hosts holding descriptors across an output
+    // change or past cleanup are unaffected. Reference counts and
+    // the detached flag are guarded by outputBlockMutex, not
+    // m_mutex, as a detached block has no adapter to go back to.
+    struct OutputBlock {
+        size_t references;
+        bool detached;
+    };
+    struct OutputSlot {
+        OutputBlock *block;
+        VampOutputDescriptor descriptor;
+    };
+    static size_t outputBlockHeaderSize() {
+        size_t align = alignof(OutputSlot);
+        return ((sizeof(OutputBlock) + align - 1) / align) * align;
+    }
+    typedef map<Plugin *, OutputBlock *> OutputBlockMap;
+    OutputBlockMap m_outputBlocks;
+
     map<Plugin *, VampFeatureList *> m_fs;
     map<Plugin *, vector<size_t> > m_fsizes;
     map<Plugin *, vector<vector<size_t> > > m_fvsizes;
     void resizeFS(Plugin *plugin, int n);
     void resizeFL(Plugin *plugin, int n, size_t sz);
     void resizeFV(Plugin *plugin, int n, int j, size_t sz);
+
+    // features held over from processToBuffer or
+    // getRemainingFeaturesToBuffer when the host's buffer was too small
+    map<Plugin *, Plugin::FeatureSet> m_retained;
+
+    // channel count and values per channel for each initialised
+    // plugin, needed to call processStrided and processDouble
+    map<Plugin *, std::pair<size_t, size_t> > m_inputShapes;
+
+    // spectrum formats other than complex accepted through
+    // vampSetSpectrumFormat, which change the input shape
+    map<Plugin *, Plugin::SpectrumFormat> m_spectrumFormats;
+    void setSpectrumFormat(Plugin *plugin, Plugin::SpectrumFormat format);
+
+    // wrappers for the schedulers supplied through
+    // vampSetTaskScheduler, deleted after the plugin that uses them
+    map<Plugin *, TaskScheduler *> m_schedulers;
+
+    // outputs disabled through vampSetEnabledOutputs, whose features
+    // are not marshalled
+    map<Plugin *, vector<bool> > m_enabledOutputs;
 };
 
 PluginAdapterBase::PluginAdapterBase()
@@ -174,15 +394,24 @@ PluginAdapterBase::getDescriptor()
     return m_impl->getDescriptor();
 }
 
+const VampPluginExtensions *
+PluginAdapterBase::getExtensions(const VampPluginDescriptor *descriptor)
+{
+    return Impl::getExtensions(descriptor);
+}
+
 PluginAdapterBase::Impl::Impl(PluginAdapterBase *base) :
     m_base(base),
-    m_populated(false)
+    m_populated(false),
+    m_stateDependency(Plugin::UnknownStateDependency),
+    m_warmUpBlocks(0)
 {
 #ifdef DEBUG_PLUGIN_ADAPTER
     cerr << "PluginAdapterBase::Impl[" << this << "]::Impl" << endl;
 #endif
 
     (void)adapterMapMutex(); // see comment in adapterMapMutex function above
+    (void)outputBlockMutex();
 }
 
 const VampPluginDescriptor *
@@ -218,6 +447,8 @@ PluginAdapterBase::Impl::getDescriptor()
 
     m_parameters = plugin->getParameterDescriptors();
     m_programs = plugin->getPrograms();
+    m_stateDependency = plugin->getStateDependency();
+    m_warmUpBlocks = plugin->getWarmUpBlockCount();
 
     m_descriptor.vampApiVersion = plugin->getVampApiVersion();
     m_descriptor.identifier = strdup(plugin->getIdentifier().c_str());
@@ -393,6 +624,7 @@ PluginAdapterBase::Impl::vampInstantiate(const VampPluginDescriptor *desc,
     Plugin *plugin = adapter->m_base->createPlugin(inputSampleRate);
     if (plugin) {
         (*m_adapterMap)[plugin] = adapter;
+        plugin->setTaskScheduler(TaskScheduler::getSerialScheduler());
     }
 
 #ifdef DEBUG_PLUGIN_ADAPTER
@@ -431,6 +663,7 @@ PluginAdapterBase::Impl::vampInitialise(VampPluginHandle handle,
     if (!adapter) return 0;
     bool result = ((Plugin *)handle)->initialise(channels, stepSize, blockSize);
     adapter->markOutputsChanged((Plugin *)handle);
+    adapter->setInputShape((Plugin *)handle, channels, blockSize);
     return result ? 1 : 0;
 }
 
@@ -585,19 +818,23 @@ PluginAdapterBase::Impl::vampReleaseOutputDescriptor(VampOutputDescriptor *desc)
     cerr << "PluginAdapterBase::Impl::vampReleaseOutputDescriptor(" << desc << ")" << endl;
 #endif
 
-    if (desc->identifier) free((void *)desc->identifier);
-    if (desc->name) free((void *)desc->name);
-    if (desc->description) free((void *)desc->description);
-    if (desc->unit) free((void *)desc->unit);
-    if (desc->hasFixedBinCount && desc->binNames) {
-        for (unsigned int i = 0; i < desc->binCount; ++i) {
-            if (desc->binNames[i]) {
-                free((void *)desc->binNames[i]);
-            }
-        }
+    if (!desc) return;
+
+    // The descriptor belongs to an output block: drop its reference,
+    // freeing the block if it has been detached from its plugin and
+    // this was the last one. The plugin may have been cleaned up
+    // already, so this must not touch the adapter
+
+    OutputSlot *slot = (OutputSlot *)
+        ((char *)desc - offsetof(OutputSlot, descriptor));
+    OutputBlock *block = slot->block;
+
+    lock_guard<mutex> guard(outputBlockMutex());
+
+    if (block->references > 0) --block->references;
+    if (block->detached && block->references == 0) {
+        free(block);
     }
-    if (desc->binNames) free((void *)desc->binNames);
-    free((void *)desc);
 }
 
 VampFeatureList *
@@ -610,6 +847,8 @@ PluginAdapterBase::Impl::vampProcess(VampPluginHandle handle,
     cerr << "PluginAdapterBase::Impl::vampProcess(" << handle << ", " << sec << ", " << nsec << ")" << endl;
 #endif
 
+    VAMP_TRACE_SCOPE("PluginAdapter::process");
+
     Impl *adapter = lookupAdapter(handle);
     if (!adapter) return 0;
     return adapter->process((Plugin *)handle, inputBuffers, sec, nsec);
@@ -635,6 +874,263 @@ PluginAdapterBase::Impl::vampReleaseFeatureSet(VampFeatureList *)
 #endif
 }
 
+size_t
+PluginAdapterBase::Impl::vampProcessToBuffer(VampPluginHandle handle,
+                                             const float *const *inputBuffers,
+                                             int sec,
+                                             int nsec,
+                                             void *buffer,
+                                             size_t bufferSize)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampProcessToBuffer(" << handle << ", " << sec << ", " << nsec << ", " << bufferSize << ")" << endl;
+#endif
+
+    VAMP_TRACE_SCOPE("PluginAdapter::processToBuffer");
+
+    Impl *adapter = lookupAdapter(handle);
+    if (!adapter) return 0;
+    return adapter->processToBuffer((Plugin *)handle, inputBuffers, sec, nsec,
+                                    buffer, bufferSize);
+}
+
+size_t
+PluginAdapterBase::Impl::vampGetRemainingFeaturesToBuffer(VampPluginHandle handle,
+                                                          void *buffer,
+                                                          size_t bufferSize)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampGetRemainingFeaturesToBuffer(" << handle << ", " << bufferSize << ")" << endl;
+#endif
+
+    Impl *adapter = lookupAdapter(handle);
+    if (!adapter) return 0;
+    return adapter->getRemainingFeaturesToBuffer((Plugin *)handle,
+                                                 buffer, bufferSize);
+}
+
+size_t
+PluginAdapterBase::Impl::vampRetrieveFeatures(VampPluginHandle handle,
+                                              void *buffer,
+                                              size_t bufferSize)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampRetrieveFeatures(" << handle << ", " << bufferSize << ")" << endl;
+#endif
+
+    Impl *adapter = lookupAdapter(handle);
+    if (!adapter) return 0;
+    return adapter->retrieveFeatures((Plugin *)handle, buffer, bufferSize);
+}
+
+int
+PluginAdapterBase::Impl::vampSupportsStridedInput(VampPluginHandle handle)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampSupportsStridedInput(" << handle << ")" << endl;
+#endif
+
+    return ((Plugin *)handle)->supportsStridedInput() ? 1 : 0;
+}
+
+VampFeatureList *
+PluginAdapterBase::Impl::vampProcessStrided(VampPluginHandle handle,
+                                            const float *inputBuffer,
+                                            unsigned int stride,
+                                            int sec,
+                                            int nsec)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampProcessStrided(" << handle << ", " << stride << ", " << sec << ", " << nsec << ")" << endl;
+#endif
+
+    VAMP_TRACE_SCOPE("PluginAdapter::processStrided");
+
+    Impl *adapter = lookupAdapter(handle);
+    if (!adapter) return 0;
+    return adapter->processStrided((Plugin *)handle, inputBuffer, stride,
+                                   sec, nsec);
+}
+
+VampStateDependency
+PluginAdapterBase::Impl::vampGetStateDependency(const VampPluginDescriptor *desc,
+                                                unsigned int *warmUpBlocks)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampGetStateDependency(" << desc << ")" << endl;
+#endif
+
+    if (warmUpBlocks) *warmUpBlocks = 0;
+    
+    Impl *adapter = 0;
+    {
+        lock_guard<mutex> adapterMapGuard(adapterMapMutex());
+        if (!m_adapterMap) return vampUnknownStateDependency;
+        AdapterMap::const_iterator i = m_adapterMap->find(desc);
+        if (i == m_adapterMap->end()) return vampUnknownStateDependency;
+        adapter = i->second;
+    }
+
+    lock_guard<mutex> guard(adapter->m_mutex);
+
+    switch (adapter->m_stateDependency) {
+    case Plugin::BlockLocal:
+        return vampBlockLocal;
+    case Plugin::BoundedHistory:
+        if (warmUpBlocks) *warmUpBlocks = adapter->m_warmUpBlocks;
+        return vampBoundedHistory;
+    case Plugin::WholeSignal:
+        return vampWholeSignal;
+    case Plugin::UnknownStateDependency:
+        break;
+    }
+    return vampUnknownStateDependency;
+}
+
+int
+PluginAdapterBase::Impl::vampGetState(VampPluginHandle handle,
+                                      void *buffer,
+                                      size_t bufferSize,
+                                      size_t *stateSize)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampGetState(" << handle << ", " << bufferSize << ")" << endl;
+#endif
+
+    Plugin::StateData state;
+    if (!((Plugin *)handle)->getState(state)) return 0;
+
+    if (stateSize) *stateSize = state.size();
+    if (!state.empty() && state.size() <= bufferSize) {
+        memcpy(buffer, &state[0], state.size());
+    }
+    return 1;
+}
+
+int
+PluginAdapterBase::Impl::vampSetState(VampPluginHandle handle,
+                                      const void *state,
+                                      size_t stateSize)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampSetState(" << handle << ", " << stateSize << ")" << endl;
+#endif
+
+    const unsigned char *data = (const unsigned char *)state;
+    Plugin::StateData s;
+    if (stateSize > 0) s.assign(data, data + stateSize);
+    return ((Plugin *)handle)->setState(s) ? 1 : 0;
+}
+
+void
+PluginAdapterBase::Impl::vampSetTaskScheduler(VampPluginHandle handle,
+                                              const VampTaskScheduler *scheduler)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampSetTaskScheduler(" << handle << ", " << scheduler << ")" << endl;
+#endif
+
+    Impl *adapter = lookupAdapter(handle);
+    if (!adapter) return;
+    adapter->setTaskScheduler((Plugin *)handle, scheduler);
+}
+
+void
+PluginAdapterBase::Impl::vampSetEnabledOutputs(VampPluginHandle handle,
+                                               const int *enabled,
+                                               unsigned int outputCount)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampSetEnabledOutputs(" << handle << ", " << outputCount << ")" << endl;
+#endif
+
+    Impl *adapter = lookupAdapter(handle);
+    if (!adapter) return;
+
+    vector<bool> e(outputCount, true);
+    for (unsigned int i = 0; i < outputCount; ++i) {
+        e[i] = (enabled[i] != 0);
+    }
+    adapter->setEnabledOutputs((Plugin *)handle, e);
+}
+
+int
+PluginAdapterBase::Impl::vampSupportsDoubleInput(VampPluginHandle handle)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampSupportsDoubleInput(" << handle << ")" << endl;
+#endif
+
+    return ((Plugin *)handle)->supportsDoubleInput() ? 1 : 0;
+}
+
+VampFeatureList *
+PluginAdapterBase::Impl::vampProcessDouble(VampPluginHandle handle,
+                                           const double *const *inputBuffers,
+                                           int sec,
+                                           int nsec)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampProcessDouble(" << handle << ", " << sec << ", " << nsec << ")" << endl;
+#endif
+
+    VAMP_TRACE_SCOPE("PluginAdapter::processDouble");
+
+    Impl *adapter = lookupAdapter(handle);
+    if (!adapter) return 0;
+    return adapter->processDouble((Plugin *)handle, inputBuffers, sec, nsec);
+}
+
+VampSpectrumFormat
+PluginAdapterBase::Impl::vampGetPreferredSpectrumFormat(VampPluginHandle handle)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampGetPreferredSpectrumFormat(" << handle << ")" << endl;
+#endif
+
+    switch (((Plugin *)handle)->getPreferredSpectrumFormat()) {
+    case Plugin::MagnitudeSpectrum: return vampMagnitudeSpectrum;
+    case Plugin::PowerSpectrum: return vampPowerSpectrum;
+    case Plugin::ComplexSpectrum: break;
+    }
+    return vampComplexSpectrum;
+}
+
+int
+PluginAdapterBase::Impl::vampSetSpectrumFormat(VampPluginHandle handle,
+                                               VampSpectrumFormat format)
+{
+#ifdef DEBUG_PLUGIN_ADAPTER
+    cerr << "PluginAdapterBase::Impl::vampSetSpectrumFormat(" << handle << ", " << format << ")" << endl;
+#endif
+
+    Plugin::SpectrumFormat f;
+    switch (format) {
+    case vampComplexSpectrum: f = Plugin::ComplexSpectrum; break;
+    case vampMagnitudeSpectrum: f = Plugin::MagnitudeSpectrum; break;
+    case vampPowerSpectrum: f = Plugin::PowerSpectrum; break;
+    default: return 0;
+    }
+
+    Impl *adapter = lookupAdapter(handle);
+    if (!adapter) return 0;
+    if (!((Plugin *)handle)->setSpectrumFormat(f)) return 0;
+    adapter->setSpectrumFormat((Plugin *)handle, f);
+    return 1;
+}
+
+const VampPluginExtensions *
+PluginAdapterBase::Impl::getExtensions(const VampPluginDescriptor *desc)
+{
+    lock_guard<mutex> adapterMapGuard(adapterMapMutex());
+    
+    if (!m_adapterMap) return 0;
+    AdapterMap::const_iterator i = m_adapterMap->find(desc);
+    if (i == m_adapterMap->end()) return 0;
+    if (desc != &i->second->m_descriptor) return 0;
+    return &m_extensions;
+}
+
 void 
 PluginAdapterBase::Impl::cleanup(Plugin *plugin)
 {
@@ -674,6 +1170,23 @@ PluginAdapterBase::Impl::cleanup(Plugin *plugin)
         m_pluginOutputs.erase(plugin);
     }
 
+    m_retained.erase(plugin);
+    m_inputShapes.erase(plugin);
+    m_spectrumFormats.erase(plugin);
+    m_enabledOutputs.erase(plugin);
+
+    TaskScheduler *scheduler = 0;
+    if (m_schedulers.find(plugin) != m_schedulers.end()) {
+        scheduler = m_schedulers[plugin];
+        m_schedulers.erase(plugin);
+    }
+
+    if (m_outputBlocks.find(plugin) != m_outputBlocks.end()) {
+        OutputBlock *block = m_outputBlocks[plugin];
+        m_outputBlocks.erase(plugin);
+        if (block) detachOutputBlock(block);
+    }
+
     if (m_adapterMap) {
         m_adapterMap->erase(plugin);
 
@@ -684,6 +1197,7 @@ PluginAdapterBase::Impl::cleanup(Plugin *plugin)
     }
 
     delete ((Plugin *)plugin);
+    delete scheduler;
 }
 
 void 
@@ -717,6 +1231,30 @@ PluginAdapterBase::Impl::markOutputsChanged(Plugin *plugin)
         m_pluginOutputs.erase(i);
         delete list;
     }
+
+    OutputBlockMap::iterator bi = m_outputBlocks.find(plugin);
+
+    if (bi != m_outputBlocks.end()) {
+        OutputBlock *block = bi->second;
+        m_outputBlocks.erase(bi);
+        if (block) detachOutputBlock(block);
+    }
+}
+
+void
+PluginAdapterBase::Impl::detachOutputBlock(OutputBlock *block)
+{
+    // The block has been removed from m_outputBlocks: free it now if
+    // no descriptors from it are held, or else leave the last
+    // vampReleaseOutputDescriptor to do so
+
+    lock_guard<mutex> guard(outputBlockMutex());
+
+    if (block->references == 0) {
+        free(block);
+    } else {
+        block->detached = true;
+    }
 }
 
 unsigned int 
@@ -737,58 +1275,126 @@ PluginAdapterBase::Impl::getOutputDescriptor(Plugin *plugin,
 
     checkOutputMap(plugin);
 
-    Plugin::OutputDescriptor &od =
-        (*m_pluginOutputs[plugin])[i];
-
-    VampOutputDescriptor *desc = (VampOutputDescriptor *)
-        malloc(sizeof(VampOutputDescriptor));
-
-    desc->identifier = strdup(od.identifier.c_str());
-    desc->name = strdup(od.name.c_str());
-    desc->description = strdup(od.description.c_str());
-    desc->unit = strdup(od.unit.c_str());
-    desc->hasFixedBinCount = od.hasFixedBinCount;
-    desc->binCount = od.binCount;
-
-    if (od.hasFixedBinCount && od.binCount > 0
-        // We would like to do "&& !od.binNames.empty()" here -- but we
-        // can't, because it will crash older versions of the host adapter
-        // which try to copy the names across whenever the bin count is
-        // non-zero, regardless of whether they exist or not
-        ) {
-        desc->binNames = (const char **)
-            malloc(od.binCount * sizeof(const char *));
-        
-        for (unsigned int i = 0; i < od.binCount; ++i) {
-            if (i < od.binNames.size()) {
-                desc->binNames[i] = strdup(od.binNames[i].c_str());
-            } else {
-                desc->binNames[i] = 0;
+    const Plugin::OutputList &outputs = *m_pluginOutputs[plugin];
+    if (i >= outputs.size()) return 0;
+
+    OutputBlock *&block = m_outputBlocks[plugin];
+    if (!block) block = buildOutputBlock(outputs);
+    if (!block) return 0;
+
+    {
+        lock_guard<mutex> blockGuard(outputBlockMutex());
+        ++block->references;
+    }
+    
+    OutputSlot *slots = (OutputSlot *)
+        ((char *)block + outputBlockHeaderSize());
+    return &slots[i].descriptor;
+}
+
+PluginAdapterBase::Impl::OutputBlock *
+PluginAdapterBase::Impl::buildOutputBlock(const Plugin::OutputList &outputs)
+{
+    // Lay out all of the descriptors in one allocation: the block
+    // header first, then an OutputSlot for each output (holding the
+    // VampOutputDescriptor and a pointer back to the header, so that
+    // vampReleaseOutputDescriptor can find it), then the bin name
+    // pointer arrays, then the text of every string. The slot size is
+    // a multiple of its alignment, which is at least that of a
+    // pointer, so the pointer arrays need no padding.
+
+    size_t n = outputs.size();
+    size_t nameCount = 0, textSize = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        const Plugin::OutputDescriptor &od = outputs[i];
+        textSize += od.identifier.size() + 1;
+        textSize += od.name.size() + 1;
+        textSize += od.description.size() + 1;
+        textSize += od.unit.size() + 1;
+        // We would like to check "&& !od.binNames.empty()" here too
+        // -- but we can't, because it will crash older versions of
+        // the host adapter which try to copy the names across
+        // whenever the bin count is non-zero, regardless of whether
+        // they exist or not
+        if (od.hasFixedBinCount && od.binCount > 0) {
+            nameCount += od.binCount;
+            for (size_t j = 0; j < od.binCount && j < od.binNames.size(); ++j) {
+                textSize += od.binNames[j].size() + 1;
             }
         }
-    } else {
-        desc->binNames = 0;
     }
 
-    desc->hasKnownExtents = od.hasKnownExtents;
-    desc->minValue = od.minValue;
-    desc->maxValue = od.maxValue;
-    desc->isQuantized = od.isQuantized;
-    desc->quantizeStep = od.quantizeStep;
+    size_t headerSize = outputBlockHeaderSize();
+    
+    char *mem = (char *)malloc(headerSize +
+                               n * sizeof(OutputSlot) +
+                               nameCount * sizeof(const char *) +
+                               textSize);
+    if (!mem) return 0;
+
+    OutputBlock *block = (OutputBlock *)mem;
+    block->references = 0;
+    block->detached = false;
+
+    OutputSlot *slots = (OutputSlot *)(mem + headerSize);
+    const char **names = (const char **)(slots + n);
+    char *text = (char *)(names + nameCount);
+
+    auto write = [&text](const string &str) -> const char * {
+        char *start = text;
+        memcpy(start, str.c_str(), str.size() + 1);
+        text += str.size() + 1;
+        return start;
+    };
+
+    for (size_t i = 0; i < n; ++i) {
+
+        const Plugin::OutputDescriptor &od = outputs[i];
+        slots[i].block = block;
+        VampOutputDescriptor *desc = &slots[i].descriptor;
+
+        desc->identifier = write(od.identifier);
+        desc->name = write(od.name);
+        desc->description = write(od.description);
+        desc->unit = write(od.unit);
+        desc->hasFixedBinCount = od.hasFixedBinCount;
+        desc->binCount = od.binCount;
+
+        if (od.hasFixedBinCount && od.binCount > 0) {
+            desc->binNames = names;
+            for (unsigned int j = 0; j < od.binCount; ++j) {
+                if (j < od.binNames.size()) {
+                    names[j] = write(od.binNames[j]);
+                } else {
+                    names[j] = 0;
+                }
+            }
+            names += od.binCount;
+        } else {
+            desc->binNames = 0;
+        }
+
+        desc->hasKnownExtents = od.hasKnownExtents;
+        desc->minValue = od.minValue;
+        desc->maxValue = od.maxValue;
+        desc->isQuantized = od.isQuantized;
+        desc->quantizeStep = od.quantizeStep;
+
+        switch (od.sampleType) {
+        case Plugin::OutputDescriptor::OneSamplePerStep:
+            desc->sampleType = vampOneSamplePerStep; break;
+        case Plugin::OutputDescriptor::FixedSampleRate:
+            desc->sampleType = vampFixedSampleRate; break;
+        case Plugin::OutputDescriptor::VariableSampleRate:
+            desc->sampleType = vampVariableSampleRate; break;
+        }
 
-    switch (od.sampleType) {
-    case Plugin::OutputDescriptor::OneSamplePerStep:
-        desc->sampleType = vampOneSamplePerStep; break;
-    case Plugin::OutputDescriptor::FixedSampleRate:
-        desc->sampleType = vampFixedSampleRate; break;
-    case Plugin::OutputDescriptor::VariableSampleRate:
-        desc->sampleType = vampVariableSampleRate; break;
+        desc->sampleRate = od.sampleRate;
+        desc->hasDuration = od.hasDuration;
     }
 
-    desc->sampleRate = od.sampleRate;
-    desc->hasDuration = od.hasDuration;
-
-    return desc;
+    return block;
 }
     
 VampFeatureList *
@@ -825,6 +1431,280 @@ PluginAdapterBase::Impl::getRemainingFeatures(Plugin *plugin)
     return convertFeatures(plugin, plugin->getRemainingFeatures());
 }
 
+size_t
+PluginAdapterBase::Impl::processToBuffer(Plugin *plugin,
+                                         const float *const *inputBuffers,
+                                         int sec, int nsec,
+                                         void *buffer, size_t bufferSize)
+{
+    RealTime rt(sec, nsec);
+
+    {    
+        lock_guard<mutex> guard(m_mutex);
+        checkOutputMap(plugin);
+        m_retained.erase(plugin);
+    }
+
+    Plugin::FeatureSet features = plugin->process(inputBuffers, rt);
+    return writeFeatures(plugin, features, buffer, bufferSize);
+}
+
+size_t
+PluginAdapterBase::Impl::getRemainingFeaturesToBuffer(Plugin *plugin,
+                                                      void *buffer,
+                                                      size_t bufferSize)
+{
+    {    
+        lock_guard<mutex> guard(m_mutex);
+        checkOutputMap(plugin);
+        m_retained.erase(plugin);
+    }
+
+    Plugin::FeatureSet features = plugin->getRemainingFeatures();
+    return writeFeatures(plugin, features, buffer, bufferSize);
+}
+
+size_t
+PluginAdapterBase::Impl::retrieveFeatures(Plugin *plugin,
+                                          void *buffer, size_t bufferSize)
+{
+    Plugin::FeatureSet features;
+    {
+        lock_guard<mutex> guard(m_mutex);
+        map<Plugin *, Plugin::FeatureSet>::iterator i = m_retained.find(plugin);
+        if (i != m_retained.end()) {
+            features.swap(i->second);
+            m_retained.erase(i);
+        }
+    }
+    return writeFeatures(plugin, features, buffer, bufferSize);
+}
+
+size_t
+PluginAdapterBase::Impl::writeFeatures(Plugin *plugin,
+                                       Plugin::FeatureSet &features,
+                                       void *buffer, size_t bufferSize)
+{
+    lock_guard<mutex> guard(m_mutex);
+
+    int outputCount = 0;
+    if (m_pluginOutputs[plugin]) outputCount = m_pluginOutputs[plugin]->size();
+
+    const vector<bool> *enabled = getEnabledOutputs(plugin);
+
+    // The layout is the same as convertFeatures produces, but packed
+    // into one block: the VampFeatureList array, then each output's
+    // (v1, v2) feature union array, then the values, then the label
+    // text. Each section's element size is a multiple of the next
+    // one's alignment, so no padding is needed between them.
+    
+    size_t unionCount = 0, valueCount = 0, textSize = 0;
+    
+    for (Plugin::FeatureSet::const_iterator fi = features.begin();
+         fi != features.end(); ++fi) {
+        if (fi->first < 0 || fi->first >= outputCount) {
+            cerr << "WARNING: PluginAdapterBase::Impl::writeFeatures: Too many outputs from plugin (" << fi->first+1 << ", only should be " << outputCount << ")" << endl;
+            continue;
+        }
+        if (enabled && fi->first < int(enabled->size()) &&
+            !(*enabled)[fi->first]) {
+            continue;
+        }
+        const Plugin::FeatureList &fl = fi->second;
+        unionCount += 2 * fl.size();
+        for (size_t j = 0; j < fl.size(); ++j) {
+            valueCount += fl[j].values.size();
+            if (!fl[j].label.empty()) textSize += fl[j].label.size() + 1;
+        }
+    }
+
+    size_t required = outputCount * sizeof(VampFeatureList) +
+        unionCount * sizeof(VampFeatureUnion) +
+        valueCount * sizeof(float) +
+        textSize;
+
+    if (required > bufferSize) {
+        m_retained[plugin].swap(features);
+        return required;
+    }
+
+    VampFeatureList *fs = (VampFeatureList *)buffer;
+    VampFeatureUnion *unions = (VampFeatureUnion *)(fs + outputCount);
+    float *values = (float *)(unions + unionCount);
+    char *text = (char *)(values + valueCount);
+
+    for (int i = 0; i < outputCount; ++i) {
+        fs[i].featureCount = 0;
+        fs[i].features = 0;
+    }
+    
+    for (Plugin::FeatureSet::const_iterator fi = features.begin();
+         fi != features.end(); ++fi) {
+
+        int n = fi->first;
+        if (n < 0 || n >= outputCount) continue;
+        if (enabled && n < int(enabled->size()) && !(*enabled)[n]) continue;
+
+        const Plugin::FeatureList &fl = fi->second;
+        size_t sz = fl.size();
+
+        fs[n].featureCount = sz;
+        fs[n].features = unions;
+        
+        for (size_t j = 0; j < sz; ++j) {
+
+            VampFeature *feature = &unions[j].v1;
+
+            feature->hasTimestamp = fl[j].hasTimestamp;
+            feature->sec = fl[j].timestamp.sec;
+            feature->nsec = fl[j].timestamp.nsec;
+            feature->valueCount = fl[j].values.size();
+
+            VampFeatureV2 *v2 = &unions[j + sz].v2;
+            
+            v2->hasDuration = fl[j].hasDuration;
+            v2->durationSec = fl[j].duration.sec;
+            v2->durationNsec = fl[j].duration.nsec;
+
+            if (fl[j].label.empty()) {
+                feature->label = 0;
+            } else {
+                size_t len = fl[j].label.size() + 1;
+                memcpy(text, fl[j].label.c_str(), len);
+                feature->label = text;
+                text += len;
+            }
+
+            feature->values = values;
+            for (unsigned int k = 0; k < feature->valueCount; ++k) {
+                values[k] = fl[j].values[k];
+            }
+            values += feature->valueCount;
+        }
+
+        unions += 2 * sz;
+    }
+
+    return required;
+}
+
+void
+PluginAdapterBase::Impl::setInputShape(Plugin *plugin,
+                                       unsigned int channels,
+                                       unsigned int blockSize)
+{
+    lock_guard<mutex> guard(m_mutex);
+
+    // As described for process(): a complex spectrum has a real and
+    // an imaginary value for each of the blockSize/2+1 bins, and a
+    // magnitude or power spectrum has a single value for each
+    size_t frames = blockSize;
+    if (m_descriptor.inputDomain == vampFrequencyDomain) {
+        map<Plugin *, Plugin::SpectrumFormat>::const_iterator i =
+            m_spectrumFormats.find(plugin);
+        if (i != m_spectrumFormats.end() &&
+            i->second != Plugin::ComplexSpectrum) {
+            frames = blockSize/2 + 1;
+        } else {
+            frames = blockSize + 2;
+        }
+    }
+    
+    m_inputShapes[plugin] = std::pair<size_t, size_t>(channels, frames);
+}
+
+void
+PluginAdapterBase::Impl::setSpectrumFormat(Plugin *plugin,
+                                           Plugin::SpectrumFormat format)
+{
+    lock_guard<mutex> guard(m_mutex);
+
+    m_spectrumFormats[plugin] = format;
+}
+
+void
+PluginAdapterBase::Impl::setTaskScheduler(Plugin *plugin,
+                                          const VampTaskScheduler *scheduler)
+{
+    TaskScheduler *previous = 0;
+    TaskScheduler *current = TaskScheduler::getSerialScheduler();
+    {
+        lock_guard<mutex> guard(m_mutex);
+        if (m_schedulers.find(plugin) != m_schedulers.end()) {
+            previous = m_schedulers[plugin];
+            m_schedulers.erase(plugin);
+        }
+        if (scheduler) {
+            current = new HostTaskScheduler(scheduler);
+            m_schedulers[plugin] = current;
+        }
+    }
+
+    plugin->setTaskScheduler(current);
+    delete previous;
+}
+
+void
+PluginAdapterBase::Impl::setEnabledOutputs(Plugin *plugin,
+                                           const vector<bool> &enabled)
+{
+    {
+        lock_guard<mutex> guard(m_mutex);
+        m_enabledOutputs[plugin] = enabled;
+    }
+
+    plugin->setEnabledOutputs(enabled);
+}
+
+const vector<bool> *
+PluginAdapterBase::Impl::getEnabledOutputs(Plugin *plugin)
+{
+    // must be called with m_mutex held
+
+    map<Plugin *, vector<bool> >::const_iterator i =
+        m_enabledOutputs.find(plugin);
+    if (i == m_enabledOutputs.end()) return 0;
+    return &i->second;
+}
+
+VampFeatureList *
+PluginAdapterBase::Impl::processStrided(Plugin *plugin,
+                                        const float *inputBuffer,
+                                        unsigned int stride,
+                                        int sec, int nsec)
+{
+    RealTime rt(sec, nsec);
+
+    std::pair<size_t, size_t> shape;
+    {    
+        lock_guard<mutex> guard(m_mutex);
+        checkOutputMap(plugin);
+        shape = m_inputShapes[plugin];
+    }
+
+    return convertFeatures(plugin, plugin->processStrided
+                           (inputBuffer, shape.first, shape.second,
+                            stride, rt));
+}
+
+VampFeatureList *
+PluginAdapterBase::Impl::processDouble(Plugin *plugin,
+                                       const double *const *inputBuffers,
+                                       int sec, int nsec)
+{
+    RealTime rt(sec, nsec);
+
+    std::pair<size_t, size_t> shape;
+    {    
+        lock_guard<mutex> guard(m_mutex);
+        checkOutputMap(plugin);
+        shape = m_inputShapes[plugin];
+    }
+
+    return convertFeatures(plugin, plugin->processDouble
+                           (inputBuffers, shape.first, shape.second, rt));
+}
+
 VampFeatureList *
 PluginAdapterBase::Impl::convertFeatures(Plugin *plugin,
                                          const Plugin::FeatureSet &features)
@@ -839,6 +1719,8 @@ PluginAdapterBase::Impl::convertFeatures(Plugin *plugin,
     resizeFS(plugin, outputCount);
     VampFeatureList *fs = m_fs[plugin];
 
+    const vector<bool> *enabled = getEnabledOutputs(plugin);
+
 //    cerr << "PluginAdapter(v2)::convertFeatures: NOTE: sizeof(Feature) == " << sizeof(Plugin::Feature) << ", sizeof(VampFeature) == " << sizeof(VampFeature) << ", sizeof(VampFeatureList) == " << sizeof(VampFeatureList) << endl;
 
     for (Plugin::FeatureSet::const_iterator fi = features.begin();
@@ -859,6 +1741,13 @@ PluginAdapterBase::Impl::convertFeatures(Plugin *plugin,
             }
         }
 
+        if (enabled && n >= 0 && n < int(enabled->size()) &&
+            !(*enabled)[n]) {
+            fs[n].featureCount = 0;
+            lastN = n;
+            continue;
+        }
+
         const Plugin::FeatureList &fl = fi->second;
 
         size_t sz = fl.size();
@@ -1005,6 +1894,31 @@ PluginAdapterBase::Impl::resizeFV(Plugin *plugin, int n, int j, size_t sz)
 PluginAdapterBase::Impl::AdapterMap *
 PluginAdapterBase::Impl::m_adapterMap = 0;
 
+const VampPluginExtensions
+PluginAdapterBase::Impl::m_extensions = {
+    sizeof(VampPluginExtensions),
+    PluginAdapterBase::Impl::vampProcessToBuffer,
+    PluginAdapterBase::Impl::vampGetRemainingFeaturesToBuffer,
+    PluginAdapterBase::Impl::vampRetrieveFeatures,
+    PluginAdapterBase::Impl::vampSupportsStridedInput,
+    PluginAdapterBase::Impl::vampProcessStrided,
+    PluginAdapterBase::Impl::vampGetStateDependency,
+    PluginAdapterBase::Impl::vampGetState,
+    PluginAdapterBase::Impl::vampSetState,
+    PluginAdapterBase::Impl::vampSetTaskScheduler,
+    PluginAdapterBase::Impl::vampSetEnabledOutputs,
+    PluginAdapterBase::Impl::vampSupportsDoubleInput,
+    PluginAdapterBase::Impl::vampProcessDouble,
+    PluginAdapterBase::Impl::vampGetPreferredSpectrumFormat,
+    PluginAdapterBase::Impl::vampSetSpectrumFormat
+};
+
+}
+
+extern "C" const VampPluginExtensions *
+vampGetPluginExtensions(const VampPluginDescriptor *descriptor)
+{
+    return Vamp::PluginAdapterBase::getExtensions(descriptor);
 }
 
 _VAMP_SDK_PLUGSPACE_END(PluginAdapter.cpp)
@@ -44,13 +44,6 @@
 #include <iostream>
 #include <limits.h>
 
-#if (defined(__GNUC__)) && (__GNUC__ < 3)
-#include <strstream>
-#define stringstream strstream
-#else
-#include <sstream>
-#endif
-
 using std::cerr;
 using std::endl;
 
@@ -78,6 +71,14 @@ namespace Vamp {
 RealTime::RealTime(int s, int n) :
     sec(s), nsec(n)
 {
+    // Most values passed in are already normalised: return early for
+    // those rather than running through all of the tests below
+    if (nsec >= 0) {
+        if (nsec < ONE_BILLION && sec >= 0) return;
+    } else {
+        if (nsec > -ONE_BILLION && sec <= 0) return;
+    }
+    
     while (nsec <= -ONE_BILLION && sec > INT_MIN) { nsec += ONE_BILLION; --sec; }
     while (nsec >=  ONE_BILLION && sec < INT_MAX) { nsec -= ONE_BILLION; ++sec; }
     while (nsec > 0 && sec < 0) { nsec -= ONE_BILLION; ++sec; }
@@ -111,89 +112,126 @@ RealTime::fromTimeval(const struct timeval &tv)
 }
 #endif
 
-std::ostream &operator<<(std::ostream &out, const RealTime &rt)
-{
-    if (rt < RealTime::zeroTime) {
-	out << "-";
-    } else {
-	out << " ";
-    }
+const int RealTime::maxFormattedLength;
 
-    int s = (rt.sec < 0 ? -rt.sec : rt.sec);
-    int n = (rt.nsec < 0 ? -rt.nsec : rt.nsec);
+// Append a character at p, if there is room before last
+static bool
+putChar(char *&p, char *last, char c)
+{
+    if (!p || p == last) return false;
+    *p++ = c;
+    return true;
+}
 
-    out << s << ".";
+// Append the decimal digits of v at p, zero-padded to at least
+// minDigits, if there is room before last
+static bool
+putUnsigned(char *&p, char *last, unsigned int v, int minDigits)
+{
+    char digits[16];
+    int n = 0;
+    do {
+        digits[n++] = char('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    while (n < minDigits) digits[n++] = '0';
+    if (!p || last - p < n) return false;
+    while (n > 0) *p++ = digits[--n];
+    return true;
+}
 
-    int nn(n);
-    if (nn == 0) out << "00000000";
-    else while (nn < (ONE_BILLION / 10)) {
-	out << "0";
-	nn *= 10;
-    }
-    
-    out << n << "R";
+std::ostream &operator<<(std::ostream &out, const RealTime &rt)
+{
+    char buffer[RealTime::maxFormattedLength];
+    char *end = rt.toChars(buffer, buffer + sizeof(buffer));
+    out.write(buffer, end - buffer);
+    out << "R";
     return out;
 }
 
-std::string
-RealTime::toString() const
+char *
+RealTime::toChars(char *first, char *last) const
 {
-    std::stringstream out;
-    out << *this;
-    
-    std::string s = out.str();
+    char *p = first;
 
-    // remove trailing R
-    return s.substr(0, s.length() - 1);
+    // Negating as unsigned, so as to be safe for INT_MIN
+    unsigned int s = (sec < 0 ? 0u - unsigned(sec) : unsigned(sec));
+    unsigned int n = (nsec < 0 ? 0u - unsigned(nsec) : unsigned(nsec));
+
+    if (putChar(p, last, (*this < zeroTime) ? '-' : ' ') &&
+        putUnsigned(p, last, s, 1) &&
+        putChar(p, last, '.') &&
+        putUnsigned(p, last, n, 9)) {
+        return p;
+    }
+    return 0;
 }
 
-std::string
-RealTime::toText(bool fixedDp) const
+char *
+RealTime::toTextChars(char *first, char *last, bool fixedDp) const
 {
-    if (*this < RealTime::zeroTime) return "-" + (-*this).toText(fixedDp);
+    if (*this < RealTime::zeroTime) {
+        char *p = first;
+        if (!putChar(p, last, '-')) return 0;
+        return (-*this).toTextChars(p, last, fixedDp);
+    }
 
-    std::stringstream out;
+    char *p = first;
+    bool ok = true;
 
     if (sec >= 3600) {
-        out << (sec / 3600) << ":";
+        ok = ok && putUnsigned(p, last, sec / 3600, 1) && putChar(p, last, ':');
     }
     
     if (sec >= 60) {
         int minutes = (sec % 3600) / 60;
-        if (sec >= 3600 && minutes < 10) out << "0";
-        out << minutes << ":";
+        ok = ok && putUnsigned(p, last, minutes, sec >= 3600 ? 2 : 1) &&
+            putChar(p, last, ':');
     }
     
     if (sec >= 10) {
-        out << ((sec % 60) / 10);
+        ok = ok && putUnsigned(p, last, (sec % 60) / 10, 1);
     }
     
-    out << (sec % 10);
+    ok = ok && putUnsigned(p, last, sec % 10, 1);
     
     int ms = msec();
 
     if (ms != 0) {
-	out << ".";
-	out << (ms / 100);
+        ok = ok && putChar(p, last, '.') && putUnsigned(p, last, ms / 100, 1);
 	ms = ms % 100;
 	if (ms != 0) {
-	    out << (ms / 10);
+            ok = ok && putUnsigned(p, last, ms / 10, 1);
 	    ms = ms % 10;
 	} else if (fixedDp) {
-	    out << "0";
+            ok = ok && putChar(p, last, '0');
 	}
 	if (ms != 0) {
-	    out << ms;
+            ok = ok && putUnsigned(p, last, ms, 1);
 	} else if (fixedDp) {
-	    out << "0";
+            ok = ok && putChar(p, last, '0');
 	}
     } else if (fixedDp) {
-	out << ".000";
+        ok = ok && putChar(p, last, '.') && putUnsigned(p, last, 0, 3);
     }
-	
-    std::string s = out.str();
 
-    return s;
+    return ok ? p : 0;
+}
+
+std::string
+RealTime::toString() const
+{
+    char buffer[maxFormattedLength];
+    char *end = toChars(buffer, buffer + sizeof(buffer));
+    return std::string(buffer, end);
+}
+
+std::string
+RealTime::toText(bool fixedDp) const
+{
+    char buffer[maxFormattedLength];
+    char *end = toTextChars(buffer, buffer + sizeof(buffer), fixedDp);
+    return std::string(buffer, end);
 }
 
 RealTime
@@ -220,19 +258,45 @@ RealTime::operator/(const RealTime &r) const
 long
 RealTime::realTime2Frame(const RealTime &time, unsigned int sampleRate)
 {
-    if (time < zeroTime) return -realTime2Frame(-time, sampleRate);
-    double s = time.sec + double(time.nsec) / ONE_BILLION;
-    return long(s * sampleRate + 0.5);
+    return long(toFrame(time, sampleRate));
 }
 
 RealTime
 RealTime::frame2RealTime(long frame, unsigned int sampleRate)
 {
-    if (frame < 0) return -frame2RealTime(-frame, sampleRate);
+    return fromFrame(frame, sampleRate);
+}
+
+int64_t
+RealTime::toFrame(const RealTime &time, unsigned int sampleRate)
+{
+    // Negate in 64 bits rather than negating the RealTime, which
+    // cannot represent -INT_MIN seconds
+    bool negative = (time < zeroTime);
+    int64_t sec = negative ? -int64_t(time.sec) : int64_t(time.sec);
+    int64_t nsec = negative ? -int64_t(time.nsec) : int64_t(time.nsec);
+
+    // Whole seconds and nanoseconds separately, so that neither
+    // product can overflow: nsec * sampleRate < 2^62
+    int64_t frame = sec * sampleRate;
+    frame += (uint64_t(nsec) * sampleRate + ONE_BILLION / 2) / ONE_BILLION;
+    return negative ? -frame : frame;
+}
+
+RealTime
+RealTime::fromFrame(int64_t frame, unsigned int sampleRate)
+{
+    if (frame < 0) return -fromFrame(-frame, sampleRate);
+    if (sampleRate == 0) return zeroTime;
+
+    int sec = int(frame / sampleRate);
+    uint64_t rem = uint64_t(frame % sampleRate);
+
+    // Round to nearest: (2 * rem * 10^9 + rate) / (2 * rate), where
+    // rem < rate < 2^32 so the numerator is less than 2^64
+    int nsec = int((2 * rem * ONE_BILLION + sampleRate) /
+                   (2 * uint64_t(sampleRate)));
 
-    int sec = int(frame / long(sampleRate));
-    frame -= sec * long(sampleRate);
-    int nsec = (int)((double(frame) / double(sampleRate)) * ONE_BILLION + 0.5);
     // Use ctor here instead of setting data members directly to
     // ensure nsec > ONE_BILLION is handled properly.  It's extremely
     // unlikely, but not impossible.
@@ -0,0 +1,284 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#include <vamp-sdk/Trace.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#if ( VAMP_SDK_MAJOR_VERSION != 2 || VAMP_SDK_MINOR_VERSION != 10 )
+#error Unexpected version of Vamp SDK header included
+#endif
+
+using std::vector;
+using std::mutex;
+using std::lock_guard;
+
+_VAMP_SDK_PLUGSPACE_BEGIN(Trace.cpp)
+
+namespace Vamp {
+
+namespace {
+
+#ifdef _VAMP_IN_HOSTSDK
+const char *const traceCategory = "vamp-hostsdk";
+#else
+const char *const traceCategory = "vamp-sdk";
+#endif
+
+struct TraceEvent
+{
+    const char *name;
+    long long start;
+    long long end;
+};
+
+// Events for a single thread. Only that thread writes to it, so the
+// count is the only thing that needs to be atomic; a reader copies
+// the events and then discards any that the writer may have lapped
+// while it was doing so. Clearing is done by the reader's side, by
+// noting the count at which to start reading next time.
+
+class TraceRing
+{
+public:
+    enum { Capacity = 16384 }; // must be a power of two
+    
+    TraceRing(long long tid) : m_tid(tid), m_count(0), m_cleared(0) { }
+
+    void record(const char *name, long long start, long long end) {
+        size_t n = m_count.load(std::memory_order_relaxed);
+        TraceEvent &e = m_events[n & (Capacity - 1)];
+        e.name = name;
+        e.start = start;
+        e.end = end;
+        m_count.store(n + 1, std::memory_order_release);
+    }
+
+    void read(vector<TraceEvent> &events) const {
+        size_t count = m_count.load(std::memory_order_acquire);
+        size_t first = (count > Capacity ? count - Capacity : 0);
+        size_t cleared = m_cleared.load(std::memory_order_acquire);
+        if (first < cleared) first = cleared;
+        vector<TraceEvent> copied;
+        for (size_t i = first; i < count; ++i) {
+            copied.push_back(m_events[i & (Capacity - 1)]);
+        }
+        size_t after = m_count.load(std::memory_order_acquire);
+        size_t valid = (after > Capacity ? after - Capacity : 0);
+        for (size_t i = first; i < count; ++i) {
+            if (i >= valid) events.push_back(copied[i - first]);
+        }
+    }
+
+    void clear() {
+        m_cleared.store(m_count.load(std::memory_order_acquire),
+                        std::memory_order_release);
+    }
+
+    long long getThreadId() const { return m_tid; }
+    
+private:
+    long long m_tid;
+    std::atomic<size_t> m_count;
+    std::atomic<size_t> m_cleared;
+    TraceEvent m_events[Capacity];
+};
+
+class TraceRegistry
+{
+public:
+    TraceRegistry() { }
+
+    ~TraceRegistry() {
+        appendToFile();
+        lock_guard<mutex> guard(m_mutex);
+        for (size_t i = 0; i < m_rings.size(); ++i) {
+            delete m_rings[i];
+        }
+        m_rings.clear();
+        m_destroyed = true;
+    }
+
+    static TraceRegistry &getInstance() {
+        static TraceRegistry registry;
+        return registry;
+    }
+
+    static bool isDestroyed() {
+        return m_destroyed;
+    }
+    
+    TraceRing *addRing() {
+        // Thread ids only need to be consistent within the process,
+        // so that events from the host and plugin libraries on the
+        // same thread are shown together
+        long long tid = (long long)
+            (std::hash<std::thread::id>()(std::this_thread::get_id())
+             % 2147483647);
+        TraceRing *ring = new TraceRing(tid);
+        lock_guard<mutex> guard(m_mutex);
+        m_rings.push_back(ring);
+        return ring;
+    }
+
+    bool write(std::ostream &out, const char *separator) {
+        bool any = false;
+        int pid = int(getpid());
+        lock_guard<mutex> guard(m_mutex);
+        for (size_t i = 0; i < m_rings.size(); ++i) {
+            vector<TraceEvent> events;
+            m_rings[i]->read(events);
+            for (size_t j = 0; j < events.size(); ++j) {
+                if (any) out << separator;
+                writeEvent(out, events[j], pid, m_rings[i]->getThreadId());
+                any = true;
+            }
+        }
+        return any;
+    }
+
+    void clear() {
+        lock_guard<mutex> guard(m_mutex);
+        for (size_t i = 0; i < m_rings.size(); ++i) {
+            m_rings[i]->clear();
+        }
+    }
+
+private:
+    mutex m_mutex;
+    vector<TraceRing *> m_rings;
+    static bool m_destroyed;
+
+    static void writeMicroseconds(std::ostream &out, long long ns) {
+        char buf[40];
+        snprintf(buf, sizeof(buf), "%lld.%03d", ns / 1000, int(ns % 1000));
+        out << buf;
+    }
+    
+    static void writeEvent(std::ostream &out, const TraceEvent &e,
+                           int pid, long long tid) {
+        out << "{\"name\":\"";
+        for (const char *c = e.name; *c; ++c) {
+            if (*c == '"' || *c == '\\') out << '\\';
+            if ((unsigned char)*c >= ' ') out << *c;
+        }
+        out << "\",\"cat\":\"" << traceCategory
+            << "\",\"ph\":\"X\",\"pid\":" << pid
+            << ",\"tid\":" << tid << ",\"ts\":";
+        writeMicroseconds(out, e.start);
+        out << ",\"dur\":";
+        writeMicroseconds(out, e.end - e.start);
+        out << "}";
+    }
+
+    // Append our events to the file named in VAMP_TRACE_FILE, using
+    // the variant of the trace format in which the closing bracket of
+    // the array is omitted, so that several libraries can add to the
+    // same file
+    void appendToFile() {
+        const char *path = getenv("VAMP_TRACE_FILE");
+        if (!path || !*path) return;
+        std::ostringstream out;
+        if (!write(out, ",\n")) return;
+        FILE *f = fopen(path, "a");
+        if (!f) return;
+        fseek(f, 0, SEEK_END);
+        if (ftell(f) == 0) fputs("[\n", f);
+        fputs(out.str().c_str(), f);
+        fputs(",\n", f);
+        fclose(f);
+    }
+};
+
+bool TraceRegistry::m_destroyed = false;
+
+thread_local TraceRing *threadRing = 0;
+
+}
+
+long long
+Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void
+Trace::record(const char *name, long long start, long long end)
+{
+    if (TraceRegistry::isDestroyed()) return;
+    if (!threadRing) {
+        threadRing = TraceRegistry::getInstance().addRing();
+    }
+    threadRing->record(name, start, end);
+}
+
+void
+Trace::writeChromeTrace(std::ostream &out)
+{
+    out << "[\n";
+    if (!TraceRegistry::isDestroyed()) {
+        if (TraceRegistry::getInstance().write(out, ",\n")) out << "\n";
+    }
+    out << "]\n";
+}
+
+void
+Trace::clear()
+{
+    if (TraceRegistry::isDestroyed()) return;
+    TraceRegistry::getInstance().clear();
+}
+
+}
+
+_VAMP_SDK_PLUGSPACE_END(Trace.cpp)
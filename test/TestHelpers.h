@@ -0,0 +1,275 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#ifndef _VAMP_TEST_HELPERS_H_
+#define _VAMP_TEST_HELPERS_H_
+
+/*
+ * Small shared support for the SDK behaviour tests in this
+ * directory. Each test is a standalone program that exits with a
+ * nonzero status if any of its checks failed; run-sdk-tests.sh runs
+ * them all. The tests expect VAMP_PATH to find the example plugins.
+ */
+
+#include <vamp-hostsdk/PluginLoader.h>
+#include <vamp-hostsdk/Plugin.h>
+#include <vamp-hostsdk/RealTime.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <iterator>
+
+#include <dirent.h>
+#include <unistd.h>
+
+namespace TestHelpers {
+
+inline int &failures()
+{
+    static int n = 0;
+    return n;
+}
+
+inline void check(bool ok, const char *what, const char *file, int line)
+{
+    if (!ok) {
+        std::cerr << file << ":" << line << ": check failed: "
+                  << what << std::endl;
+        ++failures();
+    }
+}
+
+inline int finish(const char *name)
+{
+    if (failures() > 0) {
+        std::cerr << name << ": " << failures() << " check(s) failed"
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Deterministic test signal: a sine per channel at a different
+// frequency, with a short burst of noise every quarter second
+inline std::vector<std::vector<float> >
+makeSignal(int channels, size_t frames, float rate)
+{
+    std::vector<std::vector<float> > signal
+        (channels, std::vector<float>(frames, 0.f));
+    unsigned int seed = 1;
+    for (int c = 0; c < channels; ++c) {
+        for (size_t i = 0; i < frames; ++i) {
+            float v = 0.3f * float(sin(2.0 * M_PI * 440.0 * (c + 1) *
+                                       double(i) / rate));
+            if (i % size_t(rate / 4) < 200) {
+                seed = seed * 1103515245u + 12345u;
+                v += float((seed >> 16) & 0x7fff) / 32768.f - 0.5f;
+            }
+            signal[c][i] = v;
+        }
+    }
+    return signal;
+}
+
+// Feed the signal to an initialised plugin in blocks, zero-padding
+// the last, and collect every feature returned including the
+// remaining features at the end
+inline Vamp::Plugin::FeatureSet
+runPlugin(Vamp::Plugin *plugin,
+          const std::vector<std::vector<float> > &signal,
+          size_t blockSize, size_t stepSize, float rate)
+{
+    Vamp::Plugin::FeatureSet all;
+    int channels = int(signal.size());
+    size_t frames = signal.empty() ? 0 : signal[0].size();
+    std::vector<std::vector<float> > block
+        (channels, std::vector<float>(blockSize));
+    std::vector<const float *> ptrs(channels);
+    for (size_t pos = 0; pos < frames; pos += stepSize) {
+        for (int c = 0; c < channels; ++c) {
+            for (size_t i = 0; i < blockSize; ++i) {
+                block[c][i] = (pos + i < frames ? signal[c][pos + i] : 0.f);
+            }
+            ptrs[c] = block[c].data();
+        }
+        Vamp::Plugin::FeatureSet fs = plugin->process
+            (ptrs.data(), Vamp::RealTime::frame2RealTime(long(pos), int(rate)));
+        for (auto &o : fs) {
+            all[o.first].insert(all[o.first].end(),
+                                o.second.begin(), o.second.end());
+        }
+    }
+    Vamp::Plugin::FeatureSet rem = plugin->getRemainingFeatures();
+    for (auto &o : rem) {
+        all[o.first].insert(all[o.first].end(),
+                            o.second.begin(), o.second.end());
+    }
+    return all;
+}
+
+inline bool sameFeature(const Vamp::Plugin::Feature &a,
+                        const Vamp::Plugin::Feature &b)
+{
+    return a.hasTimestamp == b.hasTimestamp &&
+        (!a.hasTimestamp || a.timestamp == b.timestamp) &&
+        a.hasDuration == b.hasDuration &&
+        (!a.hasDuration || a.duration == b.duration) &&
+        a.values == b.values &&
+        a.label == b.label;
+}
+
+inline bool sameFeatures(const Vamp::Plugin::FeatureSet &a,
+                         const Vamp::Plugin::FeatureSet &b)
+{
+    if (a.size() != b.size()) return false;
+    for (auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j) {
+        if (i->first != j->first) return false;
+        if (i->second.size() != j->second.size()) return false;
+        for (size_t k = 0; k < i->second.size(); ++k) {
+            if (!sameFeature(i->second[k], j->second[k])) return false;
+        }
+    }
+    return true;
+}
+
+// A temporary directory that is removed, with the files directly
+// inside it, on destruction
+class TempDir
+{
+public:
+    TempDir() {
+        const char *base = getenv("TMPDIR");
+        std::string templ = std::string(base ? base : "/tmp") +
+            "/vamp-test-XXXXXX";
+        std::vector<char> buf(templ.begin(), templ.end());
+        buf.push_back('\0');
+        if (mkdtemp(buf.data())) m_path = buf.data();
+    }
+    ~TempDir() {
+        if (m_path == "") return;
+        DIR *d = opendir(m_path.c_str());
+        if (d) {
+            while (struct dirent *e = readdir(d)) {
+                std::string name = e->d_name;
+                if (name == "." || name == "..") continue;
+                unlink((m_path + "/" + name).c_str());
+            }
+            closedir(d);
+        }
+        rmdir(m_path.c_str());
+    }
+    bool ok() const { return m_path != ""; }
+    std::string path() const { return m_path; }
+    std::string file(std::string name) const { return m_path + "/" + name; }
+private:
+    std::string m_path;
+    TempDir(const TempDir &);
+    TempDir &operator=(const TempDir &);
+};
+
+inline std::string readFile(std::string path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+}
+
+inline bool writeFile(std::string path, const std::string &data)
+{
+    std::ofstream out(path.c_str(), std::ios::binary);
+    out << data;
+    return bool(out);
+}
+
+// Quantise a signal to 16-bit samples, interleaved
+inline std::vector<int16_t>
+interleave16(const std::vector<std::vector<float> > &signal)
+{
+    std::vector<int16_t> samples;
+    size_t frames = signal.empty() ? 0 : signal[0].size();
+    for (size_t i = 0; i < frames; ++i) {
+        for (size_t c = 0; c < signal.size(); ++c) {
+            long v = lrintf(signal[c][i] * 32767.f);
+            if (v > 32767) v = 32767;
+            if (v < -32768) v = -32768;
+            samples.push_back(int16_t(v));
+        }
+    }
+    return samples;
+}
+
+// The contents of a 16-bit PCM WAV file holding the given
+// interleaved samples
+inline std::string
+wavData(const std::vector<int16_t> &samples, int channels, int rate)
+{
+    std::string s;
+    auto put16 = [&](long v) {
+        s += char(v & 0xff);
+        s += char((v >> 8) & 0xff);
+    };
+    auto put32 = [&](long v) {
+        put16(v & 0xffff);
+        put16((v >> 16) & 0xffff);
+    };
+    long bytes = long(samples.size()) * 2;
+    s += "RIFF";
+    put32(36 + bytes);
+    s += "WAVEfmt ";
+    put32(16);
+    put16(1);
+    put16(channels);
+    put32(rate);
+    put32(long(rate) * channels * 2);
+    put16(channels * 2);
+    put16(16);
+    s += "data";
+    put32(bytes);
+    for (size_t i = 0; i < samples.size(); ++i) put16(samples[i]);
+    return s;
+}
+
+}
+
+#define CHECK(cond) TestHelpers::check((cond), #cond, __FILE__, __LINE__)
+
+#endif
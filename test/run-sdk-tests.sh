@@ -0,0 +1,35 @@
+#!/bin/bash
+
+# Run the SDK behaviour tests named on the command line. Each is
+# either a test program or a shell script, and passes if it exits
+# with status zero. The tests find the example plugins through
+# VAMP_PATH, and those that run the simple host find it through
+# VAMP_HOST.
+
+set -u
+
+MYDIR=$(dirname "$0")
+
+if [ -z "${VAMP_PATH:-}" ]; then
+    export VAMP_PATH="$MYDIR/../examples"
+fi
+if [ -z "${VAMP_HOST:-}" ]; then
+    export VAMP_HOST="$MYDIR/../host/vamp-simple-host"
+fi
+
+some_failed=nope
+
+for test in "$@"; do
+    name=$(basename "$test")
+    if "$test" ; then
+        echo "$name: ok"
+    else
+        echo "*** $name: FAILED"
+        some_failed=yup
+    fi
+done
+
+if [ "$some_failed" != "nope" ]; then
+    echo; echo "*** Some tests failed!"; echo
+    exit 1
+fi
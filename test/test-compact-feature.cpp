@@ -0,0 +1,277 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * FeatureValues must keep short value arrays inline, longer ones in
+ * an arena or in memory of its own, and copy and move them correctly.
+ * Features delivered to a CompactFeatureSink through an adapter chain
+ * must be the same as those returned by process() and
+ * getRemainingFeatures().
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/CompactFeature.h>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::RealTime;
+using Vamp::HostExt::PluginLoader;
+using Vamp::HostExt::FeatureArena;
+using Vamp::HostExt::FeatureValues;
+using Vamp::HostExt::CompactFeature;
+using Vamp::HostExt::CompactFeatureSink;
+
+static const float rate = 44100.f;
+
+static bool
+holds(const FeatureValues &v, const vector<float> &expected)
+{
+    return v.toVector() == expected;
+}
+
+static vector<float>
+ramp(size_t n)
+{
+    vector<float> v(n);
+    for (size_t i = 0; i < n; ++i) v[i] = float(i) * 0.5f + 1.f;
+    return v;
+}
+
+static void
+testValues()
+{
+    FeatureArena arena;
+    
+    FeatureValues empty;
+    CHECK(empty.empty() && empty.size() == 0 && !empty.isInArena());
+
+    // Short arrays are inline whether or not an arena is given
+    vector<float> shortValues = ramp(FeatureValues::InlineCapacity);
+    FeatureValues inlined(shortValues.data(), shortValues.size(), &arena);
+    CHECK(holds(inlined, shortValues));
+    CHECK(!inlined.isInArena());
+    CHECK(inlined.data() != shortValues.data());
+
+    // Long arrays are in the arena if there is one, otherwise owned
+    vector<float> longValues = ramp(300);
+    FeatureValues inArena(longValues.data(), longValues.size(), &arena);
+    FeatureValues owned(longValues);
+    CHECK(holds(inArena, longValues));
+    CHECK(holds(owned, longValues));
+    CHECK(inArena.isInArena());
+    CHECK(!owned.isInArena());
+
+    // A copy of arena-backed values is independent of the arena
+    FeatureValues copied(inArena);
+    CHECK(!copied.isInArena());
+    CHECK(copied.data() != inArena.data());
+    CHECK(holds(copied, longValues));
+
+    // A move keeps the arena reference and empties the source
+    const float *where = inArena.data();
+    FeatureValues moved(std::move(inArena));
+    CHECK(moved.isInArena());
+    CHECK(moved.data() == where);
+    CHECK(holds(moved, longValues));
+    CHECK(inArena.size() == 0);
+
+    // Assignment in each direction between inline and external
+    FeatureValues assigned(shortValues);
+    assigned = owned;
+    CHECK(holds(assigned, longValues));
+    CHECK(assigned.data() != owned.data());
+    assigned = inlined;
+    CHECK(holds(assigned, shortValues));
+    assigned = std::move(owned);
+    CHECK(holds(assigned, longValues));
+    CHECK(!assigned.isInArena());
+    assigned = assigned;
+    CHECK(holds(assigned, longValues));
+
+    // Writing through a copy does not change the original
+    copied[0] = -1.f;
+    CHECK(moved[0] == longValues[0]);
+
+    // After clearing, the arena's space is reused rather than grown
+    arena.clear();
+    FeatureValues reused(longValues.data(), longValues.size(), &arena);
+    CHECK(reused.data() == where);
+    CHECK(holds(reused, longValues));
+
+    // Many allocations, some larger than any single block
+    arena.clear();
+    vector<FeatureValues> many;
+    for (size_t i = 0; i < 200; ++i) {
+        vector<float> v = ramp(5 + (i * 37) % 5000);
+        many.push_back(FeatureValues(v.data(), v.size(), &arena));
+    }
+    bool allIntact = true;
+    for (size_t i = 0; i < many.size(); ++i) {
+        if (!holds(many[i], ramp(5 + (i * 37) % 5000))) allIntact = false;
+    }
+    CHECK(allIntact);
+
+    // Conversion to and from Plugin::Feature
+    Plugin::Feature f;
+    f.hasTimestamp = true;
+    f.timestamp = RealTime(3, 250000000);
+    f.hasDuration = true;
+    f.duration = RealTime(0, 5000);
+    f.values = longValues;
+    f.label = "label";
+    CompactFeature cf(std::move(Plugin::Feature(f)));
+    CHECK(cf.hasTimestamp && cf.timestamp == f.timestamp);
+    CHECK(cf.hasDuration && cf.duration == f.duration);
+    CHECK(holds(cf.values, longValues));
+    CHECK(cf.label == "label");
+    Plugin::Feature back = cf.toFeature();
+    CHECK(back.hasTimestamp && back.timestamp == f.timestamp);
+    CHECK(back.hasDuration && back.duration == f.duration);
+    CHECK(back.values == f.values);
+    CHECK(back.label == f.label);
+}
+
+// Receives compact features, converting them straight away because
+// arena-backed values are only valid during the call
+
+class CollectingSink : public CompactFeatureSink
+{
+public:
+    CollectingSink(Plugin::FeatureSet &target) :
+        m_target(target), m_count(0), m_inArena(0) { }
+
+    void pushCompact(int outputNumber, CompactFeature &&feature) {
+        ++m_count;
+        if (feature.values.isInArena()) ++m_inArena;
+        m_target[outputNumber].push_back(feature.toFeature());
+    }
+
+    int count() const { return m_count; }
+    int inArena() const { return m_inArena; }
+
+private:
+    Plugin::FeatureSet &m_target;
+    int m_count;
+    int m_inArena;
+};
+
+int main()
+{
+    testValues();
+    
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<string> libs;
+    libs.push_back("vamp-example-plugins");
+    PluginLoader::PluginKeyList keys = loader->listPluginsIn(libs);
+    CHECK(!keys.empty());
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(2, 44100, rate);
+
+    int flagSets[] = {
+        PluginLoader::ADAPT_ALL_SAFE,
+        PluginLoader::ADAPT_ALL
+    };
+
+    int totalInArena = 0;
+
+    for (size_t k = 0; k < keys.size(); ++k) {
+        for (int f = 0; f < 2; ++f) {
+
+            Plugin *a = loader->loadPlugin(keys[k], rate, flagSets[f]);
+            Plugin *b = loader->loadPlugin(keys[k], rate, flagSets[f]);
+            CHECK(a != 0 && b != 0);
+            if (!a || !b) continue;
+
+            size_t blockSize = a->getPreferredBlockSize();
+            if (blockSize == 0) blockSize = 1024;
+            size_t stepSize = a->getPreferredStepSize();
+            if (stepSize == 0) {
+                stepSize = (a->getInputDomain() == Plugin::FrequencyDomain ?
+                            blockSize / 2 : blockSize);
+            }
+
+            CHECK(a->initialise(2, stepSize, blockSize));
+            CHECK(b->initialise(2, stepSize, blockSize));
+
+            Plugin::FeatureSet returned =
+                TestHelpers::runPlugin(a, signal, blockSize, stepSize, rate);
+
+            Plugin::FeatureSet delivered;
+            CollectingSink sink(delivered);
+            vector<vector<float> > block(2, vector<float>(blockSize));
+            const float *ptrs[2];
+            size_t frames = signal[0].size();
+            for (size_t pos = 0; pos < frames; pos += stepSize) {
+                for (int c = 0; c < 2; ++c) {
+                    for (size_t i = 0; i < blockSize; ++i) {
+                        block[c][i] = (pos + i < frames ?
+                                       signal[c][pos + i] : 0.f);
+                    }
+                    ptrs[c] = block[c].data();
+                }
+                sink.processFrom(b, ptrs,
+                                 RealTime::frame2RealTime(long(pos), int(rate)));
+            }
+            sink.remainingFeaturesFrom(b);
+
+            if (!TestHelpers::sameFeatures(returned, delivered)) {
+                cerr << "Features differ for " << keys[k]
+                     << " with adapter flags " << flagSets[f] << endl;
+                CHECK(false);
+            }
+
+            size_t expectedCount = 0;
+            for (Plugin::FeatureSet::const_iterator i = returned.begin();
+                 i != returned.end(); ++i) {
+                expectedCount += i->second.size();
+            }
+            CHECK(size_t(sink.count()) == expectedCount);
+            totalInArena += sink.inArena();
+
+            delete a;
+            delete b;
+        }
+    }
+
+    // The power spectrum's features have many values each, and reach
+    // the sink in the adapter's arena
+    CHECK(totalInArena > 0);
+
+    return TestHelpers::finish("test-compact-feature");
+}
@@ -0,0 +1,193 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * Processing double-precision input through processDouble() must
+ * give the same features as processing the same input in float,
+ * exactly for plugins that convert it to float, and to within float
+ * precision for those that read it directly.
+ */
+
+#include "TestHelpers.h"
+
+#include <cmath>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::RealTime;
+using Vamp::HostExt::PluginLoader;
+
+static const float rate = 44100.f;
+
+static Plugin::FeatureSet
+runDouble(Plugin *plugin, const vector<vector<float> > &signal,
+          size_t blockSize, size_t stepSize)
+{
+    Plugin::FeatureSet all;
+    size_t channels = signal.size();
+    size_t frames = signal[0].size();
+    vector<vector<double> > block(channels, vector<double>(blockSize));
+    vector<const double *> ptrs(channels);
+    for (size_t pos = 0; pos < frames; pos += stepSize) {
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t i = 0; i < blockSize; ++i) {
+                block[c][i] = (pos + i < frames ? signal[c][pos + i] : 0.0);
+            }
+            ptrs[c] = block[c].data();
+        }
+        Plugin::FeatureSet fs = plugin->processDouble
+            (ptrs.data(), channels, blockSize,
+             RealTime::frame2RealTime(long(pos), int(rate)));
+        for (auto &o : fs) {
+            all[o.first].insert(all[o.first].end(),
+                                o.second.begin(), o.second.end());
+        }
+    }
+    Plugin::FeatureSet rem = plugin->getRemainingFeatures();
+    for (auto &o : rem) {
+        all[o.first].insert(all[o.first].end(),
+                            o.second.begin(), o.second.end());
+    }
+    return all;
+}
+
+static bool
+closeFeatures(const Plugin::FeatureSet &a, const Plugin::FeatureSet &b)
+{
+    if (a.size() != b.size()) return false;
+    for (auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j) {
+        if (i->first != j->first) return false;
+        if (i->second.size() != j->second.size()) return false;
+        for (size_t k = 0; k < i->second.size(); ++k) {
+            const Plugin::Feature &fa = i->second[k], &fb = j->second[k];
+            if (fa.hasTimestamp != fb.hasTimestamp ||
+                (fa.hasTimestamp && fa.timestamp != fb.timestamp) ||
+                fa.values.size() != fb.values.size()) {
+                return false;
+            }
+            for (size_t v = 0; v < fa.values.size(); ++v) {
+                float x = fa.values[v], y = fb.values[v];
+                if (std::isnan(x) && std::isnan(y)) continue;
+                if (fabsf(x - y) > 1e-4f * (fabsf(x) + fabsf(y)) + 1e-6f) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<string> libs;
+    libs.push_back("vamp-example-plugins");
+    PluginLoader::PluginKeyList keys = loader->listPluginsIn(libs);
+    CHECK(!keys.empty());
+
+    // Mono, so that the channel adapter passes double input through
+    // to plugins that take it rather than mixing it down in float
+    vector<vector<float> > signal = TestHelpers::makeSignal(1, 44100, rate);
+
+    int flagSets[] = {
+        PluginLoader::ADAPT_ALL_SAFE,
+        PluginLoader::ADAPT_ALL
+    };
+
+    int nativeCount = 0;
+    
+    for (size_t k = 0; k < keys.size(); ++k) {
+        for (int f = 0; f < 2; ++f) {
+
+            Plugin *a = loader->loadPlugin(keys[k], rate, flagSets[f]);
+            Plugin *b = loader->loadPlugin(keys[k], rate, flagSets[f]);
+            CHECK(a != 0 && b != 0);
+            if (!a || !b) continue;
+
+            size_t blockSize = a->getPreferredBlockSize();
+            if (blockSize == 0) blockSize = 1024;
+            size_t stepSize = a->getPreferredStepSize();
+            if (stepSize == 0) stepSize = blockSize;
+
+            CHECK(a->initialise(1, stepSize, blockSize));
+            CHECK(b->initialise(1, stepSize, blockSize));
+
+            Plugin::FeatureSet single =
+                TestHelpers::runPlugin(a, signal, blockSize, stepSize, rate);
+            Plugin::FeatureSet twice =
+                runDouble(b, signal, blockSize, stepSize);
+
+            bool ok;
+            if (b->supportsDoubleInput()) {
+                ++nativeCount;
+                ok = closeFeatures(single, twice);
+            } else {
+                ok = TestHelpers::sameFeatures(single, twice);
+            }
+            if (!ok) {
+                cerr << "Double-precision features differ for " << keys[k]
+                     << " with adapter flags " << flagSets[f] << endl;
+                CHECK(false);
+            }
+
+            delete a;
+            delete b;
+        }
+    }
+
+    // The spectral centroid reads double input directly, both as a
+    // frequency-domain plugin and through the input domain adapter,
+    // while the zero crossing counter does not
+    PluginLoader::PluginKey centroid = loader->composePluginKey
+        ("vamp-example-plugins", "spectralcentroid");
+    PluginLoader::PluginKey zc = loader->composePluginKey
+        ("vamp-example-plugins", "zerocrossing");
+    Plugin *p = loader->loadPlugin(centroid, rate, 0);
+    CHECK(p && p->supportsDoubleInput());
+    delete p;
+    p = loader->loadPlugin(centroid, rate, PluginLoader::ADAPT_INPUT_DOMAIN);
+    CHECK(p && p->supportsDoubleInput());
+    delete p;
+    p = loader->loadPlugin(zc, rate, PluginLoader::ADAPT_ALL_SAFE);
+    CHECK(p && !p->supportsDoubleInput());
+    delete p;
+
+    CHECK(nativeCount > 0);
+
+    return TestHelpers::finish("test-double-input");
+}
@@ -0,0 +1,168 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * A plugin told to use only some of its outputs, through
+ * setEnabledOutputs(), must return no features for the others and
+ * the same features as usual for those that remain enabled.
+ */
+
+#include "TestHelpers.h"
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::HostExt::PluginLoader;
+
+static const float rate = 44100.f;
+
+static Plugin::FeatureSet
+run(PluginLoader::PluginKey key, int flags, const vector<bool> *enabled,
+    const vector<vector<float> > &signal)
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+    Plugin *plugin = loader->loadPlugin(key, rate, flags);
+    CHECK(plugin != 0);
+    if (!plugin) return Plugin::FeatureSet();
+
+    if (enabled) plugin->setEnabledOutputs(*enabled);
+
+    size_t blockSize = plugin->getPreferredBlockSize();
+    if (blockSize == 0) blockSize = 1024;
+    size_t stepSize = plugin->getPreferredStepSize();
+    if (stepSize == 0) {
+        stepSize = (plugin->getInputDomain() == Plugin::FrequencyDomain ?
+                    blockSize / 2 : blockSize);
+    }
+
+    CHECK(plugin->initialise(1, stepSize, blockSize));
+    Plugin::FeatureSet fs =
+        TestHelpers::runPlugin(plugin, signal, blockSize, stepSize, rate);
+    delete plugin;
+    return fs;
+}
+
+// Return only those outputs of the feature set that are enabled,
+// leaving out empty outputs, which are equivalent to missing ones
+static Plugin::FeatureSet
+select(const Plugin::FeatureSet &fs, const vector<bool> &enabled)
+{
+    Plugin::FeatureSet result;
+    for (Plugin::FeatureSet::const_iterator i = fs.begin();
+         i != fs.end(); ++i) {
+        if (i->second.empty()) continue;
+        if (size_t(i->first) < enabled.size() && !enabled[i->first]) continue;
+        result[i->first] = i->second;
+    }
+    return result;
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<string> libs;
+    libs.push_back("vamp-example-plugins");
+    PluginLoader::PluginKeyList keys = loader->listPluginsIn(libs);
+    CHECK(!keys.empty());
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(1, 88200, rate);
+
+    int flagSets[] = { 0, PluginLoader::ADAPT_ALL_SAFE };
+
+    for (size_t k = 0; k < keys.size(); ++k) {
+
+        Plugin *probe = loader->loadPlugin(keys[k], rate, 0);
+        CHECK(probe != 0);
+        if (!probe) continue;
+        size_t outputs = probe->getOutputDescriptors().size();
+        delete probe;
+        
+        for (int f = 0; f < 2; ++f) {
+
+            // Frequency-domain plugins need an input domain adapter
+            // to be run from time-domain input
+            int flags = flagSets[f];
+            Plugin *p = loader->loadPlugin(keys[k], rate, flags);
+            if (p->getInputDomain() == Plugin::FrequencyDomain) {
+                flags |= PluginLoader::ADAPT_INPUT_DOMAIN;
+            }
+            delete p;
+            
+            Plugin::FeatureSet all = run(keys[k], flags, 0, signal);
+            vector<bool> everything(outputs, true);
+            
+            vector<vector<bool> > cases;
+            cases.push_back(everything);
+            for (size_t o = 0; o < outputs; ++o) {
+                // Each output alone
+                vector<bool> one(outputs, false);
+                one[o] = true;
+                cases.push_back(one);
+            }
+            // A vector shorter than the output list leaves the rest
+            // enabled
+            cases.push_back(vector<bool>(1, false));
+            
+            for (size_t c = 0; c < cases.size(); ++c) {
+                Plugin::FeatureSet obtained =
+                    run(keys[k], flags, &cases[c], signal);
+                Plugin::FeatureSet expected = select(all, cases[c]);
+                if (!TestHelpers::sameFeatures(expected,
+                                               select(obtained, cases[c]))) {
+                    cerr << "Enabled outputs differ for " << keys[k]
+                         << " case " << c << " flags " << flags << endl;
+                    CHECK(false);
+                }
+                bool disabledEmpty = true;
+                for (Plugin::FeatureSet::const_iterator i = obtained.begin();
+                     i != obtained.end(); ++i) {
+                    if (size_t(i->first) < cases[c].size() &&
+                        !cases[c][i->first] && !i->second.empty()) {
+                        disabledEmpty = false;
+                    }
+                }
+                if (!disabledEmpty) {
+                    cerr << "Disabled output returned features for "
+                         << keys[k] << " case " << c << endl;
+                    CHECK(false);
+                }
+            }
+        }
+    }
+
+    return TestHelpers::finish("test-enabled-outputs");
+}
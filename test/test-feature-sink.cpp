@@ -0,0 +1,132 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * Features delivered to a FeatureSink through an adapter chain, using
+ * FeatureSink::processFrom() and remainingFeaturesFrom(), must be
+ * the same as those returned by process() and getRemainingFeatures().
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/FeatureSink.h>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::RealTime;
+using Vamp::HostExt::PluginLoader;
+using Vamp::HostExt::FeatureSetSink;
+
+static const float rate = 44100.f;
+
+static Plugin::FeatureSet
+runIntoSink(Plugin *plugin, const vector<vector<float> > &signal,
+            size_t blockSize, size_t stepSize)
+{
+    Plugin::FeatureSet all;
+    FeatureSetSink sink(all);
+    int channels = int(signal.size());
+    size_t frames = signal[0].size();
+    vector<vector<float> > block(channels, vector<float>(blockSize));
+    vector<const float *> ptrs(channels);
+    for (size_t pos = 0; pos < frames; pos += stepSize) {
+        for (int c = 0; c < channels; ++c) {
+            for (size_t i = 0; i < blockSize; ++i) {
+                block[c][i] = (pos + i < frames ? signal[c][pos + i] : 0.f);
+            }
+            ptrs[c] = block[c].data();
+        }
+        sink.processFrom(plugin, ptrs.data(),
+                         RealTime::frame2RealTime(long(pos), int(rate)));
+    }
+    sink.remainingFeaturesFrom(plugin);
+    return all;
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<string> libs;
+    libs.push_back("vamp-example-plugins");
+    PluginLoader::PluginKeyList keys = loader->listPluginsIn(libs);
+    CHECK(!keys.empty());
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(2, 44100, rate);
+
+    int flagSets[] = {
+        PluginLoader::ADAPT_ALL_SAFE,
+        PluginLoader::ADAPT_ALL
+    };
+
+    for (size_t k = 0; k < keys.size(); ++k) {
+        for (int f = 0; f < 2; ++f) {
+
+            Plugin *a = loader->loadPlugin(keys[k], rate, flagSets[f]);
+            Plugin *b = loader->loadPlugin(keys[k], rate, flagSets[f]);
+            CHECK(a != 0 && b != 0);
+            if (!a || !b) continue;
+
+            size_t blockSize = a->getPreferredBlockSize();
+            if (blockSize == 0) blockSize = 1024;
+            size_t stepSize = a->getPreferredStepSize();
+            if (stepSize == 0) {
+                stepSize = (a->getInputDomain() == Plugin::FrequencyDomain ?
+                            blockSize / 2 : blockSize);
+            }
+
+            CHECK(a->initialise(2, stepSize, blockSize));
+            CHECK(b->initialise(2, stepSize, blockSize));
+
+            Plugin::FeatureSet returned =
+                TestHelpers::runPlugin(a, signal, blockSize, stepSize, rate);
+            Plugin::FeatureSet delivered =
+                runIntoSink(b, signal, blockSize, stepSize);
+
+            if (!TestHelpers::sameFeatures(returned, delivered)) {
+                cerr << "Features differ for " << keys[k]
+                     << " with adapter flags " << flagSets[f] << endl;
+                CHECK(false);
+            }
+
+            delete a;
+            delete b;
+        }
+    }
+
+    return TestHelpers::finish("test-feature-sink");
+}
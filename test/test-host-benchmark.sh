@@ -0,0 +1,98 @@
+#!/bin/bash
+
+# The simple host's --benchmark mode must process the whole input the
+# requested number of times and report consistent figures, for both a
+# file and a synthetic input, and must refuse options it does not
+# support.
+
+set -eu
+
+MYDIR=$(dirname "$0")
+TEST_FILE="$MYDIR/testsignal.wav"
+
+tmpdir=$(mktemp -d "${TMPDIR:-/tmp}/vamp-test-XXXXXX")
+trap 'rm -rf "$tmpdir"' 0
+
+field() {
+    sed -n "s/^ *\"$1\": \(.*\),\$/\1/p" "$2"
+}
+
+fail() {
+    echo "$@" 1>&2
+    exit 1
+}
+
+# Little-endian unsigned integer of $3 bytes at offset $2 in file $1
+le_uint() {
+    od -An -t u1 -j "$2" -N "$3" "$1" |
+        awk '{ for (i = NF; i >= 1; --i) v = v * 256 + $i } END { print v }'
+}
+
+# Number of sample frames in a WAV file, from its data chunk size and
+# the block alignment in its format chunk
+wav_frames() {
+    file="$1"
+    pos=12
+    align=0
+    while true; do
+        id=$(tail -c +$((pos + 1)) "$file" | head -c 4)
+        size=$(le_uint "$file" $((pos + 4)) 4)
+        [ -n "$size" ] || fail "No data chunk in $file"
+        case "$id" in
+            "fmt ") align=$(le_uint "$file" $((pos + 20)) 2) ;;
+            data)
+                [ "$align" -gt 0 ] || fail "No format chunk in $file"
+                echo $((size / align))
+                return ;;
+        esac
+        pos=$((pos + 8 + size + size % 2))
+    done
+}
+
+check_report() {
+    report="$1"
+    runs="$2"
+    frames=$(field frames "$report")
+    step=$(field stepSize "$report")
+    blocks=$(field blocks "$report")
+    [ "$(field runs "$report")" = "$runs" ] ||
+        fail "Wrong run count in $report"
+    [ "$(field runSeconds "$report" | tr -cd , | wc -c)" = $((runs - 1)) ] ||
+        fail "Wrong number of run timings in $report"
+    [ "$blocks" -ge $(( frames / step )) ] ||
+        fail "Block count $blocks too small for $frames frames in $report"
+    grep -q '"processLatencyNs": { "p50": [0-9]*, "p99": [0-9]*, "max": [0-9]* }' \
+         "$report" || fail "No latency figures in $report"
+}
+
+"$VAMP_HOST" --benchmark --runs 3 --warmup 1 \
+             vamp-example-plugins:zerocrossing "$TEST_FILE" \
+             -o "$tmpdir/file.json" 2>/dev/null
+
+check_report "$tmpdir/file.json" 3
+[ "$(field frames "$tmpdir/file.json")" = "$(wav_frames "$TEST_FILE")" ] ||
+    fail "Wrong frame count for test file"
+[ "$(field warmupRuns "$tmpdir/file.json")" = 1 ] ||
+    fail "Wrong warm-up count for test file"
+
+# The zero crossing plugin returns one feature per block, so a normal
+# run shows how many blocks the benchmark should have processed
+
+"$VAMP_HOST" vamp-example-plugins:zerocrossing "$TEST_FILE" \
+             -o "$tmpdir/features.txt" 2>/dev/null
+[ "$(field blocks "$tmpdir/file.json")" = $(wc -l < "$tmpdir/features.txt") ] ||
+    fail "Benchmark block count differs from a normal run"
+
+"$VAMP_HOST" --benchmark --runs 2 --warmup 0 --synthetic 2 \
+             vamp-example-plugins:spectralcentroid \
+             -o "$tmpdir/synth.json" 2>/dev/null
+
+check_report "$tmpdir/synth.json" 2
+rate=$(field sampleRate "$tmpdir/synth.json")
+[ "$(field frames "$tmpdir/synth.json")" = $((rate * 2)) ] ||
+    fail "Wrong frame count for synthetic input"
+
+if "$VAMP_HOST" --benchmark --profile vamp-example-plugins:zerocrossing \
+                "$TEST_FILE" >/dev/null 2>&1; then
+    fail "Benchmark mode accepted --profile"
+fi
@@ -0,0 +1,361 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+/*
+ * The simple host's JSON Lines and CSV output formats must carry the
+ * same features as its text format, with each JSON line a flat
+ * object with its fields in the documented order and each CSV row
+ * holding output, time, duration, label and then the values.
+ */
+
+#include "TestHelpers.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <sys/wait.h>
+
+using namespace std;
+
+static const int rate = 44100;
+static const int channels = 2;
+
+struct Record
+{
+    string output;
+    string time;      // seconds, or a frame number with -s
+    string duration;  // empty if the feature has none
+    vector<string> values;
+    bool hasLabel;
+    string label;
+    Record() : hasLabel(false) { }
+};
+
+static int
+exitStatus(int status)
+{
+    return (status != -1 && WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+}
+
+static vector<string>
+lines(const string &text)
+{
+    vector<string> result;
+    istringstream in(text);
+    string line;
+    while (getline(in, line)) result.push_back(line);
+    return result;
+}
+
+static bool
+isNumber(const string &s)
+{
+    if (s.empty()) return false;
+    char *end = 0;
+    strtod(s.c_str(), &end);
+    return *end == '\0';
+}
+
+static bool
+parseJsonString(const string &s, size_t &i, string &out)
+{
+    if (i >= s.size() || s[i] != '"') return false;
+    out = "";
+    for (++i; i < s.size(); ++i) {
+        if (s[i] == '"') {
+            ++i;
+            return true;
+        }
+        if (s[i] == '\\') {
+            if (++i >= s.size()) return false;
+            if (s[i] == 'u') {
+                if (i + 4 >= s.size()) return false;
+                out += char(strtol(s.substr(i + 1, 4).c_str(), 0, 16));
+                i += 4;
+            } else {
+                out += s[i];
+            }
+        } else {
+            out += s[i];
+        }
+    }
+    return false;
+}
+
+static bool
+parseJsonNumber(const string &s, size_t &i, string &out)
+{
+    size_t start = i;
+    while (i < s.size() && s[i] != ',' && s[i] != ']' && s[i] != '}') ++i;
+    out = s.substr(start, i - start);
+    return out == "null" || isNumber(out);
+}
+
+// Parse one JSON line, requiring exactly the fields the host writes
+// and in the order it writes them
+static bool
+parseJson(const string &line, bool useFrames, Record &r)
+{
+    size_t i = 0;
+    string key;
+    if (line.size() < 2 || line[i++] != '{' || line[line.size()-1] != '}') {
+        return false;
+    }
+    
+    if (!parseJsonString(line, i, key) || key != "output" ||
+        line[i++] != ':' || !parseJsonString(line, i, r.output) ||
+        line[i++] != ',') {
+        return false;
+    }
+
+    if (!parseJsonString(line, i, key) ||
+        key != (useFrames ? "frame" : "timestamp") ||
+        line[i++] != ':' || !parseJsonNumber(line, i, r.time) ||
+        line[i++] != ',') {
+        return false;
+    }
+
+    if (!parseJsonString(line, i, key)) return false;
+    if (key == (useFrames ? "durationFrames" : "duration")) {
+        if (line[i++] != ':' || !parseJsonNumber(line, i, r.duration) ||
+            line[i++] != ',' || !parseJsonString(line, i, key)) {
+            return false;
+        }
+    }
+
+    if (key != "values" || line[i++] != ':' || line[i++] != '[') {
+        return false;
+    }
+    if (line[i] == ']') {
+        ++i;
+    } else {
+        while (true) {
+            string v;
+            if (!parseJsonNumber(line, i, v)) return false;
+            r.values.push_back(v);
+            if (line[i] == ']') {
+                ++i;
+                break;
+            }
+            if (line[i++] != ',') return false;
+        }
+    }
+
+    if (line[i] == ',') {
+        ++i;
+        if (!parseJsonString(line, i, key) || key != "label" ||
+            line[i++] != ':' || !parseJsonString(line, i, r.label)) {
+            return false;
+        }
+        r.hasLabel = true;
+    }
+
+    return i == line.size() - 1;
+}
+
+static vector<string>
+splitCsv(const string &line)
+{
+    vector<string> fields;
+    string field;
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"') {
+                if (i + 1 < line.size() && line[i+1] == '"') {
+                    field += '"';
+                    ++i;
+                } else {
+                    quoted = false;
+                }
+            } else {
+                field += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.push_back(field);
+            field = "";
+        } else {
+            field += c;
+        }
+    }
+    fields.push_back(field);
+    return fields;
+}
+
+static bool
+parseCsv(const string &line, Record &r)
+{
+    vector<string> fields = splitCsv(line);
+    if (fields.size() < 4) return false;
+    r.output = fields[0];
+    r.time = fields[1];
+    r.duration = fields[2];
+    r.label = fields[3];
+    r.hasLabel = (r.label != "");
+    if (!isNumber(r.time)) return false;
+    if (r.duration != "" && !isNumber(r.duration)) return false;
+    for (size_t i = 4; i < fields.size(); ++i) {
+        if (!isNumber(fields[i])) return false;
+        r.values.push_back(fields[i]);
+    }
+    return true;
+}
+
+static string
+trim(const string &s)
+{
+    size_t a = s.find_first_not_of(' ');
+    if (a == string::npos) return "";
+    return s.substr(a, s.find_last_not_of(' ') - a + 1);
+}
+
+// The text format has no output id and does not mark where the
+// values end and the label begins, so check a text line against a
+// record already parsed from one of the other formats
+static bool
+matchesText(const string &line, const Record &r)
+{
+    size_t colon = line.find(':');
+    if (colon == string::npos) return false;
+
+    string stamp = line.substr(0, colon);
+    size_t comma = stamp.find(',');
+    string time = trim(stamp.substr(0, comma));
+    string duration =
+        (comma == string::npos ? "" : trim(stamp.substr(comma + 1)));
+    if (time != r.time || duration != r.duration) return false;
+
+    // Values are printed to the stream's default six digits
+    istringstream in(line.substr(colon + 1));
+    for (size_t i = 0; i < r.values.size(); ++i) {
+        string word;
+        if (!(in >> word)) return false;
+        double expected = strtod(r.values[i].c_str(), 0);
+        double obtained = strtod(word.c_str(), 0);
+        if (fabs(obtained - expected) > 1e-5 * fabs(expected) + 1e-30) {
+            return false;
+        }
+    }
+
+    string label;
+    getline(in, label);
+    return trim(label) == r.label;
+}
+
+int main()
+{
+    const char *host = getenv("VAMP_HOST");
+    CHECK(host != 0);
+    if (!host) return TestHelpers::finish("test-host-output-formats");
+
+    TestHelpers::TempDir tmp;
+    CHECK(tmp.ok());
+
+    vector<vector<float> > signal =
+        TestHelpers::makeSignal(channels, rate * 4, float(rate));
+    string wav = tmp.file("signal.wav");
+    CHECK(TestHelpers::writeFile
+          (wav, TestHelpers::wavData(TestHelpers::interleave16(signal),
+                                     channels, rate)));
+
+    // One value per feature, many values per feature, values with a
+    // duration and a label, and features with no values at all
+    const char *plugins[] = {
+        "vamp-example-plugins:zerocrossing:counts",
+        "vamp-example-plugins:powerspectrum:powerspectrum",
+        "vamp-example-plugins:fixedtempo:tempo",
+        "vamp-example-plugins:percussiononsets:onsets"
+    };
+    const char *outputs[] = { "counts", "powerspectrum", "tempo", "onsets" };
+
+    for (int p = 0; p < 4; ++p) {
+        for (int useFrames = 0; useFrames < 2; ++useFrames) {
+
+            string result[3];
+            const char *formats[] = { "text", "jsonl", "csv" };
+            for (int f = 0; f < 3; ++f) {
+                string outFile = tmp.file(string("out.") + formats[f]);
+                string command = string(host) + (useFrames ? " -s" : "") +
+                    " --format " + formats[f] + " " + plugins[p] + " " +
+                    wav + " -o " + outFile + " 2>/dev/null";
+                CHECK(exitStatus(system(command.c_str())) == 0);
+                result[f] = TestHelpers::readFile(outFile);
+            }
+
+            vector<string> text = lines(result[0]);
+            vector<string> jsonl = lines(result[1]);
+            vector<string> csv = lines(result[2]);
+
+            CHECK(!text.empty());
+            CHECK(jsonl.size() == text.size());
+            CHECK(csv.size() == text.size());
+            if (jsonl.size() != text.size() || csv.size() != text.size()) {
+                cerr << "Feature counts differ for " << plugins[p] << endl;
+                continue;
+            }
+
+            for (size_t i = 0; i < text.size(); ++i) {
+                Record j, c;
+                bool ok = parseJson(jsonl[i], useFrames, j) &&
+                    parseCsv(csv[i], c) &&
+                    j.output == outputs[p] &&
+                    c.output == j.output &&
+                    c.time == j.time &&
+                    c.duration == j.duration &&
+                    c.values == j.values &&
+                    c.label == j.label &&
+                    matchesText(text[i], j);
+                if (useFrames && ok) {
+                    ok = (j.time.find('.') == string::npos &&
+                          j.duration.find('.') == string::npos);
+                }
+                if (!ok) {
+                    cerr << "Formats disagree for " << plugins[p]
+                         << (useFrames ? " with frames" : "")
+                         << " at line " << i + 1 << ":\n  " << text[i]
+                         << "\n  " << jsonl[i] << "\n  " << csv[i] << endl;
+                    CHECK(false);
+                    break;
+                }
+            }
+        }
+    }
+
+    return TestHelpers::finish("test-host-output-formats");
+}
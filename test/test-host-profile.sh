@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Running the simple host with --profile must produce the same
+# features as a normal run, and a report for both the plugin and the
+# adapted chain, with allocations counted in each.
+
+set -eu
+
+MYDIR=$(dirname "$0")
+TEST_FILE="$MYDIR/testsignal.wav"
+PLUGIN=vamp-example-plugins:zerocrossing
+
+tmpdir=$(mktemp -d "${TMPDIR:-/tmp}/vamp-test-XXXXXX")
+trap 'rm -rf "$tmpdir"' 0
+
+"$VAMP_HOST" "$PLUGIN" "$TEST_FILE" -o "$tmpdir/plain.txt" 2>/dev/null
+"$VAMP_HOST" --profile "$PLUGIN" "$TEST_FILE" -o "$tmpdir/profiled.txt" \
+             2>"$tmpdir/report.txt"
+
+if [ ! -s "$tmpdir/plain.txt" ]; then
+    echo "No features from normal run" 1>&2
+    exit 1
+fi
+
+if ! cmp -s "$tmpdir/plain.txt" "$tmpdir/profiled.txt"; then
+    echo "Features differ when profiling" 1>&2
+    diff "$tmpdir/plain.txt" "$tmpdir/profiled.txt" | head 1>&2
+    exit 1
+fi
+
+for label in plugin adapted; do
+    if ! grep -q "\"label\": \"$label\", \"plugin\": \"zerocrossing\", \"allocationsCounted\": true" "$tmpdir/report.txt"; then
+        echo "No report with counted allocations for \"$label\"" 1>&2
+        exit 1
+    fi
+done
+
+if ! grep -q '"process": { "calls": [1-9][0-9]*,.*"bytesAllocated": [1-9]' \
+     "$tmpdir/report.txt"; then
+    echo "No allocations recorded in process calls" 1>&2
+    exit 1
+fi
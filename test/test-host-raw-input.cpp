@@ -0,0 +1,179 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * The simple host must print the same features for raw samples read
+ * from standard input, as 16-bit integers or as floats, and however
+ * they are split up as they arrive, as it does for the same samples
+ * read from a WAV file. It must refuse raw input without a format.
+ */
+
+#include "TestHelpers.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <csignal>
+#include <sys/wait.h>
+
+using namespace std;
+
+static const int rate = 44100;
+static const int channels = 2;
+
+static int
+exitStatus(int status)
+{
+    return (status != -1 && WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+}
+
+// Run the host with the given arguments, writing the given data to
+// its standard input in chunks of the given sizes in turn
+static int
+runWithInput(string command, const char *data, size_t size,
+             const vector<size_t> &chunks)
+{
+    FILE *p = popen(command.c_str(), "w");
+    if (!p) return -1;
+    size_t pos = 0, c = 0;
+    while (pos < size) {
+        size_t n = chunks[c++ % chunks.size()];
+        if (n > size - pos) n = size - pos;
+        if (fwrite(data + pos, 1, n, p) != n) break;
+        fflush(p);
+        pos += n;
+    }
+    return exitStatus(pclose(p));
+}
+
+int main()
+{
+    const char *host = getenv("VAMP_HOST");
+    CHECK(host != 0);
+    if (!host) return TestHelpers::finish("test-host-raw-input");
+
+    // A host that fails early must not take us with it
+    signal(SIGPIPE, SIG_IGN);
+
+    TestHelpers::TempDir tmp;
+    CHECK(tmp.ok());
+
+    vector<vector<float> > signal =
+        TestHelpers::makeSignal(channels, rate * 3, float(rate));
+
+    // Samples that are exact in both 16-bit and float form
+    vector<int16_t> ints = TestHelpers::interleave16(signal);
+    vector<float> floats;
+    for (size_t i = 0; i < ints.size(); ++i) {
+        floats.push_back(float(ints[i]) / 32768.f);
+    }
+
+    string wav = tmp.file("signal.wav");
+    CHECK(TestHelpers::writeFile(wav, TestHelpers::wavData(ints, channels, rate)));
+
+    const char *plugins[] = {
+        "vamp-example-plugins:zerocrossing:counts",
+        "vamp-example-plugins:spectralcentroid:logcentroid",
+        "vamp-example-plugins:percussiononsets:onsets"
+    };
+
+    vector<size_t> whole(1, size_t(1) << 20);
+    vector<size_t> trickle;
+    trickle.push_back(1);
+    trickle.push_back(3);
+    trickle.push_back(4093);
+    trickle.push_back(7);
+    trickle.push_back(65537);
+
+    string rawArgs = " --rate " + to_string(rate) +
+        " --channels " + to_string(channels);
+    
+    for (int p = 0; p < 3; ++p) {
+        for (int frameLabels = 0; frameLabels < 2; ++frameLabels) {
+
+            string opts = frameLabels ? " -s " : " ";
+            string expectedFile = tmp.file("expected.txt");
+            string command = string(host) + opts + plugins[p] + " " + wav +
+                " -o " + expectedFile + " 2>/dev/null";
+            CHECK(exitStatus(system(command.c_str())) == 0);
+            string expected = TestHelpers::readFile(expectedFile);
+            CHECK(expected != "");
+
+            for (int format = 0; format < 2; ++format) {
+                for (int chunked = 0; chunked < 2; ++chunked) {
+                    string outFile = tmp.file("obtained.txt");
+                    command = string(host) + opts + rawArgs +
+                        (format == 0 ? " --int16 " : " ") +
+                        plugins[p] + " - -o " + outFile + " 2>/dev/null";
+                    const char *data = format == 0 ?
+                        (const char *)ints.data() : (const char *)floats.data();
+                    size_t size = format == 0 ?
+                        ints.size() * sizeof(int16_t) :
+                        floats.size() * sizeof(float);
+                    CHECK(runWithInput(command, data, size,
+                                       chunked ? trickle : whole) == 0);
+                    if (TestHelpers::readFile(outFile) != expected) {
+                        cerr << "Output from standard input differs for "
+                             << plugins[p] << (format == 0 ? " int16" : " float")
+                             << (chunked ? " in chunks" : "")
+                             << (frameLabels ? " with frames" : "") << endl;
+                        CHECK(false);
+                    }
+                }
+            }
+        }
+    }
+
+    // A partial frame at the end of the stream is ignored
+    vector<size_t> chunks(1, 4096);
+    string outFile = tmp.file("partial.txt");
+    string command = string(host) + rawArgs + " --int16 " + plugins[0] +
+        " - -o " + outFile + " 2>/dev/null";
+    string data((const char *)ints.data(), ints.size() * sizeof(int16_t));
+    data += "x";
+    CHECK(runWithInput(command, data.data(), data.size(), chunks) == 0);
+    CHECK(TestHelpers::readFile(outFile) != "");
+
+    // Raw input needs its format, and a file must not be given one
+    command = string(host) + " --channels 2 " + plugins[0] + " - 2>/dev/null";
+    CHECK(runWithInput(command, data.data(), 0, chunks) != 0);
+    command = string(host) + rawArgs + " " + plugins[0] + " " + wav +
+        " >/dev/null 2>&1";
+    CHECK(exitStatus(system(command.c_str())) != 0);
+
+    return TestHelpers::finish("test-host-raw-input");
+}
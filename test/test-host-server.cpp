@@ -0,0 +1,375 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * The simple host's server mode must answer many concurrent requests
+ * with the same features as a direct run, make its socket accessible
+ * only to its own user, refuse to take over a socket that another
+ * server is using while replacing one that is stale, leave anything
+ * else at the socket path alone, and on SIGTERM finish the requests
+ * it has received and exit, removing its socket. A client that does
+ * not send a request line, or sends one that is too long, must be
+ * disconnected rather than hold a worker indefinitely.
+ */
+
+#include "TestHelpers.h"
+
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+static const int rate = 44100;
+static const int channels = 2;
+
+static string host;
+
+static bool
+makeAddress(string path, struct sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, path.c_str());
+    return true;
+}
+
+static int
+connectTo(string path)
+{
+    struct sockaddr_un addr;
+    if (!makeAddress(path, addr)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool
+sendLine(int fd, string line)
+{
+    line += "\n";
+    const char *p = line.c_str();
+    size_t left = line.size();
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+static string
+readAll(int fd)
+{
+    string s;
+    char buf[4096];
+    while (true) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        s.append(buf, n);
+    }
+    close(fd);
+    return s;
+}
+
+static string
+request(string path, string line)
+{
+    int fd = connectTo(path);
+    if (fd < 0) return "";
+    if (!sendLine(fd, line)) {
+        close(fd);
+        return "";
+    }
+    return readAll(fd);
+}
+
+static pid_t
+startServer(string path)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (!freopen("/dev/null", "w", stderr)) _exit(127);
+        execl(host.c_str(), host.c_str(), "--server", path.c_str(),
+              (char *)0);
+        _exit(127);
+    }
+    return pid;
+}
+
+// Wait for the server to accept connections, or to exit; return
+// true if it is accepting
+static bool
+waitForServer(pid_t pid, string path)
+{
+    for (int i = 0; i < 400; ++i) {
+        int fd = connectTo(path);
+        if (fd >= 0) {
+            close(fd);
+            return true;
+        }
+        int status;
+        if (waitpid(pid, &status, WNOHANG) == pid) return false;
+        this_thread::sleep_for(chrono::milliseconds(25));
+    }
+    return false;
+}
+
+// Wait for the process to exit, returning its exit status, or -1 if
+// it did not exit normally within the time allowed
+static int
+waitForExit(pid_t pid)
+{
+    for (int i = 0; i < 800; ++i) {
+        int status;
+        if (waitpid(pid, &status, WNOHANG) == pid) {
+            return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        }
+        this_thread::sleep_for(chrono::milliseconds(25));
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, 0, 0);
+    return -1;
+}
+
+// Wait for the server to close the connection, giving up after a
+// generous multiple of its request timeout; return what was read
+// and whether the server closed it
+static bool
+waitForClose(int fd, string &received)
+{
+    struct timeval timeout;
+    timeout.tv_sec = 40;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char buf[4096];
+    while (true) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == ECONNRESET) break; // closed with input unread
+        if (n < 0) {
+            close(fd);
+            return false;
+        }
+        if (n == 0) break;
+        received.append(buf, n);
+    }
+    close(fd);
+    return true;
+}
+
+static bool
+exists(string path)
+{
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0;
+}
+
+int main()
+{
+    const char *h = getenv("VAMP_HOST");
+    CHECK(h != 0);
+    if (!h) return TestHelpers::finish("test-host-server");
+    host = h;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    TestHelpers::TempDir tmp;
+    CHECK(tmp.ok());
+    if (!tmp.ok()) return TestHelpers::finish("test-host-server");
+
+    vector<vector<float> > signal =
+        TestHelpers::makeSignal(channels, rate * 2, float(rate));
+    string wav = tmp.file("signal.wav");
+    CHECK(TestHelpers::writeFile
+          (wav, TestHelpers::wavData(TestHelpers::interleave16(signal),
+                                     channels, rate)));
+
+    vector<string> requests;
+    requests.push_back("vamp-example-plugins:zerocrossing:counts " + wav);
+    requests.push_back("-s vamp-example-plugins:spectralcentroid " + wav + " 1");
+    requests.push_back("vamp-example-plugins:percussiononsets:onsets " + wav);
+    requests.push_back("--format jsonl vamp-example-plugins:zerocrossing:zerocrossings " + wav);
+
+    // The same requests run directly
+    vector<string> expected;
+    for (size_t r = 0; r < requests.size(); ++r) {
+        string out = tmp.file("expected.txt");
+        string command = host + " " + requests[r] + " -o " + out +
+            " 2>/dev/null";
+        CHECK(system(command.c_str()) == 0);
+        expected.push_back(TestHelpers::readFile(out));
+        CHECK(expected[r] != "");
+    }
+
+    string path = tmp.file("server.sock");
+    pid_t server = startServer(path);
+    CHECK(server > 0);
+    bool up = waitForServer(server, path);
+    CHECK(up);
+    if (!up) return TestHelpers::finish("test-host-server");
+
+    // Only our own user may use the socket
+    struct stat st;
+    CHECK(lstat(path.c_str(), &st) == 0);
+    CHECK(S_ISSOCK(st.st_mode));
+    CHECK((st.st_mode & 077) == 0);
+
+    // Many more concurrent requests than the server has workers
+    const int nthreads = 12, perThread = 6;
+    vector<string> responses(nthreads * perThread);
+    vector<thread> threads;
+    for (int t = 0; t < nthreads; ++t) {
+        threads.push_back(thread([&, t]() {
+            for (int i = 0; i < perThread; ++i) {
+                int n = t * perThread + i;
+                responses[n] = request(path, requests[n % requests.size()]);
+            }
+        }));
+    }
+    for (int t = 0; t < nthreads; ++t) threads[t].join();
+    int mismatches = 0;
+    for (size_t n = 0; n < responses.size(); ++n) {
+        if (responses[n] != expected[n % requests.size()]) ++mismatches;
+    }
+    CHECK(mismatches == 0);
+
+    // Errors are reported to the client
+    CHECK(request(path, "vamp-example-plugins:nonexistent " + wav)
+          .compare(0, 6, "ERROR:") == 0);
+    CHECK(request(path, "vamp-example-plugins:zerocrossing " +
+                  tmp.file("missing.wav")).compare(0, 6, "ERROR:") == 0);
+    
+    // Clients that send nothing, or never finish their request line,
+    // are disconnected after the server's timeout, and requests made
+    // meanwhile are still served once they are gone
+    vector<int> idle;
+    for (int i = 0; i < 2; ++i) {
+        int fd = connectTo(path);
+        CHECK(fd >= 0);
+        if (i == 1) CHECK(write(fd, "vamp-example", 12) == 12);
+        idle.push_back(fd);
+    }
+    CHECK(request(path, requests[0]) == expected[0]);
+    for (size_t i = 0; i < idle.size(); ++i) {
+        string received;
+        CHECK(waitForClose(idle[i], received));
+        CHECK(received == "");
+    }
+
+    // An overlong request line is refused without a response
+    {
+        int fd = connectTo(path);
+        CHECK(fd >= 0);
+        string junk(100000, 'x');
+        size_t sent = 0;
+        while (sent < junk.size()) {
+            ssize_t n = write(fd, junk.data() + sent, junk.size() - sent);
+            if (n <= 0) break;
+            sent += n;
+        }
+        string received;
+        CHECK(waitForClose(fd, received));
+        CHECK(received == "");
+    }
+    
+    // A second server must not take over the socket of a running one
+    pid_t second = startServer(path);
+    CHECK(waitForExit(second) == 1);
+    CHECK(request(path, requests[0]) == expected[0]);
+
+    // A request already accepted is completed after SIGTERM, and
+    // then the server exits normally and removes its socket
+    int fd = connectTo(path);
+    CHECK(fd >= 0);
+    CHECK(sendLine(fd, requests[2]));
+    this_thread::sleep_for(chrono::milliseconds(200));
+    kill(server, SIGTERM);
+    CHECK(readAll(fd) == expected[2]);
+    CHECK(waitForExit(server) == 0);
+    CHECK(!exists(path));
+
+    // A socket left behind with nobody listening is replaced
+    struct sockaddr_un addr;
+    CHECK(makeAddress(path, addr));
+    int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(::bind(stale, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    close(stale);
+    CHECK(exists(path));
+    server = startServer(path);
+    up = waitForServer(server, path);
+    CHECK(up);
+    if (up) {
+        CHECK(request(path, requests[1]) == expected[1]);
+    }
+
+    // A connection still waiting to send its request does not hold
+    // up the server's exit
+    int waiting = connectTo(path);
+    CHECK(waiting >= 0);
+    this_thread::sleep_for(chrono::milliseconds(200));
+    auto start = chrono::steady_clock::now();
+    kill(server, SIGINT);
+    CHECK(waitForExit(server) == 0);
+    CHECK(chrono::steady_clock::now() - start < chrono::seconds(5));
+    CHECK(!exists(path));
+    if (waiting >= 0) close(waiting);
+
+    // Anything else at the path is left alone
+    CHECK(TestHelpers::writeFile(path, "precious"));
+    server = startServer(path);
+    CHECK(waitForExit(server) == 1);
+    CHECK(TestHelpers::readFile(path) == "precious");
+    
+    return TestHelpers::finish("test-host-server");
+}
@@ -0,0 +1,165 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * PluginInstancePool may be used from several threads at once, while
+ * other threads load and delete plugins through the same PluginLoader
+ * directly. Each instance handed out must be correctly initialised,
+ * and every plugin must be deleted (unloading its library) safely.
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/PluginInstancePool.h>
+
+#include <thread>
+#include <atomic>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::HostExt::PluginLoader;
+using Vamp::HostExt::PluginInstancePool;
+
+static const float rate = 44100.f;
+static const size_t blockSize = 1024;
+
+struct Outcome {
+    int acquired = 0;
+    int refused = 0;
+    int wrong = 0;
+};
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    PluginLoader::PluginKey zc =
+        loader->composePluginKey("vamp-example-plugins", "zerocrossing");
+    PluginLoader::PluginKey sc =
+        loader->composePluginKey("vamp-example-plugins", "spectralcentroid");
+
+    // Reference output for one block of each plugin, from instances
+    // loaded and used on this thread alone
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(1, blockSize, rate);
+
+    Plugin::FeatureSet expected[2];
+    PluginLoader::PluginKey keys[2] = { zc, sc };
+    for (int k = 0; k < 2; ++k) {
+        Plugin *p = loader->loadPlugin
+            (keys[k], rate, PluginLoader::ADAPT_ALL_SAFE);
+        CHECK(p != 0);
+        if (!p) return TestHelpers::finish("test-instance-pool");
+        CHECK(p->initialise(1, blockSize, blockSize));
+        expected[k] = TestHelpers::runPlugin(p, signal, blockSize, blockSize, rate);
+        delete p;
+    }
+
+    PluginInstancePool pool(loader);
+    pool.setMaxIdlePerConfiguration(2);
+
+    const int nthreads = 8;
+    const int iterations = 150;
+    vector<Outcome> outcomes(nthreads);
+    atomic<bool> done(false);
+
+    vector<thread> threads;
+    for (int t = 0; t < nthreads; ++t) {
+        threads.push_back(thread([&, t]() {
+            Outcome &o = outcomes[t];
+            for (int i = 0; i < iterations; ++i) {
+                int k = (t + i) % 2;
+                // Every seventh request asks for more channels than
+                // the plugins accept without channel adaptation, so
+                // fails in initialise and is deleted by the pool
+                bool bad = (i % 7 == 3);
+                Plugin *p = pool.acquire
+                    (keys[k], rate, PluginLoader::ADAPT_INPUT_DOMAIN,
+                     bad ? 3 : 1, blockSize, blockSize);
+                if (!p) {
+                    if (bad) ++o.refused;
+                    else ++o.wrong;
+                    continue;
+                }
+                if (bad) { ++o.wrong; pool.discard(p); continue; }
+                ++o.acquired;
+                Plugin::FeatureSet fs = TestHelpers::runPlugin
+                    (p, signal, blockSize, blockSize, rate);
+                if (!TestHelpers::sameFeatures(fs, expected[k])) ++o.wrong;
+                if (i % 5 == 0) pool.discard(p);
+                else pool.release(p);
+            }
+        }));
+    }
+
+    // Meanwhile, use the loader directly from another thread
+    int direct = 0;
+    thread other([&]() {
+        while (!done) {
+            Plugin *p = loader->loadPlugin(zc, rate, 0);
+            if (p) { ++direct; delete p; }
+            loader->getPluginCategory(sc);
+            loader->listPlugins();
+        }
+    });
+
+    for (int t = 0; t < nthreads; ++t) threads[t].join();
+    done = true;
+    other.join();
+
+    int acquired = 0, refused = 0, wrong = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        acquired += outcomes[t].acquired;
+        refused += outcomes[t].refused;
+        wrong += outcomes[t].wrong;
+    }
+
+    int bad = 0;
+    for (int i = 0; i < iterations; ++i) if (i % 7 == 3) ++bad;
+
+    CHECK(wrong == 0);
+    CHECK(refused == bad * nthreads);
+    CHECK(acquired == (iterations - bad) * nthreads);
+    CHECK(direct > 0);
+
+    // Two configurations, at most two idle instances of each
+    CHECK(pool.getIdleCount() <= 4);
+    pool.clear();
+    CHECK(pool.getIdleCount() == 0);
+
+    return TestHelpers::finish("test-instance-pool");
+}
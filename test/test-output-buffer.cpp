@@ -0,0 +1,214 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * Features written into a host-supplied output buffer, through the
+ * processToBuffer plugin extension, must be the same as those
+ * returned by the plugin's ordinary process function, including when
+ * the host's buffer is too small at first and the features are
+ * retrieved afterwards.
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp/vamp.h>
+#include <vamp-hostsdk/PluginHostAdapter.h>
+#include <vamp-hostsdk/PluginInputDomainAdapter.h>
+
+#include <cstring>
+
+#include <dlfcn.h>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::PluginHostAdapter;
+using Vamp::HostExt::PluginLoader;
+using Vamp::HostExt::PluginInputDomainAdapter;
+
+static const float rate = 44100.f;
+
+static Plugin *adapt(Plugin *plugin)
+{
+    if (plugin->getInputDomain() == Plugin::FrequencyDomain) {
+        return new PluginInputDomainAdapter(plugin);
+    }
+    return plugin;
+}
+
+static bool sameLists(const VampFeatureList *a, const VampFeatureList *b,
+                      unsigned int outputs)
+{
+    for (unsigned int o = 0; o < outputs; ++o) {
+        if (a[o].featureCount != b[o].featureCount) return false;
+        for (unsigned int i = 0; i < a[o].featureCount; ++i) {
+            const VampFeature &fa = a[o].features[i].v1;
+            const VampFeature &fb = b[o].features[i].v1;
+            if (fa.hasTimestamp != fb.hasTimestamp ||
+                fa.sec != fb.sec || fa.nsec != fb.nsec ||
+                fa.valueCount != fb.valueCount) return false;
+            for (unsigned int j = 0; j < fa.valueCount; ++j) {
+                if (fa.values[j] != fb.values[j]) return false;
+            }
+            if ((fa.label == 0) != (fb.label == 0)) return false;
+            if (fa.label && string(fa.label) != fb.label) return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+    string path = loader->getLibraryPathForPlugin
+        ("vamp-example-plugins:powerspectrum");
+    CHECK(path != "");
+
+    void *lib = dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+    CHECK(lib != 0);
+    if (!lib) return TestHelpers::finish("test-output-buffer");
+
+    VampGetPluginDescriptorFunction getDescriptor =
+        (VampGetPluginDescriptorFunction)
+        dlsym(lib, "vampGetPluginDescriptor");
+    VampGetPluginExtensionsFunction getExtensions =
+        (VampGetPluginExtensionsFunction)
+        dlsym(lib, "vampGetPluginExtensions");
+    CHECK(getDescriptor != 0);
+    CHECK(getExtensions != 0);
+    if (!getDescriptor || !getExtensions) {
+        return TestHelpers::finish("test-output-buffer");
+    }
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(1, 44100, rate);
+
+    // Every plugin in the library, through a PluginHostAdapter with
+    // and without the output buffer extensions. The other extensions
+    // are left out, as some (such as the spectrum format) may change
+    // the results legitimately
+
+    const VampPluginDescriptor *desc = 0;
+    for (int i = 0; (desc = getDescriptor(VAMP_API_VERSION, i)); ++i) {
+
+        const VampPluginExtensions *ext = getExtensions(desc);
+        CHECK(VAMP_HAS_EXTENSION(ext, processToBuffer));
+        CHECK(VAMP_HAS_EXTENSION(ext, retrieveFeatures));
+        if (!ext) continue;
+
+        VampPluginExtensions bufferOnly;
+        memset(&bufferOnly, 0, sizeof(bufferOnly));
+        bufferOnly.extensionsSize = sizeof(bufferOnly);
+        bufferOnly.processToBuffer = ext->processToBuffer;
+        bufferOnly.getRemainingFeaturesToBuffer =
+            ext->getRemainingFeaturesToBuffer;
+        bufferOnly.retrieveFeatures = ext->retrieveFeatures;
+
+        Plugin *plain = adapt(new PluginHostAdapter(desc, rate));
+        Plugin *buffered = adapt(new PluginHostAdapter(desc, &bufferOnly, rate));
+
+        size_t blockSize = plain->getPreferredBlockSize();
+        if (blockSize == 0) blockSize = 1024;
+        size_t stepSize = plain->getPreferredStepSize();
+        if (stepSize == 0) stepSize = blockSize;
+
+        CHECK(plain->initialise(1, stepSize, blockSize));
+        CHECK(buffered->initialise(1, stepSize, blockSize));
+
+        Plugin::FeatureSet expected = TestHelpers::runPlugin
+            (plain, signal, blockSize, stepSize, rate);
+        Plugin::FeatureSet obtained = TestHelpers::runPlugin
+            (buffered, signal, blockSize, stepSize, rate);
+
+        if (!TestHelpers::sameFeatures(expected, obtained)) {
+            cerr << "Features differ for " << desc->identifier << endl;
+            CHECK(false);
+        }
+
+        delete plain;
+        delete buffered;
+    }
+
+    // The C API directly, with a buffer too small to begin with
+
+    for (int i = 0; (desc = getDescriptor(VAMP_API_VERSION, i)); ++i) {
+        if (string(desc->identifier) == "powerspectrum") break;
+    }
+    CHECK(desc != 0);
+    if (!desc) return TestHelpers::finish("test-output-buffer");
+
+    const VampPluginExtensions *ext = getExtensions(desc);
+    VampPluginHandle a = desc->instantiate(desc, rate);
+    VampPluginHandle b = desc->instantiate(desc, rate);
+    CHECK(desc->initialise(a, 1, 256, 256));
+    CHECK(desc->initialise(b, 1, 256, 256));
+    unsigned int outputs = desc->getOutputCount(a);
+
+    vector<float> spectrum(258, 0.f);
+    for (size_t j = 0; j < spectrum.size(); ++j) {
+        spectrum[j] = float(j % 7) - 3.f;
+    }
+    const float *input = spectrum.data();
+
+    VampFeatureList *expected = desc->process(a, &input, 1, 0);
+
+    char small[16];
+    size_t required = ext->processToBuffer(b, &input, 1, 0,
+                                           small, sizeof(small));
+    CHECK(required > sizeof(small));
+
+    void *buffer = malloc(required);
+    CHECK(ext->retrieveFeatures(b, buffer, required) == required);
+    CHECK(sameLists(expected, (const VampFeatureList *)buffer, outputs));
+
+    // Once retrieved, the features are gone
+    CHECK(ext->retrieveFeatures(b, buffer, required) < required);
+    CHECK(((const VampFeatureList *)buffer)[0].featureCount == 0);
+
+    // A large enough buffer is written directly
+    memset(buffer, 0, required);
+    desc->releaseFeatureSet(expected);
+    expected = desc->process(a, &input, 2, 0);
+    CHECK(ext->processToBuffer(b, &input, 2, 0, buffer, required) == required);
+    CHECK(sameLists(expected, (const VampFeatureList *)buffer, outputs));
+
+    desc->releaseFeatureSet(expected);
+    free(buffer);
+    desc->cleanup(a);
+    desc->cleanup(b);
+    dlclose(lib);
+
+    return TestHelpers::finish("test-output-buffer");
+}
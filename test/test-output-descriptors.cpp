@@ -0,0 +1,181 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * An output descriptor obtained through the plugin C API must stay
+ * valid until the host releases it, even if the plugin's outputs have
+ * changed and further descriptors have been requested since, or the
+ * plugin has been cleaned up.
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp/vamp.h>
+
+#include <dlfcn.h>
+
+using namespace std;
+using Vamp::HostExt::PluginLoader;
+
+struct Snapshot {
+    string identifier;
+    string name;
+    unsigned int binCount;
+};
+
+static Snapshot snapshot(const VampOutputDescriptor *d)
+{
+    Snapshot s;
+    s.identifier = d->identifier;
+    s.name = d->name;
+    s.binCount = d->binCount;
+    return s;
+}
+
+static bool unchanged(const VampOutputDescriptor *d, const Snapshot &s)
+{
+    return s.identifier == d->identifier &&
+        s.name == d->name &&
+        s.binCount == d->binCount;
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+    string path = loader->getLibraryPathForPlugin
+        ("vamp-example-plugins:powerspectrum");
+    CHECK(path != "");
+
+    void *lib = dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+    CHECK(lib != 0);
+    if (!lib) return TestHelpers::finish("test-output-descriptors");
+
+    VampGetPluginDescriptorFunction fn = (VampGetPluginDescriptorFunction)
+        dlsym(lib, "vampGetPluginDescriptor");
+    CHECK(fn != 0);
+    if (!fn) return TestHelpers::finish("test-output-descriptors");
+
+    const VampPluginDescriptor *desc = 0;
+    for (int i = 0; (desc = fn(VAMP_API_VERSION, i)); ++i) {
+        if (string(desc->identifier) == "powerspectrum") break;
+    }
+    CHECK(desc != 0);
+    if (!desc) return TestHelpers::finish("test-output-descriptors");
+
+    VampPluginHandle h = desc->instantiate(desc, 44100.f);
+    CHECK(h != 0);
+
+    // The power spectrum's bin count follows its block size, and
+    // initialising it marks its outputs as changed
+
+    VampOutputDescriptor *first = desc->getOutputDescriptor(h, 0);
+    VampOutputDescriptor *second = desc->getOutputDescriptor(h, 0);
+    CHECK(first != 0 && second != 0);
+    Snapshot original = snapshot(first);
+
+    CHECK(desc->initialise(h, 1, 256, 256));
+    VampOutputDescriptor *small = desc->getOutputDescriptor(h, 0);
+    CHECK(small != 0);
+    CHECK(small->binCount == 129);
+    Snapshot smallShot = snapshot(small);
+
+    // Releasing one of two references to the original block must
+    // leave the other usable
+    desc->releaseOutputDescriptor(first);
+
+    CHECK(desc->initialise(h, 1, 512, 512));
+    VampOutputDescriptor *large = desc->getOutputDescriptor(h, 0);
+    CHECK(large != 0);
+    CHECK(large->binCount == 257);
+
+    // Allocate a little to encourage reuse of anything freed early
+    for (int i = 0; i < 100; ++i) {
+        vector<char> junk(100 + i * 50, 'x');
+        CHECK(junk.size() > 0);
+    }
+
+    CHECK(unchanged(second, original));
+    CHECK(unchanged(small, smallShot));
+    CHECK(original.binCount != smallShot.binCount);
+
+    desc->releaseOutputDescriptor(second);
+    desc->releaseOutputDescriptor(small);
+
+    // The current block stays available for further requests
+    VampOutputDescriptor *again = desc->getOutputDescriptor(h, 0);
+    CHECK(again == large);
+    CHECK(again->binCount == 257);
+    desc->releaseOutputDescriptor(again);
+    desc->releaseOutputDescriptor(large);
+
+    // Descriptors not yet released when the plugin is cleaned up,
+    // from both a retired block and the current one, stay valid
+    // until the host releases them afterwards
+    VampOutputDescriptor *retired = desc->getOutputDescriptor(h, 0);
+    CHECK(retired != 0);
+    Snapshot retiredShot = snapshot(retired);
+    CHECK(desc->initialise(h, 1, 1024, 1024));
+    VampOutputDescriptor *current = desc->getOutputDescriptor(h, 0);
+    CHECK(current != 0);
+    CHECK(current->binCount == 513);
+    Snapshot currentShot = snapshot(current);
+    desc->cleanup(h);
+
+    for (int i = 0; i < 100; ++i) {
+        vector<char> junk(100 + i * 50, 'x');
+        CHECK(junk.size() > 0);
+    }
+
+    CHECK(unchanged(retired, retiredShot));
+    CHECK(unchanged(current, currentShot));
+    desc->releaseOutputDescriptor(retired);
+    desc->releaseOutputDescriptor(current);
+
+    // Also when the plugin was the adapter's last one
+    VampPluginHandle h2 = desc->instantiate(desc, 44100.f);
+    CHECK(h2 != 0);
+    VampOutputDescriptor *last = desc->getOutputDescriptor(h2, 0);
+    CHECK(last != 0);
+    Snapshot lastShot = snapshot(last);
+    desc->cleanup(h2);
+    CHECK(unchanged(last, lastShot));
+    desc->releaseOutputDescriptor(last);
+
+    dlclose(lib);
+
+    return TestHelpers::finish("test-output-descriptors");
+}
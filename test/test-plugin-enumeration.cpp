@@ -0,0 +1,150 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+/*
+ * Enumerating several plugin libraries, which PluginLoader does
+ * concurrently, must find every plugin and category with results that
+ * do not depend on thread timing.
+ */
+
+#include "TestHelpers.h"
+
+#include <set>
+#include <map>
+
+using namespace std;
+using Vamp::HostExt::PluginLoader;
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<string> libs;
+    libs.push_back("vamp-example-plugins");
+    PluginLoader::PluginKeyList original = loader->listPluginsIn(libs);
+    CHECK(!original.empty());
+    if (original.empty()) return TestHelpers::finish("test-plugin-enumeration");
+
+    string libPath = loader->getLibraryPathForPlugin(original[0]);
+    string suffix = libPath.substr(libPath.rfind('.'));
+    string catPath = libPath.substr(0, libPath.rfind('.')) + ".cat";
+    string library = TestHelpers::readFile(libPath);
+    string categories = TestHelpers::readFile(catPath);
+    CHECK(!library.empty());
+    CHECK(!categories.empty());
+
+    // Copies of the example library under several names, each with a
+    // category file renamed to match
+
+    TestHelpers::TempDir dir;
+    CHECK(dir.ok());
+
+    const int copies = 12;
+    vector<string> names;
+    for (int i = 0; i < copies; ++i) {
+        string name = "copy" + to_string(i);
+        names.push_back(name);
+        CHECK(TestHelpers::writeFile(dir.file(name + suffix), library));
+        string cat = categories;
+        string from = ":vamp-example-plugins:", to = ":" + name + ":";
+        for (size_t p = cat.find(from); p != string::npos;
+             p = cat.find(from, p + to.size())) {
+            cat.replace(p, from.size(), to);
+        }
+        CHECK(TestHelpers::writeFile(dir.file(name + ".cat"), cat));
+    }
+
+    // The taxonomy is read once, on first use, so the path must
+    // include the copies before any category is asked for
+
+    const char *path = getenv("VAMP_PATH");
+    string newPath = dir.path() + (path ? string(":") + path : string());
+    setenv("VAMP_PATH", newPath.c_str(), 1);
+
+    vector<PluginLoader::PluginCategoryHierarchy> originalCategories;
+    for (size_t i = 0; i < original.size(); ++i) {
+        originalCategories.push_back(loader->getPluginCategory(original[i]));
+        CHECK(!originalCategories[i].empty());
+    }
+
+    PluginLoader::PluginKeyList first = loader->listPluginsIn(names);
+    CHECK(first.size() == original.size() * copies);
+
+    // Every copy lists the same plugins, in descriptor order, with the
+    // same categories as the original
+
+    map<string, vector<string> > byLibrary;
+    for (size_t i = 0; i < first.size(); ++i) {
+        string key = first[i];
+        string lib = key.substr(0, key.find(':'));
+        byLibrary[lib].push_back(key.substr(key.find(':') + 1));
+    }
+    CHECK(int(byLibrary.size()) == copies);
+
+    vector<string> originalIds;
+    for (size_t i = 0; i < original.size(); ++i) {
+        originalIds.push_back(original[i].substr(original[i].find(':') + 1));
+    }
+    for (auto &b : byLibrary) {
+        CHECK(b.second == originalIds);
+        for (size_t i = 0; i < b.second.size(); ++i) {
+            CHECK(loader->getPluginCategory(b.first + ":" + b.second[i]) ==
+                  originalCategories[i]);
+        }
+    }
+
+    // Keys from one library are contiguous, so the order is by library
+    // and not interleaved between threads
+
+    set<string> seen;
+    string current;
+    for (size_t i = 0; i < first.size(); ++i) {
+        string lib = first[i].substr(0, first[i].find(':'));
+        if (lib != current) {
+            CHECK(seen.find(lib) == seen.end());
+            seen.insert(lib);
+            current = lib;
+        }
+    }
+
+    // And repeated enumeration gives exactly the same result
+
+    for (int rep = 0; rep < 5; ++rep) {
+        CHECK(loader->listPluginsIn(names) == first);
+    }
+
+    return TestHelpers::finish("test-plugin-enumeration");
+}
@@ -0,0 +1,225 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * RealTime's frame and nanosecond conversions must round to the
+ * nearest frame or nanosecond, and frame counts and nanosecond
+ * counts must survive a round trip through RealTime exactly, at any
+ * plausible sample rate and stream length.
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/RealTime.h>
+
+#include <cstdint>
+
+using namespace std;
+using Vamp::RealTime;
+
+static const int64_t billion = 1000000000;
+
+#ifdef __SIZEOF_INT128__
+typedef __int128 wide;
+
+// Nearest frame to the given number of nanoseconds, rounding halves
+// away from zero, calculated in wider arithmetic
+static int64_t
+nearestFrame(int64_t ns, unsigned int rate)
+{
+    wide n = ns < 0 ? -wide(ns) : wide(ns);
+    wide f = (n * rate + billion / 2) / billion;
+    return int64_t(ns < 0 ? -f : f);
+}
+
+static int64_t
+nearestNanosecond(int64_t frame, unsigned int rate)
+{
+    wide f = frame < 0 ? -wide(frame) : wide(frame);
+    wide n = (2 * f * billion + rate) / (2 * wide(rate));
+    return int64_t(frame < 0 ? -n : n);
+}
+#endif
+
+static uint64_t seed = 42;
+
+static uint64_t
+next()
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed >> 11;
+}
+
+int main()
+{
+    // Normalisation by the constructor
+    CHECK(RealTime(1, -1) == RealTime(0, 999999999));
+    CHECK(RealTime(0, 2000000000) == RealTime(2, 0));
+    CHECK(RealTime(-1, 500000000) == RealTime(0, -500000000));
+    CHECK(RealTime(3, -3500000000LL / 2) == RealTime(1, 250000000));
+    RealTime n(-2, -1500000000);
+    CHECK(n.sec == -3 && n.nsec == -500000000);
+    
+    // Nanoseconds, both ways
+    int64_t nsValues[] = {
+        0, 1, -1, 999999999, -999999999, 1000000000, -1000000000,
+        1234567890123LL, -1234567890123LL,
+        int64_t(INT32_MAX) * billion + 999999999,
+        int64_t(INT32_MIN + 1) * billion - 999999999
+    };
+    for (size_t i = 0; i < sizeof(nsValues)/sizeof(nsValues[0]); ++i) {
+        RealTime rt = RealTime::fromNanoseconds(nsValues[i]);
+        CHECK(rt.toNanoseconds() == nsValues[i]);
+        CHECK(rt.nsec > -billion && rt.nsec < billion);
+        CHECK((rt.sec <= 0 && rt.nsec <= 0) || (rt.sec >= 0 && rt.nsec >= 0));
+    }
+    for (int i = 0; i < 100000; ++i) {
+        int64_t ns = int64_t(next() % (uint64_t(INT32_MAX) * billion));
+        if (i % 2) ns = -ns;
+        RealTime rt = RealTime::fromNanoseconds(ns);
+        if (rt.toNanoseconds() != ns ||
+            RealTime::fromNanoseconds(rt.toNanoseconds()) != rt) {
+            cerr << "Nanosecond round trip failed for " << ns << endl;
+            CHECK(false);
+            break;
+        }
+    }
+    CHECK((RealTime(5, 250) - RealTime(2, 500)).toNanoseconds() ==
+          3 * billion - 250);
+
+    unsigned int rates[] = {
+        1, 3, 7, 8000, 11025, 22050, 44100, 48000, 88200, 96000,
+        176400, 192000, 384000, 1000000007u, 4294967295u
+    };
+
+    for (size_t r = 0; r < sizeof(rates)/sizeof(rates[0]); ++r) {
+
+        unsigned int rate = rates[r];
+
+        // Largest frame whose time still fits in a RealTime
+        int64_t maxFrame = int64_t(INT32_MAX - 1) * rate;
+
+        vector<int64_t> frames;
+        for (int64_t f = 0; f < 2000; ++f) frames.push_back(f);
+        frames.push_back(rate - 1);
+        frames.push_back(rate);
+        frames.push_back(rate + 1);
+        if (int64_t(INT32_MAX) + 1 < maxFrame) {
+            frames.push_back(int64_t(INT32_MAX) + 1); // past a 32-bit long
+        }
+        frames.push_back(maxFrame);
+        for (int i = 0; i < 5000; ++i) {
+            frames.push_back(int64_t(next() % uint64_t(maxFrame)));
+        }
+
+        bool ok = true;
+        for (size_t i = 0; i < frames.size() && ok; ++i) {
+            for (int sign = 1; sign >= -1; sign -= 2) {
+                int64_t frame = frames[i] * sign;
+                RealTime rt = RealTime::fromFrame(frame, rate);
+                // (Above a billion frames per second, several frames
+                // share a nanosecond and cannot round-trip)
+                if (rate <= billion &&
+                    RealTime::toFrame(rt, rate) != frame) {
+                    cerr << "Frame round trip failed for frame " << frame
+                         << " at rate " << rate << ": went via " << rt
+                         << " to " << RealTime::toFrame(rt, rate) << endl;
+                    ok = false;
+                    break;
+                }
+#ifdef __SIZEOF_INT128__
+                if (rt.toNanoseconds() != nearestNanosecond(frame, rate)) {
+                    cerr << "fromFrame(" << frame << ", " << rate
+                         << ") gave " << rt << endl;
+                    ok = false;
+                    break;
+                }
+#endif
+            }
+        }
+        CHECK(ok);
+
+#ifdef __SIZEOF_INT128__
+        // Times that do not fall on a frame round to the nearest one
+        ok = true;
+        for (int i = 0; i < 20000 && ok; ++i) {
+            int64_t ns = int64_t(next() % (uint64_t(INT32_MAX - 1) * billion));
+            if (i % 2) ns = -ns;
+            RealTime rt = RealTime::fromNanoseconds(ns);
+            if (RealTime::toFrame(rt, rate) != nearestFrame(ns, rate)) {
+                cerr << "toFrame(" << rt << ", " << rate << ") gave "
+                     << RealTime::toFrame(rt, rate) << ", expected "
+                     << nearestFrame(ns, rate) << endl;
+                ok = false;
+            }
+        }
+        CHECK(ok);
+#endif
+    }
+
+    // The long-based functions agree with the 64-bit ones within the
+    // range of long
+    for (long f = 0; f < 100000; f += 37) {
+        RealTime rt = RealTime::frame2RealTime(f, 44100);
+        CHECK(rt == RealTime::fromFrame(f, 44100));
+        CHECK(RealTime::realTime2Frame(rt, 44100) == f);
+    }
+
+    // Consecutive steps of a long stream are evenly spaced: the
+    // difference between neighbouring block times never drifts by
+    // more than rounding
+    const int64_t step = 512;
+    const unsigned int rate = 44100;
+    int64_t exactStep = (step * billion * 2 + rate) / (2 * rate);
+    bool even = true;
+    for (int64_t b = int64_t(1) << 32; b < (int64_t(1) << 32) + 10000; ++b) {
+        int64_t d = RealTime::fromFrame((b + 1) * step, rate).toNanoseconds() -
+            RealTime::fromFrame(b * step, rate).toNanoseconds();
+        if (d < exactStep - 1 || d > exactStep + 1) even = false;
+    }
+    CHECK(even);
+
+    CHECK(RealTime::fromFrame(12345, 0) == RealTime::zeroTime);
+
+    // The most negative time that can be represented
+    RealTime earliest(INT32_MIN, 0);
+    CHECK(RealTime::toFrame(earliest, 1000) == int64_t(INT32_MIN) * 1000);
+    CHECK(RealTime::toFrame(RealTime(INT32_MIN, -500000000), 2) ==
+          int64_t(INT32_MIN) * 2 - 1);
+    
+    return TestHelpers::finish("test-realtime-frames");
+}
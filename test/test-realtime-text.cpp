@@ -0,0 +1,234 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * RealTime::toChars and toTextChars must write the same text as the
+ * stream-based formatting that toString and toText have always
+ * produced, whatever the global locale, must fit within
+ * maxFormattedLength, and must refuse a range that is too short
+ * without writing outside it.
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/RealTime.h>
+
+#include <sstream>
+#include <locale>
+#include <climits>
+#include <cstring>
+
+using namespace std;
+using Vamp::RealTime;
+
+// The formatting of toString and toText as it was when they were
+// written with streams, in the classic locale
+
+static string
+referenceString(const RealTime &rt)
+{
+    ostringstream out;
+    out.imbue(locale::classic());
+    out << (rt < RealTime::zeroTime ? "-" : " ");
+    long long s = rt.sec < 0 ? -(long long)rt.sec : rt.sec;
+    long long n = rt.nsec < 0 ? -(long long)rt.nsec : rt.nsec;
+    out << s << ".";
+    long long nn = n;
+    if (nn == 0) out << "00000000";
+    else while (nn < 100000000) {
+        out << "0";
+        nn *= 10;
+    }
+    out << n;
+    return out.str();
+}
+
+static string
+referenceText(const RealTime &rt, bool fixedDp)
+{
+    if (rt < RealTime::zeroTime) return "-" + referenceText(-rt, fixedDp);
+
+    ostringstream out;
+    out.imbue(locale::classic());
+    int sec = rt.sec;
+    if (sec >= 3600) out << (sec / 3600) << ":";
+    if (sec >= 60) {
+        int minutes = (sec % 3600) / 60;
+        if (sec >= 3600 && minutes < 10) out << "0";
+        out << minutes << ":";
+    }
+    if (sec >= 10) out << ((sec % 60) / 10);
+    out << (sec % 10);
+    int ms = rt.msec();
+    if (ms != 0) {
+        out << "." << (ms / 100);
+        ms = ms % 100;
+        if (ms != 0) {
+            out << (ms / 10);
+            ms = ms % 10;
+        } else if (fixedDp) {
+            out << "0";
+        }
+        if (ms != 0) out << ms;
+        else if (fixedDp) out << "0";
+    } else if (fixedDp) {
+        out << ".000";
+    }
+    return out.str();
+}
+
+// Grouping digits in threes, as some locales do
+struct Grouping : numpunct<char> {
+    char do_thousands_sep() const { return ','; }
+    string do_grouping() const { return "\3"; }
+    char do_decimal_point() const { return '#'; }
+};
+
+static const char guard = '\x7f';
+
+// Check that formatting into a buffer of each length up to the full
+// one fails without writing past the end, and that the full length
+// gives the expected text
+template <typename F>
+static bool
+checkLengths(const string &expected, F format)
+{
+    char buffer[RealTime::maxFormattedLength + 8];
+    for (size_t len = 0; len <= expected.size(); ++len) {
+        memset(buffer, guard, sizeof(buffer));
+        char *end = format(buffer, buffer + len);
+        for (size_t i = len; i < sizeof(buffer); ++i) {
+            if (buffer[i] != guard) return false;
+        }
+        if (len < expected.size()) {
+            if (end != 0) return false;
+        } else {
+            if (end != buffer + len) return false;
+            if (string(buffer, end) != expected) return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t seed = 7;
+
+static int
+randomInt(int lo, int hi)
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return lo + int((seed >> 33) % uint64_t(int64_t(hi) - lo + 1));
+}
+
+int main()
+{
+    vector<RealTime> times;
+    int secs[] = { 0, 1, 9, 10, 59, 60, 61, 599, 600, 3599, 3600, 3601,
+                   36000, 359999, 360000, INT_MAX, -1, -59, -3600, INT_MIN + 1 };
+    int nsecs[] = { 0, 1, 9, 10, 999, 1000, 999999, 1000000, 1500000,
+                    10000000, 100000000, 120000000, 100200000, 999999999 };
+    for (size_t i = 0; i < sizeof(secs)/sizeof(secs[0]); ++i) {
+        for (size_t j = 0; j < sizeof(nsecs)/sizeof(nsecs[0]); ++j) {
+            int n = secs[i] < 0 ? -nsecs[j] : nsecs[j];
+            times.push_back(RealTime(secs[i], n));
+        }
+    }
+    for (size_t j = 0; j < sizeof(nsecs)/sizeof(nsecs[0]); ++j) {
+        times.push_back(RealTime(0, -nsecs[j]));
+    }
+    for (int i = 0; i < 20000; ++i) {
+        int s = randomInt(-1000000, 1000000);
+        int n = randomInt(0, 999999999);
+        times.push_back(RealTime(s, s < 0 ? -n : n));
+    }
+    
+    // Unusual digit grouping in the global locale must make no
+    // difference to any of the formatting
+    locale::global(locale(locale::classic(), new Grouping));
+    
+    bool stringOk = true, textOk = true, lengthOk = true;
+    for (size_t i = 0; i < times.size(); ++i) {
+
+        const RealTime &rt = times[i];
+
+        string expected = referenceString(rt);
+        ostringstream streamed;
+        streamed << rt;
+        if (rt.toString() != expected ||
+            streamed.str() != expected + "R") {
+            cerr << "toString gave \"" << rt.toString() << "\", expected \""
+                 << expected << "\"" << endl;
+            stringOk = false;
+        }
+        if (int(expected.size()) > RealTime::maxFormattedLength ||
+            !checkLengths(expected, [&](char *a, char *b) {
+                    return rt.toChars(a, b);
+                })) {
+            lengthOk = false;
+        }
+
+        for (int fixed = 0; fixed < 2; ++fixed) {
+            expected = referenceText(rt, fixed);
+            if (rt.toText(fixed) != expected) {
+                cerr << "toText gave \"" << rt.toText(fixed)
+                     << "\", expected \"" << expected << "\"" << endl;
+                textOk = false;
+            }
+            if (int(expected.size()) > RealTime::maxFormattedLength ||
+                !checkLengths(expected, [&](char *a, char *b) {
+                        return rt.toTextChars(a, b, fixed);
+                    })) {
+                lengthOk = false;
+            }
+        }
+
+        if (!stringOk || !textOk || !lengthOk) break;
+    }
+    CHECK(stringOk);
+    CHECK(textOk);
+    CHECK(lengthOk);
+
+    // The most negative time, which cannot be negated as a RealTime
+    RealTime earliest(INT_MIN, -999999999);
+    CHECK(earliest.toString() == "-2147483648.999999999");
+    CHECK(checkLengths(earliest.toString(), [&](char *a, char *b) {
+                return earliest.toChars(a, b);
+            }));
+
+    locale::global(locale::classic());
+    
+    return TestHelpers::finish("test-realtime-text");
+}
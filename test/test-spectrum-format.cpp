@@ -0,0 +1,266 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+/*
+ * A frequency-domain plugin that has accepted a power spectrum
+ * through setSpectrumFormat() must read only blockSize/2+1 values
+ * per channel from processDouble() and processStrided(), as from
+ * process(), when called through the plugin C API, and must give
+ * the same features from each, and the same as from the equivalent
+ * complex spectrum. The input is placed directly before an
+ * inaccessible page so that reading any further fails at once.
+ */
+
+#include "TestHelpers.h"
+
+#include <sys/mman.h>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::RealTime;
+using Vamp::HostExt::PluginLoader;
+
+static const float rate = 44100.f;
+static const size_t blockSize = 1024;
+static const size_t stepSize = 512;
+static const int blocks = 96; // over a second, as fixedtempo needs
+static const size_t channels = 1; // all the plugin accepts
+
+// A buffer of n values of type T ending at the start of a page that
+// cannot be read or written
+template <typename T>
+class GuardedBuffer
+{
+public:
+    GuardedBuffer(size_t n) : m_base(0), m_length(0), m_data(0) {
+        size_t page = size_t(sysconf(_SC_PAGESIZE));
+        size_t bytes = n * sizeof(T);
+        size_t pages = (bytes + page - 1) / page;
+        m_length = (pages + 1) * page;
+        void *p = mmap(0, m_length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return;
+        m_base = (char *)p;
+        if (mprotect(m_base + pages * page, page, PROT_NONE) != 0) {
+            munmap(m_base, m_length);
+            m_base = 0;
+            return;
+        }
+        m_data = (T *)(m_base + pages * page - bytes);
+    }
+    ~GuardedBuffer() {
+        if (m_base) munmap(m_base, m_length);
+    }
+    bool ok() const { return m_data != 0; }
+    T *data() { return m_data; }
+
+private:
+    char *m_base;
+    size_t m_length;
+    T *m_data;
+    GuardedBuffer(const GuardedBuffer &);
+    GuardedBuffer &operator=(const GuardedBuffer &);
+};
+
+enum Path { Process, Strided, StridedWithGap, Double };
+
+static const char *
+pathName(Path path)
+{
+    switch (path) {
+    case Process: return "process";
+    case Strided: return "processStrided";
+    case StridedWithGap: return "processStrided with a gap";
+    case Double: return "processDouble";
+    }
+    return "";
+}
+
+static void
+append(Plugin::FeatureSet &all, const Plugin::FeatureSet &fs)
+{
+    for (auto &o : fs) {
+        all[o.first].insert(all[o.first].end(),
+                            o.second.begin(), o.second.end());
+    }
+}
+
+// Feed the given spectra, one vector of frames values per channel
+// for each block, through the given path
+static Plugin::FeatureSet
+run(Plugin *plugin, const vector<vector<vector<float> > > &input,
+    size_t channels, size_t frames, Path path)
+{
+    Plugin::FeatureSet all;
+
+    size_t stride = channels + (path == StridedWithGap ? 1 : 0);
+
+    for (int b = 0; b < blocks; ++b) {
+
+        RealTime rt = RealTime::frame2RealTime
+            (long(b * stepSize + blockSize / 2), int(rate));
+
+        if (path == Process || path == Double) {
+            vector<GuardedBuffer<float> *> fbufs;
+            vector<GuardedBuffer<double> *> dbufs;
+            vector<const float *> fptrs;
+            vector<const double *> dptrs;
+            for (size_t c = 0; c < channels; ++c) {
+                fbufs.push_back(new GuardedBuffer<float>(frames));
+                dbufs.push_back(new GuardedBuffer<double>(frames));
+                CHECK(fbufs[c]->ok() && dbufs[c]->ok());
+                for (size_t i = 0; i < frames; ++i) {
+                    fbufs[c]->data()[i] = input[b][c][i];
+                    dbufs[c]->data()[i] = input[b][c][i];
+                }
+                fptrs.push_back(fbufs[c]->data());
+                dptrs.push_back(dbufs[c]->data());
+            }
+            if (path == Process) {
+                append(all, plugin->process(fptrs.data(), rt));
+            } else {
+                append(all, plugin->processDouble
+                       (dptrs.data(), channels, frames, rt));
+            }
+            for (size_t c = 0; c < channels; ++c) {
+                delete fbufs[c];
+                delete dbufs[c];
+            }
+        } else {
+            // The last value read is that of the last channel in the
+            // last frame, which must end the buffer
+            size_t n = (frames - 1) * stride + channels;
+            GuardedBuffer<float> buf(n);
+            CHECK(buf.ok());
+            for (size_t i = 0; i < n; ++i) buf.data()[i] = 1000.f;
+            for (size_t i = 0; i < frames; ++i) {
+                for (size_t c = 0; c < channels; ++c) {
+                    buf.data()[i * stride + c] = input[b][c][i];
+                }
+            }
+            append(all, plugin->processStrided
+                   (buf.data(), channels, frames, stride, rt));
+        }
+    }
+
+    append(all, plugin->getRemainingFeatures());
+    return all;
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    // Each takes the power spectrum if offered it
+    const char *ids[] = { "powerspectrum", "percussiononsets", "fixedtempo" };
+
+    Plugin::SpectrumFormat formats[] = {
+        Plugin::ComplexSpectrum, Plugin::PowerSpectrum
+    };
+    Path paths[] = { Process, Strided, StridedWithGap, Double };
+
+    // Complex input whose components are multiples of 1/16 below 16,
+    // so that the power of each bin is exact in float and the same
+    // features are expected from either format
+    vector<vector<vector<float> > > complex
+        (blocks, vector<vector<float> >
+         (channels, vector<float>(blockSize + 2)));
+    vector<vector<vector<float> > > power
+        (blocks, vector<vector<float> >
+         (channels, vector<float>(blockSize / 2 + 1)));
+    unsigned int seed = 1;
+    for (int b = 0; b < blocks; ++b) {
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t i = 0; i <= blockSize / 2; ++i) {
+                float parts[2];
+                for (int j = 0; j < 2; ++j) {
+                    seed = seed * 1103515245u + 12345u;
+                    parts[j] = float((seed >> 16) & 0xff) / 16.f;
+                }
+                complex[b][c][i * 2] = parts[0];
+                complex[b][c][i * 2 + 1] = parts[1];
+                power[b][c][i] = parts[0] * parts[0] + parts[1] * parts[1];
+            }
+        }
+    }
+
+    for (int k = 0; k < 3; ++k) {
+
+        PluginLoader::PluginKey key =
+            loader->composePluginKey("vamp-example-plugins", ids[k]);
+        Plugin::FeatureSet expected;
+
+        for (int f = 0; f < 2; ++f) {
+
+            bool isPower = (formats[f] == Plugin::PowerSpectrum);
+            const vector<vector<vector<float> > > &input =
+                (isPower ? power : complex);
+            size_t frames = input[0][0].size();
+
+            for (int p = 0; p < 4; ++p) {
+
+                // No adapters, so that each call goes straight to the
+                // plugin through the C API
+                Plugin *plugin = loader->loadPlugin(key, rate, 0);
+                CHECK(plugin != 0);
+                if (!plugin) return TestHelpers::finish("test-spectrum-format");
+
+                CHECK(plugin->getInputDomain() == Plugin::FrequencyDomain);
+                CHECK(plugin->getPreferredSpectrumFormat() ==
+                      Plugin::PowerSpectrum);
+                CHECK(plugin->setSpectrumFormat(formats[f]));
+                CHECK(plugin->initialise(channels, stepSize, blockSize));
+
+                Plugin::FeatureSet obtained =
+                    run(plugin, input, channels, frames, paths[p]);
+                delete plugin;
+
+                if (!isPower && paths[p] == Process) {
+                    CHECK(!obtained.empty());
+                    expected = obtained;
+                } else if (!TestHelpers::sameFeatures(expected, obtained)) {
+                    cerr << "Features differ for " << ids[k] << " through "
+                         << pathName(paths[p]) << " for "
+                         << (isPower ? "power" : "complex")
+                         << " spectrum" << endl;
+                    CHECK(false);
+                }
+            }
+        }
+    }
+
+    return TestHelpers::finish("test-spectrum-format");
+}
@@ -0,0 +1,166 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * A plugin's declared state dependency must be reported by the
+ * loader without instantiating it, and must be true: for a plugin
+ * that is BlockLocal or BoundedHistory, processing a signal in
+ * separate segments, each preceded by the declared number of warm-up
+ * blocks, must give the same features as processing it in one go.
+ */
+
+#include "TestHelpers.h"
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::RealTime;
+using Vamp::HostExt::PluginLoader;
+
+static const float rate = 44100.f;
+
+// Process blocks [from, to) of the signal, starting warmUp blocks
+// earlier and discarding the features from those
+static void
+processBlocks(Plugin *plugin, const vector<vector<float> > &signal,
+              size_t blockSize, size_t stepSize,
+              size_t from, size_t to, size_t warmUp,
+              Plugin::FeatureSet &all)
+{
+    size_t channels = signal.size();
+    size_t frames = signal[0].size();
+    vector<vector<float> > block(channels, vector<float>(blockSize));
+    vector<const float *> ptrs(channels);
+    size_t first = (from > warmUp ? from - warmUp : 0);
+    for (size_t b = first; b < to; ++b) {
+        size_t pos = b * stepSize;
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t i = 0; i < blockSize; ++i) {
+                block[c][i] = (pos + i < frames ? signal[c][pos + i] : 0.f);
+            }
+            ptrs[c] = block[c].data();
+        }
+        Plugin::FeatureSet fs = plugin->process
+            (ptrs.data(), RealTime::frame2RealTime(long(pos), int(rate)));
+        if (b < from) continue;
+        for (auto &o : fs) {
+            all[o.first].insert(all[o.first].end(),
+                                o.second.begin(), o.second.end());
+        }
+    }
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    struct Expected {
+        const char *id;
+        Plugin::StateDependency dependency;
+        size_t warmUp;
+    } expected[] = {
+        { "amplitudefollower", Plugin::WholeSignal, 0 },
+        { "fixedtempo", Plugin::WholeSignal, 0 },
+        { "percussiononsets", Plugin::BoundedHistory, 3 },
+        { "powerspectrum", Plugin::BlockLocal, 0 },
+        { "spectralcentroid", Plugin::BlockLocal, 0 },
+        { "zerocrossing", Plugin::BoundedHistory, 1 }
+    };
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(1, 44100, rate);
+
+    for (size_t e = 0; e < sizeof(expected)/sizeof(expected[0]); ++e) {
+
+        PluginLoader::PluginKey key = loader->composePluginKey
+            ("vamp-example-plugins", expected[e].id);
+
+        size_t warmUp = 999;
+        Plugin::StateDependency dependency =
+            loader->getPluginStateDependency(key, &warmUp);
+        CHECK(dependency == expected[e].dependency);
+        CHECK(warmUp == expected[e].warmUp);
+
+        Plugin *whole = loader->loadPlugin
+            (key, rate, PluginLoader::ADAPT_INPUT_DOMAIN);
+        CHECK(whole != 0);
+        if (!whole) continue;
+        CHECK(whole->getStateDependency() == dependency);
+        CHECK(whole->getWarmUpBlockCount() == warmUp);
+
+        if (dependency != Plugin::BlockLocal &&
+            dependency != Plugin::BoundedHistory) {
+            delete whole;
+            continue;
+        }
+
+        size_t blockSize = whole->getPreferredBlockSize();
+        if (blockSize == 0) blockSize = 1024;
+        size_t stepSize = whole->getPreferredStepSize();
+        if (stepSize == 0) stepSize = blockSize;
+        size_t blocks = signal[0].size() / stepSize + 1;
+
+        CHECK(whole->initialise(1, stepSize, blockSize));
+        Plugin::FeatureSet reference;
+        processBlocks(whole, signal, blockSize, stepSize,
+                      0, blocks, 0, reference);
+        delete whole;
+
+        // Uneven segments, each in a fresh instance
+        size_t bounds[] = { 0, 3, 4, 17, 30, blocks };
+        Plugin::FeatureSet segmented;
+        for (int s = 0; s + 1 < int(sizeof(bounds)/sizeof(bounds[0])); ++s) {
+            Plugin *p = loader->loadPlugin
+                (key, rate, PluginLoader::ADAPT_INPUT_DOMAIN);
+            CHECK(p->initialise(1, stepSize, blockSize));
+            processBlocks(p, signal, blockSize, stepSize,
+                          bounds[s], bounds[s+1], warmUp, segmented);
+            delete p;
+        }
+
+        if (!TestHelpers::sameFeatures(reference, segmented)) {
+            cerr << "Segmented features differ for " << key << endl;
+            CHECK(false);
+        }
+    }
+
+    size_t warmUp = 999;
+    CHECK(loader->getPluginStateDependency
+          ("vamp-example-plugins:nonexistent", &warmUp) ==
+          Plugin::UnknownStateDependency);
+    CHECK(warmUp == 0);
+
+    return TestHelpers::finish("test-state-dependency");
+}
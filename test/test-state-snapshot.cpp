@@ -0,0 +1,180 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * Restoring a snapshot taken with getState() into a fresh instance,
+ * and continuing from there, must give the same features as one
+ * instance processing the whole signal without interruption.
+ */
+
+#include "TestHelpers.h"
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::RealTime;
+using Vamp::HostExt::PluginLoader;
+
+static const float rate = 44100.f;
+
+// Process blocks [from, to) of the signal, appending the features,
+// and the remaining features too if this is the end
+static void
+processBlocks(Plugin *plugin, const vector<vector<float> > &signal,
+              size_t blockSize, size_t stepSize,
+              size_t from, size_t to, bool end,
+              Plugin::FeatureSet &all)
+{
+    size_t channels = signal.size();
+    size_t frames = signal[0].size();
+    vector<vector<float> > block(channels, vector<float>(blockSize));
+    vector<const float *> ptrs(channels);
+    for (size_t b = from; b < to; ++b) {
+        size_t pos = b * stepSize;
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t i = 0; i < blockSize; ++i) {
+                block[c][i] = (pos + i < frames ? signal[c][pos + i] : 0.f);
+            }
+            ptrs[c] = block[c].data();
+        }
+        Plugin::FeatureSet fs = plugin->process
+            (ptrs.data(), RealTime::frame2RealTime(long(pos), int(rate)));
+        for (auto &o : fs) {
+            all[o.first].insert(all[o.first].end(),
+                                o.second.begin(), o.second.end());
+        }
+    }
+    if (end) {
+        Plugin::FeatureSet fs = plugin->getRemainingFeatures();
+        for (auto &o : fs) {
+            all[o.first].insert(all[o.first].end(),
+                                o.second.begin(), o.second.end());
+        }
+    }
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<string> libs;
+    libs.push_back("vamp-example-plugins");
+    PluginLoader::PluginKeyList keys = loader->listPluginsIn(libs);
+    CHECK(!keys.empty());
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(2, 88200, rate);
+
+    for (size_t k = 0; k < keys.size(); ++k) {
+
+        // With the standard adapters, and with the buffering adapter
+        // too, which has state of its own to save
+        
+        for (int buffered = 0; buffered < 2; ++buffered) {
+
+            int flags = (buffered ?
+                         PluginLoader::ADAPT_ALL :
+                         PluginLoader::ADAPT_ALL_SAFE);
+
+            Plugin *whole = loader->loadPlugin(keys[k], rate, flags);
+            Plugin *first = loader->loadPlugin(keys[k], rate, flags);
+            Plugin *second = loader->loadPlugin(keys[k], rate, flags);
+            CHECK(whole && first && second);
+            if (!whole || !first || !second) continue;
+
+            size_t blockSize = 1000, stepSize = 1000;
+            if (!buffered) {
+                blockSize = whole->getPreferredBlockSize();
+                if (blockSize == 0) blockSize = 1024;
+                stepSize = whole->getPreferredStepSize();
+                if (stepSize == 0) {
+                    stepSize = (whole->getInputDomain() ==
+                                Plugin::FrequencyDomain ?
+                                blockSize / 2 : blockSize);
+                }
+            }
+            size_t blocks = signal[0].size() / stepSize + 1;
+            size_t split = blocks / 3;
+
+            CHECK(whole->initialise(2, stepSize, blockSize));
+            CHECK(first->initialise(2, stepSize, blockSize));
+            CHECK(second->initialise(2, stepSize, blockSize));
+
+            Plugin::FeatureSet reference;
+            processBlocks(whole, signal, blockSize, stepSize,
+                          0, blocks, true, reference);
+
+            Plugin::FeatureSet resumed;
+            processBlocks(first, signal, blockSize, stepSize,
+                          0, split, false, resumed);
+
+            // The fixed tempo estimator keeps its whole input, and
+            // does not offer snapshots of it; the rest all should
+            
+            Plugin::StateData state;
+            if (keys[k] == "vamp-example-plugins:fixedtempo") {
+                CHECK(!first->getState(state));
+                delete whole;
+                delete first;
+                delete second;
+                continue;
+            }
+            
+            CHECK(first->getState(state));
+            CHECK(!state.empty());
+            CHECK(second->setState(state));
+            
+            processBlocks(second, signal, blockSize, stepSize,
+                          split, blocks, true, resumed);
+
+            if (!TestHelpers::sameFeatures(reference, resumed)) {
+                cerr << "Resumed features differ for " << keys[k]
+                     << (buffered ? " with buffering" : "") << endl;
+                CHECK(false);
+            }
+
+            // A snapshot that is not one the plugin can use must be
+            // refused
+            Plugin::StateData junk(3, 0x5a);
+            CHECK(!first->setState(junk));
+
+            delete whole;
+            delete first;
+            delete second;
+        }
+    }
+
+    return TestHelpers::finish("test-state-snapshot");
+}
@@ -0,0 +1,151 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * Processing interleaved or strided input with processStrided() must
+ * give the same features as processing the same input de-interleaved
+ * with process(), both through the adapters and directly through the
+ * plugin C API.
+ */
+
+#include "TestHelpers.h"
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::RealTime;
+using Vamp::HostExt::PluginLoader;
+
+static const float rate = 44100.f;
+
+static Plugin::FeatureSet
+runStrided(Plugin *plugin, const vector<vector<float> > &signal,
+           size_t blockSize, size_t stepSize, size_t stride)
+{
+    Plugin::FeatureSet all;
+    size_t channels = signal.size();
+    size_t frames = signal[0].size();
+    // Fill the padding between channels with something that would
+    // show up if it were read
+    vector<float> block(blockSize * stride, 1000.f);
+    for (size_t pos = 0; pos < frames; pos += stepSize) {
+        for (size_t i = 0; i < blockSize; ++i) {
+            for (size_t c = 0; c < channels; ++c) {
+                block[i * stride + c] =
+                    (pos + i < frames ? signal[c][pos + i] : 0.f);
+            }
+        }
+        Plugin::FeatureSet fs = plugin->processStrided
+            (block.data(), channels, blockSize, stride,
+             RealTime::frame2RealTime(long(pos), int(rate)));
+        for (auto &o : fs) {
+            all[o.first].insert(all[o.first].end(),
+                                o.second.begin(), o.second.end());
+        }
+    }
+    Plugin::FeatureSet rem = plugin->getRemainingFeatures();
+    for (auto &o : rem) {
+        all[o.first].insert(all[o.first].end(),
+                            o.second.begin(), o.second.end());
+    }
+    return all;
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<string> libs;
+    libs.push_back("vamp-example-plugins");
+    PluginLoader::PluginKeyList keys = loader->listPluginsIn(libs);
+    CHECK(!keys.empty());
+
+    vector<vector<float> > stereo = TestHelpers::makeSignal(2, 44100, rate);
+    vector<vector<float> > mono(1, stereo[0]);
+
+    for (size_t k = 0; k < keys.size(); ++k) {
+
+        // With the usual adapters, in stereo; and for time-domain
+        // plugins, with no adapters at all so that the call goes
+        // straight to the plugin through the C API
+
+        for (int direct = 0; direct < 2; ++direct) {
+
+            int flags = (direct ? 0 : PluginLoader::ADAPT_ALL_SAFE);
+            Plugin *a = loader->loadPlugin(keys[k], rate, flags);
+            CHECK(a != 0);
+            if (!a) continue;
+
+            if (direct && a->getInputDomain() == Plugin::FrequencyDomain) {
+                delete a;
+                continue;
+            }
+            
+            const vector<vector<float> > &signal = (direct ? mono : stereo);
+            size_t channels = signal.size();
+
+            size_t blockSize = a->getPreferredBlockSize();
+            if (blockSize == 0) blockSize = 1024;
+            size_t stepSize = a->getPreferredStepSize();
+            if (stepSize == 0) {
+                stepSize = (a->getInputDomain() == Plugin::FrequencyDomain ?
+                            blockSize / 2 : blockSize);
+            }
+
+            CHECK(a->initialise(channels, stepSize, blockSize));
+            Plugin::FeatureSet expected = TestHelpers::runPlugin
+                (a, signal, blockSize, stepSize, rate);
+            delete a;
+
+            // Plain interleaved, and with a gap after each frame
+            for (size_t stride = channels; stride <= channels + 1; ++stride) {
+                Plugin *b = loader->loadPlugin(keys[k], rate, flags);
+                CHECK(b->initialise(channels, stepSize, blockSize));
+                Plugin::FeatureSet obtained = runStrided
+                    (b, signal, blockSize, stepSize, stride);
+                if (!TestHelpers::sameFeatures(expected, obtained)) {
+                    cerr << "Features differ for " << keys[k]
+                         << " with stride " << stride
+                         << (direct ? " unadapted" : " adapted") << endl;
+                    CHECK(false);
+                }
+                delete b;
+            }
+        }
+    }
+
+    return TestHelpers::finish("test-strided-input");
+}
@@ -0,0 +1,208 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * The summarising adapter must calculate exactly the same summaries
+ * and summary state when given a memory budget small enough that it
+ * keeps its results in a temporary file as it does when keeping them
+ * all in memory, and also when the temporary file cannot be created.
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/PluginSummarisingAdapter.h>
+
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::RealTime;
+using Vamp::HostExt::PluginLoader;
+using Vamp::HostExt::PluginSummarisingAdapter;
+
+static const float rate = 44100.f;
+
+typedef PluginSummarisingAdapter SA;
+
+// Count the open files of this process whose names lie in the given
+// directory, or return -1 if that cannot be found out here
+static int
+openFilesIn(string dir)
+{
+#ifdef __linux__
+    int count = 0;
+    DIR *d = opendir("/proc/self/fd");
+    if (!d) return -1;
+    while (struct dirent *e = readdir(d)) {
+        string link = string("/proc/self/fd/") + e->d_name;
+        char target[4096];
+        ssize_t n = readlink(link.c_str(), target, sizeof(target) - 1);
+        if (n <= 0) continue;
+        target[n] = '\0';
+        if (string(target).compare(0, dir.size() + 1, dir + "/") == 0) {
+            ++count;
+        }
+    }
+    closedir(d);
+    return count;
+#else
+    (void)dir;
+    return -1;
+#endif
+}
+
+struct Result {
+    vector<Plugin::FeatureList> summaries;
+    Plugin::StateData state;
+    int spillFiles;
+};
+
+static Result
+summarise(PluginLoader::PluginKey key, const vector<vector<float> > &signal,
+          size_t budget, string tmpdir)
+{
+    Result result;
+    
+    PluginLoader *loader = PluginLoader::getInstance();
+    Plugin *plugin = loader->loadPlugin
+        (key, rate, PluginLoader::ADAPT_INPUT_DOMAIN);
+    SA *summariser = new SA(plugin);
+    if (budget > 0) summariser->setMemoryBudget(budget);
+
+    SA::SegmentBoundaries boundaries;
+    boundaries.insert(RealTime(3, 0));
+    summariser->setSummarySegmentBoundaries(boundaries);
+    
+    size_t blockSize = plugin->getPreferredBlockSize();
+    if (blockSize == 0) blockSize = 1024;
+    size_t stepSize = plugin->getPreferredStepSize();
+    if (stepSize == 0) stepSize = blockSize;
+    CHECK(summariser->initialise(1, stepSize, blockSize));
+
+    TestHelpers::runPlugin(summariser, signal, blockSize, stepSize, rate);
+
+    size_t outputs = summariser->getOutputDescriptors().size();
+    for (int m = SA::SampleAverage; m <= SA::ContinuousTimeAverage; ++m) {
+        for (int t = SA::Minimum; t <= SA::Count; ++t) {
+            for (size_t o = 0; o < outputs; ++o) {
+                result.summaries.push_back
+                    (summariser->getSummaryForOutput
+                     (int(o), SA::SummaryType(t), SA::AveragingMethod(m)));
+            }
+        }
+    }
+
+    summariser->getSummaryState().serialise(result.state);
+
+    result.spillFiles = openFilesIn(tmpdir);
+    
+    delete summariser;
+
+    // The temporary file goes with the adapter
+    int remaining = openFilesIn(tmpdir);
+    CHECK(remaining <= 0);
+    
+    return result;
+}
+
+static bool
+same(const Result &a, const Result &b)
+{
+    if (a.summaries.size() != b.summaries.size()) return false;
+    for (size_t i = 0; i < a.summaries.size(); ++i) {
+        Plugin::FeatureSet fa, fb;
+        fa[0] = a.summaries[i];
+        fb[0] = b.summaries[i];
+        if (!TestHelpers::sameFeatures(fa, fb)) return false;
+    }
+    return a.state == b.state;
+}
+
+int main()
+{
+    TestHelpers::TempDir tmp;
+    CHECK(tmp.ok());
+    if (!tmp.ok()) return TestHelpers::finish("test-summary-spill");
+    setenv("TMPDIR", tmp.path().c_str(), 1);
+    
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<string> libs;
+    libs.push_back("vamp-example-plugins");
+    PluginLoader::PluginKeyList keys = loader->listPluginsIn(libs);
+    CHECK(!keys.empty());
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(1, 441000, rate);
+
+    // Results are retired to the file a chunk of 1024 features at a
+    // time, so only outputs with more features than that per segment
+    // (such as the zero crossing counts) actually spill
+    bool anySpilled = false;
+    
+    for (size_t k = 0; k < keys.size(); ++k) {
+
+        Result inMemory = summarise(keys[k], signal, 0, tmp.path());
+        CHECK(inMemory.spillFiles <= 0);
+
+        size_t budgets[] = { 1, 4096, 65536 };
+        for (int b = 0; b < 3; ++b) {
+            Result spilled = summarise(keys[k], signal, budgets[b], tmp.path());
+            if (spilled.spillFiles > 0) anySpilled = true;
+            if (!same(inMemory, spilled)) {
+                cerr << "Summaries differ for " << keys[k]
+                     << " with memory budget " << budgets[b] << endl;
+                CHECK(false);
+            }
+        }
+    }
+
+    if (openFilesIn(tmp.path()) >= 0) {
+        CHECK(anySpilled);
+    }
+    
+    // With nowhere to write the temporary file, results stay in
+    // memory and the summaries are still the same
+    setenv("TMPDIR", tmp.file("nonexistent").c_str(), 1);
+    PluginLoader::PluginKey key = loader->composePluginKey
+        ("vamp-example-plugins", "zerocrossing");
+    Result inMemory = summarise(key, signal, 0, tmp.path());
+    Result fallback = summarise(key, signal, 4096, tmp.path());
+    CHECK(same(inMemory, fallback));
+
+    return TestHelpers::finish("test-summary-spill");
+}
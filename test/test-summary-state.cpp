@@ -0,0 +1,221 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * Summary states from separate runs over the two halves of a signal,
+ * merged, must give the same summaries as a single run over the
+ * whole signal, and a state must give the same summaries after being
+ * serialised and read back.
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/PluginSummarisingAdapter.h>
+
+#include <cmath>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::RealTime;
+using Vamp::HostExt::PluginLoader;
+using Vamp::HostExt::PluginSummarisingAdapter;
+
+static const float rate = 44100.f;
+
+typedef PluginSummarisingAdapter SA;
+
+static bool
+closeValues(const Plugin::FeatureList &a, const Plugin::FeatureList &b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].timestamp != b[i].timestamp) return false;
+        if (a[i].values.size() != b[i].values.size()) return false;
+        for (size_t j = 0; j < a[i].values.size(); ++j) {
+            double x = a[i].values[j], y = b[i].values[j];
+            if (fabs(x - y) > 1e-3 * (fabs(x) + fabs(y)) + 1e-5) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Run the plugin over the given range of blocks, with timestamps
+// relative to the start of the whole signal
+static SA::SummaryState
+runRange(PluginLoader::PluginKey key, const vector<vector<float> > &signal,
+         size_t startBlock, size_t endBlock,
+         const SA::SegmentBoundaries &boundaries)
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+    Plugin *plugin = loader->loadPlugin
+        (key, rate, PluginLoader::ADAPT_INPUT_DOMAIN);
+    SA *summariser = new SA(plugin);
+    summariser->setSummarySegmentBoundaries(boundaries);
+
+    size_t blockSize = plugin->getPreferredBlockSize();
+    if (blockSize == 0) blockSize = 1024;
+    size_t stepSize = plugin->getPreferredStepSize();
+    if (stepSize == 0) stepSize = blockSize;
+    CHECK(summariser->initialise(1, stepSize, blockSize));
+
+    size_t frames = signal[0].size();
+    vector<float> block(blockSize);
+    const float *ptr = block.data();
+    for (size_t b = startBlock; b < endBlock; ++b) {
+        size_t pos = b * stepSize;
+        for (size_t i = 0; i < blockSize; ++i) {
+            block[i] = (pos + i < frames ? signal[0][pos + i] : 0.f);
+        }
+        summariser->process(&ptr, RealTime::frame2RealTime(long(pos), int(rate)));
+    }
+    summariser->getRemainingFeatures();
+
+    SA::SummaryState state = summariser->getSummaryState();
+    delete summariser;
+    return state;
+}
+
+static size_t
+blockCount(PluginLoader::PluginKey key, size_t frames)
+{
+    Plugin *plugin = PluginLoader::getInstance()->loadPlugin
+        (key, rate, PluginLoader::ADAPT_INPUT_DOMAIN);
+    size_t blockSize = plugin->getPreferredBlockSize();
+    if (blockSize == 0) blockSize = 1024;
+    size_t stepSize = plugin->getPreferredStepSize();
+    if (stepSize == 0) stepSize = blockSize;
+    delete plugin;
+    return (frames + stepSize - 1) / stepSize;
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(1, 441000, rate);
+
+    SA::SegmentBoundaries boundaries;
+    boundaries.insert(RealTime(4, 0));
+
+    // The zero crossing counts have few distinct values, so their
+    // medians and modes merge exactly as well
+    const char *ids[] = { "zerocrossing", "spectralcentroid", "powerspectrum" };
+
+    for (int p = 0; p < 3; ++p) {
+
+        PluginLoader::PluginKey key = loader->composePluginKey
+            ("vamp-example-plugins", ids[p]);
+        bool exactOrder = (p == 0);
+        
+        size_t blocks = blockCount(key, signal[0].size());
+        SA::SummaryState whole = runRange(key, signal, 0, blocks, boundaries);
+        SA::SummaryState first =
+            runRange(key, signal, 0, blocks / 2, boundaries);
+        SA::SummaryState second =
+            runRange(key, signal, blocks / 2, blocks, boundaries);
+
+        CHECK(!whole.isEmpty());
+        CHECK(!first.isEmpty());
+        
+        SA::SummaryState merged;
+        CHECK(merged.isEmpty());
+        merged.merge(first);
+        merged.merge(second);
+        merged.merge(SA::SummaryState());
+
+        Plugin::StateData bytes;
+        merged.serialise(bytes);
+        CHECK(!bytes.empty());
+        SA::SummaryState restored;
+        CHECK(restored.deserialise(bytes));
+        Plugin::StateData again;
+        restored.serialise(again);
+        CHECK(again == bytes);
+
+        // A truncated state is refused
+        Plugin::StateData cut(bytes.begin(), bytes.begin() + bytes.size() / 2);
+        SA::SummaryState truncated;
+        CHECK(!truncated.deserialise(cut));
+        CHECK(truncated.isEmpty());
+
+        SA::SummaryState copied(restored);
+        
+        for (int m = SA::SampleAverage; m <= SA::ContinuousTimeAverage; ++m) {
+            for (int t = SA::Minimum; t <= SA::Count; ++t) {
+
+                SA::SummaryType type = SA::SummaryType(t);
+                SA::AveragingMethod method = SA::AveragingMethod(m);
+                
+                Plugin::FeatureList expected =
+                    whole.getSummaryForOutput(0, type, method);
+                Plugin::FeatureList obtained =
+                    merged.getSummaryForOutput(0, type, method);
+
+                CHECK(expected.size() == 2);
+
+                bool ordered = (type == SA::Median || type == SA::Mode);
+                if (!ordered || exactOrder) {
+                    if (!closeValues(expected, obtained)) {
+                        cerr << "Merged summary differs for " << ids[p]
+                             << " type " << t << " method " << m << endl;
+                        CHECK(false);
+                    }
+                }
+
+                Plugin::FeatureSet a, b, c;
+                a[0] = obtained;
+                b[0] = restored.getSummaryForOutput(0, type, method);
+                c[0] = copied.getSummaryForOutput(0, type, method);
+                CHECK(TestHelpers::sameFeatures(a, b));
+                CHECK(TestHelpers::sameFeatures(a, c));
+            }
+        }
+    }
+
+    // Data that is not a serialised state is refused, leaving the
+    // state empty
+    SA::SummaryState junk;
+    Plugin::StateData bad(17, 0x5a);
+    CHECK(!junk.deserialise(bad));
+    CHECK(junk.isEmpty());
+    CHECK(!junk.deserialise(Plugin::StateData()));
+    CHECK(junk.isEmpty());
+
+    return TestHelpers::finish("test-summary-state");
+}
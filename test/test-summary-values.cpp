@@ -0,0 +1,197 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * The sample-average summaries calculated by the summarising adapter
+ * must match those calculated directly from the features the plugin
+ * returns, for every output of every example plugin, including
+ * outputs with many bins.
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/PluginSummarisingAdapter.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::HostExt::PluginLoader;
+using Vamp::HostExt::PluginSummarisingAdapter;
+
+static const float rate = 44100.f;
+
+typedef PluginSummarisingAdapter SA;
+
+// Summaries of one bin, calculated the way the adapter defines them:
+// missing values count as zero, the median of an even number of
+// values is the mean of the values at count/2 and count/2+1 in
+// sorted order, and the mode is the lowest of the most common values
+static vector<double>
+reference(vector<float> values)
+{
+    vector<double> s(9, 0.0);
+    size_t n = values.size();
+    sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) sum += values[i];
+    double mean = sum / double(n);
+    double var = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        var += (values[i] - mean) * (values[i] - mean);
+    }
+    var /= double(n);
+    float mode = values[0];
+    size_t best = 0;
+    for (size_t i = 0; i < n; ) {
+        size_t j = i;
+        while (j < n && values[j] == values[i]) ++j;
+        if (j - i > best) {
+            best = j - i;
+            mode = values[i];
+        }
+        i = j;
+    }
+    s[SA::Minimum] = values[0];
+    s[SA::Maximum] = values[n-1];
+    s[SA::Mean] = mean;
+    if (n % 2 == 1) {
+        s[SA::Median] = values[n/2];
+    } else {
+        s[SA::Median] = (values[n/2] + values[min(n/2 + 1, n - 1)]) / 2;
+    }
+    s[SA::Mode] = mode;
+    s[SA::Sum] = sum;
+    s[SA::Variance] = var;
+    s[SA::StandardDeviation] = sqrt(var);
+    s[SA::Count] = double(n);
+    return s;
+}
+
+static bool
+close(double a, double b)
+{
+    return fabs(a - b) <= 1e-4 * (fabs(a) + fabs(b)) + 1e-5;
+}
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<string> libs;
+    libs.push_back("vamp-example-plugins");
+    PluginLoader::PluginKeyList keys = loader->listPluginsIn(libs);
+    CHECK(!keys.empty());
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(1, 88200, rate);
+
+    int flags = PluginLoader::ADAPT_INPUT_DOMAIN;
+    int binsChecked = 0;
+
+    for (size_t k = 0; k < keys.size(); ++k) {
+
+        Plugin *plain = loader->loadPlugin(keys[k], rate, flags);
+        Plugin *inner = loader->loadPlugin(keys[k], rate, flags);
+        CHECK(plain != 0 && inner != 0);
+        if (!plain || !inner) continue;
+        SA *summariser = new SA(inner);
+
+        size_t blockSize = plain->getPreferredBlockSize();
+        if (blockSize == 0) blockSize = 1024;
+        size_t stepSize = plain->getPreferredStepSize();
+        if (stepSize == 0) stepSize = blockSize;
+
+        CHECK(plain->initialise(1, stepSize, blockSize));
+        CHECK(summariser->initialise(1, stepSize, blockSize));
+
+        Plugin::FeatureSet features = TestHelpers::runPlugin
+            (plain, signal, blockSize, stepSize, rate);
+        TestHelpers::runPlugin(summariser, signal, blockSize, stepSize, rate);
+
+        size_t outputs = plain->getOutputDescriptors().size();
+        
+        for (size_t o = 0; o < outputs; ++o) {
+
+            const Plugin::FeatureList &fl = features[int(o)];
+            size_t bins = 0;
+            for (size_t i = 0; i < fl.size(); ++i) {
+                bins = max(bins, fl[i].values.size());
+            }
+
+            vector<vector<double> > expected;
+            for (size_t b = 0; b < bins; ++b) {
+                vector<float> column;
+                for (size_t i = 0; i < fl.size(); ++i) {
+                    column.push_back(b < fl[i].values.size() ?
+                                     fl[i].values[b] : 0.f);
+                }
+                expected.push_back(reference(column));
+            }
+
+            for (int t = SA::Minimum; t <= SA::Count; ++t) {
+                Plugin::FeatureList summary = summariser->getSummaryForOutput
+                    (int(o), SA::SummaryType(t), SA::SampleAverage);
+                if (bins == 0) {
+                    CHECK(summary.empty() || summary[0].values.empty());
+                    continue;
+                }
+                CHECK(summary.size() == 1);
+                if (summary.size() != 1) continue;
+                CHECK(summary[0].values.size() == bins);
+                if (summary[0].values.size() != bins) continue;
+                for (size_t b = 0; b < bins; ++b) {
+                    if (!close(summary[0].values[b], expected[b][t])) {
+                        cerr << keys[k] << " output " << o << " bin " << b
+                             << " summary type " << t << ": expected "
+                             << expected[b][t] << ", got "
+                             << summary[0].values[b] << endl;
+                        CHECK(false);
+                    }
+                    ++binsChecked;
+                }
+            }
+        }
+        
+        delete plain;
+        delete summariser;
+    }
+
+    CHECK(binsChecked > 1000);
+
+    return TestHelpers::finish("test-summary-values");
+}
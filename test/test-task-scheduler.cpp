@@ -0,0 +1,166 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * A task scheduler given to a plugin through the adapters and the
+ * plugin C API must be the one the plugin's parallel work runs on,
+ * and the features must be the same as when the plugin runs its work
+ * serially.
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/TaskScheduler.h>
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <set>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::TaskScheduler;
+using Vamp::HostExt::PluginLoader;
+
+static const float rate = 44100.f;
+
+// Runs each parallelFor across a few threads of its own, and records
+// what it ran and where
+class RecordingScheduler : public TaskScheduler
+{
+public:
+    RecordingScheduler() : m_calls(0), m_bodies(0) { }
+
+    Task submit(std::function<void()> task) {
+        ++m_calls;
+        return new thread(task);
+    }
+    void wait(Task task) {
+        if (!task) return;
+        thread *t = (thread *)task;
+        t->join();
+        delete t;
+    }
+    void parallelFor(size_t count, std::function<void(size_t)> body) {
+        ++m_calls;
+        const size_t nthreads = 4;
+        vector<thread> threads;
+        for (size_t t = 0; t < nthreads; ++t) {
+            threads.push_back(thread([=]() {
+                for (size_t i = t; i < count; i += nthreads) {
+                    body(i);
+                    ++m_bodies;
+                    lock_guard<mutex> guard(m_mutex);
+                    m_threads.insert(this_thread::get_id());
+                }
+            }));
+        }
+        for (size_t t = 0; t < nthreads; ++t) threads[t].join();
+    }
+    size_t getConcurrency() const { return 4; }
+
+    int calls() const { return m_calls; }
+    int bodies() const { return m_bodies; }
+    size_t threadCount() const { return m_threads.size(); }
+
+private:
+    atomic<int> m_calls;
+    atomic<int> m_bodies;
+    mutex m_mutex;
+    set<thread::id> m_threads;
+};
+
+int main()
+{
+    PluginLoader *loader = PluginLoader::getInstance();
+    PluginLoader::PluginKey key = loader->composePluginKey
+        ("vamp-example-plugins", "fixedtempo");
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(1, 441000, rate);
+
+    // The fixed tempo estimator divides its autocorrelation among
+    // tasks when it calculates its result at the end
+
+    int flagSets[] = { 0, PluginLoader::ADAPT_ALL_SAFE, PluginLoader::ADAPT_ALL };
+
+    for (int f = 0; f < 3; ++f) {
+
+        Plugin *serial = loader->loadPlugin(key, rate, flagSets[f]);
+        Plugin *parallel = loader->loadPlugin(key, rate, flagSets[f]);
+        CHECK(serial && parallel);
+        if (!serial || !parallel) continue;
+
+        RecordingScheduler scheduler;
+        parallel->setTaskScheduler(&scheduler);
+
+        size_t blockSize = serial->getPreferredBlockSize();
+        size_t stepSize = serial->getPreferredStepSize();
+        if (stepSize == 0) stepSize = blockSize / 2;
+        
+        CHECK(serial->initialise(1, stepSize, blockSize));
+        CHECK(parallel->initialise(1, stepSize, blockSize));
+
+        Plugin::FeatureSet expected = TestHelpers::runPlugin
+            (serial, signal, blockSize, stepSize, rate);
+        Plugin::FeatureSet obtained = TestHelpers::runPlugin
+            (parallel, signal, blockSize, stepSize, rate);
+
+        CHECK(!expected.empty());
+        CHECK(TestHelpers::sameFeatures(expected, obtained));
+        CHECK(scheduler.calls() > 0);
+        CHECK(scheduler.bodies() > 1);
+        CHECK(scheduler.threadCount() > 1);
+
+        // Withdrawing the scheduler again before initialising puts
+        // the plugin back to serial work
+        Plugin *withdrawn = loader->loadPlugin(key, rate, flagSets[f]);
+        RecordingScheduler unused;
+        withdrawn->setTaskScheduler(&unused);
+        withdrawn->setTaskScheduler(0);
+        CHECK(withdrawn->initialise(1, stepSize, blockSize));
+        obtained = TestHelpers::runPlugin
+            (withdrawn, signal, blockSize, stepSize, rate);
+        CHECK(TestHelpers::sameFeatures(expected, obtained));
+        CHECK(unused.calls() == 0);
+        
+        delete serial;
+        delete parallel;
+        delete withdrawn;
+    }
+
+    return TestHelpers::finish("test-task-scheduler");
+}
@@ -0,0 +1,243 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * ThreadPoolScheduler must run every task and every parallelFor
+ * index exactly once, across more than one thread, without
+ * deadlocking when tasks wait for further tasks, and must pass on
+ * exceptions. The summarising adapter must calculate identical
+ * summaries with the pool as without it.
+ */
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/ThreadPoolScheduler.h>
+#include <vamp-hostsdk/PluginSummarisingAdapter.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+
+using namespace std;
+using Vamp::Plugin;
+using Vamp::TaskScheduler;
+using Vamp::HostExt::PluginLoader;
+using Vamp::HostExt::PluginSummarisingAdapter;
+using Vamp::HostExt::ThreadPoolScheduler;
+
+static const float rate = 44100.f;
+
+typedef PluginSummarisingAdapter SA;
+
+static void
+testScheduler()
+{
+    ThreadPoolScheduler pool(4);
+    CHECK(pool.getConcurrency() == 4);
+
+    ThreadPoolScheduler defaulted;
+    CHECK(defaulted.getConcurrency() >= 1);
+
+    // Every index exactly once, on more than one thread
+    const size_t count = 5000;
+    vector<atomic<int> > hits(count);
+    for (size_t i = 0; i < count; ++i) hits[i] = 0;
+    mutex idMutex;
+    set<thread::id> ids;
+    pool.parallelFor(count, [&](size_t i) {
+        ++hits[i];
+        if (i % 100 == 0) {
+            this_thread::sleep_for(chrono::milliseconds(2));
+        }
+        lock_guard<mutex> guard(idMutex);
+        ids.insert(this_thread::get_id());
+    });
+    bool once = true;
+    for (size_t i = 0; i < count; ++i) if (hits[i] != 1) once = false;
+    CHECK(once);
+    CHECK(ids.size() > 1);
+
+    pool.parallelFor(0, [&](size_t) { CHECK(false); });
+    pool.wait(0);
+    
+    // Submitted tasks each run once, before wait() returns
+    atomic<int> ran(0);
+    vector<TaskScheduler::Task> tasks;
+    for (int i = 0; i < 100; ++i) {
+        tasks.push_back(pool.submit([&]() { ++ran; }));
+    }
+    for (size_t i = 0; i < tasks.size(); ++i) pool.wait(tasks[i]);
+    CHECK(ran == 100);
+
+    // Tasks that wait for tasks and run parallel loops of their own,
+    // more of them than there are threads, still complete
+    ThreadPoolScheduler small(2);
+    atomic<int> inner(0);
+    tasks.clear();
+    for (int i = 0; i < 8; ++i) {
+        tasks.push_back(small.submit([&]() {
+            vector<TaskScheduler::Task> subtasks;
+            for (int j = 0; j < 4; ++j) {
+                subtasks.push_back(small.submit([&]() {
+                    small.parallelFor(10, [&](size_t) { ++inner; });
+                }));
+            }
+            for (size_t j = 0; j < subtasks.size(); ++j) {
+                small.wait(subtasks[j]);
+            }
+        }));
+    }
+    for (size_t i = 0; i < tasks.size(); ++i) small.wait(tasks[i]);
+    CHECK(inner == 8 * 4 * 10);
+
+    // Exceptions reach the waiting thread
+    bool caught = false;
+    TaskScheduler::Task t = pool.submit([]() {
+        throw runtime_error("task");
+    });
+    try {
+        pool.wait(t);
+    } catch (const runtime_error &) {
+        caught = true;
+    }
+    CHECK(caught);
+
+    caught = false;
+    try {
+        pool.parallelFor(1000, [](size_t i) {
+            if (i == 500) throw runtime_error("body");
+        });
+    } catch (const runtime_error &) {
+        caught = true;
+    }
+    CHECK(caught);
+
+    // and the pool remains usable afterwards
+    ran = 0;
+    pool.parallelFor(64, [&](size_t) { ++ran; });
+    CHECK(ran == 64);
+}
+
+static bool
+sameSummaries(SA *a, SA *b, size_t outputs)
+{
+    for (int m = SA::SampleAverage; m <= SA::ContinuousTimeAverage; ++m) {
+        for (int t = SA::Minimum; t <= SA::Count; ++t) {
+            for (size_t o = 0; o < outputs; ++o) {
+                Plugin::FeatureSet fa, fb;
+                fa[0] = a->getSummaryForOutput
+                    (int(o), SA::SummaryType(t), SA::AveragingMethod(m));
+                fb[0] = b->getSummaryForOutput
+                    (int(o), SA::SummaryType(t), SA::AveragingMethod(m));
+                if (!TestHelpers::sameFeatures(fa, fb)) {
+                    cerr << "Summary type " << t << " averaging " << m
+                         << " differs for output " << o << endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    testScheduler();
+    
+    PluginLoader *loader = PluginLoader::getInstance();
+
+    vector<string> libs;
+    libs.push_back("vamp-example-plugins");
+    PluginLoader::PluginKeyList keys = loader->listPluginsIn(libs);
+    CHECK(!keys.empty());
+
+    vector<vector<float> > signal = TestHelpers::makeSignal(1, 441000, rate);
+
+    ThreadPoolScheduler pool(4);
+
+    // Segment boundaries give the pool more, smaller pieces of work
+    SA::SegmentBoundaries boundaries;
+    boundaries.insert(Vamp::RealTime(2, 0));
+    boundaries.insert(Vamp::RealTime(3, 500000000));
+    boundaries.insert(Vamp::RealTime(7, 0));
+
+    for (size_t k = 0; k < keys.size(); ++k) {
+        for (int segmented = 0; segmented < 2; ++segmented) {
+            
+            Plugin *p = loader->loadPlugin
+                (keys[k], rate, PluginLoader::ADAPT_INPUT_DOMAIN);
+            Plugin *q = loader->loadPlugin
+                (keys[k], rate, PluginLoader::ADAPT_INPUT_DOMAIN);
+            CHECK(p && q);
+            if (!p || !q) continue;
+
+            SA *serial = new SA(p);
+            SA *parallel = new SA(q);
+            parallel->setTaskScheduler(&pool);
+            if (segmented) {
+                serial->setSummarySegmentBoundaries(boundaries);
+                parallel->setSummarySegmentBoundaries(boundaries);
+            }
+            
+            size_t blockSize = p->getPreferredBlockSize();
+            if (blockSize == 0) blockSize = 1024;
+            size_t stepSize = p->getPreferredStepSize();
+            if (stepSize == 0) stepSize = blockSize;
+
+            CHECK(serial->initialise(1, stepSize, blockSize));
+            CHECK(parallel->initialise(1, stepSize, blockSize));
+
+            TestHelpers::runPlugin(serial, signal, blockSize, stepSize, rate);
+            TestHelpers::runPlugin(parallel, signal, blockSize, stepSize, rate);
+
+            size_t outputs = serial->getOutputDescriptors().size();
+            if (!sameSummaries(serial, parallel, outputs)) {
+                cerr << "Parallel summaries differ for " << keys[k]
+                     << (segmented ? " with segments" : "") << endl;
+                CHECK(false);
+            }
+
+            delete serial;
+            delete parallel;
+        }
+    }
+
+    return TestHelpers::finish("test-thread-pool");
+}
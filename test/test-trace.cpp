@@ -0,0 +1,175 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+/*
+ * Trace must record the events of each thread separately, keep only
+ * the most recent events once a thread's ring is full, write them
+ * as a Chrome trace event array, and discard them when cleared.
+ */
+
+#define VAMP_TRACE 1
+
+#include "TestHelpers.h"
+
+#include <vamp-hostsdk/Trace.h>
+
+#include <sstream>
+#include <thread>
+#include <set>
+
+using namespace std;
+using Vamp::Trace;
+
+static const size_t ringCapacity = 16384;
+
+static size_t
+countOf(const string &text, const string &s)
+{
+    size_t n = 0;
+    for (size_t i = text.find(s); i != string::npos; i = text.find(s, i + 1)) {
+        ++n;
+    }
+    return n;
+}
+
+static string
+written()
+{
+    ostringstream out;
+    Trace::writeChromeTrace(out);
+    return out.str();
+}
+
+// Return the values of the given numeric field in every event
+static vector<double>
+fieldValues(const string &text, const string &field)
+{
+    vector<double> values;
+    string key = "\"" + field + "\":";
+    for (size_t i = text.find(key); i != string::npos;
+         i = text.find(key, i + 1)) {
+        values.push_back(atof(text.c_str() + i + key.size()));
+    }
+    return values;
+}
+
+static void
+recordMany(const char *name, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        VAMP_TRACE_SCOPE(name);
+    }
+}
+
+int main()
+{
+    Trace::clear();
+    string text = written();
+    CHECK(text == "[\n]\n");
+
+    // A scope records one complete event with a non-negative duration
+    long long before = Trace::now();
+    {
+        VAMP_TRACE_SCOPE("outer");
+        VAMP_TRACE_SCOPE("inner");
+    }
+    long long after = Trace::now();
+    CHECK(after >= before);
+    
+    text = written();
+    CHECK(text.substr(0, 2) == "[\n");
+    CHECK(text.substr(text.size() - 3) == "\n]\n");
+    CHECK(countOf(text, "\"ph\":\"X\"") == 2);
+    CHECK(countOf(text, "\"name\":\"outer\"") == 1);
+    CHECK(countOf(text, "\"name\":\"inner\"") == 1);
+    CHECK(countOf(text, "\"cat\":\"vamp-hostsdk\"") == 2);
+    vector<double> durations = fieldValues(text, "dur");
+    CHECK(durations.size() == 2);
+    for (size_t i = 0; i < durations.size(); ++i) {
+        CHECK(durations[i] >= 0.0);
+        CHECK(durations[i] <= double(after - before) / 1000.0 + 0.001);
+    }
+
+    // Names are escaped so that the output stays valid JSON
+    Trace::clear();
+    Trace::record("a \"quoted\\ name\n", 1000, 3500);
+    text = written();
+    CHECK(countOf(text, "\"name\":\"a \\\"quoted\\\\ name\"") == 1);
+    CHECK(countOf(text, "\"ts\":1.000,\"dur\":2.500") == 1);
+    
+    // Clearing discards everything recorded so far, and later events
+    // are still recorded
+    Trace::clear();
+    CHECK(written() == "[\n]\n");
+    Trace::record("later", 0, 1);
+    CHECK(countOf(written(), "\"name\":\"later\"") == 1);
+
+    // A full ring keeps only its most recent events
+    Trace::clear();
+    for (size_t i = 0; i < ringCapacity + 100; ++i) {
+        Trace::record(i < 100 ? "old" : "new", (long long)i * 1000,
+                      (long long)i * 1000 + 1);
+    }
+    text = written();
+    CHECK(countOf(text, "\"ph\":\"X\"") == ringCapacity);
+    CHECK(countOf(text, "\"name\":\"old\"") == 0);
+    CHECK(fieldValues(text, "ts")[0] == 100.0);
+
+    // Each thread records into its own ring, with its own thread id,
+    // and no events are lost when threads record at the same time
+    Trace::clear();
+    const int nthreads = 4;
+    const size_t perThread = 1000;
+    vector<thread> threads;
+    for (int t = 0; t < nthreads; ++t) {
+        threads.push_back(thread(recordMany, "threaded", perThread));
+    }
+    for (int t = 0; t < nthreads; ++t) {
+        threads[t].join();
+    }
+    text = written();
+    CHECK(countOf(text, "\"name\":\"threaded\"") == nthreads * perThread);
+    vector<double> tids = fieldValues(text, "tid");
+    set<double> distinct(tids.begin(), tids.end());
+    CHECK(distinct.size() == size_t(nthreads));
+
+    // Events from a thread that has finished remain until cleared
+    Trace::clear();
+    CHECK(written() == "[\n]\n");
+
+    return TestHelpers::finish("test-trace");
+}
@@ -0,0 +1,234 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#ifndef _VAMP_COMPACT_FEATURE_H_
+#define _VAMP_COMPACT_FEATURE_H_
+
+#include "hostguard.h"
+#include "Plugin.h"
+#include "FeatureSink.h"
+
+#include <vector>
+#include <string>
+
+_VAMP_SDK_HOSTSPACE_BEGIN(CompactFeature.h)
+
+namespace Vamp {
+
+namespace HostExt {
+
+/**
+ * \class FeatureArena CompactFeature.h <vamp-hostsdk/CompactFeature.h>
+ *
+ * FeatureArena is a simple region allocator for feature values.  It
+ * hands out space from a small number of large blocks, and clear()
+ * makes all of that space available again at once without returning
+ * it to the system, so that a plugin adapter converting the same
+ * amount of output at every process call allocates nothing once it
+ * has warmed up.
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin SDK.
+ */
+
+class FeatureArena
+{
+public:
+    FeatureArena();
+    ~FeatureArena();
+
+    /**
+     * Return space for n floats, valid until the next call to clear()
+     * or the destruction of the arena.
+     */
+    float *allocate(size_t n);
+
+    /**
+     * Invalidate all space previously allocated, keeping it for
+     * reuse.
+     */
+    void clear();
+
+private:
+    FeatureArena(const FeatureArena &); // not provided
+    FeatureArena &operator=(const FeatureArena &); // not provided
+
+    std::vector<float *> m_blocks;
+    std::vector<size_t> m_sizes;
+    size_t m_block;
+    size_t m_used;
+};
+
+/**
+ * \class FeatureValues CompactFeature.h <vamp-hostsdk/CompactFeature.h>
+ *
+ * FeatureValues is a read-mostly array of feature values that avoids
+ * a heap allocation for each feature.  Up to InlineCapacity values
+ * are stored within the object itself, which covers the common case
+ * of outputs with a single value per feature.  Longer arrays, such as
+ * spectral bins, are stored in a FeatureArena if one is given, and
+ * otherwise in memory owned by the object.
+ *
+ * Values stored in an arena are only referred to, not owned, and
+ * remain valid only as long as the arena's space does.  Moving a
+ * FeatureValues object keeps that reference; copying one always
+ * makes an independent copy that owns its values.
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin SDK.
+ */
+
+class FeatureValues
+{
+public:
+    enum { InlineCapacity = 4 };
+    
+    FeatureValues() : m_size(0), m_external(0), m_owned(false) { }
+    FeatureValues(const float *values, size_t count, FeatureArena *arena = 0);
+    FeatureValues(const std::vector<float> &values);
+    FeatureValues(const FeatureValues &other);
+    FeatureValues(FeatureValues &&other);
+    ~FeatureValues();
+
+    FeatureValues &operator=(const FeatureValues &other);
+    FeatureValues &operator=(FeatureValues &&other);
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    const float *data() const {
+        return m_size <= InlineCapacity ? m_inline : m_external;
+    }
+    float *data() {
+        return m_size <= InlineCapacity ? m_inline : m_external;
+    }
+
+    const float &operator[](size_t i) const { return data()[i]; }
+    float &operator[](size_t i) { return data()[i]; }
+
+    const float *begin() const { return data(); }
+    const float *end() const { return data() + m_size; }
+
+    /**
+     * Return true if the values are stored in an arena rather than
+     * within or owned by this object.
+     */
+    bool isInArena() const { return m_size > InlineCapacity && !m_owned; }
+
+    std::vector<float> toVector() const {
+        return std::vector<float>(begin(), end());
+    }
+
+private:
+    void assign(const float *values, size_t count, FeatureArena *arena);
+    void release();
+    
+    size_t m_size;
+    float *m_external;
+    bool m_owned;
+    float m_inline[InlineCapacity];
+};
+
+/**
+ * \class CompactFeature CompactFeature.h <vamp-hostsdk/CompactFeature.h>
+ *
+ * CompactFeature is an alternative to Plugin::Feature that stores
+ * its values in a FeatureValues object rather than a std::vector, so
+ * that converting and passing on features with few values requires
+ * no heap allocation.  It is delivered to a FeatureSink through
+ * FeatureSink::pushCompact(); see CompactFeatureSink.
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin SDK.
+ */
+
+struct CompactFeature
+{
+    bool hasTimestamp;
+    RealTime timestamp;
+    bool hasDuration;
+    RealTime duration;
+    FeatureValues values;
+    std::string label;
+
+    CompactFeature() : hasTimestamp(false), hasDuration(false) { }
+
+    /**
+     * Construct from a Plugin::Feature, taking over its label.
+     */
+    explicit CompactFeature(Plugin::Feature &&feature);
+
+    /**
+     * Return a Plugin::Feature with a copy of this feature's values.
+     */
+    Plugin::Feature toFeature() const;
+};
+
+/**
+ * \class CompactFeatureSink CompactFeature.h <vamp-hostsdk/CompactFeature.h>
+ *
+ * CompactFeatureSink is a FeatureSink that receives all of its
+ * features as CompactFeature objects.  A host implements
+ * pushCompact() to consume them.  Features that reach the sink as
+ * Plugin::Feature objects, for example from a plugin or adapter that
+ * does not support compact features, are converted first.
+ *
+ * The plugin adapters in the SDK that convert features from a
+ * plugin's C representation store values that do not fit within a
+ * FeatureValues object in an arena, which is reused at the next
+ * process or getRemainingFeatures call.  A sink that keeps features
+ * beyond the call to pushCompact() must copy any whose values are
+ * in an arena (see FeatureValues::isInArena()).
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin SDK.
+ */
+
+class CompactFeatureSink : public FeatureSink
+{
+public:
+    void push(int outputNumber, Plugin::Feature &&feature) {
+        pushCompact(outputNumber, CompactFeature(std::move(feature)));
+    }
+
+    bool acceptsCompactFeatures() const { return true; }
+
+    virtual void pushCompact(int outputNumber, CompactFeature &&feature) = 0;
+};
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(CompactFeature.h)
+
+#endif
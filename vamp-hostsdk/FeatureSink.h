@@ -0,0 +1,165 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#ifndef _VAMP_FEATURE_SINK_H_
+#define _VAMP_FEATURE_SINK_H_
+
+#include "hostguard.h"
+#include "Plugin.h"
+
+_VAMP_SDK_HOSTSPACE_BEGIN(FeatureSink.h)
+
+namespace Vamp {
+
+namespace HostExt {
+
+struct CompactFeature;
+
+/**
+ * \class FeatureSink FeatureSink.h <vamp-hostsdk/FeatureSink.h>
+ *
+ * FeatureSink is an interface for receiving features from a plugin
+ * one at a time, as an alternative to receiving them in the
+ * FeatureSet returned by Plugin::process() and
+ * Plugin::getRemainingFeatures().
+ *
+ * Returning a FeatureSet by value means that every adapter in a chain
+ * (see PluginWrapper) builds a new map and copies the features of the
+ * plugin it wraps into it.  When features are delivered to a sink
+ * instead, using processFrom() and remainingFeaturesFrom(), each
+ * feature is converted once from the plugin's C representation and
+ * then moved through the adapter chain to the sink, with no
+ * intermediate maps.  The adapters provided in the SDK all support
+ * this; any other plugin or adapter is called through its ordinary
+ * process() method and the resulting features passed on.
+ *
+ * A host implements push() to consume each feature.  Features are
+ * pushed in order within each output, but features for different
+ * outputs may be interleaved in any order.
+ *
+ * A sink may instead receive features as CompactFeature objects,
+ * which need no heap allocation for outputs with few values per
+ * feature, by returning true from acceptsCompactFeatures() and
+ * implementing pushCompact().  See CompactFeatureSink.
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin SDK.
+ */
+
+class FeatureSink
+{
+public:
+    virtual ~FeatureSink();
+
+    /**
+     * Receive a single feature for the given output number.  The
+     * sink may move from the feature.
+     */
+    virtual void push(int outputNumber, Plugin::Feature &&feature) = 0;
+
+    /**
+     * Return true if this sink would rather receive features through
+     * pushCompact() than push().  Plugin adapters that convert
+     * features check this to decide which to call.  The default
+     * implementation returns false.
+     */
+    virtual bool acceptsCompactFeatures() const { return false; }
+
+    /**
+     * Receive a single feature for the given output number in
+     * compact form.  The sink may move from the feature.  Any values
+     * it holds in a FeatureArena remain valid only until this
+     * function returns.  The default implementation converts the
+     * feature and calls push().
+     */
+    virtual void pushCompact(int outputNumber, CompactFeature &&feature);
+
+    /**
+     * Push every feature in the given feature set, in output order.
+     */
+    void pushAll(Plugin::FeatureSet &&features);
+
+    /**
+     * Call process() on the given plugin, delivering the resulting
+     * features to this sink.  If the plugin is a PluginWrapper or
+     * PluginHostAdapter, the features are pushed directly rather than
+     * returned in a FeatureSet.
+     */
+    void processFrom(Plugin *plugin,
+                     const float *const *inputBuffers,
+                     RealTime timestamp);
+
+    /**
+     * Call getRemainingFeatures() on the given plugin, delivering the
+     * resulting features to this sink.
+     */
+    void remainingFeaturesFrom(Plugin *plugin);
+};
+
+/**
+ * \class FeatureSetSink FeatureSink.h <vamp-hostsdk/FeatureSink.h>
+ *
+ * FeatureSetSink is a FeatureSink that appends the features it
+ * receives to a FeatureSet, giving the same result as the FeatureSet
+ * returned by the equivalent process() or getRemainingFeatures()
+ * call.
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin SDK.
+ */
+
+class FeatureSetSink : public FeatureSink
+{
+public:
+    /**
+     * Construct a sink that appends to the given feature set, which
+     * must outlive it.
+     */
+    FeatureSetSink(Plugin::FeatureSet &features) : m_features(features) { }
+    
+    void push(int outputNumber, Plugin::Feature &&feature) {
+        m_features[outputNumber].push_back(std::move(feature));
+    }
+
+protected:
+    Plugin::FeatureSet &m_features;
+};
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(FeatureSink.h)
+
+#endif
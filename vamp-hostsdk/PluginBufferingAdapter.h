@@ -176,11 +176,43 @@ public:
 
     OutputList getOutputDescriptors() const;
 
+    /**
+     * Return UnknownStateDependency. The adapter re-blocks its input,
+     * so the blocks passed to its process() do not correspond to
+     * those the plugin sees, and splitting at one of them would not
+     * give the plugin the same blocks as a single run would.
+     */
+    StateDependency getStateDependency() const;
+
+    /**
+     * Return 0; see getStateDependency().
+     */
+    size_t getWarmUpBlockCount() const;
+
+    /**
+     * Return the state of the wrapped plugin together with the
+     * adapter's own, including any input queued but not yet passed
+     * to the plugin. Return false if the plugin does not support
+     * getState().
+     */
+    bool getState(StateData &state) const;
+
+    /**
+     * Restore a state returned by getState() on an adapter wrapping
+     * the same plugin, initialised with the same arguments.
+     */
+    bool setState(const StateData &state);
+
     void reset();
 
     FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
+
+    void processInto(const float *const *inputBuffers, RealTime timestamp,
+                     FeatureSink &sink);
     
     FeatureSet getRemainingFeatures();
+
+    void getRemainingFeaturesInto(FeatureSink &sink);
     
 protected:
     class Impl;
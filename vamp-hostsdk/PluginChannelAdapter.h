@@ -125,6 +125,9 @@ public:
 
     FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
 
+    void processInto(const float *const *inputBuffers, RealTime timestamp,
+                     FeatureSink &sink);
+
     /**
      * Call process(), providing interleaved audio data with the
      * number of channels passed to initialise().  The adapter will
@@ -136,6 +139,54 @@ public:
      */
     FeatureSet processInterleaved(const float *inputBuffer, RealTime timestamp);
 
+    /**
+     * Process strided input with the number of channels passed to
+     * initialise(). If the wrapped plugin reads strided input
+     * directly and no mixing or padding of channels is needed, the
+     * buffer is passed straight through to it; otherwise the adapter
+     * de-interleaves into temporary buffers as processInterleaved()
+     * does.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    FeatureSet processStrided(const float *inputBuffer,
+                              size_t channels, size_t frames, size_t stride,
+                              RealTime timestamp);
+
+    /**
+     * Return true if processStrided() and processInterleaved() will
+     * pass their input straight through to the wrapped plugin. This
+     * depends on the channel count, so is only meaningful after
+     * initialise() has been called.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    bool supportsStridedInput() const;
+
+    /**
+     * Pass double-precision input straight through to the wrapped
+     * plugin where no channels need to be added or mixed down, or
+     * otherwise convert it to float and call process().
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    FeatureSet processDouble(const double *const *inputBuffers,
+                             size_t channels, size_t frames,
+                             RealTime timestamp);
+
+    /**
+     * Return true if processDouble() will pass its input straight
+     * through to the wrapped plugin. Like supportsStridedInput(),
+     * this is only meaningful after initialise() has been called.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    bool supportsDoubleInput() const;
+
 protected:
     class Impl;
     Impl *m_impl;
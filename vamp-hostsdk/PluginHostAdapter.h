@@ -43,11 +43,17 @@
 #include <vamp/vamp.h>
 
 #include <vector>
+#include <mutex>
 
 _VAMP_SDK_HOSTSPACE_BEGIN(PluginHostAdapter.h)
 
 namespace Vamp {
 
+namespace HostExt {
+class FeatureSink;
+class FeatureArena;
+}
+
 /**
  * \class PluginHostAdapter PluginHostAdapter.h <vamp-hostsdk/PluginHostAdapter.h>
  * 
@@ -70,6 +76,26 @@ class PluginHostAdapter : public Plugin
 public:
     PluginHostAdapter(const VampPluginDescriptor *descriptor,
                       float inputSampleRate);
+
+    /**
+     * Construct an adapter for the given descriptor that may also
+     * use the given plugin extensions, as returned by the plugin
+     * library's vampGetPluginExtensions function. The extensions may
+     * be NULL. PluginLoader uses this constructor when the library
+     * provides extensions.
+     *
+     * Where the extensions support it, process() and
+     * getRemainingFeatures() have the plugin write its features into
+     * an output buffer owned by this adapter, rather than into memory
+     * allocated by the plugin.
+     *
+     * \note This constructor was introduced in version 2.11 of the
+     * Vamp plugin SDK.
+     */
+    PluginHostAdapter(const VampPluginDescriptor *descriptor,
+                      const VampPluginExtensions *extensions,
+                      float inputSampleRate);
+
     virtual ~PluginHostAdapter();
     
     static std::vector<std::string> getPluginPath();
@@ -107,11 +133,169 @@ public:
 
     FeatureSet getRemainingFeatures();
 
+    /**
+     * Pass strided input straight through to the plugin if it
+     * provides the strided-input extension, or de-interleave it and
+     * call process() otherwise.
+     */
+    FeatureSet processStrided(const float *inputBuffer,
+                              size_t channels, size_t frames, size_t stride,
+                              RealTime timestamp);
+
+    /**
+     * Return true if the plugin provides the strided-input extension
+     * and reports that it reads strided input directly.
+     */
+    bool supportsStridedInput() const;
+
+    /**
+     * Call the plugin's double-precision process function through
+     * the plugin library's extensions if it has them, or otherwise
+     * convert the input to float and call process().
+     */
+    FeatureSet processDouble(const double *const *inputBuffers,
+                             size_t channels, size_t frames,
+                             RealTime timestamp);
+
+    /**
+     * Return true if the plugin provides the double-precision input
+     * extension and reports that it reads double input directly.
+     */
+    bool supportsDoubleInput() const;
+
+    /**
+     * Return the plugin's preferred spectrum format through the
+     * plugin library's extensions if it has them, or otherwise
+     * ComplexSpectrum.
+     */
+    SpectrumFormat getPreferredSpectrumFormat() const;
+
+    /**
+     * Ask the plugin to accept the given spectrum format through the
+     * plugin library's extensions. A plugin without them accepts
+     * only ComplexSpectrum.
+     */
+    bool setSpectrumFormat(SpectrumFormat format);
+
+    /**
+     * Return the state dependency reported through the plugin
+     * library's extensions, or UnknownStateDependency if there are
+     * none.
+     */
+    StateDependency getStateDependency() const;
+
+    size_t getWarmUpBlockCount() const;
+
+    /**
+     * Return the state dependency reported for the plugin with the
+     * given descriptor through the given extensions (which may be
+     * NULL), without instantiating it. For BoundedHistory, also set
+     * warmUpBlocks, if non-NULL, to the number of preceding blocks
+     * required.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    static StateDependency getStateDependency
+    (const VampPluginDescriptor *descriptor,
+     const VampPluginExtensions *extensions,
+     size_t *warmUpBlocks);
+
+    /**
+     * Obtain a snapshot of the plugin's processing state through the
+     * plugin library's extensions. Return false if there are none or
+     * the plugin does not support it.
+     */
+    bool getState(StateData &state) const;
+
+    /**
+     * Restore a snapshot through the plugin library's extensions.
+     * Return false if there are none or the plugin rejects it.
+     */
+    bool setState(const StateData &state);
+
+    /**
+     * Pass the given scheduler to the plugin through the plugin
+     * library's extensions, if it has them. Otherwise the plugin
+     * will use its own threads, if any.
+     */
+    void setTaskScheduler(TaskScheduler *scheduler);
+
+    /**
+     * Pass the enabled outputs to the plugin through the plugin
+     * library's extensions, if it has them. Whether it has them or
+     * not, features for disabled outputs are not converted or
+     * returned.
+     */
+    void setEnabledOutputs(const std::vector<bool> &enabled);
+
+    /**
+     * Process the given input as process() does, but push each
+     * resulting feature to the given sink as it is converted from the
+     * plugin's C representation, instead of returning a FeatureSet.
+     * See HostExt::FeatureSink.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    void processInto(const float *const *inputBuffers, RealTime timestamp,
+                     HostExt::FeatureSink &sink);
+
+    /**
+     * Push the remaining features, as returned by
+     * getRemainingFeatures(), to the given sink.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    void getRemainingFeaturesInto(HostExt::FeatureSink &sink);
+
 protected:
     void convertFeatures(VampFeatureList *, FeatureSet &);
+    void convertFeatures(VampFeatureList *, HostExt::FeatureSink &);
+    void convertCompactFeatures(VampFeatureList *, HostExt::FeatureSink &);
 
     const VampPluginDescriptor *m_descriptor;
+    const VampPluginExtensions *m_extensions;
     VampPluginHandle m_handle;
+
+    // Host-owned buffer for the features returned through the
+    // processToBuffer extension, grown when the plugin reports it
+    // too small
+    void *m_outputBuffer;
+    size_t m_outputBufferSize;
+    bool m_useOutputBuffer;
+
+    VampFeatureList *receiveFeatures(size_t required);
+
+    // Storage for the values of features passed to sinks that accept
+    // compact features, reused at each conversion
+    HostExt::FeatureArena *m_arena;
+
+    // As passed to setEnabledOutputs; outputs beyond its end are
+    // enabled
+    std::vector<bool> m_enabledOutputs;
+    bool isOutputEnabled(unsigned int output) const {
+        return output >= m_enabledOutputs.size() || m_enabledOutputs[output];
+    }
+
+    // The output descriptors are converted from the plugin's C
+    // representation once and then reused until initialise,
+    // setParameter or selectProgram indicates they may have changed
+    mutable std::mutex m_outputsMutex;
+    mutable bool m_outputsValid;
+    mutable OutputList m_outputs;
+
+    void invalidateOutputs();
+
+    // C-callable forwarders to the TaskScheduler passed to
+    // setTaskScheduler, which is the context of m_scheduler
+    VampTaskScheduler m_scheduler;
+    static void *submitTask(void *, void (*)(void *), void *);
+    static void waitTask(void *, void *);
+    static void parallelFor(void *, unsigned int,
+                            void (*)(void *, unsigned int), void *);
+    static unsigned int getConcurrency(void *);
 };
 
 }
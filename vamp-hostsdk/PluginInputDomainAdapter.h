@@ -76,6 +76,12 @@ namespace HostExt {
  * and the current shape retrieved using getWindowType.  (This was
  * added in v2.3 of the SDK.)
  *
+ * If the wrapped plugin prefers a magnitude or power spectrum (see
+ * Plugin::getPreferredSpectrumFormat) and accepts it when asked, the
+ * adapter supplies that instead of the complex spectrum, so that the
+ * plugin does not have to convert it.  (This was added in v2.11 of
+ * the SDK.)
+ *
  * In every respect other than its input domain handling, the
  * PluginInputDomainAdapter behaves identically to the plugin that it
  * wraps.  The wrapped plugin will be deleted when the wrapper is
@@ -99,6 +105,21 @@ public:
     bool initialise(size_t channels, size_t stepSize, size_t blockSize);
     void reset();
 
+    /**
+     * Return the state of the wrapped plugin together with the
+     * adapter's own, which includes the shift buffers used by the
+     * ShiftData timestamp method. Return false if the plugin does not
+     * support getState().
+     */
+    bool getState(StateData &state) const;
+
+    /**
+     * Restore a state returned by getState() on an adapter wrapping
+     * the same plugin, with the same timestamp method, initialised
+     * with the same arguments.
+     */
+    bool setState(const StateData &state);
+
     InputDomain getInputDomain() const;
 
     size_t getPreferredStepSize() const;
@@ -106,6 +127,34 @@ public:
 
     FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
 
+    void processInto(const float *const *inputBuffers, RealTime timestamp,
+                     FeatureSink &sink);
+
+    /**
+     * Window and transform double-precision input without first
+     * converting it to float, passing the spectra on to the plugin's
+     * processDouble() if it reports supportsDoubleInput(). The input
+     * must have the channel count and block size given to
+     * initialise(); anything else is converted and passed to
+     * process().
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    FeatureSet processDouble(const double *const *inputBuffers,
+                             size_t channels, size_t frames,
+                             RealTime timestamp);
+
+    /**
+     * Return true if processDouble() reads its input directly. This
+     * is the case for frequency-domain plugins except with the
+     * ShiftData timestamp method, whose buffering is in float.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    bool supportsDoubleInput() const;
+
     /**
      * ProcessTimestampMethod determines how the
      * PluginInputDomainAdapter handles timestamps for the data passed
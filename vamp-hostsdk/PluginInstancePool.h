@@ -0,0 +1,177 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#ifndef _VAMP_PLUGIN_INSTANCE_POOL_H_
+#define _VAMP_PLUGIN_INSTANCE_POOL_H_
+
+#include <string>
+#include <map>
+
+#include "hostguard.h"
+#include "PluginLoader.h"
+
+_VAMP_SDK_HOSTSPACE_BEGIN(PluginInstancePool.h)
+
+namespace Vamp {
+
+class Plugin;
+
+namespace HostExt {
+
+/**
+ * \class PluginInstancePool PluginInstancePool.h <vamp-hostsdk/PluginInstancePool.h>
+ * 
+ * PluginInstancePool keeps a supply of loaded and initialised plugin
+ * instances, so that a host that runs the same plugin many times
+ * over (for example on a large number of short audio clips) does not
+ * have to pay the cost of loading, adapting and initialising the
+ * plugin each time.  Initialisation can be relatively expensive, as
+ * it is where plugins and adapters typically allocate their windows,
+ * FFT state, ring buffers and per-bin arrays.
+ *
+ * Instances are obtained with acquire(), which returns an instance
+ * that has been loaded through a PluginLoader with the given adapter
+ * flags, had the given parameters set, and been initialised with the
+ * given channel count, step size and block size.  When the host has
+ * finished with an instance it should hand it back with release(),
+ * which calls reset() on it and keeps it for reuse by a subsequent
+ * acquire() call with exactly the same configuration.
+ *
+ * An instance obtained from acquire() is equivalent to one freshly
+ * loaded and initialised, provided that the plugin's reset() is
+ * correctly implemented.  Hosts must not change the parameters or
+ * program of an acquired instance; an instance whose parameters are
+ * found to have changed is deleted on release() rather than reused.
+ *
+ * This class is thread-safe: acquire() and release() may be called
+ * from any thread, as may the PluginLoader that the pool uses.  The
+ * instances themselves are not, and each should be used from one
+ * thread at a time as usual.
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin SDK.
+ */
+
+class PluginInstancePool
+{
+public:
+    /**
+     * ParameterValues is a map from parameter identifier to value, as
+     * passed to Plugin::setParameter().
+     */
+    typedef std::map<std::string, float> ParameterValues;
+
+    /**
+     * Construct a pool that loads plugins using the given loader, or
+     * using the PluginLoader singleton if none is given.
+     */
+    PluginInstancePool(PluginLoader *loader = 0);
+
+    /**
+     * Destroy the pool, deleting any instances it is holding.
+     * Instances that have been acquired and not yet released are
+     * unaffected, and become the responsibility of the host to
+     * delete.
+     */
+    virtual ~PluginInstancePool();
+
+    /**
+     * Return an initialised instance of the plugin with the given
+     * key, adapted according to adapterFlags (see
+     * PluginLoader::AdapterFlags) and configured with the given
+     * parameter values, sample rate, channel count, step size and
+     * block size.  An idle instance with the same configuration is
+     * reused if available; otherwise a new one is loaded.
+     *
+     * Returns 0 if the plugin could not be loaded, or if it refused
+     * to initialise with the given configuration.
+     *
+     * The returned instance should be handed back using release()
+     * when the host has finished with it, or else deleted using
+     * discard() or the standard C++ delete keyword.
+     */
+    Plugin *acquire(PluginLoader::PluginKey key,
+                    float inputSampleRate,
+                    int adapterFlags,
+                    size_t channels,
+                    size_t stepSize,
+                    size_t blockSize,
+                    const ParameterValues &parameters = ParameterValues());
+
+    /**
+     * Return an instance previously obtained from acquire() to the
+     * pool.  The instance is reset() and kept for reuse, unless the
+     * pool already holds the maximum number of idle instances for its
+     * configuration, in which case it is deleted.  The host must not
+     * use the instance after releasing it.
+     */
+    void release(Plugin *plugin);
+
+    /**
+     * Delete an instance previously obtained from acquire(), without
+     * returning it to the pool.  This is equivalent to deleting it
+     * directly, except that the pool also forgets about it.
+     */
+    void discard(Plugin *plugin);
+
+    /**
+     * Set the maximum number of idle instances retained for any
+     * single configuration.  The default is 4.  Instances released
+     * beyond this number are deleted.
+     */
+    void setMaxIdlePerConfiguration(size_t n);
+
+    /**
+     * Return the total number of idle instances currently held.
+     */
+    size_t getIdleCount() const;
+
+    /**
+     * Delete all idle instances currently held.
+     */
+    void clear();
+
+protected:
+    class Impl;
+    Impl *m_impl;
+};
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(PluginInstancePool.h)
+
+#endif
@@ -66,8 +66,10 @@ namespace HostExt {
  * class, and are certainly not required to use this actual class.
  * But we do strongly recommend it.
  *
- * This class is not thread-safe; use it from a single application
- * thread, or guard access to it with a mutex.
+ * Since version 2.11 of the Vamp plugin SDK this class is
+ * thread-safe: plugins may be listed, loaded and deleted from any
+ * thread.  (Earlier versions required a single application thread, or
+ * a mutex guarding all use of the loader and deletion of its plugins.)
  *
  * \note This class was introduced in version 1.1 of the Vamp plugin SDK.
  */
@@ -260,6 +262,28 @@ public:
      */
     std::string getLibraryPathForPlugin(PluginKey plugin);
 
+    /**
+     * Return the state dependency declared by a Vamp plugin, given
+     * its identifying key, without instantiating it. This tells a
+     * host whether it may split its input into segments and process
+     * them in separate instances of the plugin: see
+     * Plugin::getStateDependency(). If the result is BoundedHistory
+     * and warmUpBlocks is non-NULL, it will receive the number of
+     * preceding blocks each segment needs.
+     *
+     * If the plugin or its library does not declare this, or the
+     * plugin cannot be found, return UnknownStateDependency.
+     *
+     * The result describes the plugin itself, without any of the
+     * adapters that loadPlugin() may add. Of those, only the
+     * PluginBufferingAdapter changes it.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    Plugin::StateDependency getPluginStateDependency(PluginKey plugin,
+                                                     size_t *warmUpBlocks = 0);
+
 protected:
     PluginLoader();
     virtual ~PluginLoader();
@@ -0,0 +1,194 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#ifndef _VAMP_PLUGIN_PROFILING_ADAPTER_H_
+#define _VAMP_PLUGIN_PROFILING_ADAPTER_H_
+
+#include "hostguard.h"
+#include "PluginWrapper.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+_VAMP_SDK_HOSTSPACE_BEGIN(PluginProfilingAdapter.h)
+
+namespace Vamp {
+
+namespace HostExt {
+
+/**
+ * \class PluginProfilingAdapter PluginProfilingAdapter.h <vamp-hostsdk/PluginProfilingAdapter.h>
+ *
+ * PluginProfilingAdapter is a Vamp plugin adapter that measures the
+ * plugin it wraps.  For each call to process() and
+ * getRemainingFeatures() it records the elapsed wall-clock time and
+ * the CPU time of the calling thread, accumulating them into
+ * histograms, and it counts the features and values returned on each
+ * output.  If the host has installed an allocation counter using
+ * setAllocationCounter(), it also records the number of bytes
+ * allocated during each call.
+ *
+ * Because it is an ordinary PluginWrapper, a PluginProfilingAdapter
+ * may be placed at any level of a chain of adapters.  For example, a
+ * host may wrap the plugin returned by PluginLoader::loadPlugin in
+ * order to measure the whole chain, and also wrap a plugin loaded
+ * with no adapter flags before applying the other adapters itself, in
+ * order to measure the plugin alone.  Comparing the two shows the
+ * cost of the adapters.
+ *
+ * The measurements are available as a Report structure, or formatted
+ * as a JSON object.  Profiling adds a small fixed overhead (a few
+ * clock reads) to each call.
+ *
+ * In every other respect the PluginProfilingAdapter behaves
+ * identically to the plugin that it wraps.  The wrapped plugin will
+ * be deleted when the wrapper is deleted.  If you wish to prevent
+ * this, call disownPlugin().
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin SDK.
+ */
+
+class PluginProfilingAdapter : public PluginWrapper
+{
+public:
+    /**
+     * Construct a PluginProfilingAdapter wrapping the given plugin.
+     * The adapter takes ownership of the plugin, which will be
+     * deleted when the adapter is deleted. If you wish to prevent
+     * this, call disownPlugin().
+     *
+     * The label is included in the report, and may be used to
+     * distinguish several profiling adapters in one adapter chain.
+     */
+    PluginProfilingAdapter(Plugin *plugin, std::string label = "");
+    virtual ~PluginProfilingAdapter();
+
+    FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
+
+    FeatureSet getRemainingFeatures();
+
+    /**
+     * Number of buckets in each time histogram. Bucket 0 counts calls
+     * taking less than 2 nanoseconds; bucket i > 0 counts calls taking
+     * at least 2^i and less than 2^(i+1) nanoseconds, except that the
+     * final bucket also counts anything longer.
+     */
+    static const int HistogramBuckets = 40;
+
+    /**
+     * Measurements accumulated for one kind of call.  Times are in
+     * nanoseconds.  bytesAllocated is zero unless an allocation
+     * counter has been installed.
+     */
+    struct CallProfile {
+        size_t calls;
+        unsigned long long totalWallNs;
+        unsigned long long totalCpuNs;
+        unsigned long long minWallNs;
+        unsigned long long maxWallNs;
+        unsigned long long bytesAllocated;
+        std::vector<size_t> wallHistogram;
+        std::vector<size_t> cpuHistogram;
+        CallProfile();
+    };
+
+    /**
+     * Counts of the features, and of the values within them,
+     * returned on a single output.
+     */
+    struct OutputProfile {
+        size_t features;
+        size_t values;
+        OutputProfile() : features(0), values(0) { }
+    };
+
+    struct Report {
+        std::string label;
+        std::string pluginIdentifier;
+        bool allocationsCounted;
+        CallProfile process;
+        CallProfile remaining;
+        std::map<int, OutputProfile> outputs; // by output number
+    };
+
+    /**
+     * Return the measurements accumulated since construction or the
+     * last call to resetReport().
+     */
+    Report getReport() const;
+
+    /**
+     * Return the measurements accumulated since construction or the
+     * last call to resetReport(), as a single JSON object.
+     */
+    std::string getReportJSON() const;
+
+    /**
+     * Discard all accumulated measurements.  Note that reset() does
+     * not do this, so that a report can span several runs.
+     */
+    void resetReport();
+
+    /**
+     * Function returning the total number of bytes allocated so far
+     * by the calling thread.  The difference between its values
+     * before and after a call is recorded as the bytes allocated by
+     * that call.
+     */
+    typedef unsigned long long (*AllocationCounter)();
+
+    /**
+     * Install a function used by all profiling adapters to count
+     * allocations, or 0 to stop counting.  The SDK cannot count
+     * allocations by itself; a host wishing to do so will typically
+     * replace the global operator new and count the sizes requested
+     * through it.
+     */
+    static void setAllocationCounter(AllocationCounter counter);
+
+protected:
+    class Impl;
+    Impl *m_impl;
+};
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(PluginProfilingAdapter.h)
+
+#endif
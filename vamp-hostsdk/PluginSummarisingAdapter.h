@@ -74,7 +74,9 @@ namespace HostExt {
  *
  * PluginSummarisingAdapter is straightforward rather than fast.  It
  * calculates all of the summary types for all outputs always, and
- * then returns only the ones that are requested.  It is designed on
+ * then returns only the ones that are requested.  (It can however
+ * spread that calculation across threads if given a TaskScheduler:
+ * see setTaskScheduler.)  It is designed on
  * the basis that, for most features, summarising and storing
  * summarised results is far cheaper than calculating the results in
  * the first place.  If this is not true for your particular feature,
@@ -99,9 +101,62 @@ public:
 
     void reset();
 
+    /**
+     * Return false. The adapter's accumulated summary data is not
+     * included in plugin state snapshots, so restoring only the
+     * wrapped plugin's state would give incorrect summaries.
+     */
+    bool getState(StateData &state) const;
+
+    /**
+     * Return false; see getState().
+     */
+    bool setState(const StateData &state);
+
+    /**
+     * Pass the scheduler on to the wrapped plugin, and also use it
+     * when calculating summaries. The summaries for each output,
+     * segment and range of bins are independent of one another and
+     * are calculated as separate tasks, so a summary of a long
+     * spectrogram-like output can make use of all of the host's
+     * threads. The results are the same whatever the scheduler. With
+     * no scheduler, the summaries are calculated serially. A host
+     * with no scheduler of its own can use a ThreadPoolScheduler.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    void setTaskScheduler(TaskScheduler *scheduler);
+
+    /**
+     * Limit the memory used to hold the plugin's results while they
+     * await summarising. Once the results held in memory exceed the
+     * given number of bytes, further results are written out to a
+     * temporary file, which is mapped back into memory for reading
+     * when the summaries are calculated. Sorting for the medians and
+     * modes is then also carried out in runs that fit within the
+     * budget, merging from the temporary file. The summaries are
+     * exactly the same as without a budget.
+     *
+     * The budget applies separately to the accumulated results and
+     * to the sorting, so peak memory use may approach twice the
+     * budget, plus a small amount per output and segment. Call this
+     * before processing begins. The default is 0, meaning no limit.
+     * If the temporary file cannot be written, results are kept in
+     * memory instead.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    void setMemoryBudget(size_t bytes);
+
     FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
     FeatureSet getRemainingFeatures();
 
+    void processInto(const float *const *inputBuffers, RealTime timestamp,
+                     FeatureSink &sink);
+    void getRemainingFeaturesInto(FeatureSink &sink);
+
     typedef std::set<RealTime> SegmentBoundaries;
 
     /**
@@ -184,6 +239,105 @@ public:
     FeatureSet getSummaryForAllOutputs(SummaryType type,
                                        AveragingMethod method = SampleAverage);
 
+    /**
+     * \class SummaryState PluginSummarisingAdapter.h <vamp-hostsdk/PluginSummarisingAdapter.h>
+     *
+     * SummaryState holds the partial results from which the adapter
+     * calculates its summaries, in a form that can be saved, loaded,
+     * and merged with the state from another run. A host that splits
+     * a long recording into chunks, perhaps on separate machines, can
+     * run a separate adapter over each chunk, merge the states, and
+     * then obtain summaries for the recording as a whole.
+     *
+     * Each chunk should be processed with timestamps relative to the
+     * start of the whole recording, and with the same segment
+     * boundaries (if any). Segments that start at the same time in
+     * both states are merged.
+     *
+     * Minimum, maximum, sum, count, mean and variance merge exactly,
+     * apart from floating-point rounding. Medians and modes are taken
+     * from a histogram of the values in each bin, which is exact for
+     * as long as a bin has no more than 1024 distinct values. (Even
+     * so, rounding may put a continuous-time median on the other side
+     * of a value whose durations reach exactly half of the total.)
+     * Beyond 1024 values, the closest neighbouring values are
+     * combined, and the median and mode become approximate.
+     *
+     * \note This class was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    class SummaryState
+    {
+    public:
+        /**
+         * Construct an empty state, ready to merge into or read into.
+         */
+        SummaryState();
+        SummaryState(const SummaryState &);
+        SummaryState &operator=(const SummaryState &);
+        ~SummaryState();
+
+        /**
+         * Return true if the state contains no results.
+         */
+        bool isEmpty() const;
+
+        /**
+         * Merge the results from another state into this one.
+         */
+        void merge(const SummaryState &other);
+
+        /**
+         * Return summaries of the results for the given output,
+         * equivalent to those that the adapter's own
+         * getSummaryForOutput() would return had it processed all
+         * of the input merged into this state.
+         */
+        FeatureList getSummaryForOutput(int output,
+                                        SummaryType type,
+                                        AveragingMethod method = SampleAverage)
+            const;
+
+        /**
+         * Return summaries of the results for all outputs, as for
+         * getSummaryForOutput().
+         */
+        FeatureSet getSummaryForAllOutputs(SummaryType type,
+                                           AveragingMethod method = SampleAverage)
+            const;
+
+        /**
+         * Write the state to the given byte array. The format uses
+         * fixed-size fields in the machine's byte order, so it can be
+         * read on any machine with the same byte order.
+         */
+        void serialise(StateData &data) const;
+
+        /**
+         * Replace this state with one read from the given byte array,
+         * as written by serialise(). Return false, leaving this state
+         * empty, if the data could not be read.
+         */
+        bool deserialise(const StateData &data);
+
+    private:
+        class Impl;
+        Impl *m_impl;
+        friend class PluginSummarisingAdapter;
+    };
+
+    /**
+     * Return the partial results from which the summaries are
+     * calculated, for saving or merging with those of another run.
+     *
+     * Like the getSummary functions, this must only be called once
+     * the plugin has been fully run.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    SummaryState getSummaryState();
+
 protected:
     class Impl;
     Impl *m_impl;
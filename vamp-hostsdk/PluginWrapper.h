@@ -46,6 +46,8 @@ namespace Vamp {
 
 namespace HostExt {
 
+class FeatureSink;
+
 /**
  * \class PluginWrapper PluginWrapper.h <vamp-hostsdk/PluginWrapper.h>
  * 
@@ -96,10 +98,53 @@ public:
 
     OutputList getOutputDescriptors() const;
 
+    StateDependency getStateDependency() const;
+    size_t getWarmUpBlockCount() const;
+
+    /**
+     * Return the wrapped plugin's state, or restore it. An adapter
+     * that holds processing state of its own must override these to
+     * include that state as well, or to return false.
+     */
+    bool getState(StateData &state) const;
+    bool setState(const StateData &state);
+
+    void setTaskScheduler(TaskScheduler *scheduler);
+    void setEnabledOutputs(const std::vector<bool> &enabled);
+
     FeatureSet process(const float *const *inputBuffers, RealTime timestamp);
 
     FeatureSet getRemainingFeatures();
 
+    /**
+     * Process the given input as process() does, but deliver the
+     * resulting features to the given sink instead of returning
+     * them.  Hosts would normally call FeatureSink::processFrom()
+     * rather than calling this directly.
+     *
+     * The default implementation calls process() and pushes the
+     * features it returns.  Adapters that override this to pass
+     * features straight through to the sink should implement
+     * process() in terms of it, and subclasses of such adapters that
+     * override process() must override this as well.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual void processInto(const float *const *inputBuffers,
+                             RealTime timestamp,
+                             FeatureSink &sink);
+
+    /**
+     * Deliver the remaining features, as returned by
+     * getRemainingFeatures(), to the given sink.  The same
+     * considerations apply as for processInto().
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual void getRemainingFeaturesInto(FeatureSink &sink);
+
     /**
      * Return a pointer to the plugin wrapper of type WrapperType
      * surrounding this wrapper's plugin, if present.
@@ -0,0 +1,111 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+#ifndef _VAMP_THREAD_POOL_SCHEDULER_H_
+#define _VAMP_THREAD_POOL_SCHEDULER_H_
+
+#include "hostguard.h"
+#include "TaskScheduler.h"
+
+_VAMP_SDK_HOSTSPACE_BEGIN(ThreadPoolScheduler.h)
+
+namespace Vamp {
+
+namespace HostExt {
+
+/**
+ * \class ThreadPoolScheduler ThreadPoolScheduler.h <vamp-hostsdk/ThreadPoolScheduler.h>
+ *
+ * ThreadPoolScheduler is a simple TaskScheduler that runs tasks on a
+ * fixed pool of threads of its own. A host that has no scheduler of
+ * its own can give one of these to plugins and adapters through
+ * Plugin::setTaskScheduler() to let them run their work in parallel.
+ * One scheduler may be shared by any number of plugins.
+ *
+ * A thread that waits for a task that has not yet started runs it
+ * itself, and parallelFor() runs part of its work on the calling
+ * thread, so tasks may submit and wait for further tasks without
+ * the risk of every pool thread waiting at once.
+ *
+ * If a task throws an exception, it is rethrown from wait(). If a
+ * call of a parallelFor() body throws, the calls not yet started are
+ * skipped and the exception is rethrown from parallelFor() once the
+ * calls already running have finished.
+ *
+ * Every submitted task must have been waited for before the
+ * scheduler is deleted, and the scheduler must outlive every plugin
+ * it has been given to.
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin SDK.
+ */
+
+class ThreadPoolScheduler : public TaskScheduler
+{
+public:
+    /**
+     * Construct a scheduler with the given number of threads. If
+     * threads is 0, use one per hardware thread reported by the
+     * system.
+     */
+    ThreadPoolScheduler(size_t threads = 0);
+    virtual ~ThreadPoolScheduler();
+
+    Task submit(std::function<void()> task);
+    void wait(Task task);
+    void parallelFor(size_t count, std::function<void(size_t)> body);
+
+    /**
+     * Return the number of threads in the pool.
+     */
+    size_t getConcurrency() const;
+
+protected:
+    class Impl;
+    Impl *m_impl;
+
+private:
+    ThreadPoolScheduler(const ThreadPoolScheduler &); // not provided
+    ThreadPoolScheduler &operator=(const ThreadPoolScheduler &); // not provided
+};
+
+}
+
+}
+
+_VAMP_SDK_HOSTSPACE_END(ThreadPoolScheduler.h)
+
+#endif
@@ -37,16 +37,23 @@
 #ifndef _VAMP_HOSTSDK_SINGLE_INCLUDE_H_
 #define _VAMP_HOSTSDK_SINGLE_INCLUDE_H_
 
+#include "CompactFeature.h"
+#include "FeatureSink.h"
 #include "PluginBase.h"
 #include "PluginBufferingAdapter.h"
 #include "PluginChannelAdapter.h"
 #include "Plugin.h"
 #include "PluginHostAdapter.h"
 #include "PluginInputDomainAdapter.h"
+#include "PluginInstancePool.h"
 #include "PluginLoader.h"
+#include "PluginProfilingAdapter.h"
 #include "PluginSummarisingAdapter.h"
 #include "PluginWrapper.h"
 #include "RealTime.h"
+#include "TaskScheduler.h"
+#include "ThreadPoolScheduler.h"
+#include "Trace.h"
 
 #endif
 
@@ -43,6 +43,7 @@
 
 #include "PluginBase.h"
 #include "RealTime.h"
+#include "TaskScheduler.h"
 
 #include "plugguard.h"
 _VAMP_SDK_PLUGSPACE_BEGIN(Plugin.h)
@@ -416,6 +417,9 @@ public:
      * FFT input window (i.e. the very first block passed to process
      * might contain the FFT of half a block of zero samples and the
      * first half-block of the actual data, with a timestamp of zero).
+     * If the plugin has accepted a magnitude or power spectrum
+     * through setSpectrumFormat(), each array instead contains
+     * blockSize/2+1 floats, one per bin.
      *
      * Return any features that have become available after this
      * process call.  (These do not necessarily have to fall within
@@ -437,6 +441,274 @@ public:
      */
     virtual std::string getType() const { return "Feature Extraction Plugin"; }
 
+    // The virtual functions below were added in version 2.11 of the
+    // SDK. They follow all of the earlier ones so that the earlier
+    // ones keep their places in the vtable.
+
+    /**
+     * Process a single block of input data supplied with all
+     * channels in a single buffer, such as interleaved audio.
+     *
+     * The value at index i of channel c is found at
+     * inputBuffer[i * stride + c]. The stride will be at least the
+     * number of channels; it is equal to it for plain interleaved
+     * data. The channel count and the number of values per channel
+     * (frames) are those that process() would receive, i.e. the
+     * channel count passed to initialise() and blockSize for
+     * time-domain input. For frequency-domain input, frames is
+     * blockSize+2 for a complex spectrum or blockSize/2+1 for a
+     * magnitude or power spectrum accepted through
+     * setSpectrumFormat(). The content and timestamp are otherwise
+     * as for process().
+     *
+     * The default implementation de-interleaves the input into
+     * temporary buffers and calls process(). A plugin that can read
+     * strided input directly may reimplement this to avoid the copy,
+     * and should then also reimplement supportsStridedInput() so
+     * that hosts know to use it.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual FeatureSet processStrided(const float *inputBuffer,
+                                      size_t channels,
+                                      size_t frames,
+                                      size_t stride,
+                                      RealTime timestamp) {
+        std::vector<float> data(channels * frames);
+        std::vector<const float *> ptrs(channels);
+        for (size_t c = 0; c < channels; ++c) {
+            ptrs[c] = data.data() + c * frames;
+            for (size_t i = 0; i < frames; ++i) {
+                data[c * frames + i] = inputBuffer[i * stride + c];
+            }
+        }
+        return process(ptrs.data(), timestamp);
+    }
+
+    /**
+     * Return true if the plugin reads the input to processStrided()
+     * directly, so that a host holding interleaved or strided audio
+     * would do better to call processStrided() than to de-interleave
+     * it and call process(). The default implementation returns
+     * false.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual bool supportsStridedInput() const { return false; }
+
+    /**
+     * Process a single block of input data supplied in double
+     * precision. The layout, channel count, number of values per
+     * channel (frames) and timestamp are as described for
+     * processStrided(), except that the input is in one array per
+     * channel as for process().
+     *
+     * The default implementation converts the input to float in
+     * temporary buffers and calls process(). A plugin that works in
+     * double precision internally may reimplement this to avoid the
+     * conversion and the loss of precision, and should then also
+     * reimplement supportsDoubleInput() so that hosts know to use it.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual FeatureSet processDouble(const double *const *inputBuffers,
+                                     size_t channels,
+                                     size_t frames,
+                                     RealTime timestamp) {
+        std::vector<float> data(channels * frames);
+        std::vector<const float *> ptrs(channels);
+        for (size_t c = 0; c < channels; ++c) {
+            ptrs[c] = data.data() + c * frames;
+            for (size_t i = 0; i < frames; ++i) {
+                data[c * frames + i] = float(inputBuffers[c][i]);
+            }
+        }
+        return process(ptrs.data(), timestamp);
+    }
+
+    /**
+     * Return true if the plugin reads the input to processDouble()
+     * directly, so that a host holding double-precision audio would
+     * do better to call processDouble() than to convert it to float
+     * and call process(). The default implementation returns false.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual bool supportsDoubleInput() const { return false; }
+
+    enum SpectrumFormat {
+        ComplexSpectrum,
+        MagnitudeSpectrum,
+        PowerSpectrum
+    };
+
+    /**
+     * Get the format in which a frequency-domain plugin would prefer
+     * to receive its input. A plugin that only uses the magnitude
+     * (or squared magnitude) of each bin can ask for
+     * MagnitudeSpectrum (or PowerSpectrum) here, and so save itself
+     * the conversion from real and imaginary components. This is
+     * only a preference: the host need not honour it, and the
+     * plugin only receives the format it asks for if the host
+     * subsequently calls setSpectrumFormat() and that returns true.
+     *
+     * The default implementation returns ComplexSpectrum. The result
+     * is not meaningful for time-domain plugins.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual SpectrumFormat getPreferredSpectrumFormat() const {
+        return ComplexSpectrum;
+    }
+
+    /**
+     * Ask a frequency-domain plugin to accept its input in the given
+     * spectrum format. Return true if the plugin will expect that
+     * format in subsequent process(), processStrided() and
+     * processDouble() calls, or false if it cannot, in which case it
+     * continues to expect the complex spectrum. See process() for
+     * the layout of each format.
+     *
+     * This must be called before initialise(), if at all. The
+     * default implementation accepts only ComplexSpectrum. A plugin
+     * that reimplements getPreferredSpectrumFormat() should also
+     * reimplement this.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual bool setSpectrumFormat(SpectrumFormat format) {
+        return format == ComplexSpectrum;
+    }
+
+    enum StateDependency {
+        UnknownStateDependency,
+        BlockLocal,
+        BoundedHistory,
+        WholeSignal
+    };
+
+    /**
+     * Return how far the features returned from each process() call
+     * depend on the input to earlier calls. This tells a host whether
+     * it may split a signal into segments, process each in a separate
+     * instance of the plugin (perhaps in parallel), and combine the
+     * results to get the same features as from a single run.
+     *
+     * BlockLocal - the features from each block depend only on that
+     * block. Segments may start at any block boundary.
+     *
+     * BoundedHistory - the features from each block depend on that
+     * block and at most getWarmUpBlockCount() blocks before it. Each
+     * segment may be processed separately provided that its instance
+     * is first given that many preceding blocks, whose features are
+     * discarded.
+     *
+     * WholeSignal - the features may depend on any of the preceding
+     * input, or are only calculated in getRemainingFeatures(). The
+     * signal should not be split.
+     *
+     * UnknownStateDependency - the plugin does not say. Hosts should
+     * treat this as WholeSignal.
+     *
+     * The answer should hold for the default parameter values, as a
+     * host may ask before configuring the plugin. The default
+     * implementation returns UnknownStateDependency.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual StateDependency getStateDependency() const {
+        return UnknownStateDependency;
+    }
+
+    /**
+     * Return the number of preceding process blocks that each block's
+     * features depend on, if getStateDependency() returns
+     * BoundedHistory. The default implementation returns 0.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual size_t getWarmUpBlockCount() const { return 0; }
+
+    typedef std::vector<unsigned char> StateData;
+
+    /**
+     * Write into the given state a snapshot of everything the plugin has
+     * accumulated from the input processed since it was initialised
+     * or last reset, and return true. Return false if the plugin
+     * does not support saving its state.
+     *
+     * The snapshot can be passed to setState() on another instance
+     * of the same plugin, created with the same sample rate, given
+     * the same parameter and program settings and initialised with
+     * the same arguments, which will then continue exactly as this
+     * instance would. This lets a host checkpoint a long stream and
+     * recover from the checkpoint later, or fork one instance that
+     * has been warmed up into several.
+     *
+     * The snapshot is an opaque byte sequence whose format is up to
+     * the plugin. It need not be portable between plugin versions or
+     * platforms. The default implementation returns false.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual bool getState(StateData &) const { return false; }
+
+    /**
+     * Restore a snapshot previously obtained from getState(), as
+     * described there. The plugin must already have been initialised.
+     * Return true on success, or false if the plugin does not support
+     * restoring its state or the snapshot is not one it can use, in
+     * which case the plugin should be left as if just reset. The
+     * default implementation returns false.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual bool setState(const StateData &) { return false; }
+
+    /**
+     * Provide a scheduler through which the plugin may run work in
+     * parallel on the host's threads, rather than starting threads
+     * of its own. See TaskScheduler.
+     *
+     * If called at all, this is called before initialise(). The
+     * scheduler remains owned by the host and stays valid until the
+     * plugin is deleted. A plugin that is never given a scheduler
+     * should use TaskScheduler::getSerialScheduler(). The default
+     * implementation ignores the scheduler.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual void setTaskScheduler(TaskScheduler *) { }
+
+    /**
+     * Tell the plugin which of its outputs the host will use. The
+     * vector has one element per output, in the order returned by
+     * getOutputDescriptors(), and an output whose element is false
+     * is disabled. Outputs with no element in the vector are enabled.
+     *
+     * If called at all, this is called before initialise(). The
+     * plugin need not calculate features for a disabled output, and
+     * the host will discard any that it does return, so a plugin can
+     * use this to skip work whose only product is an output nobody
+     * reads. The default implementation ignores the call, so that all
+     * outputs are calculated as usual.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    virtual void setEnabledOutputs(const std::vector<bool> &) { }
+
     /**
      * Retrieve the input sample rate set on construction.
      */
@@ -73,6 +73,19 @@ public:
      */
     const VampPluginDescriptor *getDescriptor();
 
+    /**
+     * Return the VampPluginExtensions supported for the given
+     * descriptor, if it is one returned by getDescriptor() on some
+     * adapter in this library, or NULL otherwise. This is what the
+     * SDK's implementation of vampGetPluginExtensions returns; plugin
+     * libraries do not normally need to call it.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    static const VampPluginExtensions *getExtensions
+    (const VampPluginDescriptor *descriptor);
+
 protected:
     PluginAdapterBase();
 
@@ -46,6 +46,7 @@
 
 #include <iostream>
 #include <string>
+#include <cstdint>
 
 #ifndef _WIN32
 struct timeval;
@@ -80,6 +81,30 @@ struct RealTime
     static RealTime fromSeconds(double sec);
     static RealTime fromMilliseconds(int msec);
 
+    /**
+     * Return a RealTime for the given signed number of nanoseconds.
+     * This is exact, involving integer arithmetic only.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    static RealTime fromNanoseconds(int64_t nsec) {
+        return RealTime(int(nsec / 1000000000), int(nsec % 1000000000));
+    }
+
+    /**
+     * Return this time as a signed number of nanoseconds. Unlike a
+     * conversion through seconds as a double, this is exact for all
+     * times, and differences between nanosecond values do not drift
+     * however long the times are.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    int64_t toNanoseconds() const {
+        return int64_t(sec) * 1000000000 + nsec;
+    }
+
 #ifndef _WIN32
     static RealTime fromTimeval(const struct timeval &);
 #endif
@@ -145,6 +170,38 @@ struct RealTime
      */
     std::string toText(bool fixedDp = false) const;
 
+    /**
+     * The number of characters that toChars or toTextChars may write
+     * for any time. A buffer of this size is always large enough.
+     *
+     * \note This was introduced in version 2.11 of the Vamp plugin
+     * SDK.
+     */
+    static const int maxFormattedLength = 24;
+
+    /**
+     * Write the same text as toString into the range [first, last),
+     * without allocating or using the stream locale, and return a
+     * pointer just past the last character written. No terminating
+     * null is written. If the range is too short, return 0; the
+     * contents of the range are then unspecified.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    char *toChars(char *first, char *last) const;
+
+    /**
+     * Write the same text as toText into the range [first, last),
+     * without allocating or using the stream locale, and return a
+     * pointer just past the last character written, or 0 if the
+     * range is too short, as for toChars.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    char *toTextChars(char *first, char *last, bool fixedDp = false) const;
+
     /**
      * Convert a RealTime into a sample frame at the given sample rate.
      */
@@ -155,6 +212,28 @@ struct RealTime
      */
     static RealTime frame2RealTime(long frame, unsigned int sampleRate);
 
+    /**
+     * Convert a RealTime into a sample frame at the given sample
+     * rate, rounding to the nearest frame. Unlike realTime2Frame,
+     * this uses exact integer arithmetic and a 64-bit frame count on
+     * all platforms, so it is suitable for streams of any length.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    static int64_t toFrame(const RealTime &r, unsigned int sampleRate);
+
+    /**
+     * Convert a sample frame at the given sample rate into a
+     * RealTime, rounding to the nearest nanosecond. Unlike
+     * frame2RealTime, this uses exact integer arithmetic and a 64-bit
+     * frame count on all platforms.
+     *
+     * \note This function was introduced in version 2.11 of the Vamp
+     * plugin SDK.
+     */
+    static RealTime fromFrame(int64_t frame, unsigned int sampleRate);
+
     static const RealTime zeroTime;
 };
 
@@ -0,0 +1,145 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#ifndef _VAMP_SDK_TASK_SCHEDULER_H_
+#define _VAMP_SDK_TASK_SCHEDULER_H_
+
+#include <functional>
+#include <cstddef>
+
+#include "plugguard.h"
+_VAMP_SDK_PLUGSPACE_BEGIN(TaskScheduler.h)
+
+namespace Vamp {
+
+/**
+ * \class TaskScheduler TaskScheduler.h <vamp-sdk/TaskScheduler.h>
+ *
+ * TaskScheduler is an interface through which a plugin can run work
+ * in parallel using threads belonging to the host, instead of
+ * starting threads of its own. A host that runs several plugins at
+ * once, or several instances of one plugin, can then keep the total
+ * number of busy threads within the number of cores available.
+ *
+ * The host supplies a scheduler through Plugin::setTaskScheduler()
+ * before the plugin is initialised. A plugin that is never given one
+ * should use getSerialScheduler(), which runs everything at once on
+ * the calling thread, so that the same plugin code works either way.
+ *
+ * All functions may be called from any thread, including from within
+ * a task. A task must not assume that it runs on a different thread
+ * from the one that submitted it.
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin
+ * SDK.
+ */
+
+class TaskScheduler
+{
+public:
+    virtual ~TaskScheduler() { }
+
+    /**
+     * Opaque identifier for a submitted task.
+     */
+    typedef void *Task;
+
+    /**
+     * Submit a task to be run at some point before the corresponding
+     * call to wait() returns. Every task submitted must be waited for
+     * exactly once. The returned value may be 0 if the task has
+     * already been run.
+     */
+    virtual Task submit(std::function<void()> task) = 0;
+
+    /**
+     * Wait for a task returned by submit() to complete. Waiting for a
+     * task of 0 does nothing.
+     */
+    virtual void wait(Task task) = 0;
+
+    /**
+     * Call body once for each index from 0 to count-1, in any order
+     * and possibly concurrently, returning when all calls are
+     * complete.
+     */
+    virtual void parallelFor(size_t count,
+                             std::function<void(size_t)> body) = 0;
+
+    /**
+     * Return the number of tasks the host expects to be able to run
+     * at once, as a guide to how finely to divide work. A serial
+     * scheduler returns 1.
+     */
+    virtual size_t getConcurrency() const = 0;
+
+    /**
+     * Return a scheduler that runs each task immediately on the
+     * calling thread. This is the scheduler a plugin should use if
+     * the host has not provided one.
+     */
+    static TaskScheduler *getSerialScheduler();
+
+private:
+    class SerialScheduler;
+};
+
+class TaskScheduler::SerialScheduler : public TaskScheduler
+{
+public:
+    Task submit(std::function<void()> task) {
+        task();
+        return 0;
+    }
+    void wait(Task) { }
+    void parallelFor(size_t count, std::function<void(size_t)> body) {
+        for (size_t i = 0; i < count; ++i) body(i);
+    }
+    size_t getConcurrency() const { return 1; }
+};
+
+inline TaskScheduler *
+TaskScheduler::getSerialScheduler()
+{
+    static SerialScheduler scheduler;
+    return &scheduler;
+}
+
+}
+
+_VAMP_SDK_PLUGSPACE_END(TaskScheduler.h)
+
+#endif
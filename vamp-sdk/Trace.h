@@ -0,0 +1,137 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp
+
+    An API for audio analysis and feature extraction plugins.
+
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2006-2020 Chris Cannam and QMUL.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+#ifndef _VAMP_SDK_TRACE_H_
+#define _VAMP_SDK_TRACE_H_
+
+#include <iostream>
+
+#include "plugguard.h"
+_VAMP_SDK_PLUGSPACE_BEGIN(Trace.h)
+
+namespace Vamp {
+
+/**
+ * \class Trace Trace.h <vamp-sdk/Trace.h>
+ *
+ * Trace records how long each process call spends in each layer of
+ * a plugin and its adapters, so that the cost of a block can be
+ * broken down in a running host without attaching a profiler.
+ *
+ * Recording only happens in code built with VAMP_TRACE defined,
+ * through the VAMP_TRACE_SCOPE macro. Without it the macro expands
+ * to nothing and Trace records nothing. The SDK's own libraries use
+ * the macro in the process functions of PluginAdapter and of each
+ * host-side adapter, so building the SDK with -DVAMP_TRACE is enough
+ * to trace a plugin through the whole adapter chain.
+ *
+ * Each thread records into a fixed-size ring of its own without
+ * locking, overwriting its oldest events when the ring is full.
+ * Events can be written out in the Chrome trace event format, which
+ * chrome://tracing and Perfetto will display.
+ *
+ * The plugin and host SDK libraries each keep their own events. If
+ * the environment variable VAMP_TRACE_FILE is set when a library
+ * that has recorded events is unloaded, or at exit, it appends them
+ * to the named file, so that a single file collects the events from
+ * the host and from every plugin library.
+ *
+ * \note This class was introduced in version 2.11 of the Vamp plugin
+ * SDK.
+ */
+
+class Trace
+{
+public:
+    /**
+     * Records a single event spanning the lifetime of the object.
+     * The name must be a string literal or otherwise outlive the
+     * recorded events.
+     */
+    class Scope
+    {
+    public:
+        Scope(const char *name) : m_name(name), m_start(now()) { }
+        ~Scope() { record(m_name, m_start, now()); }
+
+    private:
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        const char *m_name;
+        long long m_start;
+    };
+
+    /**
+     * Return the current time in nanoseconds from an arbitrary
+     * origin, as used in recorded events.
+     */
+    static long long now();
+
+    /**
+     * Record an event for the calling thread, with start and end
+     * times obtained from now().
+     */
+    static void record(const char *name, long long start, long long end);
+
+    /**
+     * Write every event recorded so far, by any thread, to the given
+     * stream as a complete Chrome trace event JSON array. Threads
+     * that are still recording may have their most recent events
+     * omitted.
+     */
+    static void writeChromeTrace(std::ostream &out);
+
+    /**
+     * Discard all recorded events.
+     */
+    static void clear();
+};
+
+}
+
+#ifdef VAMP_TRACE
+#define VAMP_TRACE_SCOPE_NAME2(line) _vampTraceScope##line
+#define VAMP_TRACE_SCOPE_NAME(line) VAMP_TRACE_SCOPE_NAME2(line)
+#define VAMP_TRACE_SCOPE(name) \
+    Vamp::Trace::Scope VAMP_TRACE_SCOPE_NAME(__LINE__)(name)
+#else
+#define VAMP_TRACE_SCOPE(name)
+#endif
+
+_VAMP_SDK_PLUGSPACE_END(Trace.h)
+
+#endif
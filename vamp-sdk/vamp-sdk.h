@@ -41,6 +41,8 @@
 #include "Plugin.h"
 #include "RealTime.h"
 #include "FFT.h"
+#include "TaskScheduler.h"
+#include "Trace.h"
 
 #endif
 
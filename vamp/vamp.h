@@ -37,6 +37,8 @@
 #ifndef VAMP_HEADER_INCLUDED
 #define VAMP_HEADER_INCLUDED
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -245,6 +247,28 @@ typedef enum
 
 typedef void *VampPluginHandle;
 
+typedef enum
+{
+    vampUnknownStateDependency,
+    vampBlockLocal,
+    vampBoundedHistory,
+    vampWholeSignal
+
+} VampStateDependency;
+
+typedef enum
+{
+    /** Complex spectrum as real/imaginary pairs (the default). */
+    vampComplexSpectrum,
+
+    /** Magnitude spectrum, one value per bin. */
+    vampMagnitudeSpectrum,
+
+    /** Power (squared magnitude) spectrum, one value per bin. */
+    vampPowerSpectrum
+
+} VampSpectrumFormat;
+
 typedef struct _VampPluginDescriptor
 {
     /** API version with which this descriptor is compatible. */
@@ -381,6 +405,221 @@ const VampPluginDescriptor *vampGetPluginDescriptor
 typedef const VampPluginDescriptor *(*VampGetPluginDescriptorFunction)
     (unsigned int, unsigned int);
 
+/**
+ * Task scheduler supplied by a host, through which a plugin may run
+ * work in parallel on the host's threads. See setTaskScheduler in
+ * VampPluginExtensions, and Vamp::TaskScheduler.
+ *
+ * All functions may be called from any thread, including from
+ * within a running task. As with VampPluginExtensions, the plugin
+ * must not use any field that does not lie wholly within
+ * schedulerSize bytes of the start of the structure.
+ *
+ * This structure was introduced in version 2.11 of the Vamp plugin
+ * SDK.
+ */
+typedef struct _VampTaskScheduler
+{
+    /** Size of this structure as known to the host, in bytes. */
+    unsigned int schedulerSize;
+
+    /** Host data, passed as the first argument to each function. */
+    void *context;
+
+    /** Arrange for task(arg) to be called, and return a non-NULL
+        identifier for it to pass to wait. Every submitted task must
+        be waited for exactly once. Return NULL if the task cannot be
+        accepted, in which case the plugin will run it itself. */
+    void *(*submit)(void *context,
+                    void (*task)(void *arg),
+                    void *arg);
+
+    /** Return once the task with the given identifier is complete.
+        The host may run other tasks on the calling thread
+        meanwhile. */
+    void (*wait)(void *context, void *task);
+
+    /** Call body(arg, i) for each i from 0 to count-1, in any order
+        and possibly concurrently, returning when all are complete. */
+    void (*parallelFor)(void *context,
+                        unsigned int count,
+                        void (*body)(void *arg, unsigned int index),
+                        void *arg);
+
+    /** Return the number of tasks the host expects to run at once. */
+    unsigned int (*getConcurrency)(void *context);
+
+} VampTaskScheduler;
+
+/**
+ * Optional extensions to the plugin descriptor.
+ *
+ * These are obtained from vampGetPluginExtensions rather than from
+ * the descriptor itself, so that they can be added without changing
+ * the binary layout of VampPluginDescriptor. New fields are only ever
+ * appended. A host must not use any field that does not lie wholly
+ * within extensionsSize bytes of the start of the structure, and must
+ * treat a NULL function pointer as meaning the extension is absent.
+ *
+ * These extensions were introduced in version 2.11 of the Vamp
+ * plugin SDK.
+ */
+typedef struct _VampPluginExtensions
+{
+    /** Size of this structure as known to the plugin, in bytes. */
+    unsigned int extensionsSize;
+
+    /** Process an input block as process() does, but write the
+        resulting feature set into the host-supplied buffer instead of
+        into memory owned by the plugin. The buffer must be aligned
+        suitably for any type, as malloc's return value is.
+
+        Return the number of bytes the feature set occupies. If this
+        is no greater than bufferSize, the buffer begins with the
+        plugin's VampFeatureList array and everything it points to
+        lies within the buffer, which the host continues to own; no
+        releaseFeatureSet call is needed. If it is greater than
+        bufferSize, nothing has been written: the plugin retains the
+        features and the host should call retrieveFeatures with a
+        buffer of at least the returned size. */
+    size_t (*processToBuffer)(VampPluginHandle,
+                              const float *const *inputBuffers,
+                              int sec,
+                              int nsec,
+                              void *buffer,
+                              size_t bufferSize);
+
+    /** Return any remaining features at the end of processing, in
+        the same manner as processToBuffer. */
+    size_t (*getRemainingFeaturesToBuffer)(VampPluginHandle,
+                                           void *buffer,
+                                           size_t bufferSize);
+
+    /** Write the features retained by the most recent call to
+        processToBuffer or getRemainingFeaturesToBuffer that found its
+        buffer too small, with the same return value convention. The
+        retained features are discarded once written, or on the next
+        process call. */
+    size_t (*retrieveFeatures)(VampPluginHandle,
+                               void *buffer,
+                               size_t bufferSize);
+
+    /** Return 1 if the plugin reads the input to processStrided
+        directly, so that a host holding interleaved or strided audio
+        would do better to call processStrided than to de-interleave
+        it and call process. Return 0 otherwise. */
+    int (*supportsStridedInput)(VampPluginHandle);
+
+    /** Process an input block as process() does, but with all
+        channels supplied in one buffer: value i of channel c is at
+        inputBuffer[i * stride + c], and stride is at least the
+        channel count. The channel count and number of values per
+        channel are those process() would receive. The returned
+        feature set is as for process(). */
+    VampFeatureList *(*processStrided)(VampPluginHandle,
+                                       const float *inputBuffer,
+                                       unsigned int stride,
+                                       int sec,
+                                       int nsec);
+
+    /** Return how far the output for each process block depends on
+        preceding input, for the plugin with the given descriptor in
+        its default configuration, without the host having to
+        instantiate it. For vampBoundedHistory, also set
+        *warmUpBlocks to the number of preceding blocks needed. See
+        Vamp::Plugin::getStateDependency. */
+    VampStateDependency (*getStateDependency)(const VampPluginDescriptor *,
+                                              unsigned int *warmUpBlocks);
+
+    /** Take a snapshot of the plugin's processing state, as
+        Vamp::Plugin::getState. Return 0 if the plugin cannot do so.
+        Otherwise set *stateSize to the number of bytes in the
+        snapshot, copy the snapshot into the host-supplied buffer if
+        it is no larger than bufferSize, and return 1. A host that
+        does not know the size in advance may call with a zero
+        bufferSize first. */
+    int (*getState)(VampPluginHandle,
+                    void *buffer,
+                    size_t bufferSize,
+                    size_t *stateSize);
+
+    /** Restore a snapshot obtained from getState, as
+        Vamp::Plugin::setState. Return 1 on success, 0 on failure. */
+    int (*setState)(VampPluginHandle,
+                    const void *state,
+                    size_t stateSize);
+
+    /** Provide a task scheduler for the plugin to use, as
+        Vamp::Plugin::setTaskScheduler. Call after instantiate and
+        before initialise. The scheduler must remain valid until
+        cleanup is called. Pass NULL to have the plugin run its tasks
+        serially, which is also what happens if this is never
+        called. */
+    void (*setTaskScheduler)(VampPluginHandle,
+                             const VampTaskScheduler *scheduler);
+
+    /** Tell the plugin which of its outputs the host will use, as
+        Vamp::Plugin::setEnabledOutputs. enabled[i] is nonzero if
+        output i is wanted, for i from 0 to outputCount-1; outputs
+        beyond outputCount are wanted. Call after instantiate and
+        before initialise. The plugin leaves the feature lists of
+        disabled outputs empty. */
+    void (*setEnabledOutputs)(VampPluginHandle,
+                              const int *enabled,
+                              unsigned int outputCount);
+
+    /** Return 1 if the plugin reads the input to processDouble
+        directly, so that a host holding double-precision audio would
+        do better to call processDouble than to convert it to float
+        and call process. Return 0 otherwise. */
+    int (*supportsDoubleInput)(VampPluginHandle);
+
+    /** Process an input block as process() does, but with the input
+        in double precision. The returned feature set is as for
+        process(). */
+    VampFeatureList *(*processDouble)(VampPluginHandle,
+                                      const double *const *inputBuffers,
+                                      int sec,
+                                      int nsec);
+
+    /** Return the spectrum format the plugin would prefer to receive,
+        as Vamp::Plugin::getPreferredSpectrumFormat. Only meaningful
+        for frequency-domain plugins. */
+    VampSpectrumFormat (*getPreferredSpectrumFormat)(VampPluginHandle);
+
+    /** Ask the plugin to accept its frequency-domain input in the
+        given format, as Vamp::Plugin::setSpectrumFormat. Call after
+        instantiate and before initialise. Return 1 if the plugin
+        accepts the format and 0 otherwise; a plugin that refuses
+        continues to expect the complex spectrum. */
+    int (*setSpectrumFormat)(VampPluginHandle, VampSpectrumFormat format);
+
+} VampPluginExtensions;
+
+/** True if the given (possibly NULL) extensions structure is long
+    enough to include the named field and that field is set. */
+#define VAMP_HAS_EXTENSION(ext, field) \
+    ((ext) && \
+     offsetof(VampPluginExtensions, field) + sizeof((ext)->field) <= \
+     (ext)->extensionsSize && \
+     (ext)->field)
+
+/** Get the extensions supported by the given plugin descriptor, which
+    must have been returned by vampGetPluginDescriptor in the same
+    library. Return NULL if there are none.
+
+    A plugin library need not export this symbol, and hosts should
+    not require it. The Vamp plugin SDK provides it for libraries
+    built using PluginAdapter; a library that restricts its exported
+    symbols should export it as well as vampGetPluginDescriptor.
+*/
+const VampPluginExtensions *vampGetPluginExtensions
+    (const VampPluginDescriptor *descriptor);
+
+/** Function pointer type for vampGetPluginExtensions. */
+typedef const VampPluginExtensions *(*VampGetPluginExtensionsFunction)
+    (const VampPluginDescriptor *);
+
 #ifdef __cplusplus
 }
 #endif